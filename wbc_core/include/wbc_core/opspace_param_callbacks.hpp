@@ -36,8 +36,22 @@ namespace wbc_core_opspace {
   class ParamCallbacks
   {
   public:
+    /**
+       Gets told about every parameter that was successfully written
+       through a service call or a channel, e.g. for recording a
+       session. Runs in whichever thread spins the ROS callbacks.
+    */
+    class Observer {
+    public:
+      virtual ~Observer() {}
+      virtual void written(opspace::Parameter const * param) = 0;
+    };
+    
     ParamCallbacks();
     
+    /** Does not transfer ownership, pass zero to remove it. */
+    inline void setObserver(Observer * observer) { observer_ = observer; }
+    
     void init(ros::NodeHandle node,
 	      boost::shared_ptr<opspace::ReflectionRegistry> registry,
 	      size_t input_queue_size,
@@ -92,6 +106,7 @@ namespace wbc_core_opspace {
     std::map<int, opspace::MatrixParameter *> matrices_;
     
     int next_channel_id_;
+    Observer * observer_;
   };
   
 }
@@ -33,7 +33,8 @@ namespace wbc_core_opspace {
   
   ParamCallbacks::
   ParamCallbacks()
-    : next_channel_id_(0)
+    : next_channel_id_(0),
+      observer_(0)
   {
   }
   
@@ -179,6 +180,10 @@ namespace wbc_core_opspace {
       status.errstr = "unsupported or invalid type";
     }
     
+    if (status && observer_) {
+      observer_->written(param);
+    }
+    
     response.ok = status.ok;
     response.errstr = status.errstr;
     return true;
@@ -446,6 +451,9 @@ namespace wbc_core_opspace {
 	feedback.ok = false;
 	feedback.errstr = status.errstr;
       }
+      else if (observer_) {
+	observer_->written(ip->second);
+      }
     }
     
     channel_feedback_.publish(feedback);
@@ -472,6 +480,9 @@ namespace wbc_core_opspace {
 	feedback.ok = false;
 	feedback.errstr = status.errstr;
       }
+      else if (observer_) {
+	observer_->written(ip->second);
+      }
     }
     
     channel_feedback_.publish(feedback);
@@ -498,6 +509,9 @@ namespace wbc_core_opspace {
 	feedback.ok = false;
 	feedback.errstr = status.errstr;
       }
+      else if (observer_) {
+	observer_->written(ip->second);
+      }
     }
     
     channel_feedback_.publish(feedback);
@@ -525,6 +539,9 @@ namespace wbc_core_opspace {
 	feedback.ok = false;
 	feedback.errstr = status.errstr;
       }
+      else if (observer_) {
+	observer_->written(ip->second);
+      }
     }
     
     channel_feedback_.publish(feedback);
@@ -552,6 +569,9 @@ namespace wbc_core_opspace {
 	feedback.ok = false;
 	feedback.errstr = status.errstr;
       }
+      else if (observer_) {
+	observer_->written(ip->second);
+      }
     }
     
     channel_feedback_.publish(feedback);
@@ -18,6 +18,7 @@
 #endif
 
 #include <wbc_tinyxml/wbc_tinyxml.h>
+#include <wbc_tinyxml/wbc_tinyxmlinsitu.h>
 using namespace wbc_tinyxml;
 
 bool XmlTest (const char* testString, const char* expected, const char* found, bool noEcho = false);
@@ -70,6 +71,39 @@ bool XmlTest( const char* testString, int expected, int found, bool noEcho )
 }
 
 
+// Compare the elements, attributes, and text of a DOM tree with an
+// in-situ tree. Comments and declarations only exist in the former.
+static bool SameTree( const TiXmlNode* dom, const TiXmlInSituNode* insitu )
+{
+	const TiXmlNode* dd = dom->FirstChild();
+	const TiXmlInSituNode* ii = insitu->FirstChild();
+	for (;; dd = dd->NextSibling(), ii = ii->NextSibling() )
+	{
+		while ( dd && dd->Type() != TiXmlNode::TINYXML_ELEMENT && dd->Type() != TiXmlNode::TINYXML_TEXT )
+			dd = dd->NextSibling();
+		if ( !dd || !ii )
+			return !dd && !ii;
+		if ( strcmp( dd->Value(), ii->Value() ) )
+			return false;
+		if ( dd->Type() == TiXmlNode::TINYXML_TEXT )
+		{
+			if ( ii->Type() != TiXmlInSituNode::INSITU_TEXT )
+				return false;
+			continue;
+		}
+		const TiXmlAttribute* da = dd->ToElement()->FirstAttribute();
+		const TiXmlInSituAttribute* ia = ii->FirstAttribute();
+		for ( ; da && ia; da = da->Next(), ia = ia->Next() )
+		{
+			if ( strcmp( da->Name(), ia->Name() ) || strcmp( da->Value(), ia->Value() ) )
+				return false;
+		}
+		if ( da || ia || !SameTree( dd, ii ) )
+			return false;
+	}
+}
+
+
 //
 // This file demonstrates some basic functionality of TinyXml.
 // Note that the example is very contrived. It presumes you know
@@ -1339,6 +1373,67 @@ int main()
 		}*/
 	}
 
+	{
+		// In-situ parsing: names, text, and attributes are
+		// terminated and entity-decoded inside the buffer.
+		TiXmlBase::SetCondenseWhiteSpace( true );
+		char buf[] =
+			"<?xml version=\"1.0\" ?>\n"
+			"<!-- leading comment -->\n"
+			"<robot name='tut&amp;rob' id=\"&#65;&#x42;\">\n"
+			"  <pos>  0,   0,\n -9.81  </pos>\n"
+			"  <empty/>\n"
+			"  <!-- <pos>ignored</pos> -->\n"
+			"  <note>a &lt;b&gt; &quot;c&quot;</note>\n"
+			"  <raw><![CDATA[ <not> &amp; parsed ]]></raw>\n"
+			"  <jointNode><ID>0</ID></jointNode><jointNode><ID>1</ID></jointNode>\n"
+			"</robot>\n";
+		TiXmlInSituDocument doc;
+		XmlTest( "In-situ parse.", true, doc.Parse( buf, sizeof( buf ) - 1 ) );
+		TiXmlInSituNode* robot = doc.RootElement();
+		XmlTest( "In-situ root element.", "robot", robot->Value() );
+		XmlTest( "In-situ attribute entity.", "tut&rob", robot->Attribute( "name" ) );
+		XmlTest( "In-situ attribute char refs.", "AB", robot->Attribute( "id" ) );
+		XmlTest( "In-situ missing attribute.", true, 0 == robot->Attribute( "nope" ) );
+		XmlTest( "In-situ condensed text.", "0, 0, -9.81", robot->FirstChildElement( "pos" )->GetText() );
+		XmlTest( "In-situ empty element.", true, 0 == robot->FirstChildElement( "empty" )->FirstChild() );
+		XmlTest( "In-situ text entities.", "a <b> \"c\"", robot->FirstChildElement( "note" )->GetText() );
+		XmlTest( "In-situ CDATA.", " <not> &amp; parsed ", robot->FirstChildElement( "raw" )->GetText() );
+		TiXmlInSituNode* joint = robot->FirstChildElement( "jointNode" );
+		XmlTest( "In-situ sibling elements.", "1",
+			 joint->NextSiblingElement( "jointNode" )->FirstChildElement( "ID" )->GetText() );
+		XmlTest( "In-situ comments skipped.", true, 0 == robot->FirstChildElement( "pos" )->NextSiblingElement( "pos" ) );
+		XmlTest( "In-situ node count.", 14, (int) doc.NodeCount() );
+	}
+	{
+		TiXmlBase::SetCondenseWhiteSpace( true );
+		char mismatched[] = "<a>\n<b>\n</a>";
+		TiXmlInSituDocument doc;
+		XmlTest( "In-situ mismatched end tag.", false, doc.Parse( mismatched, sizeof( mismatched ) - 1 ) );
+		XmlTest( "In-situ error row.", 3, doc.ErrorRow() );
+
+		char unclosed[] = "<a><b>text";
+		XmlTest( "In-situ missing end tag.", false, doc.Parse( unclosed, sizeof( unclosed ) - 1 ) );
+
+		char quotes[] = "<a x=\"1></a>";
+		XmlTest( "In-situ bad end quotes.", false, doc.Parse( quotes, sizeof( quotes ) - 1 ) );
+
+		char empty[] = "  <!-- nothing -->  ";
+		XmlTest( "In-situ empty document.", false, doc.Parse( empty, sizeof( empty ) - 1 ) );
+		XmlTest( "In-situ empty document.", "Document empty", doc.ErrorDesc() );
+
+		XmlTest( "In-situ missing file.", false, doc.LoadFile( "no_such_file.xml" ) );
+	}
+	{
+		// LoadFile() must agree with the DOM on a real document.
+		TiXmlBase::SetCondenseWhiteSpace( true );
+		TiXmlDocument dom;
+		dom.LoadFile( "demotest.xml" );
+		TiXmlInSituDocument insitu;
+		XmlTest( "In-situ LoadFile.", true, insitu.LoadFile( "demotest.xml" ) );
+		XmlTest( "In-situ matches DOM.", true, SameTree( &dom, insitu.RootElement()->Parent() ) );
+	}
+
 	/*  1417717 experiment
 	{
 		TiXmlDocument xml;
@@ -0,0 +1,731 @@
+/*
+www.sourceforge.net/projects/tinyxml
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any
+damages arising from the use of this software.
+
+Permission is granted to anyone to use this software for any
+purpose, including commercial applications, and to alter it and
+redistribute it freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this
+software in a product, an acknowledgment in the product documentation
+would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and
+must not be misrepresented as being the original software.
+
+3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+#include "wbc_tinyxmlinsitu.h"
+#include "wbc_tinyxml.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace wbc_tinyxml {
+
+// The first arena block is this big, each further block doubles the
+// previous one, so even large documents need only a few of them.
+static const size_t TIXML_INSITU_FIRST_BLOCK = 4096;
+
+struct TiXmlInSituDocument::Block
+{
+	Block* next;
+	size_t size;
+	size_t used;
+};
+
+
+static inline bool IsSpace( char c )
+{
+	return ' ' == c || '\n' == c || '\r' == c || '\t' == c;
+}
+
+
+static inline bool IsNameStart( char c )
+{
+	return ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' )
+		|| '_' == c || ':' == c || (unsigned char) c >= 0x80;
+}
+
+
+static inline bool IsNameChar( char c )
+{
+	return IsNameStart( c ) || ( c >= '0' && c <= '9' ) || '-' == c || '.' == c;
+}
+
+
+static char* SkipSpace( char* p, char* end )
+{
+	while ( p < end && IsSpace( *p ) )
+		++p;
+	return p;
+}
+
+
+// Returns a pointer to the first occurrence of pattern in [p, end),
+// or null. The buffer is not NUL-terminated, hence no strstr().
+static char* Find( char* p, char* end, const char* pattern )
+{
+	const size_t len = strlen( pattern );
+	while ( p + len <= end )
+	{
+		char* q = (char*) memchr( p, pattern[0], end - p - len + 1 );
+		if ( !q )
+			return 0;
+		if ( 0 == memcmp( q, pattern, len ) )
+			return q;
+		p = q + 1;
+	}
+	return 0;
+}
+
+
+// Decode the entity starting at p (which points to the '&') and write
+// the result to *out. The decoded form is never longer than the
+// entity, which is what makes in-place decoding work. Unknown or
+// malformed entities are copied verbatim, like TiXmlBase::GetEntity()
+// does. Returns the position after the entity.
+static char* DecodeEntity( char* p, char* end, char** out )
+{
+	static const struct { const char* str; size_t len; char chr; } entity[] =
+	{
+		{ "&amp;",  5, '&' },
+		{ "&lt;",   4, '<' },
+		{ "&gt;",   4, '>' },
+		{ "&quot;", 6, '\"' },
+		{ "&apos;", 6, '\'' }
+	};
+
+	if ( p + 1 < end && '#' == p[1] )
+	{
+		char* q = p + 2;
+		unsigned long code = 0;
+		bool hex = q < end && ( 'x' == *q || 'X' == *q );
+		if ( hex )
+			++q;
+		char* digits = q;
+		for ( ; q < end && ';' != *q && q - digits < 8; ++q )
+		{
+			char c = *q;
+			if ( c >= '0' && c <= '9' )
+				code = code * ( hex ? 16 : 10 ) + ( c - '0' );
+			else if ( hex && c >= 'a' && c <= 'f' )
+				code = code * 16 + ( c - 'a' + 10 );
+			else if ( hex && c >= 'A' && c <= 'F' )
+				code = code * 16 + ( c - 'A' + 10 );
+			else
+				break;
+		}
+		if ( q < end && ';' == *q && q > digits && code > 0 && code <= 0x10FFFF )
+		{
+			char* o = *out;
+			if ( code < 0x80 )
+				*o++ = (char) code;
+			else if ( code < 0x800 )
+			{
+				*o++ = (char) ( 0xC0 | ( code >> 6 ) );
+				*o++ = (char) ( 0x80 | ( code & 0x3F ) );
+			}
+			else if ( code < 0x10000 )
+			{
+				*o++ = (char) ( 0xE0 | ( code >> 12 ) );
+				*o++ = (char) ( 0x80 | ( ( code >> 6 ) & 0x3F ) );
+				*o++ = (char) ( 0x80 | ( code & 0x3F ) );
+			}
+			else
+			{
+				*o++ = (char) ( 0xF0 | ( code >> 18 ) );
+				*o++ = (char) ( 0x80 | ( ( code >> 12 ) & 0x3F ) );
+				*o++ = (char) ( 0x80 | ( ( code >> 6 ) & 0x3F ) );
+				*o++ = (char) ( 0x80 | ( code & 0x3F ) );
+			}
+			*out = o;
+			return q + 1;
+		}
+	}
+	else
+	{
+		for ( size_t ii = 0; ii < sizeof( entity ) / sizeof( entity[0] ); ++ii )
+		{
+			if ( p + entity[ii].len <= end && 0 == memcmp( p, entity[ii].str, entity[ii].len ) )
+			{
+				*(*out)++ = entity[ii].chr;
+				return p + entity[ii].len;
+			}
+		}
+	}
+
+	*(*out)++ = '&';
+	return p + 1;
+}
+
+
+TiXmlInSituNode* TiXmlInSituNode::FirstChildElement() const
+{
+	TiXmlInSituNode* node = firstChild;
+	while ( node && INSITU_ELEMENT != node->type )
+		node = node->next;
+	return node;
+}
+
+
+TiXmlInSituNode* TiXmlInSituNode::FirstChildElement( const char* name ) const
+{
+	TiXmlInSituNode* node = firstChild;
+	while ( node && ( INSITU_ELEMENT != node->type || 0 != strcmp( node->value, name ) ) )
+		node = node->next;
+	return node;
+}
+
+
+TiXmlInSituNode* TiXmlInSituNode::NextSiblingElement() const
+{
+	TiXmlInSituNode* node = next;
+	while ( node && INSITU_ELEMENT != node->type )
+		node = node->next;
+	return node;
+}
+
+
+TiXmlInSituNode* TiXmlInSituNode::NextSiblingElement( const char* name ) const
+{
+	TiXmlInSituNode* node = next;
+	while ( node && ( INSITU_ELEMENT != node->type || 0 != strcmp( node->value, name ) ) )
+		node = node->next;
+	return node;
+}
+
+
+const char* TiXmlInSituNode::Attribute( const char* name ) const
+{
+	for ( const TiXmlInSituAttribute* attr = firstAttribute; attr; attr = attr->Next() )
+	{
+		if ( 0 == strcmp( attr->Name(), name ) )
+			return attr->Value();
+	}
+	return 0;
+}
+
+
+const char* TiXmlInSituNode::GetText() const
+{
+	if ( firstChild && INSITU_TEXT == firstChild->type )
+		return firstChild->value;
+	return 0;
+}
+
+
+TiXmlInSituDocument::TiXmlInSituDocument()
+	: blocks( 0 ),
+	  buffer( 0 ),
+	  end( 0 ),
+	  length( 0 ),
+	  mapped( false ),
+	  owned( false ),
+	  errorDesc( 0 ),
+	  errorRow( 0 ),
+	  nodeCount( 0 ),
+	  arenaSize( 0 )
+{
+	root.type = TiXmlInSituNode::INSITU_DOCUMENT;
+	root.value = "";
+	root.parent = 0;
+	root.firstChild = 0;
+	root.lastChild = 0;
+	root.next = 0;
+	root.firstAttribute = 0;
+}
+
+
+TiXmlInSituDocument::~TiXmlInSituDocument()
+{
+	Clear();
+}
+
+
+void TiXmlInSituDocument::Clear()
+{
+	while ( blocks )
+	{
+		Block* next = blocks->next;
+		free( blocks );
+		blocks = next;
+	}
+#ifndef _WIN32
+	if ( mapped )
+		munmap( buffer, length );
+#endif
+	if ( owned )
+		free( buffer );
+	buffer = 0;
+	end = 0;
+	length = 0;
+	mapped = false;
+	owned = false;
+	errorDesc = 0;
+	errorRow = 0;
+	nodeCount = 0;
+	arenaSize = 0;
+	root.firstChild = 0;
+	root.lastChild = 0;
+}
+
+
+void* TiXmlInSituDocument::Allocate( size_t size )
+{
+	const size_t align = sizeof( void* );
+	size = ( size + align - 1 ) & ~( align - 1 );
+	if ( !blocks || blocks->used + size > blocks->size )
+	{
+		size_t blockSize = blocks ? 2 * blocks->size : TIXML_INSITU_FIRST_BLOCK;
+		if ( blockSize < size )
+			blockSize = size;
+		// The header size is a multiple of the pointer size, so the
+		// payload that follows it is aligned as well.
+		Block* block = (Block*) malloc( sizeof( Block ) + blockSize );
+		if ( !block )
+			return 0;
+		block->next = blocks;
+		block->size = blockSize;
+		block->used = 0;
+		blocks = block;
+		arenaSize += blockSize;
+	}
+	void* mem = reinterpret_cast<char*>( blocks + 1 ) + blocks->used;
+	blocks->used += size;
+	return mem;
+}
+
+
+TiXmlInSituNode* TiXmlInSituDocument::NewNode( int type, const char* value, TiXmlInSituNode* parent )
+{
+	TiXmlInSituNode* node = (TiXmlInSituNode*) Allocate( sizeof( TiXmlInSituNode ) );
+	if ( !node )
+		return 0;
+	node->type = type;
+	node->value = value;
+	node->parent = parent;
+	node->firstChild = 0;
+	node->lastChild = 0;
+	node->next = 0;
+	node->firstAttribute = 0;
+	if ( parent->lastChild )
+		parent->lastChild->next = node;
+	else
+		parent->firstChild = node;
+	parent->lastChild = node;
+	++nodeCount;
+	return node;
+}
+
+
+bool TiXmlInSituDocument::SetError( const char* desc, const char* where )
+{
+	errorDesc = desc;
+	errorRow = 0;
+	if ( where )
+	{
+		// only paid on failure, no need to track rows while parsing
+		errorRow = 1;
+		for ( const char* p = buffer; p < where; ++p )
+		{
+			if ( '\n' == *p )
+				++errorRow;
+		}
+	}
+	return false;
+}
+
+
+bool TiXmlInSituDocument::LoadFile( const char* filename )
+{
+	Clear();
+
+#ifndef _WIN32
+	int fd = open( filename, O_RDONLY );
+	if ( fd < 0 )
+		return SetError( "Failed to open file", 0 );
+	struct stat st;
+	if ( 0 != fstat( fd, &st ) )
+	{
+		close( fd );
+		return SetError( "Failed to open file", 0 );
+	}
+	length = st.st_size;
+	if ( 0 == length )
+	{
+		close( fd );
+		return SetError( "Document empty", 0 );
+	}
+	// Private mapping: terminating strings in place touches only the
+	// pages that hold them, and never the file.
+	void* mem = mmap( 0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( MAP_FAILED != mem )
+	{
+		buffer = (char*) mem;
+		mapped = true;
+		return ParseBuffer();
+	}
+	length = 0;
+#endif
+
+	FILE* file = fopen( filename, "rb" );
+	if ( !file )
+		return SetError( "Failed to open file", 0 );
+	fseek( file, 0, SEEK_END );
+	long size = ftell( file );
+	fseek( file, 0, SEEK_SET );
+	if ( size <= 0 )
+	{
+		fclose( file );
+		return SetError( "Document empty", 0 );
+	}
+	buffer = (char*) malloc( size );
+	if ( !buffer )
+	{
+		fclose( file );
+		return SetError( "Memory allocation failed", 0 );
+	}
+	owned = true;
+	length = size;
+	size_t nread = fread( buffer, 1, length, file );
+	fclose( file );
+	if ( nread != length )
+		return SetError( "Failed to read file", 0 );
+	return ParseBuffer();
+}
+
+
+bool TiXmlInSituDocument::Parse( char* buf, size_t len )
+{
+	Clear();
+	buffer = buf;
+	length = len;
+	if ( 0 == length )
+		return SetError( "Document empty", 0 );
+	return ParseBuffer();
+}
+
+
+bool TiXmlInSituDocument::ParseBuffer()
+{
+	char* p = buffer;
+	end = buffer + length;
+	if ( length >= 3 && 0 == memcmp( p, "\xef\xbb\xbf", 3 ) )
+		p += 3;
+
+	TiXmlInSituNode* parent = &root;
+	while ( p < end )
+	{
+		if ( '<' == *p )
+			++p;
+		else
+		{
+			// returns where the '<' was, it may have been overwritten
+			// by the text's terminator
+			p = ParseText( p, parent );
+			if ( !p )
+				return false;
+			if ( p >= end )
+				break;
+			++p;
+		}
+
+		if ( p >= end )
+			return SetError( "Error parsing Element.", p - 1 );
+
+		if ( '/' == *p )
+		{
+			if ( &root == parent )
+				return SetError( "Error reading end tag.", p - 1 );
+			char* name = ++p;
+			while ( p < end && IsNameChar( *p ) )
+				++p;
+			size_t len = p - name;
+			if ( 0 != strncmp( parent->value, name, len ) || '\0' != parent->value[len] )
+				return SetError( "Error reading end tag.", name );
+			p = SkipSpace( p, end );
+			if ( p >= end || '>' != *p )
+				return SetError( "Error reading end tag.", name );
+			++p;
+			parent = parent->parent;
+		}
+		else if ( '!' == *p || '?' == *p )
+		{
+			p = SkipMarkup( p, parent );
+			if ( !p )
+				return false;
+		}
+		else
+		{
+			TiXmlInSituNode* element = 0;
+			p = ParseElement( p, parent, &element );
+			if ( !p )
+				return false;
+			if ( element )
+				parent = element;
+		}
+	}
+
+	if ( &root != parent )
+		return SetError( "Error reading end tag.", end );
+	if ( !root.FirstChildElement() )
+		return SetError( "Document empty", 0 );
+	return true;
+}
+
+
+char* TiXmlInSituDocument::ParseElement( char* p, TiXmlInSituNode* parent, TiXmlInSituNode** opened )
+{
+	char* name = p;
+	if ( !IsNameStart( *p ) )
+	{
+		SetError( "Error parsing Element.", p );
+		return 0;
+	}
+	while ( p < end && IsNameChar( *p ) )
+		++p;
+	if ( p >= end )
+	{
+		SetError( "Error parsing Element.", name );
+		return 0;
+	}
+
+	TiXmlInSituNode* element = NewNode( TiXmlInSituNode::INSITU_ELEMENT, name, parent );
+	if ( !element )
+	{
+		SetError( "Memory allocation failed", name );
+		return 0;
+	}
+	TiXmlInSituAttribute* lastAttribute = 0;
+
+	// Look at the delimiter before terminating the name on top of it.
+	char delim = *p;
+	*p++ = '\0';
+	for (;;)
+	{
+		while ( IsSpace( delim ) )
+		{
+			if ( p >= end )
+			{
+				SetError( "Error parsing Element.", name );
+				return 0;
+			}
+			delim = *p++;
+		}
+
+		if ( '>' == delim )
+		{
+			*opened = element;
+			return p;
+		}
+
+		if ( '/' == delim )
+		{
+			if ( p >= end || '>' != *p )
+			{
+				SetError( "Error parsing Element.", name );
+				return 0;
+			}
+			*opened = 0;
+			return p + 1;
+		}
+
+		// delim is the first character of an attribute name, at p - 1
+		char* attrName = p - 1;
+		if ( !IsNameStart( delim ) )
+		{
+			SetError( "Error reading Attributes.", attrName );
+			return 0;
+		}
+		while ( p < end && IsNameChar( *p ) )
+			++p;
+		char* attrNameEnd = p;
+		p = SkipSpace( p, end );
+		if ( p >= end || '=' != *p )
+		{
+			SetError( "Error reading Attributes.", attrName );
+			return 0;
+		}
+		p = SkipSpace( p + 1, end );
+		if ( p >= end || ( '\"' != *p && '\'' != *p ) )
+		{
+			SetError( "Error reading Attributes.", attrName );
+			return 0;
+		}
+		char quote = *p++;
+		char* value = p;
+		char* out = p;
+		while ( p < end && quote != *p )
+		{
+			if ( '<' == *p )
+			{
+				SetError( "Error reading Attributes.", attrName );
+				return 0;
+			}
+			if ( '&' == *p )
+				p = DecodeEntity( p, end, &out );
+			else
+				*out++ = *p++;
+		}
+		if ( p >= end )
+		{
+			SetError( "Error reading Attributes.", attrName );
+			return 0;
+		}
+		*attrNameEnd = '\0';
+		*out = '\0';
+		++p;
+
+		TiXmlInSituAttribute* attr = (TiXmlInSituAttribute*) Allocate( sizeof( TiXmlInSituAttribute ) );
+		if ( !attr )
+		{
+			SetError( "Memory allocation failed", attrName );
+			return 0;
+		}
+		attr->name = attrName;
+		attr->value = value;
+		attr->next = 0;
+		if ( lastAttribute )
+			lastAttribute->next = attr;
+		else
+			element->firstAttribute = attr;
+		lastAttribute = attr;
+
+		if ( p >= end )
+		{
+			SetError( "Error parsing Element.", name );
+			return 0;
+		}
+		delim = *p++;
+	}
+}
+
+
+char* TiXmlInSituDocument::ParseText( char* p, TiXmlInSituNode* parent )
+{
+	if ( &root == parent )
+	{
+		// stray text outside the root element carries no information
+		char* lt = (char*) memchr( p, '<', end - p );
+		return lt ? lt : end;
+	}
+
+	const bool condense = TiXmlBase::IsWhiteSpaceCondensed();
+	char* text = p;
+	char* out = p;
+	bool pendingSpace = false;
+	while ( p < end && '<' != *p )
+	{
+		if ( condense && IsSpace( *p ) )
+		{
+			pendingSpace = out > text;
+			++p;
+			continue;
+		}
+		if ( pendingSpace )
+		{
+			*out++ = ' ';
+			pendingSpace = false;
+		}
+		if ( '&' == *p )
+			p = DecodeEntity( p, end, &out );
+		else
+			*out++ = *p++;
+	}
+
+	// Text running into the end of the buffer means an unclosed
+	// element, which ParseBuffer() reports. Otherwise out <= p < end
+	// and the terminator fits.
+	if ( out > text && p < end )
+	{
+		*out = '\0';
+		if ( !NewNode( TiXmlInSituNode::INSITU_TEXT, text, parent ) )
+		{
+			SetError( "Memory allocation failed", text );
+			return 0;
+		}
+	}
+	return p;
+}
+
+
+char* TiXmlInSituDocument::SkipMarkup( char* p, TiXmlInSituNode* parent )
+{
+	char* start = p;
+	if ( '?' == *p )
+	{
+		p = Find( p, end, "?>" );
+		if ( !p )
+		{
+			SetError( "Error parsing Declaration.", start );
+			return 0;
+		}
+		return p + 2;
+	}
+
+	if ( p + 3 <= end && 0 == memcmp( p, "!--", 3 ) )
+	{
+		p = Find( p + 3, end, "-->" );
+		if ( !p )
+		{
+			SetError( "Error parsing Comment.", start );
+			return 0;
+		}
+		return p + 3;
+	}
+
+	if ( p + 8 <= end && 0 == memcmp( p, "![CDATA[", 8 ) )
+	{
+		char* text = p + 8;
+		p = Find( text, end, "]]>" );
+		if ( !p )
+		{
+			SetError( "Error parsing CDATA.", start );
+			return 0;
+		}
+		if ( &root != parent && p > text )
+		{
+			*p = '\0';
+			if ( !NewNode( TiXmlInSituNode::INSITU_TEXT, text, parent ) )
+			{
+				SetError( "Memory allocation failed", text );
+				return 0;
+			}
+		}
+		return p + 3;
+	}
+
+	// DTD and friends: skip to the matching '>', allowing for an
+	// internal subset in square brackets.
+	int depth = 0;
+	for ( ++p; p < end; ++p )
+	{
+		if ( '[' == *p )
+			++depth;
+		else if ( ']' == *p )
+			--depth;
+		else if ( '>' == *p && depth <= 0 )
+			return p + 1;
+	}
+	SetError( "Error parsing Unknown.", start );
+	return 0;
+}
+
+}
@@ -0,0 +1,192 @@
+/*
+www.sourceforge.net/projects/tinyxml
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any
+damages arising from the use of this software.
+
+Permission is granted to anyone to use this software for any
+purpose, including commercial applications, and to alter it and
+redistribute it freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this
+software in a product, an acknowledgment in the product documentation
+would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and
+must not be misrepresented as being the original software.
+
+3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+/*
+ * THIS FILE WAS ADDED TO THE wbc_tinyxml SNAPSHOT.
+ *
+ * - read-only, in-situ parser for the legacy SAI robot descriptions.
+ * - names and text are NUL-terminated inside the (private) input buffer.
+ * - nodes and attributes come from a block arena owned by the document.
+ */
+
+#ifndef TINYXML_INSITU_INCLUDED
+#define TINYXML_INSITU_INCLUDED
+
+#include <stddef.h>
+
+namespace wbc_tinyxml {
+
+class TiXmlInSituDocument;
+
+
+/** An attribute of a TiXmlInSituNode element. Name and value point
+	into the document's buffer and remain valid for as long as the
+	document is neither cleared nor destroyed.
+*/
+class TiXmlInSituAttribute
+{
+public:
+	const char* Name() const			{ return name; }
+	const char* Value() const			{ return value; }
+	const TiXmlInSituAttribute* Next() const	{ return next; }
+
+private:
+	friend class TiXmlInSituDocument;
+
+	const char* name;
+	const char* value;
+	TiXmlInSituAttribute* next;
+};
+
+
+/** A node of a TiXmlInSituDocument. Only elements and (non-empty)
+	text are kept, comments, declarations and other markup are
+	skipped by the parser. The interface mirrors the read-only
+	navigation subset of TiXmlNode and TiXmlElement, so code that
+	walks a TiXmlDocument can be ported by changing types.
+*/
+class TiXmlInSituNode
+{
+public:
+	enum NodeType
+	{
+		INSITU_DOCUMENT,
+		INSITU_ELEMENT,
+		INSITU_TEXT
+	};
+
+	int Type() const						{ return type; }
+
+	/** The tag name for elements, the (entity-decoded and, unless
+		TiXmlBase::IsWhiteSpaceCondensed() is false, condensed)
+		content for text nodes.
+	*/
+	const char* Value() const				{ return value; }
+
+	TiXmlInSituNode* Parent() const			{ return parent; }
+	TiXmlInSituNode* FirstChild() const		{ return firstChild; }
+	TiXmlInSituNode* NextSibling() const	{ return next; }
+
+	TiXmlInSituNode* FirstChildElement() const;
+	TiXmlInSituNode* FirstChildElement( const char* name ) const;
+	TiXmlInSituNode* NextSiblingElement() const;
+	TiXmlInSituNode* NextSiblingElement( const char* name ) const;
+
+	/** Value of the named attribute, or null if there is none. */
+	const char* Attribute( const char* name ) const;
+	const TiXmlInSituAttribute* FirstAttribute() const	{ return firstAttribute; }
+
+	/** Same semantics as TiXmlElement::GetText(): the text of the
+		first child if that is a text node, null otherwise.
+	*/
+	const char* GetText() const;
+
+private:
+	friend class TiXmlInSituDocument;
+
+	int type;
+	const char* value;
+	TiXmlInSituNode* parent;
+	TiXmlInSituNode* firstChild;
+	TiXmlInSituNode* lastChild;
+	TiXmlInSituNode* next;
+	TiXmlInSituAttribute* firstAttribute;
+};
+
+
+/** Zero-copy parser for well-formed, UTF-8 XML. Unlike TiXmlDocument,
+	which builds a tree of individually heap-allocated nodes and
+	strings, LoadFile() maps the file copy-on-write and the parser
+	terminates names and text in place. Nodes and attributes are
+	carved out of a small number of arena blocks, so parsing a robot
+	description costs a handful of allocations instead of several per
+	element. The document is read-only: there is no printing, no
+	editing, and no streaming.
+
+	Everything returned by the document and its nodes points into
+	storage owned by the document and is invalidated by Clear(),
+	another LoadFile() or Parse(), and by the destructor.
+*/
+class TiXmlInSituDocument
+{
+public:
+	TiXmlInSituDocument();
+	~TiXmlInSituDocument();
+
+	/** Map (or, where mmap is not available, read) the file and parse
+		it in place. Returns true on success.
+	*/
+	bool LoadFile( const char* filename );
+
+	/** Parse a caller-provided, writable buffer in place. The buffer
+		is modified and must outlive the document's nodes, it need
+		not be NUL-terminated. Returns true on success.
+	*/
+	bool Parse( char* buffer, size_t length );
+
+	/** Release the nodes and the buffer (if the document owns it). */
+	void Clear();
+
+	TiXmlInSituNode* RootElement() const	{ return root.FirstChildElement(); }
+	TiXmlInSituNode* FirstChild() const		{ return root.FirstChild(); }
+
+	bool Error() const					{ return 0 != errorDesc; }
+	const char* ErrorDesc() const		{ return errorDesc ? errorDesc : ""; }
+	/** 1-based line of the error, or 0 if there was none. */
+	int ErrorRow() const				{ return errorRow; }
+
+	/** Number of element and text nodes in the document. */
+	size_t NodeCount() const			{ return nodeCount; }
+	/** Number of bytes allocated for nodes and attributes. */
+	size_t ArenaSize() const			{ return arenaSize; }
+
+private:
+	TiXmlInSituDocument( const TiXmlInSituDocument& );		// not implemented.
+	void operator=( const TiXmlInSituDocument& );			// not implemented.
+
+	struct Block;
+
+	void* Allocate( size_t size );
+	TiXmlInSituNode* NewNode( int type, const char* value, TiXmlInSituNode* parent );
+	bool SetError( const char* desc, const char* where );
+	bool ParseBuffer();
+	char* ParseElement( char* p, TiXmlInSituNode* parent, TiXmlInSituNode** element );
+	char* ParseText( char* p, TiXmlInSituNode* parent );
+	char* SkipMarkup( char* p, TiXmlInSituNode* parent );
+
+	TiXmlInSituNode root;
+	Block* blocks;
+	char* buffer;
+	char* end;
+	size_t length;
+	bool mapped;
+	bool owned;
+	const char* errorDesc;
+	int errorRow;
+	size_t nodeCount;
+	size_t arenaSize;
+};
+
+}
+
+#endif // TINYXML_INSITU_INCLUDED
@@ -138,7 +138,7 @@ int main(int argc, char ** argv)
     if (verbosity > 0) {
       dump_tao_tree_info(cout, tree, "robot", false);
     }
-    if (0 != model.init(tree, 0, &cerr)) {
+    if (0 != model.init(tree, false, &cerr)) {
       throw runtime_error("jspace::Model::init() failed");
     }
   }
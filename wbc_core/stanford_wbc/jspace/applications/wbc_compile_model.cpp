@@ -0,0 +1,199 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+/**
+   \file wbc_compile_model.cpp
+   \author Roland Philippsen
+
+   Compile a SAI XML robot description into a binary model cache
+   (see jspace/model_cache.hpp), check that the cached model behaves
+   exactly like the parsed one, and report how much faster it is to
+   load. URDF models go through wbc_urdf's urdf_to_tao node, which
+   can write the same cache format.
+*/
+
+#include <jspace/Model.hpp>
+#include <jspace/model_cache.hpp>
+#include <jspace/tao_util.hpp>
+#include <jspace/test/sai_brep.hpp>
+#include <jspace/test/sai_brep_parser.hpp>
+#include <jspace/test/sai_util.hpp>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <err.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+using namespace std;
+
+
+static double wall_seconds()
+{
+  struct timeval now;
+  if (0 != gettimeofday(&now, 0)) {
+    err(EXIT_FAILURE, "gettimeofday");
+  }
+  return now.tv_sec + 1e-6 * now.tv_usec;
+}
+
+
+int main(int argc, char ** argv)
+{
+  string xmlfname;
+  string cachefname;
+  int nrepeat(20);
+  bool check(true);
+  for (int iopt(1); iopt < argc; ++iopt) {
+    string const opt(argv[iopt]);
+    if ("-n" == opt) {
+      ++iopt;
+      if (iopt >= argc) {
+	errx(EXIT_FAILURE, "-n requires an argument (use -h for some help)");
+      }
+      if ((1 != sscanf(argv[iopt], "%d", &nrepeat)) || (0 > nrepeat)) {
+	errx(EXIT_FAILURE, "invalid number of repetitions `%s'", argv[iopt]);
+      }
+    }
+    else if ("-q" == opt) {
+      check = false;
+    }
+    else if ("-h" == opt) {
+      printf("usage [-n count] [-q] [-h] robot.xml robot.cache\n"
+	     "\n"
+	     "  -n  count   how many times to load the model for the timing\n"
+	     "              comparison (default 20, zero skips the timing)\n"
+	     "  -q          skip the comparison of parsed and cached model\n"
+	     "  -h          this message\n");
+      exit(EXIT_SUCCESS);
+    }
+    else if (xmlfname.empty()) {
+      xmlfname = opt;
+    }
+    else if (cachefname.empty()) {
+      cachefname = opt;
+    }
+    else {
+      errx(EXIT_FAILURE, "invalid option `%s' (use -h for some help)", argv[iopt]);
+    }
+  }
+  if (cachefname.empty()) {
+    errx(EXIT_FAILURE, "SAI XML input file and model cache output file required (use -h for some help)");
+  }
+
+  uint64_t hash;
+  jspace::Status st(jspace::compute_model_file_hash(xmlfname, hash));
+  if ( ! st) {
+    errx(EXIT_FAILURE, "%s", st.errstr.c_str());
+  }
+
+  try {
+    jspace::test::BRParser brp;
+    jspace::test::BranchingRepresentation * brep(brp.parse(xmlfname));
+    jspace::constraint_spec_s const constraint_spec(brep->getConstraintSpec());
+    jspace::tao_tree_info_s * tree(brep->createTreeInfo());
+    delete brep;
+    st = jspace::write_model_cache(cachefname, hash, *tree, constraint_spec);
+    delete tree;
+    if ( ! st) {
+      errx(EXIT_FAILURE, "%s", st.errstr.c_str());
+    }
+  }
+  catch (std::exception const & ee) {
+    errx(EXIT_FAILURE, "exception: %s", ee.what());
+  }
+  printf("wrote %s (source hash %016llx)\n", cachefname.c_str(), static_cast<unsigned long long>(hash));
+
+  if (check) {
+    jspace::Model * parsed(0);
+    try {
+      parsed = jspace::test::parse_sai_xml_file(xmlfname, true);
+    }
+    catch (std::exception const & ee) {
+      errx(EXIT_FAILURE, "exception: %s", ee.what());
+    }
+    jspace::Model cached;
+    ostringstream msg;
+    if (0 != cached.init(cachefname, hash, true, &msg)) {
+      errx(EXIT_FAILURE, "failed to load the model cache:\n%s", msg.str().c_str());
+    }
+
+    size_t const ndof(parsed->getNDOF());
+    if (cached.getNDOF() != ndof) {
+      errx(EXIT_FAILURE, "cached model has %zu DOF instead of %zu", cached.getNDOF(), ndof);
+    }
+    // with constraints, the state only covers the actuated DOF
+    size_t const nact(parsed->getUnconstrainedNDOF());
+    if (cached.getUnconstrainedNDOF() != nact) {
+      errx(EXIT_FAILURE, "cached model has %zu actuated DOF instead of %zu", cached.getUnconstrainedNDOF(), nact);
+    }
+    jspace::State state(nact, nact, 0);
+    for (size_t ii(0); ii < nact; ++ii) {
+      state.position_[ii] = 0.1 * (ii + 1);
+      state.velocity_[ii] = -0.2 * (ii + 1);
+    }
+    parsed->update(state);
+    cached.update(state);
+    jspace::Matrix a_parsed, a_cached;
+    jspace::Vector g_parsed, g_cached, b_parsed, b_cached;
+    parsed->getMassInertia(a_parsed);
+    cached.getMassInertia(a_cached);
+    parsed->getGravity(g_parsed);
+    cached.getGravity(g_cached);
+    parsed->getCoriolisCentrifugal(b_parsed);
+    cached.getCoriolisCentrifugal(b_cached);
+    double const delta(std::max((a_parsed - a_cached).cwise().abs().maxCoeff(),
+				std::max((g_parsed - g_cached).cwise().abs().maxCoeff(),
+					 (b_parsed - b_cached).cwise().abs().maxCoeff())));
+    if (delta > 1e-9) {
+      errx(EXIT_FAILURE, "cached model differs from parsed model by %g", delta);
+    }
+    printf("cached model matches the parsed one (%zu DOF)\n", ndof);
+    delete parsed;
+  }
+
+  if (0 < nrepeat) {
+    double t0(wall_seconds());
+    for (int ii(0); ii < nrepeat; ++ii) {
+      delete jspace::test::parse_sai_xml_file(xmlfname, true);
+    }
+    double const dt_parse((wall_seconds() - t0) / nrepeat);
+
+    t0 = wall_seconds();
+    for (int ii(0); ii < nrepeat; ++ii) {
+      jspace::Model model;
+      if (0 != model.init(cachefname, hash, true, 0)) {
+	errx(EXIT_FAILURE, "failed to load the model cache");
+      }
+    }
+    double const dt_cache((wall_seconds() - t0) / nrepeat);
+
+    printf("startup time over %d runs:\n"
+	   "  SAI XML parse:  %9.3f ms\n"
+	   "  model cache:    %9.3f ms\n"
+	   "  reduction:      %9.1f%% (%.1fx faster)\n",
+	   nrepeat, 1e3 * dt_parse, 1e3 * dt_cache,
+	   100.0 * (dt_parse - dt_cache) / dt_parse, dt_parse / dt_cache);
+  }
+}
@@ -0,0 +1,877 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+/**
+   \file wbc_kingen.cpp
+   \author Roland Philippsen
+
+   Generate closed-form kinematics kernels for selected chains of a
+   robot model. The output is a self-contained C++ header with, for
+   each chain, straight-line code for the forward kinematics, the
+   Jacobian, and the gravity torques of the chain's joints. It uses
+   plain fixed-size arrays, computes the sine and cosine of each
+   joint angle once, folds all the constants of the model (home
+   frames, masses, centers of mass) into the expressions, and shares
+   common subexpressions. The results are the same as what
+   jspace::Model computes via TAO, see the kingen test in
+   jspace/tests/testJspace.cpp.
+
+   The model is either a SAI XML file or a model cache (see
+   jspace/model_cache.hpp). For URDF models, write a cache with
+   wbc_urdf's urdf_to_tao node and pass that.
+*/
+
+#include <jspace/model_cache.hpp>
+#include <jspace/tao_util.hpp>
+#include <jspace/constraint_library.hpp>
+#include <jspace/test/sai_brep.hpp>
+#include <jspace/test/sai_brep_parser.hpp>
+#include <tao/dynamics/taoDNode.h>
+#include <tao/dynamics/taoJoint.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <err.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+
+using namespace std;
+
+
+namespace {
+
+  // Same gravity as in Model.cpp
+  double const earth_gravity[3] = { 0, 0, -9.81 };
+
+  // Coefficients below this get dropped. Rotations by a rounded pi/2
+  // produce lots of them, e.g. cos(1.5707963267948966) = 6e-17.
+  double const zero_threshold(1e-14);
+
+
+  /** The shortest decimal representation that reads back as the
+      same double. */
+  string literal(double value)
+  {
+    char buf[32];
+    for (int prec(1); prec <= 17; ++prec) {
+      snprintf(buf, sizeof(buf), "%.*g", prec, value);
+      if (strtod(buf, 0) == value) {
+	break;
+      }
+    }
+    return buf;
+  }
+
+
+  /** A scalar in the generated code, either a constant known at
+      generation time or a constant multiple of a variable. The
+      multiple saves a statement whenever something is just the
+      negative (or a scaled copy) of a variable that already exists. */
+  struct sym_s {
+    sym_s() : is_const(true), value(0), scale(1) {}
+    explicit sym_s(double value_) : is_const(true), value(value_), scale(1) {}
+    sym_s(string const & name_, double scale_ = 1)
+      : is_const(false), value(0), scale(scale_), name(name_) {}
+
+    string text() const {
+      if (is_const) {
+	return literal(value);
+      }
+      if (1.0 == scale) {
+	return name;
+      }
+      if (-1.0 == scale) {
+	return "- " + name;
+      }
+      return literal(scale) + " * " + name;
+    }
+
+    bool is_const;
+    double value;
+    double scale;
+    string name;
+  };
+
+
+  /** coeff * aa, or coeff * aa * bb if bb is not empty. */
+  struct term_s {
+    double coeff;
+    string aa;
+    string bb;
+
+    bool operator < (term_s const & rhs) const {
+      if (bb.empty() != rhs.bb.empty()) {
+	return ! bb.empty();	// products first
+      }
+      if (aa != rhs.aa) {
+	return aa < rhs.aa;
+      }
+      return bb < rhs.bb;
+    }
+  };
+
+
+  /** A sum of products of at most two variables with constant
+      coefficients, which gets built up before it is turned into a
+      statement. Constant factors are folded as they get added. */
+  class sum_builder {
+  public:
+    sum_builder() : constant_(0) {}
+
+    void add(double coeff, sym_s const & aa) {
+      if (aa.is_const) {
+	constant_ += coeff * aa.value;
+      }
+      else {
+	addTerm(coeff * aa.scale, aa.name, "");
+      }
+    }
+
+    void add(double coeff, sym_s const & aa, sym_s const & bb) {
+      if (aa.is_const) {
+	add(coeff * aa.value, bb);
+      }
+      else if (bb.is_const) {
+	add(coeff * bb.value, aa);
+      }
+      else if (aa.name < bb.name) {
+	addTerm(coeff * aa.scale * bb.scale, aa.name, bb.name);
+      }
+      else {
+	addTerm(coeff * aa.scale * bb.scale, bb.name, aa.name);
+      }
+    }
+
+    double constant_;
+    vector<term_s> terms_;
+
+  private:
+    void addTerm(double coeff, string const & aa, string const & bb) {
+      for (size_t ii(0); ii < terms_.size(); ++ii) {
+	if ((aa == terms_[ii].aa) && (bb == terms_[ii].bb)) {
+	  terms_[ii].coeff += coeff;
+	  return;
+	}
+      }
+      term_s tt;
+      tt.coeff = coeff;
+      tt.aa = aa;
+      tt.bb = bb;
+      terms_.push_back(tt);
+    }
+  };
+
+
+  struct frame_s {
+    sym_s rot[3][3];
+    sym_s pos[3];
+  };
+
+
+  struct statement_s {
+    string name;
+    string rhs;
+    vector<string> deps;
+  };
+
+
+  /**
+     Accumulates the statements of one generated function. Each
+     distinct right-hand side gets emitted only once (the second
+     request for the same sum gets the existing variable), and when
+     the function is written out, statements that do not contribute
+     to any of the outputs get dropped.
+  */
+  class function_builder {
+  public:
+    function_builder() : ntmp_(0) {}
+
+    sym_s emit(sum_builder const & sum);
+
+    sym_s sine(int dof) {
+      ostringstream name;
+      name << "s" << dof;
+      return sym_s(name.str());
+    }
+
+    sym_s cosine(int dof) {
+      ostringstream name;
+      name << "c" << dof;
+      return sym_s(name.str());
+    }
+
+    sym_s position(int dof) {
+      ostringstream name;
+      name << "q[" << dof << "]";
+      return sym_s(name.str());
+    }
+
+    /** Global frame of a node origin, recursing towards the root. */
+    frame_s const & frame(taoDNode * node);
+
+    void output(string const & lhs, sym_s const & value) {
+      outputs_.push_back(make_pair(lhs, value));
+    }
+
+    void write(ostream & os, string const & indent, string const & signature) const;
+
+  private:
+    int ntmp_;
+    map<string, string> cse_;
+    vector<statement_s> statements_;
+    vector<pair<string, sym_s> > outputs_;
+    map<taoDNode *, frame_s> frames_;
+  };
+
+
+  sym_s function_builder::
+  emit(sum_builder const & sum)
+  {
+    vector<term_s> terms;
+    for (size_t ii(0); ii < sum.terms_.size(); ++ii) {
+      if (fabs(sum.terms_[ii].coeff) >= zero_threshold) {
+	terms.push_back(sum.terms_[ii]);
+      }
+    }
+    double constant(fabs(sum.constant_) >= zero_threshold ? sum.constant_ : 0);
+    if (terms.empty()) {
+      return sym_s(constant);
+    }
+    if ((1 == terms.size()) && terms[0].bb.empty() && (0 == constant)) {
+      return sym_s(terms[0].aa, terms[0].coeff);
+    }
+    sort(terms.begin(), terms.end());
+
+    // Normalize the sign, so that a - b and b - a share a statement.
+    double const sign((terms[0].coeff < 0) ? -1 : 1);
+    for (size_t ii(0); ii < terms.size(); ++ii) {
+      terms[ii].coeff *= sign;
+    }
+    constant *= sign;
+
+    statement_s st;
+    ostringstream rhs;
+    for (size_t ii(0); ii < terms.size(); ++ii) {
+      term_s const & tt(terms[ii]);
+      if (0 != ii) {
+	rhs << ((tt.coeff < 0) ? " - " : " + ");
+      }
+      if (1.0 != fabs(tt.coeff)) {
+	rhs << literal(fabs(tt.coeff)) << " * ";
+      }
+      rhs << tt.aa;
+      st.deps.push_back(tt.aa);
+      if ( ! tt.bb.empty()) {
+	rhs << " * " << tt.bb;
+	st.deps.push_back(tt.bb);
+      }
+    }
+    if (0 != constant) {
+      rhs << ((constant < 0) ? " - " : " + ") << literal(fabs(constant));
+    }
+    st.rhs = rhs.str();
+
+    map<string, string>::const_iterator const icse(cse_.find(st.rhs));
+    if (cse_.end() != icse) {
+      return sym_s(icse->second, sign);
+    }
+    ostringstream name;
+    name << "t" << ntmp_++;
+    st.name = name.str();
+    cse_.insert(make_pair(st.rhs, st.name));
+    statements_.push_back(st);
+    return sym_s(st.name, sign);
+  }
+
+
+  frame_s const & function_builder::
+  frame(taoDNode * node)
+  {
+    map<taoDNode *, frame_s>::const_iterator const iframe(frames_.find(node));
+    if (frames_.end() != iframe) {
+      return iframe->second;
+    }
+
+    deFrame const * home(node->frameHome());
+    deMatrix3 home_rot;
+    home_rot.set(home->rotation());
+    frame_s ff;
+
+    taoDNode * parent(node->getDParent());
+    if ( ! parent) {
+      for (size_t ii(0); ii < 3; ++ii) {
+	ff.pos[ii] = sym_s(home->translation()[ii]);
+	for (size_t jj(0); jj < 3; ++jj) {
+	  ff.rot[ii][jj] = sym_s(home_rot.elementAt(ii, jj));
+	}
+      }
+      return frames_[node] = ff;
+    }
+
+    // TAO composes parent frame, home frame, and joint frame.
+    frame_s const & pf(frame(parent));
+    for (size_t ii(0); ii < 3; ++ii) {
+      sum_builder pos;
+      pos.add(1, pf.pos[ii]);
+      for (size_t kk(0); kk < 3; ++kk) {
+	pos.add(home->translation()[kk], pf.rot[ii][kk]);
+      }
+      ff.pos[ii] = emit(pos);
+      for (size_t jj(0); jj < 3; ++jj) {
+	sum_builder rot;
+	for (size_t kk(0); kk < 3; ++kk) {
+	  rot.add(home_rot.elementAt(kk, jj), pf.rot[ii][kk]);
+	}
+	ff.rot[ii][jj] = emit(rot);
+      }
+    }
+
+    taoJointDOF1 const * joint(dynamic_cast<taoJointDOF1 const *>(node->getJointList()));
+    int const axis(joint->getAxis());
+    int const dof(node->getID());
+    if (dynamic_cast<taoJointRevolute const *>(joint)) {
+      // Multiply with the rotation about the axis, which only mixes
+      // the two other columns.
+      int const i1((axis + 1) % 3);
+      int const i2((axis + 2) % 3);
+      sym_s const ss(sine(dof));
+      sym_s const cc(cosine(dof));
+      for (size_t ii(0); ii < 3; ++ii) {
+	sum_builder col1, col2;
+	col1.add(1, ff.rot[ii][i1], cc);
+	col1.add(1, ff.rot[ii][i2], ss);
+	col2.add(-1, ff.rot[ii][i1], ss);
+	col2.add(1, ff.rot[ii][i2], cc);
+	ff.rot[ii][i1] = emit(col1);
+	ff.rot[ii][i2] = emit(col2);
+      }
+    }
+    else {
+      sym_s const qq(position(dof));
+      for (size_t ii(0); ii < 3; ++ii) {
+	sum_builder pos;
+	pos.add(1, ff.pos[ii]);
+	pos.add(1, ff.rot[ii][axis], qq);
+	ff.pos[ii] = emit(pos);
+      }
+    }
+
+    return frames_[node] = ff;
+  }
+
+
+  void function_builder::
+  write(ostream & os, string const & indent, string const & signature) const
+  {
+    set<string> live;
+    for (size_t ii(0); ii < outputs_.size(); ++ii) {
+      if ( ! outputs_[ii].second.is_const) {
+	live.insert(outputs_[ii].second.name);
+      }
+    }
+    vector<bool> keep(statements_.size(), false);
+    for (size_t ii(statements_.size()); ii > 0; --ii) {
+      statement_s const & st(statements_[ii - 1]);
+      if (live.count(st.name)) {
+	keep[ii - 1] = true;
+	live.insert(st.deps.begin(), st.deps.end());
+      }
+    }
+
+    os << indent << "inline void " << signature << "\n"
+       << indent << "{\n";
+
+    // sine and cosine of the joint angles that are actually needed
+    bool uses_q(false);
+    set<int> dofs;
+    for (set<string>::const_iterator il(live.begin()); il != live.end(); ++il) {
+      int dof;
+      if ((1 == sscanf(il->c_str(), "s%d", &dof)) || (1 == sscanf(il->c_str(), "c%d", &dof))) {
+	dofs.insert(dof);
+      }
+      else if (1 == sscanf(il->c_str(), "q[%d]", &dof)) {
+	uses_q = true;
+      }
+    }
+    for (set<int>::const_iterator id(dofs.begin()); id != dofs.end(); ++id) {
+      ostringstream ss, cc;
+      ss << "s" << *id;
+      cc << "c" << *id;
+      if (live.count(ss.str()) && live.count(cc.str())) {
+	os << indent << "  double " << ss.str() << ", " << cc.str() << ";\n"
+	   << indent << "  sin_cos(q[" << *id << "], &" << ss.str() << ", &" << cc.str() << ");\n";
+      }
+      else if (live.count(ss.str())) {
+	os << indent << "  double const " << ss.str() << "(sin(q[" << *id << "]));\n";
+      }
+      else {
+	os << indent << "  double const " << cc.str() << "(cos(q[" << *id << "]));\n";
+      }
+    }
+    if (dofs.empty() && ! uses_q) {
+      os << indent << "  (void) q;\n";
+    }
+
+    for (size_t ii(0); ii < statements_.size(); ++ii) {
+      if (keep[ii]) {
+	os << indent << "  double const " << statements_[ii].name << "(" << statements_[ii].rhs << ");\n";
+      }
+    }
+    for (size_t ii(0); ii < outputs_.size(); ++ii) {
+      os << indent << "  " << outputs_[ii].first << " = " << outputs_[ii].second.text() << ";\n";
+    }
+    os << indent << "}\n";
+  }
+
+
+  void cross(function_builder & fb, sym_s const * aa, sym_s const * bb, sym_s * result)
+  {
+    for (size_t ii(0); ii < 3; ++ii) {
+      size_t const i1((ii + 1) % 3);
+      size_t const i2((ii + 2) % 3);
+      sum_builder sum;
+      sum.add(1, aa[i1], bb[i2]);
+      sum.add(-1, aa[i2], bb[i1]);
+      result[ii] = fb.emit(sum);
+    }
+  }
+
+
+  struct chain_s {
+    string name;
+    string link;
+    double offset[3];
+    taoDNode * tip;
+    vector<taoDNode *> joints;	// from the root towards the tip
+  };
+
+
+  void point(function_builder & fb, chain_s const & chain, sym_s * pos)
+  {
+    frame_s const & ff(fb.frame(chain.tip));
+    for (size_t ii(0); ii < 3; ++ii) {
+      sum_builder sum;
+      sum.add(1, ff.pos[ii]);
+      for (size_t kk(0); kk < 3; ++kk) {
+	sum.add(chain.offset[kk], ff.rot[ii][kk]);
+      }
+      pos[ii] = fb.emit(sum);
+    }
+  }
+
+
+  void axis(function_builder & fb, taoDNode * node, sym_s * zz)
+  {
+    frame_s const & ff(fb.frame(node));
+    int const ax(dynamic_cast<taoJointDOF1 const *>(node->getJointList())->getAxis());
+    for (size_t ii(0); ii < 3; ++ii) {
+      zz[ii] = ff.rot[ii][ax];
+    }
+  }
+
+
+  /** Mass and mass-weighted global COM of the subtree rooted at the
+      given node, memoized so that each node gets visited once. */
+  struct moment_s {
+    double mass;
+    sym_s moment[3];
+  };
+
+  typedef map<taoDNode *, moment_s> moment_map_t;
+
+  moment_s const & subtree_moment(function_builder & fb, moment_map_t & memo, taoDNode * node)
+  {
+    moment_map_t::const_iterator const im(memo.find(node));
+    if (memo.end() != im) {
+      return im->second;
+    }
+    double const mass(node->mass() ? *node->mass() : 0);
+    sum_builder sum[3];
+    if (0 != mass) {
+      frame_s const & ff(fb.frame(node));
+      deVector3 const & com(*node->center());
+      for (size_t ii(0); ii < 3; ++ii) {
+	sum[ii].add(mass, ff.pos[ii]);
+	for (size_t kk(0); kk < 3; ++kk) {
+	  sum[ii].add(mass * com[kk], ff.rot[ii][kk]);
+	}
+      }
+    }
+    moment_s mm;
+    mm.mass = mass;
+    for (taoDNode * child(node->getDChild()); 0 != child; child = child->getDSibling()) {
+      moment_s const & cm(subtree_moment(fb, memo, child));
+      mm.mass += cm.mass;
+      for (size_t ii(0); ii < 3; ++ii) {
+	sum[ii].add(1, cm.moment[ii]);
+      }
+    }
+    for (size_t ii(0); ii < 3; ++ii) {
+      mm.moment[ii] = fb.emit(sum[ii]);
+    }
+    return memo[node] = mm;
+  }
+
+
+  void write_fk(ostream & os, size_t ndof, chain_s const & chain)
+  {
+    function_builder fb;
+    sym_s pos[3];
+    point(fb, chain, pos);
+    frame_s const & ff(fb.frame(chain.tip));
+    for (size_t ii(0); ii < 3; ++ii) {
+      ostringstream lhs;
+      lhs << "pos[" << ii << "]";
+      fb.output(lhs.str(), pos[ii]);
+    }
+    for (size_t ii(0); ii < 3; ++ii) {
+      for (size_t jj(0); jj < 3; ++jj) {
+	ostringstream lhs;
+	lhs << "rot[" << ii << "][" << jj << "]";
+	fb.output(lhs.str(), ff.rot[ii][jj]);
+      }
+    }
+    ostringstream sig;
+    sig << "fk(double const q[" << ndof << "], double pos[3], double rot[3][3])";
+    os << "\n"
+       << "    /** Position of the control point and orientation of the\n"
+       << "\tlink, as a rotation matrix from link to global coordinates. */\n";
+    fb.write(os, "    ", sig.str());
+  }
+
+
+  void write_jacobian(ostream & os, size_t ndof, chain_s const & chain)
+  {
+    function_builder fb;
+    sym_s pos[3];
+    point(fb, chain, pos);
+    for (size_t jj(0); jj < chain.joints.size(); ++jj) {
+      taoDNode * node(chain.joints[jj]);
+      sym_s zz[3], lin[3];
+      axis(fb, node, zz);
+      if (dynamic_cast<taoJointRevolute const *>(node->getJointList())) {
+	frame_s const & ff(fb.frame(node));
+	sym_s delta[3];
+	for (size_t ii(0); ii < 3; ++ii) {
+	  sum_builder sum;
+	  sum.add(1, pos[ii]);
+	  sum.add(-1, ff.pos[ii]);
+	  delta[ii] = fb.emit(sum);
+	}
+	cross(fb, zz, delta, lin);
+      }
+      else {
+	for (size_t ii(0); ii < 3; ++ii) {
+	  lin[ii] = zz[ii];
+	  zz[ii] = sym_s(0.0);
+	}
+      }
+      for (size_t ii(0); ii < 6; ++ii) {
+	ostringstream lhs;
+	lhs << "J[" << ii << "][" << jj << "]";
+	fb.output(lhs.str(), (ii < 3) ? lin[ii] : zz[ii - 3]);
+      }
+    }
+    ostringstream sig;
+    sig << "jacobian(double const q[" << ndof << "], double J[6][" << chain.joints.size() << "])";
+    os << "\n"
+       << "    /** Jacobian of the control point, linear over angular\n"
+       << "\tvelocity, with one column per entry of joint[]. */\n";
+    fb.write(os, "    ", sig.str());
+  }
+
+
+  void write_gravity(ostream & os, size_t ndof, chain_s const & chain)
+  {
+    function_builder fb;
+    moment_map_t memo;
+    for (size_t jj(0); jj < chain.joints.size(); ++jj) {
+      taoDNode * node(chain.joints[jj]);
+      moment_s const & mm(subtree_moment(fb, memo, node));
+      sym_s zz[3];
+      axis(fb, node, zz);
+      sum_builder torque;
+      if (dynamic_cast<taoJointRevolute const *>(node->getJointList())) {
+	// moment of the subtree weight about the joint origin
+	frame_s const & ff(fb.frame(node));
+	sym_s arm[3], ww[3];
+	for (size_t ii(0); ii < 3; ++ii) {
+	  sum_builder sum;
+	  sum.add(1, mm.moment[ii]);
+	  sum.add(- mm.mass, ff.pos[ii]);
+	  arm[ii] = fb.emit(sum);
+	}
+	cross(fb, zz, arm, ww);
+	for (size_t ii(0); ii < 3; ++ii) {
+	  torque.add(- earth_gravity[ii], ww[ii]);
+	}
+      }
+      else {
+	for (size_t ii(0); ii < 3; ++ii) {
+	  torque.add(- earth_gravity[ii] * mm.mass, zz[ii]);
+	}
+      }
+      ostringstream lhs;
+      lhs << "g[" << jj << "]";
+      fb.output(lhs.str(), fb.emit(torque));
+    }
+    ostringstream sig;
+    sig << "gravity(double const q[" << ndof << "], double g[" << chain.joints.size() << "])";
+    os << "\n"
+       << "    /** Gravity torques (or forces) of the joints in joint[], due\n"
+       << "\tto the weight of everything they carry, including other\n"
+       << "\tbranches. Same sign convention as Model::getGravity(). */\n";
+    fb.write(os, "    ", sig.str());
+  }
+
+
+  bool is_identifier(string const & str)
+  {
+    if (str.empty() || isdigit(str[0])) {
+      return false;
+    }
+    for (size_t ii(0); ii < str.size(); ++ii) {
+      if (( ! isalnum(str[ii])) && ('_' != str[ii])) {
+	return false;
+      }
+    }
+    return true;
+  }
+
+
+  chain_s parse_chain(string const & spec)
+  {
+    chain_s chain;
+    chain.offset[0] = 0;
+    chain.offset[1] = 0;
+    chain.offset[2] = 0;
+    chain.tip = 0;
+    size_t const colon(spec.find(':'));
+    if (string::npos == colon) {
+      errx(EXIT_FAILURE, "invalid chain `%s', expected name:link[:x,y,z]", spec.c_str());
+    }
+    chain.name = spec.substr(0, colon);
+    if ( ! is_identifier(chain.name)) {
+      errx(EXIT_FAILURE, "chain name `%s' is not a valid C++ identifier", chain.name.c_str());
+    }
+    chain.link = spec.substr(colon + 1);
+    size_t const colon2(chain.link.rfind(':'));
+    if (string::npos != colon2) {
+      string const offset(chain.link.substr(colon2 + 1));
+      chain.link.resize(colon2);
+      if (3 != sscanf(offset.c_str(), "%lf,%lf,%lf", &chain.offset[0], &chain.offset[1], &chain.offset[2])) {
+	errx(EXIT_FAILURE, "invalid offset `%s' in chain `%s', expected x,y,z", offset.c_str(), spec.c_str());
+      }
+    }
+    return chain;
+  }
+
+}
+
+
+int main(int argc, char ** argv)
+{
+  string ns("kingen");
+  string infname;
+  string outfname;
+  vector<chain_s> chains;
+  for (int iopt(1); iopt < argc; ++iopt) {
+    string const opt(argv[iopt]);
+    if (("-n" == opt) || ("-o" == opt) || ("-c" == opt)) {
+      ++iopt;
+      if (iopt >= argc) {
+	errx(EXIT_FAILURE, "%s requires an argument (use -h for some help)", opt.c_str());
+      }
+      if ("-n" == opt) {
+	ns = argv[iopt];
+	if ( ! is_identifier(ns)) {
+	  errx(EXIT_FAILURE, "namespace `%s' is not a valid C++ identifier", argv[iopt]);
+	}
+      }
+      else if ("-o" == opt) {
+	outfname = argv[iopt];
+      }
+      else {
+	chains.push_back(parse_chain(argv[iopt]));
+      }
+    }
+    else if ("-h" == opt) {
+      printf("usage [-n namespace] [-o output] -c name:link[:x,y,z] [-c ...] [-h] robot\n"
+	     "\n"
+	     "  robot                 SAI XML file or model cache (for URDF, write a\n"
+	     "                        model cache using urdf_to_tao -c)\n"
+	     "  -n  namespace         namespace of the generated code (default kingen)\n"
+	     "  -o  output            header file to write (default stdout)\n"
+	     "  -c  name:link:x,y,z   generate kernels for the chain from the root to\n"
+	     "                        the given link, with a control point at the\n"
+	     "                        given offset in the link frame (default 0,0,0)\n"
+	     "  -h                    this message\n");
+      exit(EXIT_SUCCESS);
+    }
+    else if (infname.empty()) {
+      infname = opt;
+    }
+    else {
+      errx(EXIT_FAILURE, "invalid option `%s' (use -h for some help)", argv[iopt]);
+    }
+  }
+  if (infname.empty()) {
+    errx(EXIT_FAILURE, "robot model file required (use -h for some help)");
+  }
+  if (chains.empty()) {
+    errx(EXIT_FAILURE, "at least one chain required (use -h for some help)");
+  }
+
+  jspace::tao_tree_info_s * tree(0);
+  uint64_t hash;
+  if (jspace::read_model_cache_hash(infname, hash)) {
+    jspace::constraint_spec_s constraints;
+    jspace::Status const st(jspace::read_model_cache(infname, 0, &tree, constraints));
+    if ( ! st) {
+      errx(EXIT_FAILURE, "%s", st.errstr.c_str());
+    }
+  }
+  else {
+    try {
+      jspace::test::BRParser brp;
+      jspace::test::BranchingRepresentation * brep(brp.parse(infname));
+      tree = brep->createTreeInfo();
+      delete brep;
+    }
+    catch (std::exception const & ee) {
+      errx(EXIT_FAILURE, "exception: %s", ee.what());
+    }
+  }
+
+  size_t const ndof(tree->info.size());
+  for (size_t ii(0); ii < ndof; ++ii) {
+    taoDNode * node(tree->info[ii].node);
+    taoJoint * joint(node->getJointList());
+    taoJointDOF1 * dof1(dynamic_cast<taoJointDOF1 *>(joint));
+    if (( ! dof1) || (0 != joint->getNext()) || (static_cast<int>(ii) != node->getID())
+	|| (2 < dof1->getAxis())
+	|| ! (dynamic_cast<taoJointRevolute *>(joint) || dynamic_cast<taoJointPrismatic *>(joint))) {
+      errx(EXIT_FAILURE, "node `%s' does not have exactly one revolute or prismatic joint about X, Y, or Z",
+	   tree->info[ii].link_name.c_str());
+    }
+  }
+
+  for (size_t ic(0); ic < chains.size(); ++ic) {
+    chain_s & chain(chains[ic]);
+    for (size_t jc(0); jc < ic; ++jc) {
+      if (chains[jc].name == chain.name) {
+	errx(EXIT_FAILURE, "duplicate chain name `%s'", chain.name.c_str());
+      }
+    }
+    for (size_t ii(0); ii < ndof; ++ii) {
+      if (tree->info[ii].link_name == chain.link) {
+	chain.tip = tree->info[ii].node;
+	break;
+      }
+    }
+    if ( ! chain.tip) {
+      errx(EXIT_FAILURE, "no link called `%s' in %s", chain.link.c_str(), infname.c_str());
+    }
+    for (taoDNode * node(chain.tip); node->getDParent(); node = node->getDParent()) {
+      chain.joints.push_back(node);
+    }
+    reverse(chain.joints.begin(), chain.joints.end());
+  }
+
+  ostringstream os;
+  string guard(ns);
+  transform(guard.begin(), guard.end(), guard.begin(), ::toupper);
+  guard += "_KINGEN_HPP";
+  os << "// Generated by wbc_kingen from " << infname << ", do not edit.\n"
+     << "\n"
+     << "#ifndef " << guard << "\n"
+     << "#define " << guard << "\n"
+     << "\n"
+     << "#include <math.h>\n"
+     << "\n"
+     << "namespace " << ns << " {\n"
+     << "\n"
+     << "  /** Size of the joint position array that all kernels take as\n"
+     << "      first argument, indexed like the jspace::Model DOF. */\n"
+     << "  static int const ndof = " << ndof << ";\n"
+     << "\n"
+     << "  inline void sin_cos(double angle, double * ss, double * cc)\n"
+     << "  {\n"
+     << "#if defined (__GLIBC__) && defined (_GNU_SOURCE)\n"
+     << "    sincos(angle, ss, cc);\n"
+     << "#else\n"
+     << "    *ss = sin(angle);\n"
+     << "    *cc = cos(angle);\n"
+     << "#endif\n"
+     << "  }\n";
+
+  for (size_t ic(0); ic < chains.size(); ++ic) {
+    chain_s const & chain(chains[ic]);
+    os << "\n"
+       << "\n"
+       << "  /** Chain from the root to link `" << chain.link << "', control point at ("
+       << literal(chain.offset[0]) << ", " << literal(chain.offset[1]) << ", "
+       << literal(chain.offset[2]) << ").\n";
+    for (size_t jj(0); jj < chain.joints.size(); ++jj) {
+      jspace::tao_node_info_s const & info(tree->info[chain.joints[jj]->getID()]);
+      os << "      - joint[" << jj << "] = " << info.id << " `" << info.joint_name << "'\n";
+    }
+    os << "  */\n"
+       << "  namespace " << chain.name << " {\n"
+       << "\n"
+       << "    static int const njoints = " << chain.joints.size() << ";\n"
+       << "\n"
+       << "    static int const joint[" << chain.joints.size() << "] = {";
+    for (size_t jj(0); jj < chain.joints.size(); ++jj) {
+      os << ((0 == jj) ? " " : ", ") << chain.joints[jj]->getID();
+    }
+    os << " };\n";
+    write_fk(os, ndof, chain);
+    write_jacobian(os, ndof, chain);
+    write_gravity(os, ndof, chain);
+    os << "\n"
+       << "  }\n";
+  }
+  os << "\n"
+     << "}\n"
+     << "\n"
+     << "#endif // " << guard << "\n";
+  delete tree;
+
+  if (outfname.empty()) {
+    cout << os.str();
+  }
+  else {
+    ofstream out(outfname.c_str());
+    out << os.str();
+    if ( ! out) {
+      errx(EXIT_FAILURE, "failed to write %s", outfname.c_str());
+    }
+  }
+}
@@ -1,8 +1,17 @@
 #include <jspace/pseudo_inverse.hpp>
 #include <jspace/Constraint.hpp>
+#include <jspace/Model.hpp>
 
 namespace jspace {
 
+  Constraint::Constraint()
+    : sigmaThreshold_(0.0001),
+      projection_valid_(false),
+      projection_version_(0),
+      reuse_threshold_(0)
+  {
+  }
+
   Status Constraint::getU(Matrix & U) 
   {
     U = U_;
@@ -22,7 +31,7 @@ namespace jspace {
     return ok;
   }
   
-  Status Constraint::getJcBar(Matrix const Ainv,
+  Status Constraint::getJcBar(Matrix const & Ainv,
 				 Matrix & JcBar) {
     Matrix lambda;
     pseudoInverse(Jc_ * Ainv * Jc_.transpose(),
@@ -34,7 +43,7 @@ namespace jspace {
     return ok;
   }
 
-  Status Constraint::getNc(Matrix const Ainv,
+  Status Constraint::getNc(Matrix const & Ainv,
 			      Matrix & Nc) {
     Matrix JcBar;
     if (!getJcBar(Ainv,JcBar)) {
@@ -47,7 +56,7 @@ namespace jspace {
     return ok;
   }
 
-  Status Constraint::getUNc(Matrix const Ainv,
+  Status Constraint::getUNc(Matrix const & Ainv,
 			       Matrix & UNc) {
     Matrix Nc;
     if (!getNc(Ainv,Nc)) {
@@ -60,7 +69,7 @@ namespace jspace {
     return ok;
   }
   
-  Status Constraint::getUNcBar(Matrix const Ainv,
+  Status Constraint::getUNcBar(Matrix const & Ainv,
 				  Matrix & UNcBar) {
     Matrix UNc;
     if (!getUNc(Ainv,UNc)) {
@@ -77,4 +86,90 @@ namespace jspace {
     return ok;
   }
 
+
+  Status Constraint::updateProjection(Model const & model) {
+    if (projection_valid_ && (model.getStateVersion() == projection_version_)) {
+      Status ok;
+      return ok;
+    }
+    
+    Vector const & position(model.getFullState().position_);
+    if (projection_valid_ && (position.rows() == projection_position_.rows())) {
+      double const delta((position - projection_position_).cwise().abs().maxCoeff());
+      if (delta <= reuse_threshold_) {
+	projection_version_ = model.getStateVersion();
+	Status ok;
+	return ok;
+      }
+    }
+    
+    projection_valid_ = false;
+    Status st(updateJc(model));
+    if ( ! st) {
+      return st;
+    }
+    if ( ! model.getInverseMassInertia(projection_.Ainv)) {
+      return Status(false, "failed to get inverse mass inertia");
+    }
+    Matrix const & ainv(projection_.Ainv);
+    
+    Matrix lambda;
+    if (jc_columns_.empty()) {
+      pseudoInverse(Jc_ * ainv * Jc_.transpose(),
+		    sigmaThreshold_,
+		    lambda, 0);
+      Matrix const JcBar(ainv * Jc_.transpose() * lambda);
+      projection_.Nc = Matrix::Identity(ainv.rows(), ainv.cols()) - JcBar * Jc_;
+    }
+    else {
+      // Gather the non-zero columns of Jc, and the matching columns
+      // and rows of Ainv, so that none of the products below run
+      // through the columns that are known to be zero.
+      size_t const ncols(jc_columns_.size());
+      Matrix jc(Jc_.rows(), ncols);
+      Matrix ainv_cols(ainv.rows(), ncols);
+      for (size_t ii(0); ii < ncols; ++ii) {
+	jc.col(ii) = Jc_.col(jc_columns_[ii]);
+	ainv_cols.col(ii) = ainv.col(jc_columns_[ii]);
+      }
+      Matrix const ainvJct(ainv_cols * jc.transpose());
+      Matrix ainvJct_rows(ncols, ainvJct.cols());
+      for (size_t ii(0); ii < ncols; ++ii) {
+	ainvJct_rows.row(ii) = ainvJct.row(jc_columns_[ii]);
+      }
+      pseudoInverse(jc * ainvJct_rows,
+		    sigmaThreshold_,
+		    lambda, 0);
+      Matrix const JcBar(ainvJct * lambda);
+      projection_.Nc = Matrix::Identity(ainv.rows(), ainv.cols());
+      for (size_t ii(0); ii < ncols; ++ii) {
+	projection_.Nc.col(jc_columns_[ii]) -= JcBar * jc.col(ii);
+      }
+    }
+    if (selection_.empty()) {
+      projection_.UNc = U_ * projection_.Nc;
+    }
+    else {
+      projection_.UNc.resize(selection_.size(), projection_.Nc.cols());
+      for (size_t ii(0); ii < selection_.size(); ++ii) {
+	projection_.UNc.row(ii) = projection_.Nc.row(selection_[ii]);
+      }
+    }
+    
+    // computing ainv * UNc^T once saves a product below
+    Matrix const ainvUNct(ainv * projection_.UNc.transpose());
+    projection_.phi = projection_.UNc * ainvUNct;
+    pseudoInverse(projection_.phi,
+		  sigmaThreshold_,
+		  projection_.phiinv, 0);
+    projection_.UNcBar = ainvUNct * projection_.phiinv;
+    
+    projection_position_ = position;
+    projection_version_ = model.getStateVersion();
+    projection_valid_ = true;
+    
+    Status ok;
+    return ok;
+  }
+
 }
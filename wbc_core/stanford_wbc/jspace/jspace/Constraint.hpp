@@ -3,32 +3,93 @@
 
 #include <jspace/Status.hpp>
 #include <jspace/State.hpp>
+#include <vector>
 
 namespace jspace {
   
   class Model;
 
+  /**
+     Everything that the controllers and the full-state estimation
+     need to know about the constraint projection. Computed by
+     Constraint::updateProjection() and shared by all consumers.
+  */
+  struct constraint_projection_s {
+    Matrix Ainv;		/**< inverse mass-inertia used for the rest */
+    Matrix Nc;			/**< dynamically consistent constraint nullspace */
+    Matrix UNc;			/**< U * Nc */
+    Matrix phi;			/**< UNc * Ainv * UNc^T */
+    Matrix phiinv;		/**< pseudo-inverse of phi */
+    Matrix UNcBar;		/**< Ainv * UNc^T * phiinv */
+  };
+
   class Constraint {
   public:
-    Constraint() {}
+    Constraint();
+    virtual ~Constraint() {}
     virtual Status getU(Matrix & U);
     virtual Status updateJc(Model const & model);
     virtual Status getJc(Matrix & Jc);
-    virtual Status getJcBar(Matrix const Ainv,
+    virtual Status getJcBar(Matrix const & Ainv,
 			    Matrix & JcBar);
-    virtual Status getNc(Matrix const Ainv,
+    virtual Status getNc(Matrix const & Ainv,
 			 Matrix & Nc);
-    virtual Status getUNc(Matrix const Ainv,
+    virtual Status getUNc(Matrix const & Ainv,
 			  Matrix & UNc);
-    virtual Status getUNcBar(Matrix const Ainv,
+    virtual Status getUNcBar(Matrix const & Ainv,
 			     Matrix & UNcBar);
+    /**
+       Fill in the full (constrained) state from the actuated state.
+       Model::setState() calls this exactly once per state and owns
+       fullState, which already has ndof entries and still holds
+       whatever was written on the previous tick, so implementations
+       can integrate (e.g. odometry) and should write in place.
+       Everybody else reads the result via Model::getFullState().
+    */
     virtual void getFullState(State const & state,
 			      State & fullState) = 0;
 
+    /**
+       Compute Jc (using updateJc()) and all the derived projection
+       matrices for the current model state, and cache them. Call
+       this after Model::update(). Subsequent calls with the same
+       model state (see Model::getStateVersion()) return right away,
+       so everybody who needs the projection can just call this and
+       then use getProjection().
+
+       Jc and Ainv only depend on the joint positions. If the full
+       state positions moved by less than the reuse threshold
+       (max-norm) since the last time the projection was computed,
+       the cached matrices are kept. The default threshold of zero
+       means they only get reused if the configuration is exactly
+       the same, which keeps the result exact.
+    */
+    virtual Status updateProjection(Model const & model);
+
+    /** Valid after a successful updateProjection(). */
+    inline constraint_projection_s const & getProjection() const { return projection_; }
+
+    inline void setReuseThreshold(double threshold) { reuse_threshold_ = threshold; }
+    inline double getReuseThreshold() const { return reuse_threshold_; }
+
   protected:
     Matrix U_;
     Matrix Jc_;
     double sigmaThreshold_;
+    
+    /** If non-empty, U_ simply selects these columns (one per row),
+	and updateProjection() gathers rows instead of multiplying. */
+    std::vector<size_t> selection_;
+    
+    /** If non-empty, Jc_ is zero outside these (distinct) columns,
+	and updateProjection() only multiplies through them. */
+    std::vector<size_t> jc_columns_;
+    
+    constraint_projection_s projection_;
+    bool projection_valid_;
+    size_t projection_version_;
+    Vector projection_position_;
+    double reuse_threshold_;
   };
 }
 
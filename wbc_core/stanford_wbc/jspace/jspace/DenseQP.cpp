@@ -0,0 +1,470 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include <jspace/DenseQP.hpp>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+
+
+namespace {
+
+  double const inf(numeric_limits<double>::infinity());
+  double const eps(numeric_limits<double>::epsilon());
+
+  // An inequality counts as violated when it is off by more than
+  // this, relative to its right hand side.
+  double const feasibility_tolerance(1e-9);
+
+
+  /** sqrt(a^2 + b^2) without needless overflow. */
+  inline double distance(double aa, double bb)
+  {
+    aa = fabs(aa);
+    bb = fabs(bb);
+    if (aa > bb) {
+      double const tt(bb / aa);
+      return aa * sqrt(1.0 + tt * tt);
+    }
+    if (bb > aa) {
+      double const tt(aa / bb);
+      return bb * sqrt(1.0 + tt * tt);
+    }
+    return aa * sqrt(2.0);
+  }
+
+}
+
+
+namespace jspace {
+
+
+  DenseQP::
+  DenseQP()
+    : warm_nineq_(0),
+      nactive_(0),
+      niterations_(0)
+  {
+  }
+
+
+  void DenseQP::
+  init(size_t max_var, size_t max_eq, size_t max_ineq)
+  {
+    H_ = Matrix::Zero(max_var, max_var);
+    f_ = Vector::Zero(max_var);
+    Ceq_ = Matrix::Zero(max_eq, max_var);
+    deq_ = Vector::Zero(max_eq);
+    Cin_ = Matrix::Zero(max_ineq, max_var);
+    din_ = Vector::Zero(max_ineq);
+    L_ = Matrix::Zero(max_var, max_var);
+    J_ = Matrix::Zero(max_var, max_var);
+    R_ = Matrix::Zero(max_var, max_var);
+    x_ = Vector::Zero(max_var);
+    np_ = Vector::Zero(max_var);
+    dd_ = Vector::Zero(max_var);
+    zz_ = Vector::Zero(max_var);
+    rr_ = Vector::Zero(max_var + 1);
+    uu_ = Vector::Zero(max_var + 1);
+    active_.assign(max_var + 1, 0);
+    inset_.assign(max_ineq, 0);
+    excluded_.assign(max_ineq, 0);
+    warm_.assign(max_ineq, 0);
+    warm_nineq_ = 0;
+    nactive_ = 0;
+    niterations_ = 0;
+  }
+
+
+  void DenseQP::
+  resetWarmStart()
+  {
+    for (size_t ii(0); ii < warm_.size(); ++ii) {
+      warm_[ii] = 0;
+    }
+  }
+
+
+  void DenseQP::
+  computeStep(size_t nvar, size_t iq)
+  {
+    // d = J^T n
+    for (size_t ii(0); ii < nvar; ++ii) {
+      double sum(0);
+      for (size_t kk(0); kk < nvar; ++kk) {
+	sum += J_.coeff(kk, ii) * np_.coeff(kk);
+      }
+      dd_.coeffRef(ii) = sum;
+    }
+
+    // primal step direction z = J2 d2, from the columns of J which
+    // are not (yet) taken up by active constraints
+    for (size_t ii(0); ii < nvar; ++ii) {
+      double sum(0);
+      for (size_t jj(iq); jj < nvar; ++jj) {
+	sum += J_.coeff(ii, jj) * dd_.coeff(jj);
+      }
+      zz_.coeffRef(ii) = sum;
+    }
+
+    // dual step direction r = R^-1 d1
+    for (int ii(iq - 1); ii >= 0; --ii) {
+      double sum(dd_.coeff(ii));
+      for (size_t jj(ii + 1); jj < iq; ++jj) {
+	sum -= R_.coeff(ii, jj) * rr_.coeff(jj);
+      }
+      rr_.coeffRef(ii) = sum / R_.coeff(ii, ii);
+    }
+  }
+
+
+  bool DenseQP::
+  addConstraint(size_t nvar, size_t & iq, double & rnorm)
+  {
+    if (iq >= nvar) {
+      return false;
+    }
+
+    // Givens rotations which zero d below position iq, applied to
+    // the columns of J as well.
+    for (int jj(nvar - 1); jj > static_cast<int>(iq); --jj) {
+      double cc(dd_.coeff(jj - 1));
+      double ss(dd_.coeff(jj));
+      double const hh(distance(cc, ss));
+      if (0 == hh) {
+	continue;
+      }
+      dd_.coeffRef(jj) = 0;
+      ss /= hh;
+      cc /= hh;
+      if (cc < 0) {
+	cc = -cc;
+	ss = -ss;
+	dd_.coeffRef(jj - 1) = -hh;
+      }
+      else {
+	dd_.coeffRef(jj - 1) = hh;
+      }
+      double const xny(ss / (1.0 + cc));
+      for (size_t kk(0); kk < nvar; ++kk) {
+	double const t1(J_.coeff(kk, jj - 1));
+	double const t2(J_.coeff(kk, jj));
+	J_.coeffRef(kk, jj - 1) = t1 * cc + t2 * ss;
+	J_.coeffRef(kk, jj) = xny * (t1 + J_.coeff(kk, jj - 1)) - t2;
+      }
+    }
+
+    if (fabs(dd_.coeff(iq)) <= eps * rnorm) {
+      // linearly dependent on the active set
+      return false;
+    }
+    for (size_t ii(0); ii <= iq; ++ii) {
+      R_.coeffRef(ii, iq) = dd_.coeff(ii);
+    }
+    if (fabs(dd_.coeff(iq)) > rnorm) {
+      rnorm = fabs(dd_.coeff(iq));
+    }
+    ++iq;
+    return true;
+  }
+
+
+  void DenseQP::
+  deleteConstraint(size_t nvar, size_t & iq, size_t position)
+  {
+    if (active_[position] >= 0) {
+      inset_[active_[position]] = 0;
+    }
+
+    // Shift everything after position one to the left, including
+    // the candidate at iq, and drop the last column of R.
+    for (size_t ii(position); ii + 1 < iq; ++ii) {
+      active_[ii] = active_[ii + 1];
+      uu_.coeffRef(ii) = uu_.coeff(ii + 1);
+      for (size_t jj(0); jj < nvar; ++jj) {
+	R_.coeffRef(jj, ii) = R_.coeff(jj, ii + 1);
+      }
+    }
+    active_[iq - 1] = active_[iq];
+    uu_.coeffRef(iq - 1) = uu_.coeff(iq);
+    active_[iq] = 0;
+    uu_.coeffRef(iq) = 0;
+    for (size_t jj(0); jj < iq; ++jj) {
+      R_.coeffRef(jj, iq - 1) = 0;
+    }
+    --iq;
+
+    // R is now upper Hessenberg from position on, rotate it back to
+    // triangular and apply the same rotations to J.
+    for (size_t jj(position); jj < iq; ++jj) {
+      double cc(R_.coeff(jj, jj));
+      double ss(R_.coeff(jj + 1, jj));
+      double const hh(distance(cc, ss));
+      if (0 == hh) {
+	continue;
+      }
+      cc /= hh;
+      ss /= hh;
+      R_.coeffRef(jj + 1, jj) = 0;
+      if (cc < 0) {
+	R_.coeffRef(jj, jj) = -hh;
+	cc = -cc;
+	ss = -ss;
+      }
+      else {
+	R_.coeffRef(jj, jj) = hh;
+      }
+      double const xny(ss / (1.0 + cc));
+      for (size_t kk(jj + 1); kk < iq; ++kk) {
+	double const t1(R_.coeff(jj, kk));
+	double const t2(R_.coeff(jj + 1, kk));
+	R_.coeffRef(jj, kk) = t1 * cc + t2 * ss;
+	R_.coeffRef(jj + 1, kk) = xny * (t1 + R_.coeff(jj, kk)) - t2;
+      }
+      for (size_t kk(0); kk < nvar; ++kk) {
+	double const t1(J_.coeff(kk, jj));
+	double const t2(J_.coeff(kk, jj + 1));
+	J_.coeffRef(kk, jj) = t1 * cc + t2 * ss;
+	J_.coeffRef(kk, jj + 1) = xny * (J_.coeff(kk, jj) + t1) - t2;
+      }
+    }
+  }
+
+
+  Status DenseQP::
+  solve(size_t nvar, size_t neq, size_t nineq)
+  {
+    niterations_ = 0;
+    nactive_ = 0;
+    if ((0 == nvar)
+	|| (nvar > static_cast<size_t>(H_.rows()))
+	|| (neq > static_cast<size_t>(Ceq_.rows()))
+	|| (nineq > static_cast<size_t>(Cin_.rows()))) {
+      return Status(false, "problem size exceeds what was allocated in init()");
+    }
+    if (nineq != warm_nineq_) {
+      resetWarmStart();
+      warm_nineq_ = nineq;
+    }
+
+    // H = L L^T
+    for (size_t jj(0); jj < nvar; ++jj) {
+      double sum(H_.coeff(jj, jj));
+      for (size_t kk(0); kk < jj; ++kk) {
+	sum -= L_.coeff(jj, kk) * L_.coeff(jj, kk);
+      }
+      if (sum <= 0) {
+	return Status(false, "Hessian is not positive definite");
+      }
+      L_.coeffRef(jj, jj) = sqrt(sum);
+      for (size_t ii(jj + 1); ii < nvar; ++ii) {
+	double sum(H_.coeff(ii, jj));
+	for (size_t kk(0); kk < jj; ++kk) {
+	  sum -= L_.coeff(ii, kk) * L_.coeff(jj, kk);
+	}
+	L_.coeffRef(ii, jj) = sum / L_.coeff(jj, jj);
+      }
+    }
+
+    // J = L^-T, upper triangular
+    for (size_t cc(0); cc < nvar; ++cc) {
+      for (int ii(nvar - 1); ii >= 0; --ii) {
+	double sum((static_cast<size_t>(ii) == cc) ? 1.0 : 0.0);
+	for (size_t kk(ii + 1); kk < nvar; ++kk) {
+	  sum -= L_.coeff(kk, ii) * J_.coeff(kk, cc);
+	}
+	J_.coeffRef(ii, cc) = sum / L_.coeff(ii, ii);
+      }
+    }
+
+    // unconstrained minimum x = - H^-1 f = - J J^T f
+    for (size_t ii(0); ii < nvar; ++ii) {
+      double sum(0);
+      for (size_t kk(0); kk < nvar; ++kk) {
+	sum += J_.coeff(kk, ii) * f_.coeff(kk);
+      }
+      dd_.coeffRef(ii) = sum;
+    }
+    for (size_t ii(0); ii < nvar; ++ii) {
+      double sum(0);
+      for (size_t kk(ii); kk < nvar; ++kk) {
+	sum += J_.coeff(ii, kk) * dd_.coeff(kk);
+      }
+      x_.coeffRef(ii) = -sum;
+    }
+
+    size_t iq(0);
+    double rnorm(1.0);
+    for (size_t ii(0); ii < nineq; ++ii) {
+      inset_[ii] = 0;
+      excluded_[ii] = 0;
+    }
+
+    // Equalities go in first and stay in, with full steps onto each.
+    for (size_t ie(0); ie < neq; ++ie) {
+      for (size_t kk(0); kk < nvar; ++kk) {
+	np_.coeffRef(kk) = Ceq_.coeff(ie, kk);
+      }
+      computeStep(nvar, iq);
+      double zz2(0), zn(0), nx(0);
+      for (size_t kk(0); kk < nvar; ++kk) {
+	zz2 += zz_.coeff(kk) * zz_.coeff(kk);
+	zn += zz_.coeff(kk) * np_.coeff(kk);
+	nx += np_.coeff(kk) * x_.coeff(kk);
+      }
+      double tt(0);
+      if (zz2 > eps) {
+	tt = (deq_.coeff(ie) - nx) / zn;
+      }
+      for (size_t kk(0); kk < nvar; ++kk) {
+	x_.coeffRef(kk) += tt * zz_.coeff(kk);
+      }
+      uu_.coeffRef(iq) = tt;
+      for (size_t kk(0); kk < iq; ++kk) {
+	uu_.coeffRef(kk) -= tt * rr_.coeff(kk);
+      }
+      active_[iq] = -1 - static_cast<int>(ie);
+      ++niterations_;
+      if ( ! addConstraint(nvar, iq, rnorm)) {
+	return Status(false, "equality constraints are linearly dependent");
+      }
+    }
+
+    size_t const max_iterations(neq + 10 * (nvar + nineq) + 10);
+
+    for (;;) {
+
+      // Pick the inequality to add: among the violated ones, prefer
+      // those which were active last time, then the most violated.
+      int pp(-1);
+      double sp(0);
+      bool pwarm(false);
+      for (size_t ii(0); ii < nineq; ++ii) {
+	if (inset_[ii] || excluded_[ii]) {
+	  continue;
+	}
+	double ss(-din_.coeff(ii));
+	for (size_t kk(0); kk < nvar; ++kk) {
+	  ss += Cin_.coeff(ii, kk) * x_.coeff(kk);
+	}
+	if (ss >= - feasibility_tolerance * (1.0 + fabs(din_.coeff(ii)))) {
+	  continue;
+	}
+	bool const warm(warm_[ii]);
+	if ((pp < 0) || (warm && ! pwarm) || ((warm == pwarm) && (ss < sp))) {
+	  pp = ii;
+	  sp = ss;
+	  pwarm = warm;
+	}
+      }
+      if (pp < 0) {
+	break;
+      }
+
+      for (size_t kk(0); kk < nvar; ++kk) {
+	np_.coeffRef(kk) = Cin_.coeff(pp, kk);
+      }
+      uu_.coeffRef(iq) = 0;
+      active_[iq] = pp;
+
+      for (;;) {
+	if (++niterations_ > max_iterations) {
+	  return Status(false, "iteration limit exceeded");
+	}
+	computeStep(nvar, iq);
+
+	// partial step: largest dual step that keeps the multipliers
+	// of the active inequalities non-negative
+	double t1(inf);
+	int ll(-1);
+	for (size_t kk(neq); kk < iq; ++kk) {
+	  if ((rr_.coeff(kk) > 0) && (uu_.coeff(kk) / rr_.coeff(kk) < t1)) {
+	    t1 = uu_.coeff(kk) / rr_.coeff(kk);
+	    ll = kk;
+	  }
+	}
+
+	// full step: onto the constraint
+	double t2(inf);
+	double zz2(0), zn(0);
+	for (size_t kk(0); kk < nvar; ++kk) {
+	  zz2 += zz_.coeff(kk) * zz_.coeff(kk);
+	  zn += zz_.coeff(kk) * np_.coeff(kk);
+	}
+	if (zz2 > eps) {
+	  t2 = - sp / zn;
+	}
+
+	if ((inf == t1) && (inf == t2)) {
+	  return Status(false, "constraints are infeasible");
+	}
+
+	if (inf == t2) {
+	  // step in dual space only
+	  for (size_t kk(0); kk < iq; ++kk) {
+	    uu_.coeffRef(kk) -= t1 * rr_.coeff(kk);
+	  }
+	  uu_.coeffRef(iq) += t1;
+	  deleteConstraint(nvar, iq, ll);
+	  continue;
+	}
+
+	double const tt((t1 < t2) ? t1 : t2);
+	for (size_t kk(0); kk < nvar; ++kk) {
+	  x_.coeffRef(kk) += tt * zz_.coeff(kk);
+	}
+	for (size_t kk(0); kk < iq; ++kk) {
+	  uu_.coeffRef(kk) -= tt * rr_.coeff(kk);
+	}
+	uu_.coeffRef(iq) += tt;
+
+	if (t2 <= t1) {
+	  if (addConstraint(nvar, iq, rnorm)) {
+	    inset_[pp] = 1;
+	  }
+	  else {
+	    // Numerically dependent on the active set. It is satisfied
+	    // now, so just stop looking at it.
+	    excluded_[pp] = 1;
+	    uu_.coeffRef(iq) = 0;
+	  }
+	  break;
+	}
+
+	deleteConstraint(nvar, iq, ll);
+	sp = - din_.coeff(pp);
+	for (size_t kk(0); kk < nvar; ++kk) {
+	  sp += np_.coeff(kk) * x_.coeff(kk);
+	}
+      }
+    }
+
+    for (size_t ii(0); ii < nineq; ++ii) {
+      warm_[ii] = inset_[ii];
+    }
+    nactive_ = iq - neq;
+    return Status();
+  }
+
+}
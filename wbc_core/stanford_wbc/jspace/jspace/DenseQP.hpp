@@ -0,0 +1,138 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef JSPACE_DENSE_QP_HPP
+#define JSPACE_DENSE_QP_HPP
+
+#include <jspace/Status.hpp>
+#include <jspace/wrap_eigen.hpp>
+#include <vector>
+
+namespace jspace {
+
+  /**
+     Small dense strictly convex quadratic program
+
+       min  1/2 x^T H x + f^T x
+       s.t. Ceq x  = deq
+	    Cin x >= din
+
+     solved with the dual active-set method of Goldfarb and Idnani,
+     which does not need a feasible starting point: it starts at the
+     unconstrained minimum and adds violated constraints one at a
+     time.
+
+     All storage is allocated by init() for the largest problem that
+     will be posed. The problem data lives inside the solver: fill in
+     the leading nvar-by-nvar part of getHessian(), the leading
+     entries of getGradient(), and so on, then call solve() with the
+     actual sizes. Neither filling in a problem nor solving it
+     allocates memory, so a DenseQP can be used in a servo loop.
+
+     The inequalities that were active at the end of a solve() are
+     remembered. When the next problem has the same number of
+     inequalities, those get added first (if violated), which usually
+     brings the number of iterations close to the number of active
+     constraints when the problem changes a little from tick to tick.
+  */
+  class DenseQP
+  {
+  public:
+    DenseQP();
+
+    /** Allocate for at most max_var variables, max_eq equality and
+	max_ineq inequality constraints, and forget the warm start. */
+    void init(size_t max_var, size_t max_eq, size_t max_ineq);
+
+    inline size_t maxVariables() const { return H_.rows(); }
+    inline size_t maxEqualities() const { return Ceq_.rows(); }
+    inline size_t maxInequalities() const { return Cin_.rows(); }
+
+    /** Must be symmetric positive definite (in its leading part). */
+    inline Matrix & getHessian() { return H_; }
+    inline Vector & getGradient() { return f_; }
+    inline Matrix & getEqualityMatrix() { return Ceq_; }
+    inline Vector & getEqualityVector() { return deq_; }
+    inline Matrix & getInequalityMatrix() { return Cin_; }
+    inline Vector & getInequalityVector() { return din_; }
+
+    /** Solve the problem made up of the leading nvar columns, neq
+	equality rows and nineq inequality rows of the problem
+	data. Fails if the Hessian is not positive definite, if the
+	equalities are linearly dependent, or if the constraints are
+	infeasible. */
+    Status solve(size_t nvar, size_t neq, size_t nineq);
+
+    /** The leading nvar entries hold the solution of the last
+	successful solve(). */
+    inline Vector const & getSolution() const { return x_; }
+
+    /** Number of inequalities active at the solution. */
+    inline size_t getNActive() const { return nactive_; }
+
+    /** Whether inequality ii was active at the solution. */
+    inline bool isActive(size_t ii) const { return warm_[ii]; }
+
+    /** Number of constraint additions and removals in the last
+	solve(), including the equalities. */
+    inline size_t getNIterations() const { return niterations_; }
+
+    /** Forget which inequalities were active. */
+    void resetWarmStart();
+
+  protected:
+    // problem data
+    Matrix H_;
+    Vector f_;
+    Matrix Ceq_;
+    Vector deq_;
+    Matrix Cin_;
+    Vector din_;
+
+    // Cholesky factor of H, then the orthogonal-ish basis J = L^-T Q
+    // and the upper triangular R of the active constraints.
+    Matrix L_;
+    Matrix J_;
+    Matrix R_;
+    Vector x_;
+    Vector np_;
+    Vector dd_;
+    Vector zz_;
+    Vector rr_;
+    Vector uu_;			// multipliers, one more than active
+    std::vector<int> active_;	// eq: -1-index, ineq: index
+    std::vector<char> inset_;	// per inequality
+    std::vector<char> excluded_; // numerically dependent ones
+    std::vector<char> warm_;	// active at end of the last solve
+    size_t warm_nineq_;
+    size_t nactive_;
+    size_t niterations_;
+
+    void computeStep(size_t nvar, size_t iq);
+    bool addConstraint(size_t nvar, size_t & iq, double & rnorm);
+    void deleteConstraint(size_t nvar, size_t & iq, size_t position);
+  };
+
+}
+
+#endif // JSPACE_DENSE_QP_HPP
@@ -0,0 +1,542 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include <jspace/DynamicsDerivatives.hpp>
+#include <jspace/Model.hpp>
+#include <jspace/State.hpp>
+#include <tao/dynamics/taoDNode.h>
+#include <tao/dynamics/taoJoint.h>
+#include <iostream>
+#include <sstream>
+#include <cmath>
+
+using namespace std;
+
+
+namespace {
+
+  typedef Eigen::Matrix<double, 6, 1> Vector6;
+  typedef Eigen::Matrix<double, 6, 6> Matrix6;
+
+
+  // Same gravity as in Model.cpp
+  double const earth_gravity_z(-9.81);
+
+
+  Eigen::Matrix3d skew(Eigen::Vector3d const & vv)
+  {
+    Eigen::Matrix3d mm;
+    mm <<
+      0, -vv[2], vv[1],
+      vv[2], 0, -vv[0],
+      -vv[1], vv[0], 0;
+    return mm;
+  }
+
+
+  // Spatial vectors are linear over angular, as in the Jacobian. The
+  // motion cross product (vv x mm) is the rate of change of the motion
+  // vector mm when it gets carried along with the velocity vv.
+  Vector6 motion_cross(Vector6 const & vv, Vector6 const & mm)
+  {
+    Eigen::Vector3d const vl(vv.segment<3>(0));
+    Eigen::Vector3d const va(vv.segment<3>(3));
+    Eigen::Vector3d const ml(mm.segment<3>(0));
+    Eigen::Vector3d const ma(mm.segment<3>(3));
+    Vector6 result;
+    result.segment<3>(0) = va.cross(ml) + vl.cross(ma);
+    result.segment<3>(3) = va.cross(ma);
+    return result;
+  }
+
+
+  // Force cross product, the dual of motion_cross().
+  Vector6 force_cross(Vector6 const & vv, Vector6 const & ff)
+  {
+    Eigen::Vector3d const vl(vv.segment<3>(0));
+    Eigen::Vector3d const va(vv.segment<3>(3));
+    Eigen::Vector3d const fl(ff.segment<3>(0));
+    Eigen::Vector3d const fa(ff.segment<3>(3));
+    Vector6 result;
+    result.segment<3>(0) = va.cross(fl);
+    result.segment<3>(3) = va.cross(fa) + vl.cross(fl);
+    return result;
+  }
+
+
+  // Rate of change of a spatial inertia that rotates (or translates)
+  // along with the motion vector ss.
+  Matrix6 inertia_rate(Vector6 const & ss, Matrix6 const & inertia)
+  {
+    Matrix6 crm(Matrix6::Zero());
+    Eigen::Matrix3d const sl(skew(ss.segment<3>(0)));
+    Eigen::Matrix3d const sa(skew(ss.segment<3>(3)));
+    crm.block<3,3>(0, 0) = sa;
+    crm.block<3,3>(0, 3) = sl;
+    crm.block<3,3>(3, 3) = sa;
+    // the force cross product matrix is -crm^T
+    Matrix6 const tmp(inertia * crm);
+    return - crm.transpose() * inertia - tmp;
+  }
+
+}
+
+
+namespace jspace {
+
+
+  DynamicsDerivatives::
+  DynamicsDerivatives()
+    : ndof_(0)
+  {
+  }
+
+
+  Status DynamicsDerivatives::
+  init(Model const & model)
+  {
+    ndof_ = model.getNDOF();
+    if (0 == ndof_) {
+      return Status(false, "model has no DOF (not initialized?)");
+    }
+
+    parent_.resize(ndof_);
+    rotor_.resize(ndof_);
+    for (size_t ii(0); ii < ndof_; ++ii) {
+      taoDNode * node(model.getNode(ii));
+      if ( ! node) {
+	ostringstream msg;
+	msg << "no node for DOF " << ii;
+	return Status(false, msg.str());
+      }
+      taoJoint * joint(node->getJointList());
+      if (( ! joint) || (1 != joint->getDOF()) || (0 != joint->getNext())) {
+	ostringstream msg;
+	msg << "node " << ii << " does not have exactly one single-DOF joint";
+	return Status(false, msg.str());
+      }
+      parent_[ii] = -1;
+      for (taoDNode * anc(node->getDParent()); 0 != anc; anc = anc->getDParent()) {
+	if ((0 != anc->getJointList()) && (0 <= anc->getID())) {
+	  parent_[ii] = anc->getID();
+	  break;
+	}
+      }
+      rotor_[ii] = 0;
+      if (node->rotorInertia() && node->gearRatio()) {
+	rotor_[ii] = *node->rotorInertia() * pow(*node->gearRatio(), 2);
+      }
+    }
+
+    // Order the DOF by depth, which puts parents before their
+    // children.
+    std::vector<size_t> depth(ndof_, 0);
+    size_t maxdepth(0);
+    for (size_t ii(0); ii < ndof_; ++ii) {
+      for (int anc(parent_[ii]); anc >= 0; anc = parent_[anc]) {
+	if (++depth[ii] > ndof_) {
+	  return Status(false, "cycle in the DOF ancestry");
+	}
+      }
+      if (depth[ii] > maxdepth) {
+	maxdepth = depth[ii];
+      }
+    }
+    order_.clear();
+    order_.reserve(ndof_);
+    for (size_t dd(0); dd <= maxdepth; ++dd) {
+      for (size_t ii(0); ii < ndof_; ++ii) {
+	if (dd == depth[ii]) {
+	  order_.push_back(ii);
+	}
+      }
+    }
+
+    axis_.resize(ndof_);
+    inertia_.resize(ndof_);
+    vel_.resize(ndof_);
+    acc_.resize(ndof_);
+    force_.resize(ndof_);
+    dvel_.resize(ndof_);
+    dacc_.resize(ndof_);
+    dforce_.resize(ndof_);
+    daxis_.resize(ndof_);
+    in_subtree_.resize(ndof_);
+
+    Status ok;
+    return ok;
+  }
+
+
+  Status DynamicsDerivatives::
+  update(Model const & model)
+  {
+    if ((0 == ndof_) || (model.getNDOF() != ndof_)) {
+      return Status(false, "not initialized for this model");
+    }
+    if (static_cast<size_t>(model.getFullState().velocity_.size()) != ndof_) {
+      return Status(false, "state of the model has no joint velocities");
+    }
+    if ( ! model.getInverseMassInertia(ainv_)) {
+      return Status(false, "model has no inverse mass-inertia (call Model::update() first)");
+    }
+    qd_ = model.getFullState().velocity_;
+
+    for (size_t ii(0); ii < ndof_; ++ii) {
+      taoDNode * node(model.getNode(ii));
+
+      deVector6 Jg_col;
+      node->getJointList()->getJgColumns(&Jg_col);
+      for (size_t jj(0); jj < 6; ++jj) {
+	axis_[ii][jj] = Jg_col.elementAt(jj);
+      }
+
+      // TAO stores the rotational inertia wrt the node origin, in
+      // the node frame (see also mass_inertia_explicit_form()).
+      Transform frame;
+      model.getGlobalFrame(node, frame);
+      double const mass(node->mass() ? *node->mass() : 0);
+      Eigen::Vector3d com_local(Eigen::Vector3d::Zero());
+      if (node->center()) {
+	deVector3 const & cc(*node->center());
+	com_local << cc[0], cc[1], cc[2];
+      }
+      Eigen::Matrix3d icom(Eigen::Matrix3d::Zero());
+      if (node->inertia()) {
+	deMatrix3 const & in(*node->inertia());
+	for (size_t jj(0); jj < 3; ++jj) {
+	  for (size_t kk(0); kk < 3; ++kk) {
+	    icom.coeffRef(jj, kk) = in.elementAt(jj, kk);
+	  }
+	}
+	icom -= mass * (com_local.squaredNorm() * Eigen::Matrix3d::Identity()
+			- com_local * com_local.transpose());
+      }
+      Eigen::Matrix3d const rot(frame.linear());
+      Eigen::Matrix3d const cx(skew(rot * com_local + frame.translation()));
+      Matrix6 & inertia(inertia_[ii]);
+      inertia.block<3,3>(0, 0) = mass * Eigen::Matrix3d::Identity();
+      inertia.block<3,3>(0, 3) = - mass * cx;
+      inertia.block<3,3>(3, 0) = mass * cx;
+      inertia.block<3,3>(3, 3) = rot * icom * rot.transpose() - mass * cx * cx;
+    }
+
+    Status ok;
+    return ok;
+  }
+
+
+  void DynamicsDerivatives::
+  rnea(Vector const & qd, Vector const & qdd, bool gravity, Vector & tau)
+  {
+    // The base does not move, but accelerating it upwards is the
+    // same as having gravity pull down on all the links.
+    Vector6 base_acc(Vector6::Zero());
+    if (gravity) {
+      base_acc[2] = - earth_gravity_z;
+    }
+
+    for (size_t io(0); io < ndof_; ++io) {
+      size_t const ii(order_[io]);
+      int const pp(parent_[ii]);
+      Vector6 const sqd(axis_[ii] * qd[ii]);
+      if (pp >= 0) {
+	vel_[ii] = vel_[pp] + sqd;
+	acc_[ii] = acc_[pp];
+      }
+      else {
+	vel_[ii] = sqd;
+	acc_[ii] = base_acc;
+      }
+      acc_[ii] += axis_[ii] * qdd[ii] + motion_cross(vel_[ii], sqd);
+      force_[ii] = inertia_[ii] * acc_[ii] + force_cross(vel_[ii], inertia_[ii] * vel_[ii]);
+    }
+
+    tau.resize(ndof_);
+    for (size_t io(ndof_); io > 0; --io) {
+      size_t const ii(order_[io - 1]);
+      tau[ii] = axis_[ii].dot(force_[ii]);
+      if (parent_[ii] >= 0) {
+	force_[parent_[ii]] += force_[ii];
+      }
+    }
+  }
+
+
+  void DynamicsDerivatives::
+  derivativePass(size_t idof, bool wrt_velocity,
+		 Vector const & qd, Vector const & qdd, Matrix & dtau)
+  {
+    Vector6 const & sj(axis_[idof]);
+
+    for (size_t io(0); io < ndof_; ++io) {
+      size_t const ii(order_[io]);
+      int const pp(parent_[ii]);
+
+      // Moving q[idof] carries along all the axes and inertias in
+      // the subtree of idof, whereas moving qd[idof] only changes the
+      // velocities of that subtree.
+      in_subtree_[ii] = (ii == idof) || ((pp >= 0) && in_subtree_[pp]);
+      Matrix6 dinertia(Matrix6::Zero());
+      daxis_[ii].setZero();
+      if (in_subtree_[ii] && ( ! wrt_velocity)) {
+	daxis_[ii] = motion_cross(sj, axis_[ii]);
+	dinertia = inertia_rate(sj, inertia_[ii]);
+      }
+
+      Vector6 const sqd(axis_[ii] * qd[ii]);
+      if (pp >= 0) {
+	dvel_[ii] = dvel_[pp];
+	dacc_[ii] = dacc_[pp];
+      }
+      else {
+	dvel_[ii].setZero();
+	dacc_[ii].setZero();
+      }
+      dvel_[ii] += daxis_[ii] * qd[ii];
+      dacc_[ii] += daxis_[ii] * qdd[ii]
+	+ motion_cross(dvel_[ii], sqd)
+	+ motion_cross(vel_[ii], daxis_[ii] * qd[ii]);
+      if (wrt_velocity && (ii == idof)) {
+	dvel_[ii] += axis_[ii];
+	dacc_[ii] += motion_cross(vel_[ii], axis_[ii]);
+      }
+
+      Vector6 const iv(inertia_[ii] * vel_[ii]);
+      dforce_[ii] = dinertia * acc_[ii] + inertia_[ii] * dacc_[ii]
+	+ force_cross(dvel_[ii], iv)
+	+ force_cross(vel_[ii], dinertia * vel_[ii] + inertia_[ii] * dvel_[ii]);
+    }
+
+    // force_ holds the accumulated (subtree) forces after rnea(),
+    // and dforce_ gets accumulated the same way here.
+    for (size_t io(ndof_); io > 0; --io) {
+      size_t const ii(order_[io - 1]);
+      dtau.coeffRef(ii, idof) = daxis_[ii].dot(force_[ii]) + axis_[ii].dot(dforce_[ii]);
+      if (parent_[ii] >= 0) {
+	dforce_[parent_[ii]] += dforce_[ii];
+      }
+    }
+  }
+
+
+  Status DynamicsDerivatives::
+  computeInverseDynamics(Vector const & qdd, Vector & tau)
+  {
+    if ((0 == ndof_) || (static_cast<size_t>(qd_.size()) != ndof_)) {
+      return Status(false, "not initialized or not updated");
+    }
+    if (static_cast<size_t>(qdd.size()) != ndof_) {
+      return Status(false, "invalid qdd dimension");
+    }
+    rnea(qd_, qdd, true, tau);
+    for (size_t ii(0); ii < ndof_; ++ii) {
+      tau[ii] += rotor_[ii] * qdd[ii];
+    }
+    Status ok;
+    return ok;
+  }
+
+
+  Status DynamicsDerivatives::
+  computeForwardDynamics(Vector const & tau, Vector & qdd)
+  {
+    if ((0 == ndof_) || (static_cast<size_t>(qd_.size()) != ndof_)) {
+      return Status(false, "not initialized or not updated");
+    }
+    if (static_cast<size_t>(tau.size()) != ndof_) {
+      return Status(false, "invalid tau dimension");
+    }
+    Vector bg;
+    rnea(qd_, Vector::Zero(ndof_), true, bg);
+    qdd = ainv_ * (tau - bg);
+    Status ok;
+    return ok;
+  }
+
+
+  Status DynamicsDerivatives::
+  computeGravityDerivative(Matrix & dg_dq)
+  {
+    if ((0 == ndof_) || (static_cast<size_t>(qd_.size()) != ndof_)) {
+      return Status(false, "not initialized or not updated");
+    }
+    Vector const zero(Vector::Zero(ndof_));
+    Vector gg;
+    rnea(zero, zero, true, gg);
+    dg_dq.resize(ndof_, ndof_);
+    for (size_t jj(0); jj < ndof_; ++jj) {
+      derivativePass(jj, false, zero, zero, dg_dq);
+    }
+    Status ok;
+    return ok;
+  }
+
+
+  Status DynamicsDerivatives::
+  computeInverseDynamicsDerivatives(Vector const & qdd,
+				    Vector & tau,
+				    Matrix & dtau_dq,
+				    Matrix & dtau_dqd)
+  {
+    Status st(computeInverseDynamics(qdd, tau));
+    if ( ! st) {
+      return st;
+    }
+    dtau_dq.resize(ndof_, ndof_);
+    dtau_dqd.resize(ndof_, ndof_);
+    for (size_t jj(0); jj < ndof_; ++jj) {
+      derivativePass(jj, false, qd_, qdd, dtau_dq);
+      derivativePass(jj, true, qd_, qdd, dtau_dqd);
+    }
+    return st;
+  }
+
+
+  Status DynamicsDerivatives::
+  computeForwardDynamicsDerivatives(Vector const & tau,
+				    Vector & qdd,
+				    Matrix & dqdd_dq,
+				    Matrix & dqdd_dqd)
+  {
+    Status st(computeForwardDynamics(tau, qdd));
+    if ( ! st) {
+      return st;
+    }
+    Vector tau_check;
+    Matrix dtau_dq, dtau_dqd;
+    st = computeInverseDynamicsDerivatives(qdd, tau_check, dtau_dq, dtau_dqd);
+    if ( ! st) {
+      return st;
+    }
+    dqdd_dq = - ainv_ * dtau_dq;
+    dqdd_dqd = - ainv_ * dtau_dqd;
+    return st;
+  }
+
+
+  static bool check_derivative(char const * name, Matrix const & want, Matrix const & have,
+			   double tolerance, std::ostream * msg)
+  {
+    double const delta((want - have).cwise().abs().maxCoeff());
+    if (delta <= tolerance) {
+      return true;
+    }
+    if (msg) {
+      *msg << "check_dynamics_derivatives(): " << name << " differs by " << delta << "\n";
+      pretty_print(want, *msg, "  finite differences", "    ");
+      pretty_print(have, *msg, "  analytical", "    ");
+    }
+    return false;
+  }
+
+
+  Status check_dynamics_derivatives(Model & model,
+				    State const & state,
+				    Vector const & qdd,
+				    double step,
+				    double tolerance,
+				    std::ostream * msg)
+  {
+    size_t const ndof(model.getNDOF());
+    if ((static_cast<size_t>(state.position_.size()) != ndof)
+	|| (static_cast<size_t>(state.velocity_.size()) != ndof)
+	|| (static_cast<size_t>(qdd.size()) != ndof)) {
+      return Status(false, "dimension mismatch");
+    }
+
+    DynamicsDerivatives dd;
+    Status st(dd.init(model));
+    if ( ! st) {
+      return st;
+    }
+
+    // Nominal values, and consistency with the Model.
+    model.update(state);
+    st = dd.update(model);
+    if ( ! st) {
+      return st;
+    }
+    Vector tau, tau_fd, qdd_fd;
+    Matrix dg_dq, dtau_dq, dtau_dqd, dqdd_dq, dqdd_dqd;
+    dd.computeGravityDerivative(dg_dq);
+    dd.computeInverseDynamicsDerivatives(qdd, tau, dtau_dq, dtau_dqd);
+    dd.computeForwardDynamicsDerivatives(tau, qdd_fd, dqdd_dq, dqdd_dqd);
+
+    bool ok(true);
+    Matrix mass_inertia;
+    Vector gg, bb;
+    if (( ! model.getMassInertia(mass_inertia)) || ( ! model.getGravity(gg))
+	|| ( ! model.getCoriolisCentrifugal(bb))) {
+      return Status(false, "model does not provide A, g, and b (Coriolis-centrifugal disabled?)");
+    }
+    ok &= check_derivative("Newton-Euler torque", mass_inertia * qdd + bb + gg, tau, tolerance, msg);
+    ok &= check_derivative("forward dynamics", qdd, qdd_fd, tolerance, msg);
+
+    // Central differences, one column at a time.
+    Matrix fd_dg_dq(ndof, ndof), fd_dtau_dq(ndof, ndof), fd_dtau_dqd(ndof, ndof);
+    Matrix fd_dqdd_dq(ndof, ndof), fd_dqdd_dqd(ndof, ndof);
+    State perturbed(state);
+    for (size_t jj(0); jj < ndof; ++jj) {
+      for (size_t iv(0); iv < 2; ++iv) {
+	Vector & var(0 == iv ? perturbed.position_ : perturbed.velocity_);
+	Vector gplus, gminus, tplus, tminus, aplus, aminus;
+	var[jj] += step;
+	model.update(perturbed);
+	dd.update(model);
+	model.getGravity(gplus);
+	dd.computeInverseDynamics(qdd, tplus);
+	dd.computeForwardDynamics(tau, aplus);
+	var[jj] -= 2 * step;
+	model.update(perturbed);
+	dd.update(model);
+	model.getGravity(gminus);
+	dd.computeInverseDynamics(qdd, tminus);
+	dd.computeForwardDynamics(tau, aminus);
+	var[jj] += step;
+	if (0 == iv) {
+	  fd_dg_dq.col(jj) = (gplus - gminus) / (2 * step);
+	  fd_dtau_dq.col(jj) = (tplus - tminus) / (2 * step);
+	  fd_dqdd_dq.col(jj) = (aplus - aminus) / (2 * step);
+	}
+	else {
+	  fd_dtau_dqd.col(jj) = (tplus - tminus) / (2 * step);
+	  fd_dqdd_dqd.col(jj) = (aplus - aminus) / (2 * step);
+	}
+      }
+    }
+    model.update(state);
+
+    ok &= check_derivative("dg/dq", fd_dg_dq, dg_dq, tolerance, msg);
+    ok &= check_derivative("dtau/dq", fd_dtau_dq, dtau_dq, tolerance, msg);
+    ok &= check_derivative("dtau/dqd", fd_dtau_dqd, dtau_dqd, tolerance, msg);
+    ok &= check_derivative("dqdd/dq", fd_dqdd_dq, dqdd_dq, tolerance, msg);
+    ok &= check_derivative("dqdd/dqd", fd_dqdd_dqd, dqdd_dqd, tolerance, msg);
+
+    if ( ! ok) {
+      return Status(false, "analytical and finite-difference derivatives differ");
+    }
+    return st;
+  }
+
+}
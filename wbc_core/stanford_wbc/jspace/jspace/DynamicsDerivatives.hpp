@@ -0,0 +1,162 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef JSPACE_DYNAMICS_DERIVATIVES_HPP
+#define JSPACE_DYNAMICS_DERIVATIVES_HPP
+
+#include <jspace/Status.hpp>
+#include <jspace/wrap_eigen.hpp>
+#include <Eigen/StdVector>
+#include <iosfwd>
+#include <vector>
+
+namespace jspace {
+
+  class Model;
+  class State;
+
+
+  /**
+     Partial derivatives of the joint-space dynamics with respect to
+     the joint positions and velocities, for parameter identification,
+     gain tuning, or anything else that would otherwise have to
+     finite-difference a whole series of Model::update() calls.
+
+     The computation is a recursive Newton-Euler pass over the TAO
+     tree of the model, with all spatial quantities expressed wrt the
+     global frame (like the columns of Model::computeJacobian()). Each
+     derivative direction gets its own forward-mode pass along the
+     tree, so a full set of derivatives costs O(ndof^2), about the
+     same as Model::computeMassInertia().
+
+     Usage: call init() once after the model has been initialized,
+     and update() each time after Model::update(). All quantities
+     refer to the full state of the model (Model::getFullState()),
+     gravity is the same as in the Model, and gravity compensation
+     that was disabled with Model::disableGravityCompensation() is not
+     taken into account.
+  */
+  class DynamicsDerivatives
+  {
+  public:
+    DynamicsDerivatives();
+
+    /** Set up the tree structure (parent of each DOF, and an order
+	in which parents come before their children). Fails if the
+	model has not been initialized, or if a joint has more than
+	one DOF. */
+    Status init(Model const & model);
+
+    /** Read the current joint axes, inertias, velocities, and the
+	inverse mass-inertia matrix from the model. Call this after
+	Model::update(), before the compute methods. */
+    Status update(Model const & model);
+
+    /** Joint torques required for the given joint accelerations at
+	the current state, i.e. A * qdd + b + g including the rotor
+	inertias. */
+    Status computeInverseDynamics(Vector const & qdd, Vector & tau);
+
+    /** Joint accelerations resulting from the given joint torques at
+	the current state, i.e. Ainv * (tau - b - g). */
+    Status computeForwardDynamics(Vector const & tau, Vector & qdd);
+
+    /** Derivative of the gravity joint-torque vector with respect to
+	the joint positions. */
+    Status computeGravityDerivative(Matrix & dg_dq);
+
+    /** Inverse dynamics (see computeInverseDynamics()) and its
+	derivatives with respect to the joint positions and
+	velocities. The derivative with respect to qdd is simply the
+	mass-inertia matrix. */
+    Status computeInverseDynamicsDerivatives(Vector const & qdd,
+					     Vector & tau,
+					     Matrix & dtau_dq,
+					     Matrix & dtau_dqd);
+
+    /** Forward dynamics (see computeForwardDynamics()) and its
+	derivatives with respect to the joint positions and
+	velocities. This uses the fact that the derivative of qdd is
+	-Ainv times the derivative of the inverse dynamics evaluated
+	at the resulting qdd. The derivative with respect to tau is
+	simply Ainv. */
+    Status computeForwardDynamicsDerivatives(Vector const & tau,
+					     Vector & qdd,
+					     Matrix & dqdd_dq,
+					     Matrix & dqdd_dqd);
+
+  protected:
+    typedef Eigen::Matrix<double, 6, 1> Vector6;
+    typedef Eigen::Matrix<double, 6, 6> Matrix6;
+    typedef std::vector<Vector6, Eigen::aligned_allocator<Vector6> > vector6_list_t;
+    typedef std::vector<Matrix6, Eigen::aligned_allocator<Matrix6> > matrix6_list_t;
+
+    /** Nominal Newton-Euler pass, fills in vel_, acc_, and force_
+	and computes tau (without rotor inertias). */
+    void rnea(Vector const & qd, Vector const & qdd, bool gravity, Vector & tau);
+
+    /** Forward-mode pass along the direction of q[idof] (or of
+	qd[idof] if wrt_velocity is true), after rnea(). Fills in
+	column idof of dtau. */
+    void derivativePass(size_t idof, bool wrt_velocity,
+			Vector const & qd, Vector const & qdd, Matrix & dtau);
+
+    size_t ndof_;
+    std::vector<int> parent_;
+    std::vector<size_t> order_;
+    std::vector<double> rotor_;
+
+    // per DOF, wrt the global frame
+    vector6_list_t axis_;
+    matrix6_list_t inertia_;
+    Vector qd_;
+    Matrix ainv_;
+
+    // nominal and derivative quantities of the most recent pass
+    vector6_list_t vel_, acc_, force_;
+    vector6_list_t dvel_, dacc_, dforce_, daxis_;
+    std::vector<bool> in_subtree_;
+  };
+
+
+  /**
+     Compare the analytical derivatives against central finite
+     differences, for a model which has Coriolis-centrifugal effects
+     enabled. The model gets updated at perturbations of the given
+     state, and is left updated at the state itself. Also checks that
+     the Newton-Euler torques agree with A * qdd + b + g from the
+     model. Differences larger than tolerance get reported to msg
+     (if non-NULL) and make the returned status false. The state
+     must have as many positions and velocities as the full state of
+     the model (i.e. an unconstrained model).
+  */
+  Status check_dynamics_derivatives(Model & model,
+				    State const & state,
+				    Vector const & qdd,
+				    double step,
+				    double tolerance,
+				    std::ostream * msg);
+
+}
+
+#endif // JSPACE_DYNAMICS_DERIVATIVES_HPP
@@ -26,12 +26,15 @@
 
 #include "Model.hpp"
 #include "tao_util.hpp"
+#include "model_cache.hpp"
 #include <tao/dynamics/taoNode.h>
 #include <tao/dynamics/taoJoint.h>
 #include <tao/dynamics/taoDynamics.h>
 #include <Eigen/LU>
 #include <Eigen/SVD>
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #undef DEBUG
 
@@ -57,6 +60,79 @@ size_t squareToTriangularIndex(size_t irow, size_t icol, size_t dim)
 }
 
 
+// Fill one column of a Jacobian (J_v over J_omega) with the
+// contribution of a joint, at the global point [gx;gy;gz].
+static void fill_jacobian_column(taoJoint * joint,
+				 double gx, double gy, double gz,
+				 jspace::Matrix & jacobian,
+				 int icol)
+{
+  deVector6 Jg_col;
+  joint->getJgColumns(&Jg_col);
+  
+#ifdef DEBUG
+  fprintf(stderr, "iJg[%d]: [ % 4.2f % 4.2f % 4.2f % 4.2f % 4.2f % 4.2f]\n",
+	  icol,
+	  Jg_col.elementAt(0), Jg_col.elementAt(1), Jg_col.elementAt(2),
+	  Jg_col.elementAt(3), Jg_col.elementAt(4), Jg_col.elementAt(5));
+#endif // DEBUG
+  
+  for (size_t irow(0); irow < 6; ++irow) {
+    jacobian.coeffRef(irow, icol) = Jg_col.elementAt(irow);
+  }
+  
+  // Add the effect of the joint rotation on the translational
+  // velocity at the global point (column-wise cross product with
+  // [gx;gy;gz]). Note that Jg_col.elementAt(3) is the
+  // contribution to omega_x etc, because the upper 3 elements of
+  // Jg_col are v_x etc.  (And don't ask me why we have to
+  // subtract the cross product, it probably got inverted
+  // somewhere)
+  jacobian.coeffRef(0, icol) -= -gz * Jg_col.elementAt(4) + gy * Jg_col.elementAt(5);
+  jacobian.coeffRef(1, icol) -=  gz * Jg_col.elementAt(3) - gx * Jg_col.elementAt(5);
+  jacobian.coeffRef(2, icol) -= -gy * Jg_col.elementAt(3) + gx * Jg_col.elementAt(4);
+  
+#ifdef DEBUG
+  fprintf(stderr, "0Jg[%d]: [ % 4.2f % 4.2f % 4.2f % 4.2f % 4.2f % 4.2f]\n",
+	  icol,
+	  jacobian.coeff(0, icol), jacobian.coeff(1, icol), jacobian.coeff(2, icol),
+	  jacobian.coeff(3, icol), jacobian.coeff(4, icol), jacobian.coeff(5, icol));
+#endif // DEBUG
+}
+
+
+// TAO computes in deFloat, which is float if the build defines
+// DE_PRECISION_FLOAT (TAO_FLOAT in CMake). A tao_array gives TAO a
+// deFloat array to write into, and copies it into the Vector when it
+// goes out of scope. When deFloat is double, TAO just writes straight
+// into the Vector.
+template<typename tao_float_t>
+class tao_array
+{
+public:
+  explicit tao_array(jspace::Vector & vector): vector_(vector), data_(vector.size()) {}
+  ~tao_array() {
+    for (size_t ii(0); ii < data_.size(); ++ii) {
+      vector_.coeffRef(ii) = data_[ii];
+    }
+  }
+  tao_float_t * get() { return &data_[0]; }
+private:
+  jspace::Vector & vector_;
+  std::vector<tao_float_t> data_;
+};
+
+template<>
+class tao_array<double>
+{
+public:
+  explicit tao_array(jspace::Vector & vector): data_(&vector.coeffRef(0)) {}
+  double * get() { return data_; }
+private:
+  double * data_;
+};
+
+
 namespace jspace {
   
   
@@ -64,14 +140,16 @@ namespace jspace {
   Model()
     : ndof_(0),
       kgm_tree_(0),
-      cc_tree_(0)
+      cc_enabled_(false),
+      state_version_(0),
+      constraint_(0)
   {
   }
   
   
   int Model::
   init(tao_tree_info_s * kgm_tree,
-       tao_tree_info_s * cc_tree,
+       bool enable_coriolis_centrifugal,
        std::ostream * msg)
   {
     int const status(tao_consistency_check(kgm_tree->root, msg));
@@ -93,16 +171,14 @@ namespace jspace {
       return -2;
     }
     
-    if ((0 != cc_tree) && ( ! cc_tree->sort())) {
-      if (msg) {
-	*msg << "jspace::Model::init(): could not sort CC nodes according to IDs\n";
-      }
-      return -3;
-    }
-    
     // Create ancestry table of all nodes in the KGM tree, for correct
-    // (and slightly more efficient) computation of the Jacobian.
-    ancestry_table_.clear();	// just paranoid...
+    // (and slightly more efficient) computation of the Jacobian. It
+    // is a flat array indexed by node ID, so that the Jacobian
+    // computations do not need to search for it.
+    ancestry_table_.clear();
+    ancestry_begin_.assign(1, 0);
+    link_names_.clear();
+    joint_names_.clear();
     typedef tao_tree_info_s::node_info_t::const_iterator cit_t;
     cit_t in(kgm_tree->info.begin());
     cit_t iend(kgm_tree->info.end());
@@ -120,7 +196,6 @@ namespace jspace {
 	}
 	return -5;
       }
-      ancestry_list_t & alist(ancestry_table_[in->node]); // first reference creates the instance
       // walk up the ancestry, append each parent to the list of
       // ancestors of this node
       for (taoDNode * node(in->node); 0 != node; node = node->getDParent()) {
@@ -128,41 +203,97 @@ namespace jspace {
 	entry.id = node->getID();
 	entry.joint = node->getJointList();
 	if (0 != entry.joint) {
-	  alist.push_back(entry);
+	  ancestry_table_.push_back(entry);
 	}
       }
+      ancestry_begin_.push_back(ancestry_table_.size());
+      // duplicate names resolve to the lowest ID, as add() keeps
+      // the first entry
+      link_names_.add(in->link_name, in->id);
+      joint_names_.add(in->joint_name, in->id);
     }
+    link_names_.build();
+    joint_names_.build();
     
     kgm_tree_ = kgm_tree;
-    cc_tree_ = cc_tree;
+    cc_enabled_ = enable_coriolis_centrifugal;
     ndof_ = kgm_tree->info.size();
     
     return 0;
   }
 
+  
   int Model::
-  setConstraint(std::string constraint) {
-    if (!constraint.compare("Dreamer_Base")) {
-      constraint_ = new Dreamer_Base();
-      return 1;
-    } 
-    if (!constraint.compare("Dreamer_Torso")) {
-      constraint_ = new Dreamer_Torso();
-      return 1;
-    } 
-    if (!constraint.compare("Dreamer_Full")) {
-      constraint_ = new Dreamer_Full();
-      return 1;
-    } 
+  init(std::string const & cache_filename,
+       uint64_t source_hash,
+       bool enable_coriolis_centrifugal,
+       std::ostream * msg)
+  {
+    tao_tree_info_s * kgm_tree(0);
+    constraint_spec_s spec;
+    Status const st(read_model_cache(cache_filename, source_hash, &kgm_tree, spec));
+    if ( ! st) {
+      if (msg) {
+	*msg << "jspace::Model::init(): " << st.errstr << "\n";
+      }
+      return -6;
+    }
+    
+    int const status(init(kgm_tree, enable_coriolis_centrifugal, msg));
+    if (0 != status) {
+      if (kgm_tree_ != kgm_tree) {
+	delete kgm_tree;
+      }
+      return status;
+    }
+    
+    if ( ! spec.empty()) {
+      GenericConstraint * constraint(new GenericConstraint(spec));
+      Status const cst(constraint->init(*this));
+      if ( ! cst) {
+	delete constraint;
+	if (msg) {
+	  *msg << "jspace::Model::init(): invalid constraints in " << cache_filename
+	       << ": " << cst.errstr << "\n";
+	}
+	return -7;
+      }
+      setConstraint(constraint);
+    }
+    
     return 0;
   }
+
+  int Model::
+  setConstraint(std::string constraint) {
+    constraint_spec_s spec;
+    if ( ! get_builtin_constraint_spec(constraint, spec)) {
+      return 0;
+    }
+    GenericConstraint * generic(new GenericConstraint(spec));
+    if ( ! generic->init(*this)) {
+      delete generic;
+      return 0;
+    }
+    setConstraint(generic);
+    return 1;
+  }
+  
+  
+  void Model::
+  setConstraint(Constraint * constraint) {
+    if (constraint != constraint_) {
+      delete constraint_;
+      constraint_ = constraint;
+    }
+  }
   
   
   Model::
   ~Model()
   {
     delete kgm_tree_;
-    delete cc_tree_;
+    delete constraint_;
   }
   
   
@@ -178,32 +309,41 @@ namespace jspace {
   void Model::
   setState(State const & state)
   {
-    state_ = state;
-    State fullState(ndof_,ndof_,6);
+    ++state_version_;
+    if (&state != &state_) {
+      state_ = state;
+    }
+    
+    // The full state is computed here, once per state, and written
+    // in place so that the servo loop does not allocate once the
+    // sizes are settled. Consumers share it through getFullState().
     if (constraint_){
-      constraint_->getFullState(state_,fullState);
+      if ((static_cast<size_t>(fullstate_.position_.rows()) != ndof_)
+	  || (static_cast<size_t>(fullstate_.velocity_.rows()) != ndof_)) {
+	fullstate_.init(ndof_, ndof_, 6);
+      }
+      fullstate_.time_sec_ = state_.time_sec_;
+      fullstate_.time_usec_ = state_.time_usec_;
+      constraint_->getFullState(state_, fullstate_);
     }
     else {
-      fullState = state_;
+      fullstate_ = state_;
     }
-
+    
     for (size_t ii(0); ii < ndof_; ++ii) {
       taoJoint * joint(kgm_tree_->info[ii].joint);
-      joint->setQ(&const_cast<State&>(fullState).position_.coeffRef(ii));
-      joint->zeroDQ();
+      deFloat const qq(fullstate_.position_.coeff(ii));
+      joint->setQ(&qq);
+      if (cc_enabled_) {
+	deFloat const dq(fullstate_.velocity_.coeff(ii));
+	joint->setDQ(&dq);
+      }
+      else {
+	joint->zeroDQ();
+      }
       joint->zeroDDQ();
       joint->zeroTau();
     }
-    if (cc_tree_) {
-      for (size_t ii(0); ii < ndof_; ++ii) {
-	taoJoint * joint(cc_tree_->info[ii].joint);
-	joint->setQ(&const_cast<State&>(fullState).position_.coeffRef(ii));
-	joint->setDQ(&const_cast<State&>(fullState).velocity_.coeffRef(ii));
-	joint->zeroDDQ();
-	joint->zeroTau();
-      }
-    }
-    fullstate_ = fullState;
   }
   
   
@@ -295,24 +435,64 @@ namespace jspace {
   taoDNode * Model::
   getNodeByName(std::string const & name) const
   {
-    for (size_t ii(0); ii < ndof_; ++ii) {
-      if (name == kgm_tree_->info[ii].link_name) {
-	return  kgm_tree_->info[ii].node;
-      }
+    int const id(link_names_.find(name));
+    if (0 > id) {
+      return 0;
     }
-    return 0;
+    return kgm_tree_->info[id].node;
   }
   
   
   taoDNode * Model::
   getNodeByJointName(std::string const & name) const
   {
-    for (size_t ii(0); ii < ndof_; ++ii) {
-      if (name == kgm_tree_->info[ii].joint_name) {
-	return  kgm_tree_->info[ii].node;
-      }
+    int const id(joint_names_.find(name));
+    if (0 > id) {
+      return 0;
     }
-    return 0;
+    return kgm_tree_->info[id].node;
+  }
+  
+  
+  bool Model::
+  addAlias(std::string const & alias, std::string const & name)
+  {
+    int const link_id(link_names_.find(name));
+    int const joint_id(joint_names_.find(name));
+    if ((0 > link_id) && (0 > joint_id)) {
+      return false;
+    }
+    if ((0 <= link_names_.find(alias)) || (0 <= joint_names_.find(alias))) {
+      return false;
+    }
+    if (0 <= link_id) {
+      link_names_.add(alias, link_id);
+      link_names_.build();
+    }
+    if (0 <= joint_id) {
+      joint_names_.add(alias, joint_id);
+      joint_names_.build();
+    }
+    return true;
+  }
+  
+  
+  bool Model::
+  getAncestry(taoDNode const * node,
+	      ancestry_entry_s const ** begin,
+	      ancestry_entry_s const ** end) const
+  {
+    if ( ! node) {
+      return false;
+    }
+    int const id(node->getID());
+    if ((0 > id) || (ndof_ <= static_cast<size_t>(id)) || (kgm_tree_->info[id].node != node)) {
+      return false;
+    }
+    ancestry_entry_s const * const base(ancestry_table_.empty() ? 0 : &ancestry_table_[0]);
+    *begin = base + ancestry_begin_[id];
+    *end = base + ancestry_begin_[id + 1];
+    return true;
   }
   
   
@@ -334,10 +514,6 @@ namespace jspace {
   {
     taoDynamics::updateTransformation(kgm_tree_->root);
     taoDynamics::globalJacobian(kgm_tree_->root);
-    if (cc_tree_) {
-      taoDynamics::updateTransformation(cc_tree_->root);
-      taoDynamics::globalJacobian(cc_tree_->root);
-    }
   }
   
   
@@ -459,14 +635,11 @@ namespace jspace {
 		  double gx, double gy, double gz,
 		  Matrix & jacobian) const
   {
-    if ( ! node) {
-      return false;
-    }
-    ancestry_table_t::const_iterator iae(ancestry_table_.find(const_cast<taoDNode*>(node)));
-    if (iae == ancestry_table_.end()) {
+    ancestry_entry_s const * abegin;
+    ancestry_entry_s const * aend;
+    if ( ! getAncestry(node, &abegin, &aend)) {
       return false;
     }
-    ancestry_list_t const & alist(iae->second);
     
 #ifdef DEBUG
     fprintf(stderr, "computeJacobian()\ng: [% 4.2f % 4.2f % 4.2f]\n", gx, gy, gz);
@@ -475,42 +648,119 @@ namespace jspace {
     // \todo Implement support for more than one joint per node, and
     // 	more than one DOF per joint.
     jacobian = Matrix::Zero(6, ndof_);
-    ancestry_list_t::const_iterator ia(alist.begin());
-    ancestry_list_t::const_iterator iend(alist.end());
-    for (/**/; ia != iend; ++ia) {
+    for (ancestry_entry_s const * ia(abegin); ia != aend; ++ia) {
+      fill_jacobian_column(ia->joint, gx, gy, gz, jacobian, ia->id);
+    }
+    return true;
+  }
+  
+  
+  bool Model::
+  computeJacobian(taoDNode const * node,
+		  SparseJacobian & jacobian) const
+  {
+    if ( ! node) {
+      return false;
+    }
+    deVector3 const & gpos(node->frameGlobal()->translation());
+    return computeJacobian(node, gpos[0], gpos[1], gpos[2], jacobian);
+  }
+  
+  
+  bool Model::
+  computeJacobian(taoDNode const * node,
+		  double gx, double gy, double gz,
+		  SparseJacobian & jacobian) const
+  {
+    ancestry_entry_s const * abegin;
+    ancestry_entry_s const * aend;
+    if ( ! getAncestry(node, &abegin, &aend)) {
+      return false;
+    }
+    
+    // The ancestry list goes from the node up to the root, but having
+    // the columns in root-to-node order usually makes them
+    // ascending. The structure only gets set up again if the caller
+    // passes in a Jacobian that was used for some other node.
+    std::vector<size_t> columns;
+    columns.reserve(aend - abegin);
+    for (ancestry_entry_s const * ia(aend); ia != abegin; /**/) {
+      columns.push_back((--ia)->id);
+    }
+    if ((jacobian.cols() != ndof_) || (jacobian.rows() != 6)
+	|| (jacobian.getColumns() != columns)) {
+      jacobian.init(6, ndof_, columns);
+    }
+    
+    Matrix & block(jacobian.getBlock());
+    int icol(aend - abegin - 1);
+    for (ancestry_entry_s const * ia(abegin); ia != aend; ++ia, --icol) {
+      fill_jacobian_column(ia->joint, gx, gy, gz, block, icol);
+    }
+    return true;
+  }
+  
+  
+  bool Model::
+  computeJdotQdot(taoDNode const * node,
+		  Vector & jdot_qdot) const
+  {
+    if ( ! node) {
+      return false;
+    }
+    deVector3 const & gpos(node->frameGlobal()->translation());
+    return computeJdotQdot(node, gpos[0], gpos[1], gpos[2], jdot_qdot);
+  }
+  
+  
+  bool Model::
+  computeJdotQdot(taoDNode const * node,
+		  double gx, double gy, double gz,
+		  Vector & jdot_qdot) const
+  {
+    if ( ! node) {
+      return false;
+    }
+    if (static_cast<size_t>(fullstate_.velocity_.size()) != ndof_) {
+      return false;
+    }
+    ancestry_entry_s const * abegin;
+    ancestry_entry_s const * aend;
+    if ( ! getAncestry(node, &abegin, &aend)) {
+      return false;
+    }
+    
+    // Work with spatial vectors wrt the global origin, like the
+    // Jacobian columns from getJgColumns(). Each joint axis is
+    // attached to the parent link, so its time derivative is the
+    // cross product of the parent's spatial velocity with the
+    // axis. Going from the root outwards, the velocity-product
+    // acceleration accumulates these cross products.
+    Eigen::Vector3d vel(Eigen::Vector3d::Zero());
+    Eigen::Vector3d omega(Eigen::Vector3d::Zero());
+    Eigen::Vector3d acc(Eigen::Vector3d::Zero());
+    Eigen::Vector3d alpha(Eigen::Vector3d::Zero());
+    for (ancestry_entry_s const * ia(aend); ia != abegin; /**/) {
+      --ia;
       deVector6 Jg_col;
       ia->joint->getJgColumns(&Jg_col);
-      int const icol(ia->id);
-      
-#ifdef DEBUG
-      fprintf(stderr, "iJg[%d]: [ % 4.2f % 4.2f % 4.2f % 4.2f % 4.2f % 4.2f]\n",
-	      icol,
-	      Jg_col.elementAt(0), Jg_col.elementAt(1), Jg_col.elementAt(2),
-	      Jg_col.elementAt(3), Jg_col.elementAt(4), Jg_col.elementAt(5));
-#endif // DEBUG
-      
-      for (size_t irow(0); irow < 6; ++irow) {
-	jacobian.coeffRef(irow, icol) = Jg_col.elementAt(irow);
-      }
-      
-      // Add the effect of the joint rotation on the translational
-      // velocity at the global point (column-wise cross product with
-      // [gx;gy;gz]). Note that Jg_col.elementAt(3) is the
-      // contribution to omega_x etc, because the upper 3 elements of
-      // Jg_col are v_x etc.  (And don't ask me why we have to
-      // subtract the cross product, it probably got inverted
-      // somewhere)
-      jacobian.coeffRef(0, icol) -= -gz * Jg_col.elementAt(4) + gy * Jg_col.elementAt(5);
-      jacobian.coeffRef(1, icol) -=  gz * Jg_col.elementAt(3) - gx * Jg_col.elementAt(5);
-      jacobian.coeffRef(2, icol) -= -gy * Jg_col.elementAt(3) + gx * Jg_col.elementAt(4);
-      
-#ifdef DEBUG
-      fprintf(stderr, "0Jg[%d]: [ % 4.2f % 4.2f % 4.2f % 4.2f % 4.2f % 4.2f]\n",
-	      icol,
-	      jacobian.coeff(0, icol), jacobian.coeff(1, icol), jacobian.coeff(2, icol),
-	      jacobian.coeff(3, icol), jacobian.coeff(4, icol), jacobian.coeff(5, icol));
-#endif // DEBUG
-      
+      double const qd(fullstate_.velocity_.coeff(ia->id));
+      Eigen::Vector3d const sv(Jg_col.elementAt(0) * qd, Jg_col.elementAt(1) * qd, Jg_col.elementAt(2) * qd);
+      Eigen::Vector3d const sw(Jg_col.elementAt(3) * qd, Jg_col.elementAt(4) * qd, Jg_col.elementAt(5) * qd);
+      acc += omega.cross(sv) + vel.cross(sw);
+      alpha += omega.cross(sw);
+      vel += sv;
+      omega += sw;
+    }
+    
+    // Turn the spatial acceleration into the classical acceleration
+    // of the point, which also picks up the centripetal term.
+    Eigen::Vector3d const pos(gx, gy, gz);
+    Eigen::Vector3d const lin(acc + alpha.cross(pos) + omega.cross(vel + omega.cross(pos)));
+    jdot_qdot.resize(6);
+    for (size_t ii(0); ii < 3; ++ii) {
+      jdot_qdot.coeffRef(ii) = lin.coeff(ii);
+      jdot_qdot.coeffRef(ii + 3) = alpha.coeff(ii);
     }
     return true;
   }
@@ -519,8 +769,7 @@ namespace jspace {
   void Model::
   updateDynamics()
   {
-    computeGravity();
-    computeCoriolisCentrifugal();
+    computeBiasForces();
     computeMassInertia();
     computeInverseMassInertia();
   }
@@ -548,7 +797,7 @@ namespace jspace {
       }
       wpos *= *(node->mass());
       mtotal += *(node->mass());
-      com += Vector::Map(&wpos[0], 3);
+      com += Eigen::Vector3d(wpos[0], wpos[1], wpos[2]);
     }
     if (fabs(mtotal) > 1e-3) {
       com /= mtotal;
@@ -578,7 +827,7 @@ namespace jspace {
       opt_jcom += *(node->mass()) * wjcom.block(0, 0, 3, wjcom.cols());
       wpos *= *(node->mass());
       mtotal += *(node->mass());
-      com += Vector::Map(&wpos[0], 3);
+      com += Eigen::Vector3d(wpos[0], wpos[1], wpos[2]);
     }
     if (fabs(mtotal) > 1e-3) {
       com /= mtotal;
@@ -588,13 +837,35 @@ namespace jspace {
 }
   
   void Model::
-  computeGravity()
+  computeBiasForces()
   {
+    // Both vectors get indexed by node ID, which coincides with the
+    // index into kgm_tree_->info (see tao_tree_info_s::sort()).
     g_torque_.resize(ndof_);
-    taoDynamics::invDynamics(kgm_tree_->root, &earth_gravity);
-    for (size_t ii(0); ii < ndof_; ++ii) {
-      kgm_tree_->info[ii].joint->getTau(&g_torque_[ii]);
+    cc_torque_.resize(ndof_);
+    tao_array<deFloat> cc(cc_torque_);
+    tao_array<deFloat> gg(g_torque_);
+    taoDynamics::computeBG(kgm_tree_->root, &earth_gravity, ndof_, cc.get(), gg.get());
+  }
+  
+  
+  bool Model::
+  getBiasForces(Vector & bias) const
+  {
+    if ( ! getGravity(bias)) {
+      return false;
+    }
+    if (cc_enabled_) {
+      bias += cc_torque_;
     }
+    return true;
+  }
+  
+  
+  void Model::
+  computeGravity()
+  {
+    computeBiasForces();
   }
   
   
@@ -642,20 +913,14 @@ namespace jspace {
   void Model::
   computeCoriolisCentrifugal()
   {
-    if (cc_tree_) {
-      cc_torque_.resize(ndof_);
-      taoDynamics::invDynamics(cc_tree_->root, &zero_gravity);
-      for (size_t ii(0); ii < ndof_; ++ii) {
-	cc_tree_->info[ii].joint->getTau(&cc_torque_[ii]);
-      }
-    }
+    computeBiasForces();
   }
   
   
   bool Model::
   getCoriolisCentrifugal(Vector & coriolis_centrifugal) const
   {
-    if ( ! cc_tree_) {
+    if ( ! cc_enabled_) {
       return false;
     }
     if (0 == cc_torque_.size()) {
@@ -666,6 +931,53 @@ namespace jspace {
   }
   
   
+  bool Model::
+  computeCoriolisMatrix(Matrix & coriolis)
+  {
+    if ( ! cc_enabled_) {
+      return false;
+    }
+    if (static_cast<size_t>(fullstate_.velocity_.size()) != ndof_) {
+      return false;
+    }
+    
+    // With b(qd) = G(qd, qd) for some bilinear G, the difference
+    // b(qd + s e_j) - b(qd - s e_j) is exactly 2 s (G(qd, e_j) +
+    // G(e_j, qd)). Dividing by 4 s gives column j of a matrix that
+    // maps qd back onto b(qd). The step s just keeps both sweeps at
+    // the same scale as the actual velocities.
+    Vector qd(fullstate_.velocity_);
+    double const step(std::max(1.0, qd.cwise().abs().maxCoeff()));
+    Vector bplus(ndof_);
+    Vector bminus(ndof_);
+    coriolis.resize(ndof_, ndof_);
+    for (size_t jj(0); jj < ndof_; ++jj) {
+      taoJoint * joint(kgm_tree_->info[jj].joint);
+      deFloat dq(qd.coeff(jj) + step);
+      joint->setDQ(&dq);
+      {
+	tao_array<deFloat> bb(bplus);
+	taoDynamics::computeB(kgm_tree_->root, ndof_, bb.get());
+      }
+      dq = qd.coeff(jj) - step;
+      joint->setDQ(&dq);
+      {
+	tao_array<deFloat> bb(bminus);
+	taoDynamics::computeB(kgm_tree_->root, ndof_, bb.get());
+      }
+      dq = qd.coeff(jj);
+      joint->setDQ(&dq);
+      coriolis.col(jj) = (bplus - bminus) / (4 * step);
+    }
+    
+    // computeB() leaves the velocity-dependent quantities of the
+    // tree at the last perturbed state, bring them back.
+    tao_array<deFloat> bb(bplus);
+    taoDynamics::computeB(kgm_tree_->root, ndof_, bb.get());
+    return true;
+  }
+  
+  
   void Model::
   computeMassInertia()
   {
@@ -673,6 +985,15 @@ namespace jspace {
       a_upper_triangular_.resize(ndof_ * (ndof_ + 1) / 2);
     }
     
+    // The kgm_tree_ carries the joint velocities when
+    // Coriolis-centrifugal effects are enabled, set them to zero
+    // while computing the columns (and put them back afterwards).
+    if (cc_enabled_) {
+      for (size_t ii(0); ii < ndof_; ++ii) {
+	kgm_tree_->info[ii].joint->zeroDQ();
+      }
+    }
+    
     deFloat const one(1);
     for (size_t irow(0); irow < ndof_; ++irow) {
       taoJoint * joint(kgm_tree_->info[irow].joint);
@@ -680,8 +1001,9 @@ namespace jspace {
       // Compute one column of A by solving inverse dynamics of the
       // corresponding joint having a unit acceleration, while all the
       // others remain fixed. This works on the kgm_tree because it
-      // has zero speeds, thus the Coriolis-centrifgual effects are
-      // zero, and by using zero gravity we get pure system dynamics:
+      // has zero speeds (see above), thus the Coriolis-centrifgual
+      // effects are zero, and by using zero gravity we get pure
+      // system dynamics:
       // force = mass * acceleration (in matrix form).
       joint->setDDQ(&one);
       taoDynamics::invDynamics(kgm_tree_->root, &zero_gravity);
@@ -692,14 +1014,22 @@ namespace jspace {
       // flattened upper triangular matrix).
       
       for (size_t icol(0); icol <= irow; ++icol) {
-	kgm_tree_->info[icol].joint->getTau(&a_upper_triangular_[squareToTriangularIndex(irow, icol, ndof_)]);
+	deFloat tau;
+	kgm_tree_->info[icol].joint->getTau(&tau);
+	a_upper_triangular_[squareToTriangularIndex(irow, icol, ndof_)] = tau;
       }
     }
     
-    // Reset all the torques.
+    // Reset all the torques, and restore the speeds.
     for (size_t ii(0); ii < ndof_; ++ii) {
       kgm_tree_->info[ii].joint->zeroTau();
     }
+    if (cc_enabled_) {
+      for (size_t ii(0); ii < ndof_; ++ii) {
+	deFloat const dq(fullstate_.velocity_.coeff(ii));
+	kgm_tree_->info[ii].joint->setDQ(&dq);
+      }
+    }
 
     mass_inertia_.resize(ndof_, ndof_);
     for (size_t irow(0); irow < ndof_; ++irow) {
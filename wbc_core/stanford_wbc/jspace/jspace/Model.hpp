@@ -29,6 +29,9 @@
 
 #include <jspace/State.hpp>
 #include <jspace/wrap_eigen.hpp>
+#include <jspace/SparseJacobian.hpp>
+#include <jspace/NameTable.hpp>
+#include <stdint.h>
 #include <string>
 #include <vector>
 #include <list>
@@ -57,9 +60,9 @@ namespace jspace {
     
     ~Model();
     
-    /** Initialize the model with a TAO tree. Actually, it needs two
-	copies of the same tree if you want to estimate centrifugal
-	and Coriolis effects, but that is optional.
+    /** Initialize the model with a TAO tree. Coriolis and
+	centrifugal effects are optional, they cost an extra inward
+	pass of the inverse dynamics in each update.
 	
 	This method also does some sanity checks and will return a
 	non-zero error code if something is amiss. In order to get
@@ -67,9 +70,9 @@ namespace jspace {
 	in as well. For instance, &std::cout will do nicely in most
 	cases.
 	
-	\note Transfers ownership of the given TAO trees. They will be
+	\note Transfers ownership of the given TAO tree. It will be
 	deleted when this jspace::Model instance is destructed. Also
-	note that their info vector might get reordered in order to
+	note that its info vector might get reordered in order to
 	ensure that each node sits at the index that corresponds to
 	its ID.
 	
@@ -80,23 +83,55 @@ namespace jspace {
 		 its inverse. This tree will be deleted in the
 		 jspace::Model destructor. */
 	     tao_tree_info_s * kgm_tree,
-	     /** Optional TAO tree info for computing Coriolis and
-		 centrifugal torques. If you set this to NULL, then
-		 the Coriolis and centrifugal forces won't be
-		 computed. This tree will be deleted in the
-		 jspace::Model destructor. */
-	     tao_tree_info_s * cc_tree,
+	     /** Set this to false if you are not interested in
+		 Coriolis and centrifugal torques, in which case the
+		 joint velocities are not passed to the TAO tree. */
+	     bool enable_coriolis_centrifugal,
 	     /** Optional stream that will receive error messages from
 		 the consistency checks. */
 	     std::ostream * msg);
 
+    /** Initialize the model from a binary model cache, as written by
+	write_model_cache() or the wbc_compile_model tool. This skips
+	all XML parsing and mass property computations, and also
+	installs the constraints that were stored along with the
+	tree. See jspace::test::parse_sai_xml_file_cached() for a
+	loader which rebuilds the cache when the robot description
+	changes.
+
+	\return 0 on success, -6 if the cache could not be read (or
+	was written for another source_hash), -7 if the stored
+	constraints do not fit the tree, or one of the error codes of
+	the other init() method.
+    */
+    int init(/** Name of the model cache file. */
+	     std::string const & cache_filename,
+	     /** Reject the cache unless it was written for this
+		 source hash (see compute_model_hash()). Pass zero to
+		 accept any cache. */
+	     uint64_t source_hash,
+	     /** See the other init() method. */
+	     bool enable_coriolis_centrifugal,
+	     /** Optional stream that will receive error messages. */
+	     std::ostream * msg);
+
     /* Set the constraint type
        returns 1 if constraint is found
        0 otherwise
+
+       The known names are the ones listed in
+       get_builtin_constraint_spec(). Robots which describe their
+       constraints in the XML file get them installed by the parser,
+       see jspace::test::parse_sai_xml_file().
     */
 
     int setConstraint(std::string constraint);
     
+    /** Install an already initialized constraint, or remove the
+	current one by passing NULL. Transfers ownership: the
+	constraint will be deleted along with this model. */
+    void setConstraint(Constraint * constraint);
+    
     //////////////////////////////////////////////////
     // fire-and-forget facet
     
@@ -136,9 +171,27 @@ namespace jspace {
     /** Retrieve the state passed to setState() (or update(), for that
 	matter). */
     inline State const & getState() const { return state_; }
+    
+    /** Writable access to the storage behind getState(), for callers
+	that want to fill in sensor data without going through an
+	intermediate State (e.g. straight from shared memory in a
+	real-time servo). After writing to it, pass it back to
+	setState() or update(): this skips the copy and only
+	distributes the values over the tree. The dimensions are
+	whatever the last setState() left them at, so size it once
+	(e.g. with State::init()) before entering the servo loop. */
+    inline State & getStateBuffer() { return state_; }
 
+    /** The full (constrained) state, computed by setState() from the
+	actuated state via the Constraint, or a copy of getState() if
+	there is no constraint. */
     inline State const & getFullState() const { return fullstate_; }
     
+    /** Counter that gets incremented by each call to setState(), so
+	that users can cache quantities which only change along with
+	the state (see e.g. Constraint::updateProjection()). */
+    inline size_t getStateVersion() const { return state_version_; }
+    
     //////////////////////////////////////////////////
     // Bare tree accessors.
     
@@ -195,11 +248,9 @@ namespace jspace {
     /** Retrieve a node by ID. */
     taoDNode * getNode(size_t id) const;
     
-    /** Retrieve a node by its name.
-	
-	\todo Add support for registering aliases, such as
-	"end-effector" or "End_Effector", which might correspond to
-	"right-gripper" or so depending on the robot.
+    /** Retrieve a node by its name, or by an alias registered with
+	addAlias(). The names are hashed into a collision-free table
+	in init(), so this costs the same for any number of nodes.
     */
     taoDNode * getNodeByName(std::string const & name) const;
     
@@ -214,10 +265,24 @@ namespace jspace {
 	limited to exactly one joint per node (and each node having
 	exactly one joint).
 	
-	\todo Add support for registering aliases, just as for getNodeByName().
+	Aliases registered with addAlias() work here as well.
     */
     taoDNode * getNodeByJointName(std::string const & name) const;
     
+    /** Register an alias, such as "end-effector", for a node which
+	is known under another name depending on the robot (such as
+	"right-gripper"). The name is looked up among the link names
+	and the joint names, and the alias gets added to whichever of
+	these matched, such that getNodeByName() and
+	getNodeByJointName() behave as if it were a real name. This
+	rebuilds the name tables, so it should be done at
+	initialization time.
+	
+	\return False if the model has not been initialized, the name
+	is unknown, or the alias is already in use.
+    */
+    bool addAlias(std::string const & alias, std::string const & name);
+    
     /** Retrieve joint limit information. This method fills the
 	provided vectors with the lower and upper joint limits. In
 	case no joint limit information is available, it sets the
@@ -313,6 +378,20 @@ namespace jspace {
 				Vector const & global_point,
 				Matrix & jacobian) const
     { return computeJacobian(node, global_point[0], global_point[1], global_point[2], jacobian); }
+    
+    /** Same as the dense computeJacobian() at the origin of a node,
+	but only the columns of the ancestor joints get stored (in
+	root-to-node order). */
+    bool computeJacobian(taoDNode const * node,
+			 SparseJacobian & jacobian) const;
+    
+    /** Same as the dense computeJacobian() at a global point, but
+	only the columns of the ancestor joints get stored (in
+	root-to-node order). Use this when the node sits at the end of
+	a branch that involves only a fraction of the DOF. */
+    bool computeJacobian(taoDNode const * node,
+			 double gx, double gy, double gz,
+			 SparseJacobian & jacobian) const;
 
     /** Convience method for checking external calculations of the A 
 	matrix
@@ -321,6 +400,31 @@ namespace jspace {
     bool computeJacobianCOM(int id,
 			    Matrix & jacobian) const;
     
+    /** Compute the velocity-product term Jdot * qdot at a point
+	(expressed wrt the global frame) attached to the given node,
+	i.e. the acceleration that point would have if all joint
+	accelerations were zero. The result has six rows (linear over
+	angular), just like the Jacobian. Operational-space tasks can
+	subtract it from their commanded acceleration in order to
+	account for the Lambda * Jdot * qdot bias force.
+	
+	This walks the ancestry of the node once, so it costs about as
+	much as computeJacobian(). It uses the joint velocities of the
+	most recent setState() even if Coriolis-centrifugal effects
+	were disabled in init().
+	
+	
+eturn True on success. The failure modes are the same as for
+	computeJacobian(), plus a state without joint velocities. */
+    bool computeJdotQdot(taoDNode const * node,
+			 double gx, double gy, double gz,
+			 Vector & jdot_qdot) const;
+    
+    /** Same as the other computeJdotQdot(), at the origin of the
+	given node. */
+    bool computeJdotQdot(taoDNode const * node,
+			 Vector & jdot_qdot) const;
+    
     //////////////////////////////////////////////////
     // dynamics facet
     
@@ -338,7 +442,24 @@ namespace jspace {
     // Non optional Jcom since I couldnt get the other to work quickly
     bool computeCOM(Vector & com, Matrix & opt_jcom) const;
     
-    /** Compute the gravity joint-torque vector. */
+    /** Compute the gravity and the Coriolis-centrifugal
+	joint-torque vectors together, using a single outward pass of
+	the inverse dynamics. Called by updateDynamics(). */
+    void computeBiasForces();
+    
+    /** Retrieve the combined bias joint-torque vector b + g,
+	i.e. the torque needed for zero joint accelerations. Gravity
+	compensation that got disabled for some DOF is knocked out as
+	in getGravity(), and Coriolis-centrifugal effects are omitted
+	if they are not enabled.
+	
+	\return True on success. The only possibility of receiving
+	false is if you never called computeBiasForces(), which gets
+	called by updateDynamics(), which gets called by update(). */
+    bool getBiasForces(Vector & bias) const;
+    
+    /** Compute the gravity joint-torque vector. Same as
+	computeBiasForces(), kept for backwards compatibility. */
     void computeGravity();
     
     /** Disable (or enable) gravity compensation for a given DOF
@@ -359,20 +480,35 @@ namespace jspace {
 	called by updateDynamics(), which gets called by update(). */
     bool getGravity(Vector & gravity) const;
     
-    /** Compute the Coriolis and contrifugal joint-torque vector. If
-	you set cc_tree=NULL in the constructor, then this is a
-	no-op. */
+    /** Compute the Coriolis and contrifugal joint-torque
+	vector. Same as computeBiasForces(), kept for backwards
+	compatibility. */
     void computeCoriolisCentrifugal();
     
     /** Retrieve the Coriolis and contrifugal joint-torque vector.
 	
 	\return True on success. There are two possibility of
-	receiving false: (i) you set cc_tree=NULL in the constructor,
+	receiving false: (i) you disabled them in init(),
 	or (ii) you never called computeCoriolisCentrifugal(), which
 	gets called by updateDynamics(), which gets called by
 	update(). */
     bool getCoriolisCentrifugal(Vector & coriolis_centrifugal) const;
     
+    /** Compute a Coriolis-centrifugal matrix C(q, qdot) such that C *
+	qdot equals the vector retrieved by
+	getCoriolisCentrifugal(). The Coriolis-centrifugal vector is
+	a quadratic form in the joint velocities, and this uses the
+	factorization where C is linear in qdot and symmetric in the
+	underlying bilinear form. Each column costs two inverse
+	dynamics sweeps, so only call this if you really need the
+	matrix and not just the vector.
+	
+	
+eturn True on success. Fails if Coriolis-centrifugal effects
+	were disabled in init(), or if the state has no joint
+	velocities. */
+    bool computeCoriolisMatrix(Matrix & coriolis);
+    
     /** Compute the joint-space mass-inertia matrix, a.k.a. the
 	kinetic energy matrix. */
     void computeMassInertia();
@@ -400,11 +536,6 @@ namespace jspace {
 	kinematics-gravity-mass-inertia tree. */
     tao_tree_info_s * _getKGMTree() { return kgm_tree_; }
     
-    /** For debugging only, access to the optional
-	Coriolis-centrifugal tree. Can NULL if the user is not
-	interested in Coriolis-centrifugal effects. */
-    tao_tree_info_s * _getCCTree() { return cc_tree_; }
-    
     
   private:
     typedef std::set<size_t> dof_set_t;
@@ -412,10 +543,11 @@ namespace jspace {
     
     std::size_t ndof_;
     tao_tree_info_s * kgm_tree_;
-    tao_tree_info_s * cc_tree_;
+    bool cc_enabled_;
     
     State state_;
     State fullstate_;
+    size_t state_version_;
     Vector g_torque_;
     Vector cc_torque_;
 
@@ -427,9 +559,23 @@ namespace jspace {
       int id;
       taoJoint * joint;
     };
-    typedef std::list<ancestry_entry_s> ancestry_list_t;
-    typedef std::map<taoDNode *, ancestry_list_t> ancestry_table_t;
+    typedef std::vector<ancestry_entry_s> ancestry_table_t;
+    
+    /** Ancestors (with joints) of each node, going from the node up
+	to the root. The ancestry of the node with ID ii occupies the
+	range [ancestry_begin_[ii], ancestry_begin_[ii+1]) of
+	ancestry_table_. */
     ancestry_table_t ancestry_table_;
+    std::vector<size_t> ancestry_begin_;
+    
+    /** Finds the range of ancestry_table_ for the given node, or
+	returns false if it is not part of this model. */
+    bool getAncestry(taoDNode const * node,
+		     ancestry_entry_s const ** begin,
+		     ancestry_entry_s const ** end) const;
+    
+    NameTable link_names_;
+    NameTable joint_names_;
     
     Constraint * constraint_;
 
@@ -0,0 +1,189 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include "NameTable.hpp"
+#include <algorithm>
+
+namespace jspace {
+
+
+  NameTable::
+  NameTable()
+    : seed_(0),
+      mask_(0),
+      bucket_mask_(0)
+  {
+  }
+
+
+  void NameTable::
+  clear()
+  {
+    names_.clear();
+    ids_.clear();
+    slots_.clear();
+    displacements_.clear();
+    seed_ = 0;
+    mask_ = 0;
+    bucket_mask_ = 0;
+  }
+
+
+  bool NameTable::
+  add(std::string const & name, int id)
+  {
+    for (size_t ii(0); ii < names_.size(); ++ii) {
+      if (name == names_[ii]) {
+	return false;
+      }
+    }
+    names_.push_back(name);
+    ids_.push_back(id);
+    slots_.clear();
+    return true;
+  }
+
+
+  uint64_t NameTable::
+  hash(std::string const & name, uint64_t seed)
+  {
+    // FNV-1a started from a seed-dependent offset, followed by a
+    // final mix so that the low bits (which select the slot) depend
+    // on all of the input.
+    uint64_t hh(14695981039346656037ULL ^ (seed * 0x9e3779b97f4a7c15ULL));
+    for (size_t ii(0); ii < name.size(); ++ii) {
+      hh ^= static_cast<unsigned char>(name[ii]);
+      hh *= 1099511628211ULL;
+    }
+    hh ^= hh >> 33;
+    hh *= 0xff51afd7ed558ccdULL;
+    hh ^= hh >> 33;
+    return hh;
+  }
+
+
+  uint64_t NameTable::
+  slot(uint64_t hh, uint64_t displacement)
+  {
+    // The low bits of the hash select the bucket, the high bits give
+    // an offset and an odd step, so that the displacements of a
+    // bucket walk all slots of the power-of-two table.
+    return (hh >> 16) + displacement * ((hh >> 40) | 1);
+  }
+
+
+  void NameTable::
+  build()
+  {
+    size_t const nnames(names_.size());
+    size_t nslots(1);
+    while (nslots < 2 * nnames) {
+      nslots *= 2;
+    }
+    size_t nbuckets(1);
+    while (2 * nbuckets < nnames) {
+      nbuckets *= 2;
+    }
+    
+    std::vector<uint64_t> hashes(nnames);
+    std::vector<std::pair<size_t, size_t> > order(nbuckets); // (size, bucket)
+    std::vector<size_t> first(nbuckets + 1);
+    std::vector<size_t> members(nnames);
+    std::vector<uint64_t> tried;
+    
+    // Each seed fails only if two names of a bucket share their
+    // whole slot sequence, or if a bucket finds no free slots after
+    // trying every offset, which is rare enough that a handful of
+    // seeds always does it. Still, make sure that this terminates.
+    for (uint64_t seed(0); ; ++seed) {
+      if ((0 != seed) && (0 == seed % 16)) {
+	nslots *= 2;
+      }
+      
+      // Group the names into buckets (counting sort on the bucket).
+      std::fill(first.begin(), first.end(), 0);
+      for (size_t ii(0); ii < nnames; ++ii) {
+	hashes[ii] = hash(names_[ii], seed);
+	++first[(hashes[ii] & (nbuckets - 1)) + 1];
+      }
+      for (size_t ib(0); ib < nbuckets; ++ib) {
+	order[ib] = std::make_pair(first[ib + 1], ib);
+	first[ib + 1] += first[ib];
+      }
+      std::vector<size_t> fill(first.begin(), first.end() - 1);
+      for (size_t ii(0); ii < nnames; ++ii) {
+	members[fill[hashes[ii] & (nbuckets - 1)]++] = ii;
+      }
+      
+      // Place the big buckets first, while there is still room.
+      std::sort(order.rbegin(), order.rend());
+      slots_.assign(nslots, -1);
+      displacements_.assign(nbuckets, 0);
+      bool ok(true);
+      for (size_t ib(0); ok && (ib < nbuckets) && (0 < order[ib].first); ++ib) {
+	size_t const bucket(order[ib].second);
+	ok = false;
+	for (uint64_t dd(0); dd < nslots; ++dd) {
+	  tried.clear();
+	  for (size_t im(first[bucket]); im < first[bucket + 1]; ++im) {
+	    uint64_t const ss(slot(hashes[members[im]], dd) & (nslots - 1));
+	    if ((-1 != slots_[ss]) || (tried.end() != std::find(tried.begin(), tried.end(), ss))) {
+	      break;
+	    }
+	    tried.push_back(ss);
+	  }
+	  if (tried.size() == first[bucket + 1] - first[bucket]) {
+	    for (size_t im(0); im < tried.size(); ++im) {
+	      slots_[tried[im]] = members[first[bucket] + im];
+	    }
+	    displacements_[bucket] = dd;
+	    ok = true;
+	    break;
+	  }
+	}
+      }
+      if (ok) {
+	seed_ = seed;
+	mask_ = nslots - 1;
+	bucket_mask_ = nbuckets - 1;
+	return;
+      }
+    }
+  }
+
+
+  int NameTable::
+  find(std::string const & name) const
+  {
+    if (slots_.empty()) {
+      return -1;
+    }
+    uint64_t const hh(hash(name, seed_));
+    int const index(slots_[slot(hh, displacements_[hh & bucket_mask_]) & mask_]);
+    if ((-1 == index) || (name != names_[index])) {
+      return -1;
+    }
+    return ids_[index];
+  }
+
+}
@@ -0,0 +1,92 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef JSPACE_NAME_TABLE_HPP
+#define JSPACE_NAME_TABLE_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace jspace {
+
+
+  /**
+     Maps a fixed set of names to dense integer IDs, for instance the
+     link or joint names of a robot (plus any aliases) to node IDs.
+
+     After all names have been added, build() computes a perfect
+     hash by hash-and-displace: the names are grouped into buckets of
+     about two names each, and each bucket gets a displacement which
+     moves its names into free slots of the table. The table has the
+     smallest power of two of at least twice as many slots as there
+     are names. A lookup then costs one hash computation and at most
+     one string comparison, regardless of how many names there
+     are. Adding a name after build() invalidates the table until
+     build() gets called again, so this is meant for names which are
+     known at initialization time.
+  */
+  class NameTable
+  {
+  public:
+    NameTable();
+
+    void clear();
+
+    /** Register a name for the given ID. Several names can map to
+	the same ID (aliases), but each name can only be added once:
+	if it is already known, this returns false and the existing
+	entry is kept. */
+    bool add(std::string const & name, int id);
+
+    /** Compute the perfect hash over the names that have been added
+	so far. Has to be called before find() can succeed. */
+    void build();
+
+    /** \return The ID registered for the name, or -1 if it is
+	unknown (or if build() has not been called since the last
+	add()). */
+    int find(std::string const & name) const;
+
+    inline size_t size() const { return names_.size(); }
+
+    /** \return The number of slots in the hash table, zero before
+	build(). */
+    inline size_t capacity() const { return slots_.size(); }
+
+  private:
+    static uint64_t hash(std::string const & name, uint64_t seed);
+    static uint64_t slot(uint64_t hh, uint64_t displacement);
+
+    std::vector<std::string> names_;
+    std::vector<int> ids_;
+    std::vector<int> slots_;	// index into names_, or -1 for empty slots
+    std::vector<uint32_t> displacements_; // one per bucket
+    uint64_t seed_;
+    uint64_t mask_;
+    uint64_t bucket_mask_;
+  };
+
+}
+
+#endif // JSPACE_NAME_TABLE_HPP
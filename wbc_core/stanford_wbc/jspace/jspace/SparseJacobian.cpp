@@ -0,0 +1,125 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include <jspace/SparseJacobian.hpp>
+#include <assert.h>
+
+using namespace std;
+
+namespace jspace {
+
+
+  SparseJacobian::
+  SparseJacobian()
+    : ndof_(0)
+  {
+  }
+
+
+  void SparseJacobian::
+  init(size_t nrows,
+       size_t ndof,
+       std::vector<size_t> const & columns)
+  {
+    ndof_ = ndof;
+    columns_ = columns;
+    block_ = Matrix::Zero(nrows, columns.size());
+  }
+
+
+  void SparseJacobian::
+  getRows(size_t first, size_t count, SparseJacobian & rows) const
+  {
+    rows.ndof_ = ndof_;
+    rows.columns_ = columns_;
+    rows.block_ = block_.block(first, 0, count, block_.cols());
+  }
+
+
+  void SparseJacobian::
+  toDense(Matrix & dense) const
+  {
+    dense = Matrix::Zero(block_.rows(), ndof_);
+    for (size_t ii(0); ii < columns_.size(); ++ii) {
+      dense.col(columns_[ii]) = block_.col(ii);
+    }
+  }
+
+
+  void SparseJacobian::
+  multiply(Matrix const & rhs, Matrix & result) const
+  {
+    assert(static_cast<size_t>(rhs.rows()) == ndof_);
+    
+    // Gather the rows of rhs that meet a non-zero column, then do a
+    // single compact product.
+    Matrix gathered(columns_.size(), rhs.cols());
+    for (size_t ii(0); ii < columns_.size(); ++ii) {
+      gathered.row(ii) = rhs.row(columns_[ii]);
+    }
+    result = block_ * gathered;
+  }
+
+
+  void SparseJacobian::
+  multiply(Vector const & rhs, Vector & result) const
+  {
+    assert(static_cast<size_t>(rhs.size()) == ndof_);
+    
+    Vector gathered(columns_.size());
+    for (size_t ii(0); ii < columns_.size(); ++ii) {
+      gathered.coeffRef(ii) = rhs.coeff(columns_[ii]);
+    }
+    result = block_ * gathered;
+  }
+
+
+  void SparseJacobian::
+  transposeMultiply(Vector const & rhs, Vector & result) const
+  {
+    assert(rhs.size() == block_.rows());
+    
+    Vector const compact(block_.transpose() * rhs);
+    result = Vector::Zero(ndof_);
+    for (size_t ii(0); ii < columns_.size(); ++ii) {
+      result.coeffRef(columns_[ii]) = compact.coeff(ii);
+    }
+  }
+
+
+  void SparseJacobian::
+  quadratic(Matrix const & mm, Matrix & result) const
+  {
+    assert((static_cast<size_t>(mm.rows()) == ndof_) && (static_cast<size_t>(mm.cols()) == ndof_));
+    
+    size_t const nn(columns_.size());
+    Matrix gathered(nn, nn);
+    for (size_t ii(0); ii < nn; ++ii) {
+      for (size_t jj(0); jj < nn; ++jj) {
+	gathered.coeffRef(ii, jj) = mm.coeff(columns_[ii], columns_[jj]);
+      }
+    }
+    result = block_ * gathered * block_.transpose();
+  }
+
+}
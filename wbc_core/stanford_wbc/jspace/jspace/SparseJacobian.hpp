@@ -0,0 +1,102 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef JSPACE_SPARSE_JACOBIAN_HPP
+#define JSPACE_SPARSE_JACOBIAN_HPP
+
+#include <jspace/wrap_eigen.hpp>
+#include <vector>
+
+namespace jspace {
+
+  /**
+     A Jacobian which is known to be zero except for a subset of its
+     columns. The Jacobian of a node in a kinematic tree only depends
+     on the joints between the node and the root, so for branched
+     robots (e.g. a head or hand on a humanoid torso) most columns of
+     the dense Jacobian are zero. This class stores only the
+     potentially non-zero columns in a compact block, along with
+     their column indices in the full matrix, and provides the
+     products that the controllers need without multiplying through
+     the zero columns.
+
+     Use Model::computeJacobian() to fill it in, or init() and
+     getBlock() if you know the structure from elsewhere.
+  */
+  class SparseJacobian
+  {
+  public:
+    SparseJacobian();
+
+    /** Set up the structure, with all entries of the block set to
+	zero. The columns have to be distinct and smaller than
+	ndof. */
+    void init(size_t nrows,
+	      size_t ndof,
+	      std::vector<size_t> const & columns);
+
+    /** Number of rows of the full (and the compact) matrix. */
+    inline size_t rows() const { return block_.rows(); }
+
+    /** Number of columns of the full matrix. */
+    inline size_t cols() const { return ndof_; }
+
+    /** Indices of the non-zero columns in the full matrix, in the
+	same order as the columns of getBlock(). */
+    inline std::vector<size_t> const & getColumns() const { return columns_; }
+
+    inline Matrix const & getBlock() const { return block_; }
+    inline Matrix & getBlock() { return block_; }
+
+    /** Copy count rows, starting at first, into another sparse
+	Jacobian with the same columns. For instance, use getRows(0,
+	3, jv) to retrieve only the linear part of a Jacobian computed
+	by the Model. */
+    void getRows(size_t first, size_t count, SparseJacobian & rows) const;
+
+    /** Expand into the equivalent dense matrix. */
+    void toDense(Matrix & dense) const;
+
+    /** result = J * rhs, where rhs has cols() rows. */
+    void multiply(Matrix const & rhs, Matrix & result) const;
+
+    /** result = J * rhs, where rhs has cols() entries. */
+    void multiply(Vector const & rhs, Vector & result) const;
+
+    /** result = J^T * rhs, where rhs has rows() entries. */
+    void transposeMultiply(Vector const & rhs, Vector & result) const;
+
+    /** result = J * mm * J^T, where mm is cols() by cols(). Only the
+	rows and columns of mm which correspond to non-zero columns of
+	J get read. */
+    void quadratic(Matrix const & mm, Matrix & result) const;
+
+  protected:
+    size_t ndof_;
+    std::vector<size_t> columns_;
+    Matrix block_;
+  };
+
+}
+
+#endif // JSPACE_SPARSE_JACOBIAN_HPP
@@ -1,334 +1,401 @@
 #include <jspace/constraint_library.hpp>
 #include <jspace/Model.hpp>
+#include <tao/dynamics/taoNode.h>
+#include <algorithm>
+#include <sstream>
+#include <set>
+#include <cmath>
 
 namespace jspace {
-  
-  Dreamer_Base::Dreamer_Base() {
-    sigmaThreshold_ = 0.0001;
-    U_ = Matrix::Zero(3,9);
-    U_(0,6) = 1; U_(1,7) = 1; U_(2,8) = 1;
-    wheel_radius_ = 4 * 0.0254;
-    x_prev = Vector::Zero(3);
-    jpos_prev = Vector::Zero(3);
-    Ainv = Matrix::Zero(9,9);
-    Jc_ = Matrix::Zero(6,9);
-
-    //Jacobian for the linear velocity of the base
-    Jxyz = Matrix::Zero(3,9);
-    Jxyz(0,0) = 1;
-    Jxyz(1,1) = 1;
-    Jxyz(2,2) = 1;
-
-    //Jacobian for the rotational velocity of the base
-    Jabg = Matrix::Zero(3,9);
-    Jabg(0,3) = 1;
-    Jabg(1,4) = 1;
-    Jabg(2,5) = 1;
-  }
 
-  Status Dreamer_Base::updateJc(Model const & model) {
-    Jc_ = Matrix::Zero(6,9);
 
-    taoDNode* node = model.getNode(5);
-    Vector wx; Vector wz; Vector r_vec;
+  static void wrap_angle(double & angle)
+  {
+    if (angle > M_PI) {
+      angle -= 2*M_PI;
+    }
+    else if (angle < -M_PI) {
+      angle += 2*M_PI;
+    }
+  }
 
-    jspace::Transform ee_transform;
-    Matrix base_ori;
 
-    //Calculation of vector between the center of the wheel 
-    // and the contact point
-    model.computeGlobalFrame(node,0,0,-wheel_radius_,ee_transform);
-    r_vec = ee_transform.translation();
-    model.computeGlobalFrame(node,0,0,0,ee_transform);
-    r_vec -= ee_transform.translation();
+  static taoDNode * find_node(Model const & model, std::string const & name)
+  {
+    taoDNode * node(model.getNodeByJointName(name));
+    if ( ! node) {
+      node = model.getNodeByName(name);
+    }
+    return node;
+  }
 
-    Matrix r_cross(Matrix::Zero(3,3));
-    r_cross(0,1) = r_vec(2); r_cross(0,2) = -r_vec(1);
-    r_cross(1,0) = -r_vec(2); r_cross(1,2) = r_vec(0);
-    r_cross(2,1) = r_vec(1); r_cross(2,1) = -r_vec(0);
 
-    base_ori = ee_transform.linear();
-    
-    wz = base_ori.block(0,2,3,1); 
-    
-    Matrix Jfull; Matrix Jv; Matrix Jw;
+  static Vector vector3(double x, double y, double z)
+  {
+    Vector vv(3);
+    vv << x, y, z;
+    return vv;
+  }
 
-    for (size_t ii(0); ii < 3; ++ii) {
 
-      node = model.getNode(ii+6);
-      model.computeGlobalFrame(node,0,0,0,ee_transform);
-      Vector actual(ee_transform.translation());
-      if ( ! model.computeJacobian(node, actual[0], actual[1], actual[2], Jfull)) {
-	return Status(false, "failed to compute Jacobian (unsupported joint type?)");
+  bool get_builtin_constraint_spec(std::string const & name,
+				   constraint_spec_s & spec)
+  {
+    spec = constraint_spec_s();
+
+    if (("Dreamer_Base" == name) || ("Dreamer_Full" == name)) {
+      // Three omni-wheels below virtualr-z, each of which also
+      // couples the floating base to the ground.
+      for (size_t ii(0); ii < 3; ++ii) {
+	rolling_wheel_s wheel;
+	std::ostringstream os;
+	os << "wheel" << ii + 1;
+	wheel.wheel = os.str();
+	wheel.base = "virtualr-z";
+	wheel.radius = 4 * 0.0254;
+	if ("Dreamer_Base" == name) {
+	  wheel.direction = vector3(0, -1, 0);
+	  wheel.direction_in_base = false;
+	}
+	else {
+	  // the y-axis of the base, rotated by 120 degrees per wheel
+	  double const angle((ii + 1) * 2 * M_PI / 3);
+	  wheel.direction = vector3(-sin(angle), cos(angle), 0);
+	  wheel.direction_in_base = true;
+	}
+	spec.rolling_wheel.push_back(wheel);
       }
-      Jv  = Jfull.block(0, 0, 3, Jfull.cols());
-      Jw  = Jfull.block(3, 0, 3, Jfull.cols());
-
-	  model.computeGlobalFrame(node,0,-1,0,ee_transform);
-      wx = ee_transform.translation();
-      model.computeGlobalFrame(node,0,0,0,ee_transform);
-      wx -= ee_transform.translation();
-      
-      Jc_.block(2*ii,0,1,9) = wx.transpose()*(Jv + r_cross * Jw);
-      Jc_.block(2*ii+1,0,1,9) = wz.transpose()*(Jv + r_cross * Jw);
-
-    }
-    
-    //Save a copy for fullstate
-    if(!model.getInverseMassInertia(Ainv)) {
-      return Status(false,"failed to get mass inertia");
+      floating_base_s base;
+      base.orientation[0] = "virtualr-x";
+      base.orientation[1] = "virtualr-y";
+      base.orientation[2] = "virtualr-z";
+      if ("Dreamer_Base" == name) {
+	base.offset = vector3(0, 0, 0);
+	base.sign = vector3(1, 1, 1);
+      }
+      else {
+	base.offset = vector3(-M_PI, 0, M_PI);
+	base.sign = vector3(1, 1, -1);
+      }
+      spec.floating_base.push_back(base);
     }
-    //Catch for first run where Ainv has not been initialized yet
-    if (Ainv.rows() == 0) {
-      Ainv = Matrix::Zero(9,9);
+
+    if (("Dreamer_Torso" == name) || ("Dreamer_Full" == name)) {
+      coupled_joint_s torso;
+      torso.master = "torso-bend1-";
+      torso.slave = "torso-bend2-";
+      torso.ratio = 1;
+      spec.coupled_joint.push_back(torso);
     }
 
-    Status ok;
-    return ok;
+    return ! spec.empty();
   }
 
-  void Dreamer_Base::getFullState(State const & state,
-				  State & fullState) {
 
-    Matrix UNcBar;
-    getUNcBar(Ainv,UNcBar);
+  GenericConstraint::GenericConstraint(constraint_spec_s const & spec)
+    : spec_(spec),
+      ndof_(0)
+  {
+  }
+
 
-    //Estimate base position and find base velocity from wheel states
-    x_prev = x_prev + Jxyz * UNcBar * (state.position_ - jpos_prev);
-    jpos_prev = state.position_;
-    Vector x_vel(Jxyz * UNcBar * state.velocity_);
+  Status GenericConstraint::init(Model const & model) {
+    ndof_ = model.getNDOF();
 
-    for (size_t ii(0); ii < 3; ++ii) {
-      fullState.position_[ii] = x_prev[ii];
-      fullState.velocity_[ii] = x_vel[ii];
+    // U selects the actuated DOF
+    Vector constrained;
+    model.getConstrained(constrained);
+    selection_.clear();
+    for (size_t ii(0); ii < ndof_; ++ii) {
+      if (constrained[ii] < 0.5) {
+	selection_.push_back(ii);
+      }
     }
-
-    //Find alpha, beta, gamma velocities
-    Vector ang_vel(Jabg * UNcBar * state.velocity_);
-    for (size_t ii(0); ii < 3; ++ii) {
-      fullState.velocity_[ii+3] = ang_vel[ii];
+    size_t const nu(selection_.size());
+    U_ = Matrix::Zero(nu, ndof_);
+    for (size_t ii(0); ii < nu; ++ii) {
+      U_(ii, selection_[ii]) = 1;
     }
 
-    //Find alpha, beta, gamma from orientation matrix
-    Matrix const ori_mtx(state.orientation_mtx_);
+    size_t nrows(0);
 
-    if ( ori_mtx(2,0) < 0.99 && ori_mtx(2,0) > -0.99) {
-      fullState.position_[4] = -asin(ori_mtx(2,0));
-      fullState.position_[3] = atan2(ori_mtx(2,1)/cos(fullState.position_[4]), ori_mtx(2,2)/cos(fullState.position_[4]));
-      fullState.position_[5] = atan2(ori_mtx(1,0)/cos(fullState.position_[4]), ori_mtx(0,0)/cos(fullState.position_[4]));
-    }
-    else {
-      fullState.position_[5] = 0;
-      if ( ori_mtx(2,0) < -0.99) {
-	fullState.position_[4] = M_PI/2;
-	fullState.position_[3] = fullState.position_[5] + atan2(ori_mtx(0,1), ori_mtx(0,2));
+    wheel_.clear();
+    for (size_t ii(0); ii < spec_.rolling_wheel.size(); ++ii) {
+      rolling_wheel_s const & rw(spec_.rolling_wheel[ii]);
+      wheel_s wheel;
+      wheel.wheel = find_node(model, rw.wheel);
+      if ( ! wheel.wheel) {
+	return Status(false, "invalid wheel node `" + rw.wheel + "'");
       }
-      else {
-	fullState.position_[4] = -M_PI/2;
-	fullState.position_[3] = -fullState.position_[5] + atan2(-ori_mtx(0,1),-ori_mtx(0,2));
+      wheel.base = find_node(model, rw.base);
+      if ( ! wheel.base) {
+	return Status(false, "invalid wheel base node `" + rw.base + "'");
       }
-    } 
-
-    //Add wheels
-    for (size_t ii(0); ii < 3; ++ii) {
-      fullState.position_[ii+6] = state.position_[ii];
-      fullState.velocity_[ii+6] = state.velocity_[ii];
+      if (3 != rw.direction.rows()) {
+	return Status(false, "wheel `" + rw.wheel + "' direction needs three entries");
+      }
+      wheel.radius = rw.radius;
+      wheel.direction = rw.direction;
+      wheel.direction_in_base = rw.direction_in_base;
+      wheel.row = nrows;
+      nrows += 2;
+      wheel_.push_back(wheel);
     }
 
-  }
+    contact_.clear();
+    for (size_t ii(0); ii < spec_.fixed_contact.size(); ++ii) {
+      fixed_contact_s const & fc(spec_.fixed_contact[ii]);
+      contact_s contact;
+      contact.node = find_node(model, fc.node);
+      if ( ! contact.node) {
+	return Status(false, "invalid contact node `" + fc.node + "'");
+      }
+      if ((3 != fc.point.rows()) || (6 != fc.mask.rows())) {
+	return Status(false, "contact `" + fc.node + "' needs a 3D point and a 6D mask");
+      }
+      contact.point = fc.point;
+      for (size_t jj(0); jj < 6; ++jj) {
+	if (fc.mask[jj] > 0.5) {
+	  contact.axes.push_back(jj);
+	}
+      }
+      contact.row = nrows;
+      nrows += contact.axes.size();
+      contact_.push_back(contact);
+    }
 
+    // The coupling rows never change, so they go into Jc right here
+    // and updateJc() does not touch them.
+    Jc_ = Matrix::Zero(nrows + spec_.coupled_joint.size(), ndof_);
+    std::set<size_t> slave_dof;
+    slave_.clear();
+    for (size_t ii(0); ii < spec_.coupled_joint.size(); ++ii) {
+      coupled_joint_s const & cj(spec_.coupled_joint[ii]);
+      taoDNode * master(find_node(model, cj.master));
+      if ( ! master) {
+	return Status(false, "invalid master joint `" + cj.master + "'");
+      }
+      taoDNode * slave(find_node(model, cj.slave));
+      if ( ! slave) {
+	return Status(false, "invalid slave joint `" + cj.slave + "'");
+      }
+      slave_s ss;
+      ss.master = master->getID();
+      ss.slave = slave->getID();
+      ss.ratio = cj.ratio;
+      if (constrained[ss.master] > 0.5) {
+	return Status(false, "master joint `" + cj.master + "' must not be constrained");
+      }
+      if (constrained[ss.slave] < 0.5) {
+	return Status(false, "slave joint `" + cj.slave + "' must be constrained");
+      }
+      Jc_(nrows, ss.master) = ss.ratio;
+      Jc_(nrows, ss.slave) = -1;
+      ++nrows;
+      slave_dof.insert(ss.slave);
+      slave_.push_back(ss);
+    }
 
-  Dreamer_Torso::Dreamer_Torso() {
-    sigmaThreshold_ = 0.0001;
-    U_ = Matrix::Zero(9,10);
-    U_(0,0) = 1; U_(1,1) = 1; U_(2,3) = 1; U_(3,4) = 1; U_(4,5) = 1;
-    U_(5,6) = 1; U_(6,7) = 1; U_(7,8) = 1; U_(8,9) = 1;
-    Jc_ = Matrix::Zero(1,10);
-    Jc_(0,1) = 1; Jc_(0,2) = -1;
-  }
+    orientation_.clear();
+    if (spec_.floating_base.size() > 1) {
+      return Status(false, "at most one floating base is supported");
+    }
+    if ( ! spec_.floating_base.empty()) {
+      floating_base_s const & fb(spec_.floating_base[0]);
+      for (size_t ii(0); ii < 3; ++ii) {
+	taoDNode * node(find_node(model, fb.orientation[ii]));
+	if ( ! node) {
+	  return Status(false, "invalid floating base joint `" + fb.orientation[ii] + "'");
+	}
+	orientation_.push_back(node->getID());
+      }
+      orientation_offset_ = fb.offset;
+      if (3 != orientation_offset_.rows()) {
+	orientation_offset_ = Vector::Zero(3);
+      }
+      orientation_sign_ = fb.sign;
+      if (3 != orientation_sign_.rows()) {
+	orientation_sign_ = Vector::Ones(3);
+      }
+    }
 
-  void Dreamer_Torso::getFullState(State const & state,
-				   State & fullState) {
-    for (size_t ii(0); ii < 10; ++ii) {
-      if ( ii <2 ) {
-	fullState.position_[ii] = state.position_[ii];
-	fullState.velocity_[ii] = state.velocity_[ii];
+    integrated_.clear();
+    for (size_t ii(0); ii < ndof_; ++ii) {
+      if ((constrained[ii] > 0.5)
+	  && (slave_dof.end() == slave_dof.find(ii))
+	  && (orientation_.end() == std::find(orientation_.begin(), orientation_.end(), ii))) {
+	integrated_.push_back(ii);
       }
-      else {
-	fullState.position_[ii] = state.position_[ii-1];
-	fullState.velocity_[ii] = state.velocity_[ii-1];
+    }
+
+    // Jc can only be non-zero in the coupled columns and in the
+    // columns of the joints that move a wheel or a contact.
+    std::set<size_t> jc_columns;
+    for (size_t ii(0); ii < slave_.size(); ++ii) {
+      jc_columns.insert(slave_[ii].master);
+      jc_columns.insert(slave_[ii].slave);
+    }
+    std::vector<taoDNode const *> moving;
+    for (size_t ii(0); ii < wheel_.size(); ++ii) {
+      moving.push_back(wheel_[ii].wheel);
+    }
+    for (size_t ii(0); ii < contact_.size(); ++ii) {
+      moving.push_back(contact_[ii].node);
+    }
+    for (size_t ii(0); ii < moving.size(); ++ii) {
+      for (taoDNode const * node(moving[ii]); 0 != node; node = node->getDParent()) {
+	if ((0 != node->getJointList()) && (0 <= node->getID())) {
+	  jc_columns.insert(node->getID());
+	}
       }
     }
-  }
+    jc_columns_.assign(jc_columns.begin(), jc_columns.end());
 
-  
-  Dreamer_Full::Dreamer_Full() {
-    sigmaThreshold_ = 0.0001;
-    U_ = Matrix::Zero(12,19);
-    U_(0,6) = 1; U_(1,7) = 1; U_(2,8) = 1; U_(3,9) = 1;
-    U_(4,10) = 1; U_(5,12) = 1; U_(6,13) = 1; U_(7,14) = 1;
-    U_(8,15) = 1; U_(9,16) = 1; U_(10,17) = 1; U_(11,18) = 1;
-    wheel_radius_ = 4 * 0.0254;
-    x_prev = Vector::Zero(3);
-    jpos_prev = Vector::Zero(12);
-    Ainv = Matrix::Zero(19,19);
-    Jc_ = Matrix::Zero(7,19);
-
-    //Jacobian for the linear velocity of the base
-    Jxyz = Matrix::Zero(3,19);
-    Jxyz(0,0) = 1;
-    Jxyz(1,1) = 1;
-    Jxyz(2,2) = 1;
-
-    //Jacobian for the rotational velocity of the base
-    Jabg = Matrix::Zero(3,19);
-    Jabg(0,3) = 1;
-    Jabg(1,4) = 1;
-    Jabg(2,5) = 1;
+    position_prev_ = Vector::Zero(nu);
+    integrated_position_ = Vector::Zero(ndof_);
+
+    // until the first updateProjection(), the constrained DOF do not move
+    projection_.UNcBar = Matrix::Zero(ndof_, nu);
+    projection_valid_ = false;
+
+    Status ok;
+    return ok;
   }
 
-  Status Dreamer_Full::updateJc(Model const & model) {
-    Jc_ = Matrix::Zero(7,19);
-
-    taoDNode* node = model.getNode(5);
-    Vector wx; Vector wz; Vector r_vec; Vector ay;
-
-    jspace::Transform ee_transform;
-    Matrix base_ori;
-
-    //Calculation of vector between the center of the wheel 
-    // and the contact point
-    model.computeGlobalFrame(node,0,0,-wheel_radius_,ee_transform);
-    r_vec = ee_transform.translation();
-    model.computeGlobalFrame(node,0,0,0,ee_transform);
-    r_vec -= ee_transform.translation();
-
-    Matrix r_cross(Matrix::Zero(3,3));
-    r_cross(0,1) = r_vec(2); r_cross(0,2) = -r_vec(1);
-    r_cross(1,0) = -r_vec(2); r_cross(1,2) = r_vec(0);
-    r_cross(2,1) = r_vec(1); r_cross(2,1) = -r_vec(0);
-
-    base_ori = ee_transform.linear();
-    
-    ay = Vector::Zero(3);
-    ay(1) = 1;
-    wz = base_ori.block(0,2,3,1); 
-    
-    Matrix rot(Matrix::Identity(3,3));
-    rot(0,0) = cos(2*M_PI/3);
-    rot(0,1) = -sin(2*M_PI/3);
-    rot(1,0) = sin(2*M_PI/3);
-    rot(1,1) = cos(2*M_PI/3);
-    
-    Matrix Jfull; Matrix Jv; Matrix Jw;
 
-    for (size_t ii(0); ii < 3; ++ii) {
+  Status GenericConstraint::updateJc(Model const & model) {
+    jspace::Transform frame;
 
-      node = model.getNode(ii+6);
-      model.computeGlobalFrame(node,0,0,0,ee_transform);
-      Vector actual(ee_transform.translation());
-      if ( ! model.computeJacobian(node, actual[0], actual[1], actual[2], Jfull)) {
-	return Status(false, "failed to compute Jacobian (unsupported joint type?)");
-      }
-      Jv  = Jfull.block(0, 0, 3, Jfull.cols());
-      Jw  = Jfull.block(3, 0, 3, Jfull.cols());
+    for (size_t ii(0); ii < wheel_.size(); ++ii) {
+      wheel_s & wheel(wheel_[ii]);
 
-      ay = rot * ay;
-      wx = base_ori * ay;
-      
-      Jc_.block(2*ii,0,1,19) = wx.transpose()*(Jv + r_cross * Jw);
-      Jc_.block(2*ii+1,0,1,19) = wz.transpose()*(Jv + r_cross * Jw);
+      model.getGlobalFrame(wheel.base, frame);
+      Eigen::Matrix3d const base_ori(frame.linear());
+      //Vector between the center of the wheel and the contact point
+      Eigen::Vector3d const rr(base_ori * Eigen::Vector3d(0, 0, -wheel.radius));
+      Eigen::Vector3d const wz(base_ori.col(2));
+      Eigen::Vector3d const dir(wheel.direction[0], wheel.direction[1], wheel.direction[2]);
+      Eigen::Vector3d wx;
+      if (wheel.direction_in_base) {
+	wx = base_ori * dir;
+      }
+      else {
+	model.getGlobalFrame(wheel.wheel, frame);
+	wx = frame.linear() * dir;
+      }
 
+      if ( ! model.computeJacobian(wheel.wheel, wheel.jacobian)) {
+	return Status(false, "failed to compute Jacobian (unsupported joint type?)");
+      }
+      // contact point velocity v + omega x r, only in the columns
+      // that can be non-zero
+      std::vector<size_t> const & columns(wheel.jacobian.getColumns());
+      Matrix const & block(wheel.jacobian.getBlock());
+      for (size_t jj(0); jj < columns.size(); ++jj) {
+	size_t const col(columns[jj]);
+	Eigen::Vector3d const vv(block(0, jj), block(1, jj), block(2, jj));
+	Eigen::Vector3d const ww(block(3, jj), block(4, jj), block(5, jj));
+	Eigen::Vector3d const vc(vv + ww.cross(rr));
+	Jc_(wheel.row, col) = wx.dot(vc);
+	Jc_(wheel.row + 1, col) = wz.dot(vc);
+      }
     }
 
-    //Add the torso contraint
-    Jc_(6,10) = 1; Jc_(6,11) = -1;
-    
-    //Save a copy for fullstate
-    if(!model.getInverseMassInertia(Ainv)) {
-      return Status(false,"failed to get mass inertia");
-    }
-    //Catch for first run where Ainv has not been initialized yet
-    if (Ainv.rows() == 0) {
-      Ainv = Matrix::Zero(19,19);
+    for (size_t ii(0); ii < contact_.size(); ++ii) {
+      contact_s & contact(contact_[ii]);
+      model.computeGlobalFrame(contact.node, contact.point, frame);
+      if ( ! model.computeJacobian(contact.node,
+				   frame.translation()[0],
+				   frame.translation()[1],
+				   frame.translation()[2],
+				   contact.jacobian)) {
+	return Status(false, "failed to compute Jacobian (unsupported joint type?)");
+      }
+      std::vector<size_t> const & columns(contact.jacobian.getColumns());
+      Matrix const & block(contact.jacobian.getBlock());
+      for (size_t jj(0); jj < contact.axes.size(); ++jj) {
+	for (size_t kk(0); kk < columns.size(); ++kk) {
+	  Jc_(contact.row + jj, columns[kk]) = block(contact.axes[jj], kk);
+	}
+      }
     }
 
     Status ok;
     return ok;
-
   }
 
-  void Dreamer_Full::getFullState(State const & state,
-				   State & fullState) {
-    Matrix UNcBar;
-    getUNcBar(Ainv,UNcBar);
 
-    //Estimate base position and find base velocity from wheel states
-    x_prev = x_prev + Jxyz * UNcBar * (state.position_ - jpos_prev);
-    jpos_prev = state.position_;
-    Vector x_vel(Jxyz * UNcBar * state.velocity_);
+  void GenericConstraint::getFullState(State const & state,
+				       State & fullState) {
+    // projection from the most recent updateProjection()
+    Matrix const & UNcBar(projection_.UNcBar);
+    size_t const nu(selection_.size());
 
-    for (size_t ii(0); ii < 3; ++ii) {
-      fullState.position_[ii] = x_prev[ii];
-      fullState.velocity_[ii] = x_vel[ii];
+    for (size_t ii(0); ii < nu; ++ii) {
+      fullState.position_[selection_[ii]] = state.position_[ii];
+      fullState.velocity_[selection_[ii]] = state.velocity_[ii];
     }
 
-    //Find alpha, beta, gamma velocities from wheel velocities
-    Vector ang_vel(Jabg * UNcBar * state.velocity_);
-    for (size_t ii(0); ii < 3; ++ii) {
-      fullState.velocity_[ii+3] = ang_vel[ii];
+    for (size_t ii(0); ii < slave_.size(); ++ii) {
+      slave_s const & ss(slave_[ii]);
+      fullState.position_[ss.slave] = ss.ratio * fullState.position_[ss.master];
+      fullState.velocity_[ss.slave] = ss.ratio * fullState.velocity_[ss.master];
     }
 
-    //Find alpha, beta, gamma from orientation matrix
-    Matrix const ori_mtx(state.orientation_mtx_);
-
-    if ( ori_mtx(2,0) < 0.99 && ori_mtx(2,0) > -0.99) {
-      fullState.position_[4] = -asin(ori_mtx(2,0));
-      fullState.position_[3] = atan2(ori_mtx(2,1)/cos(fullState.position_[4]), ori_mtx(2,2)/cos(fullState.position_[4])) - M_PI;
-      fullState.position_[5] = -atan2(ori_mtx(1,0)/cos(fullState.position_[4]), ori_mtx(0,0)/cos(fullState.position_[4])) + M_PI;
-
-      if (fullState.position_[3] > M_PI) {
-	fullState.position_[3] -= 2*M_PI;
-      }
-      else if (fullState.position_[3] < -M_PI) {
-	fullState.position_[3] += 2*M_PI;
-      }
-
-      if (fullState.position_[5] > M_PI) {
-	fullState.position_[5] -= 2*M_PI;
-      }
-      else if (fullState.position_[5] < -M_PI) {
-	fullState.position_[5] += 2*M_PI;
+    //Estimate positions (odometry) and velocities of the remaining
+    //constrained DOF from the actuated joint motion
+    if (position_prev_.rows() != state.position_.rows()) {
+      position_prev_ = state.position_;
+    }
+    for (size_t ii(0); ii < integrated_.size(); ++ii) {
+      size_t const dof(integrated_[ii]);
+      double dx(0);
+      for (size_t jj(0); jj < nu; ++jj) {
+	dx += UNcBar.coeff(dof, jj) * (state.position_.coeff(jj) - position_prev_.coeff(jj));
       }
+      integrated_position_[dof] += dx;
+      fullState.position_[dof] = integrated_position_[dof];
+      fullState.velocity_[dof] = UNcBar.row(dof).dot(state.velocity_.transpose());
+    }
+    position_prev_ = state.position_;
 
+    if (orientation_.empty()) {
+      return;
     }
-    else {
-      fullState.position_[5] = 0;
-      if ( ori_mtx(2,0) < -0.99) {
-	fullState.position_[4] = M_PI/2;
-	fullState.position_[3] = fullState.position_[5] + atan2(ori_mtx(0,1), ori_mtx(0,2));
-      }
-      else {
-	fullState.position_[4] = -M_PI/2;
-	fullState.position_[3] = -fullState.position_[5] + atan2(-ori_mtx(0,1),-ori_mtx(0,2));
-      }
-    } 
 
-    //Add wheels
     for (size_t ii(0); ii < 3; ++ii) {
-      fullState.position_[ii+6] = state.position_[ii];
-      fullState.velocity_[ii+6] = state.velocity_[ii];
+      fullState.velocity_[orientation_[ii]] = UNcBar.row(orientation_[ii]).dot(state.velocity_.transpose());
+    }
+
+    //Find alpha, beta, gamma from orientation matrix
+    Matrix const & ori_mtx(state.orientation_mtx_);
+    if ((3 != ori_mtx.rows()) || (3 != ori_mtx.cols())) {
+      return;
     }
+    double & alpha(fullState.position_[orientation_[0]]);
+    double & beta(fullState.position_[orientation_[1]]);
+    double & gamma(fullState.position_[orientation_[2]]);
 
-    //Torso DOF
-    for (size_t ii(0); ii < 10; ++ii) {
-      if ( ii <2 ) {
-	fullState.position_[ii+9] = state.position_[ii+3];
-	fullState.velocity_[ii+9] = state.velocity_[ii+3];
+    if ( ori_mtx(2,0) < 0.99 && ori_mtx(2,0) > -0.99) {
+      beta = -asin(ori_mtx(2,0));
+      alpha = atan2(ori_mtx(2,1)/cos(beta), ori_mtx(2,2)/cos(beta));
+      gamma = atan2(ori_mtx(1,0)/cos(beta), ori_mtx(0,0)/cos(beta));
+      alpha = orientation_sign_[0] * alpha + orientation_offset_[0];
+      beta = orientation_sign_[1] * beta + orientation_offset_[1];
+      gamma = orientation_sign_[2] * gamma + orientation_offset_[2];
+      wrap_angle(alpha);
+      wrap_angle(beta);
+      wrap_angle(gamma);
+    }
+    else {
+      gamma = 0;
+      if ( ori_mtx(2,0) < -0.99) {
+	beta = M_PI/2;
+	alpha = gamma + atan2(ori_mtx(0,1), ori_mtx(0,2));
       }
       else {
-	fullState.position_[ii+9] = state.position_[ii-1+3];
-	fullState.velocity_[ii+9] = state.velocity_[ii-1+3];
+	beta = -M_PI/2;
+	alpha = -gamma + atan2(-ori_mtx(0,1),-ori_mtx(0,2));
       }
     }
   }
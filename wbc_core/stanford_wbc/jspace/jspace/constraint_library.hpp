@@ -2,63 +2,151 @@
 #define CONSTRAINT_LIBRARY_H
 
 #include <jspace/Constraint.hpp>
+#include <jspace/SparseJacobian.hpp>
+#include <vector>
+
+class taoDNode;
 
 namespace jspace {
 
-  /*
-    Constraints for the Dreamer Base only
-   */
+  /**
+     A wheel that rolls without slipping on the ground plane. It
+     contributes two rows to Jc: no velocity of the contact point
+     along the rolling direction, and none along the base z-axis. The
+     contact point lies radius below the wheel center, along the
+     negative z-axis of the base.
+  */
+  struct rolling_wheel_s {
+    std::string wheel;		/**< node (joint or link name) of the wheel */
+    std::string base;		/**< node whose frame defines "up" */
+    double radius;
+    Vector direction;		/**< rolling direction, local to wheel or base */
+    bool direction_in_base;	/**< if false, direction is local to the wheel */
+  };
 
-  class Dreamer_Base
-    : public Constraint {
-  public:
-    Dreamer_Base();
-    Status updateJc(Model const & model);
-    void getFullState(State const & state,
-		      State & fullState);
-  protected:
-    double wheel_radius_;
-    Vector x_prev;
-    Vector jpos_prev;
-    Matrix Jxyz;
-    Matrix Jabg;
-    Matrix Ainv;
-    
+  /**
+     Two joints that move together, slave = ratio * master. The slave
+     has to be marked as constrained in the robot model, the master
+     not.
+  */
+  struct coupled_joint_s {
+    std::string master;
+    std::string slave;
+    double ratio;
   };
 
+  /**
+     A point on a node which cannot move (or rotate) along the
+     directions selected by mask, which has six entries: x, y, z of
+     the linear velocity followed by the angular velocity.
+  */
+  struct fixed_contact_s {
+    std::string node;
+    Vector point;		/**< local to the node */
+    Vector mask;
+  };
 
-  /*
-    Constraint for the Dreamer Torso with 
-    only the torso and arm together
-   */
+  /**
+     Orientation of a floating base, given by three rotational
+     virtual joints about x, y, and z. Their positions are taken from
+     State::orientation_mtx_ as sign * angle + offset (wrapped to
+     [-pi, pi]). All other constrained DOF that are not coupling
+     slaves get their position integrated from the actuated joint
+     motion (odometry).
+  */
+  struct floating_base_s {
+    std::string orientation[3];
+    Vector offset;
+    Vector sign;
+  };
 
-  class Dreamer_Torso
-    : public Constraint {
-  public:
-    Dreamer_Torso();
-    void getFullState(State const & state,
-		      State & fullState);
-    
+  /**
+     Everything needed to set up a GenericConstraint. Node names get
+     resolved when the constraint is initialized with a Model, so the
+     same specification can be used with different trees as long as
+     the names match.
+  */
+  struct constraint_spec_s {
+    std::vector<rolling_wheel_s> rolling_wheel;
+    std::vector<coupled_joint_s> coupled_joint;
+    std::vector<fixed_contact_s> fixed_contact;
+    std::vector<floating_base_s> floating_base; // zero or one entry
+
+    inline bool empty() const {
+      return rolling_wheel.empty() && coupled_joint.empty()
+	&& fixed_contact.empty() && floating_base.empty();
+    }
   };
 
-  /*
-    Constraints for the Full Dreamer
-   */
+  /**
+     Retrieve the specification of one of the constraints that we
+     used to hardcode ("Dreamer_Base", "Dreamer_Torso", and
+     "Dreamer_Full").
 
-  class Dreamer_Full
+     \return False if the name is unknown.
+  */
+  bool get_builtin_constraint_spec(std::string const & name,
+				   constraint_spec_s & spec);
+
+
+  /**
+     Constraint built from a constraint_spec_s. All the structure
+     (which DOF are actuated, the constant coupling rows of Jc) is
+     figured out by init(), and updateJc() uses column-sparse contact
+     Jacobians, so the per-tick update only touches the entries that
+     can actually change. The columns that Jc can be non-zero in are
+     recorded as well, and the projection only multiplies through
+     those.
+  */
+  class GenericConstraint
     : public Constraint {
   public:
-    Dreamer_Full();
+    explicit GenericConstraint(constraint_spec_s const & spec);
+
+    /** Resolve node names and precompute the sparsity structure. The
+	model does not need to have a valid state yet. */
+    Status init(Model const & model);
+
     Status updateJc(Model const & model);
     void getFullState(State const & state,
 		      State & fullState);
+
   protected:
-    double wheel_radius_;
-    Vector x_prev;
-    Vector jpos_prev;
-    Matrix Jxyz;
-    Matrix Jabg;
-    Matrix Ainv;		   
+    struct wheel_s {
+      taoDNode * wheel;
+      taoDNode * base;
+      double radius;
+      Vector direction;
+      bool direction_in_base;
+      size_t row;
+      SparseJacobian jacobian;	// of the wheel, reused every tick
+    };
+
+    struct contact_s {
+      taoDNode * node;
+      Vector point;
+      std::vector<size_t> axes;	   // selected rows of the node Jacobian
+      size_t row;
+      SparseJacobian jacobian;	// of the node, reused every tick
+    };
+
+    struct slave_s {
+      size_t master;
+      size_t slave;
+      double ratio;
+    };
+
+    constraint_spec_s const spec_;
+    size_t ndof_;
+    std::vector<wheel_s> wheel_;
+    std::vector<contact_s> contact_;
+    std::vector<slave_s> slave_;
+    std::vector<size_t> orientation_; // empty or three DOF indices
+    Vector orientation_offset_;
+    Vector orientation_sign_;
+    std::vector<size_t> integrated_;  // odometry DOF
+    Vector position_prev_;	      // actuated positions of the previous call
+    Vector integrated_position_;
   };
 
 }
@@ -57,6 +57,7 @@ namespace jspace {
 				       deVector3 const & translation, double mass,
 				       deMatrix3 & out_inertia)
   {
+    double ixx, ixy, ixz, iyy, iyz, izz;
     inertia_parallel_axis_transform(in_inertia.elementAt(0, 0),
 				    in_inertia.elementAt(0, 1),
 				    in_inertia.elementAt(0, 2),
@@ -67,12 +68,14 @@ namespace jspace {
 				    translation[1],
 				    translation[2],
 				    mass,
-				    out_inertia.elementAt(0, 0),
-				    out_inertia.elementAt(0, 1),
-				    out_inertia.elementAt(0, 2),
-				    out_inertia.elementAt(1, 1),
-				    out_inertia.elementAt(1, 2),
-				    out_inertia.elementAt(2, 2));
+				    ixx, ixy, ixz, iyy, iyz, izz);
+    // go through doubles, deFloat may be float
+    out_inertia.elementAt(0, 0) = ixx;
+    out_inertia.elementAt(0, 1) = ixy;
+    out_inertia.elementAt(0, 2) = ixz;
+    out_inertia.elementAt(1, 1) = iyy;
+    out_inertia.elementAt(1, 2) = iyz;
+    out_inertia.elementAt(2, 2) = izz;
   }
   
   
@@ -233,7 +236,8 @@ namespace jspace {
 			 *additional.mass(), *additional.inertia(), adtl_com,
 			 home_of_additional_wrt_original,
 			 fused_mass, fused_inertia, fused_com);
-    fused.set(&fused_mass, &fused_com.translation(), &fused_inertia);
+    deFloat const tao_fused_mass(fused_mass);
+    fused.set(&tao_fused_mass, &fused_com.translation(), &fused_inertia);
   }
   
   
@@ -0,0 +1,684 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include "model_cache.hpp"
+#include "tao_util.hpp"
+#include "constraint_library.hpp"
+#include <tao/dynamics/taoNode.h>
+#include <tao/dynamics/taoJoint.h>
+#include <tao/dynamics/taoVar.h>
+#include <tao/dynamics/taoDynamics.h>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+
+
+namespace {
+
+  char const cache_magic[8] = { 'W', 'B', 'C', 'M', 'O', 'D', 'E', 'L' };
+  uint32_t const cache_byte_order(0x01020304);
+  uint64_t const fnv_offset(14695981039346656037ULL);
+  uint64_t const fnv_prime(1099511628211ULL);
+
+
+  struct cache_header_s {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t source_hash;
+    uint64_t checksum;		// of everything that follows the header
+    uint32_t node_count;	// not counting the root
+    uint32_t names_size;
+    uint32_t constraints_size;	// without the padding at the end of the file
+    uint32_t reserved;
+    double root_translation[3];
+    double root_rotation[4];
+  };
+
+
+  struct cache_node_s {
+    int32_t id;
+    int32_t parent_id;		// -1 for children of the root
+    int32_t joint_type;		// 'p', 'r', or 's'
+    int32_t joint_axis;		// taoAxis, ignored for spherical joints
+    int32_t is_constrained;
+    uint32_t link_name;		// offsets into the name table
+    uint32_t joint_name;
+    uint32_t reserved;
+    double home_translation[3];
+    double home_rotation[4];
+    double mass;
+    double center[3];
+    double inertia[9];		// as stored in TAO, i.e. wrt the node origin
+    double rotor_inertia;
+    double gear_ratio;
+    double damping;
+    double joint_inertia;
+    double limit_lower;
+    double limit_upper;
+  };
+
+
+  uint64_t fnv1a(char const * data, size_t len)
+  {
+    uint64_t hash(fnv_offset);
+    for (size_t ii(0); ii < len; ++ii) {
+      hash ^= static_cast<unsigned char>(data[ii]);
+      hash *= fnv_prime;
+    }
+    return hash;
+  }
+
+
+  void pad8(std::string & buf)
+  {
+    while (0 != buf.size() % 8) {
+      buf.push_back('\0');
+    }
+  }
+
+
+  class cache_writer {
+  public:
+    std::string buf;
+
+    void u32(uint32_t value) {
+      buf.append(reinterpret_cast<char const *>(&value), sizeof(value));
+    }
+
+    void f64(double value) {
+      buf.append(reinterpret_cast<char const *>(&value), sizeof(value));
+    }
+
+    void str(std::string const & value) {
+      u32(value.size());
+      buf.append(value);
+    }
+
+    void vec(jspace::Vector const & value) {
+      u32(value.size());
+      for (int ii(0); ii < value.size(); ++ii) {
+	f64(value[ii]);
+      }
+    }
+  };
+
+
+  class cache_reader {
+  public:
+    cache_reader(char const * begin, char const * end)
+      : pos_(begin), end_(end), ok_(true) {}
+
+    bool ok() const { return ok_ && (pos_ == end_); }
+
+    void raw(void * dst, size_t len) {
+      if ( ! ok_ || (static_cast<size_t>(end_ - pos_) < len)) {
+	ok_ = false;
+	memset(dst, 0, len);
+	return;
+      }
+      memcpy(dst, pos_, len);
+      pos_ += len;
+    }
+
+    uint32_t u32() {
+      uint32_t value;
+      raw(&value, sizeof(value));
+      return value;
+    }
+
+    double f64() {
+      double value;
+      raw(&value, sizeof(value));
+      return value;
+    }
+
+    std::string str() {
+      uint32_t const len(u32());
+      if ( ! ok_ || (static_cast<size_t>(end_ - pos_) < len)) {
+	ok_ = false;
+	return "";
+      }
+      std::string value(pos_, len);
+      pos_ += len;
+      return value;
+    }
+
+    jspace::Vector vec() {
+      uint32_t const len(u32());
+      if ( ! ok_ || (static_cast<size_t>(end_ - pos_) < len * sizeof(double))) {
+	ok_ = false;
+	return jspace::Vector();
+      }
+      jspace::Vector value(len);
+      for (uint32_t ii(0); ii < len; ++ii) {
+	value[ii] = f64();
+      }
+      return value;
+    }
+
+  private:
+    char const * pos_;
+    char const * end_;
+    bool ok_;
+  };
+
+
+  void write_constraints(cache_writer & ww, jspace::constraint_spec_s const & spec)
+  {
+    ww.u32(spec.rolling_wheel.size());
+    for (size_t ii(0); ii < spec.rolling_wheel.size(); ++ii) {
+      jspace::rolling_wheel_s const & wheel(spec.rolling_wheel[ii]);
+      ww.str(wheel.wheel);
+      ww.str(wheel.base);
+      ww.f64(wheel.radius);
+      ww.vec(wheel.direction);
+      ww.u32(wheel.direction_in_base ? 1 : 0);
+    }
+    ww.u32(spec.coupled_joint.size());
+    for (size_t ii(0); ii < spec.coupled_joint.size(); ++ii) {
+      jspace::coupled_joint_s const & coupling(spec.coupled_joint[ii]);
+      ww.str(coupling.master);
+      ww.str(coupling.slave);
+      ww.f64(coupling.ratio);
+    }
+    ww.u32(spec.fixed_contact.size());
+    for (size_t ii(0); ii < spec.fixed_contact.size(); ++ii) {
+      jspace::fixed_contact_s const & contact(spec.fixed_contact[ii]);
+      ww.str(contact.node);
+      ww.vec(contact.point);
+      ww.vec(contact.mask);
+    }
+    ww.u32(spec.floating_base.size());
+    for (size_t ii(0); ii < spec.floating_base.size(); ++ii) {
+      jspace::floating_base_s const & base(spec.floating_base[ii]);
+      for (size_t jj(0); jj < 3; ++jj) {
+	ww.str(base.orientation[jj]);
+      }
+      ww.vec(base.offset);
+      ww.vec(base.sign);
+    }
+  }
+
+
+  // The sizes come from the file, so cap them before resizing
+  // anything: each entry takes at least four bytes.
+  bool read_count(cache_reader & rr, size_t limit, size_t & count)
+  {
+    count = rr.u32();
+    return count <= limit;
+  }
+
+
+  bool read_constraints(cache_reader & rr, size_t limit, jspace::constraint_spec_s & spec)
+  {
+    size_t count;
+    if ( ! read_count(rr, limit, count)) {
+      return false;
+    }
+    spec.rolling_wheel.resize(count);
+    for (size_t ii(0); ii < count; ++ii) {
+      jspace::rolling_wheel_s & wheel(spec.rolling_wheel[ii]);
+      wheel.wheel = rr.str();
+      wheel.base = rr.str();
+      wheel.radius = rr.f64();
+      wheel.direction = rr.vec();
+      wheel.direction_in_base = (0 != rr.u32());
+    }
+    if ( ! read_count(rr, limit, count)) {
+      return false;
+    }
+    spec.coupled_joint.resize(count);
+    for (size_t ii(0); ii < count; ++ii) {
+      jspace::coupled_joint_s & coupling(spec.coupled_joint[ii]);
+      coupling.master = rr.str();
+      coupling.slave = rr.str();
+      coupling.ratio = rr.f64();
+    }
+    if ( ! read_count(rr, limit, count)) {
+      return false;
+    }
+    spec.fixed_contact.resize(count);
+    for (size_t ii(0); ii < count; ++ii) {
+      jspace::fixed_contact_s & contact(spec.fixed_contact[ii]);
+      contact.node = rr.str();
+      contact.point = rr.vec();
+      contact.mask = rr.vec();
+    }
+    if ( ! read_count(rr, limit, count)) {
+      return false;
+    }
+    spec.floating_base.resize(count);
+    for (size_t ii(0); ii < count; ++ii) {
+      jspace::floating_base_s & base(spec.floating_base[ii]);
+      for (size_t jj(0); jj < 3; ++jj) {
+	base.orientation[jj] = rr.str();
+      }
+      base.offset = rr.vec();
+      base.sign = rr.vec();
+    }
+    return rr.ok();
+  }
+
+
+  // taoNode::link() prepends new children to the sibling list, so
+  // we store them in reverse order in order to get the same tree
+  // back when the nodes get created in the order of the records.
+  void collect_nodes(taoDNode * node, std::vector<taoDNode *> & order)
+  {
+    std::vector<taoDNode *> children;
+    for (taoDNode * child(node->getDChild()); 0 != child; child = child->getDSibling()) {
+      children.push_back(child);
+    }
+    for (std::vector<taoDNode *>::reverse_iterator ic(children.rbegin());
+	 ic != children.rend(); ++ic) {
+      order.push_back(*ic);
+      collect_nodes(*ic, order);
+    }
+  }
+
+
+  uint32_t add_name(std::string & names, std::string const & name)
+  {
+    uint32_t const offset(names.size());
+    names.append(name);
+    names.push_back('\0');
+    return offset;
+  }
+
+
+  jspace::Status read_file(std::string const & filename, std::string & contents)
+  {
+    std::ifstream is(filename.c_str(), std::ios::in | std::ios::binary);
+    if ( ! is) {
+      return jspace::Status(false, "could not open " + filename);
+    }
+    std::ostringstream os;
+    os << is.rdbuf();
+    if (is.bad()) {
+      return jspace::Status(false, "error reading " + filename);
+    }
+    contents = os.str();
+    return jspace::Status();
+  }
+
+
+  jspace::Status check_header(std::string const & filename,
+			      std::string const & contents,
+			      cache_header_s & header)
+  {
+    if (contents.size() < sizeof(header)) {
+      return jspace::Status(false, filename + " is too small to be a model cache");
+    }
+    memcpy(&header, contents.data(), sizeof(header));
+    if (0 != memcmp(header.magic, cache_magic, sizeof(cache_magic))) {
+      return jspace::Status(false, filename + " is not a model cache");
+    }
+    if (cache_byte_order != header.byte_order) {
+      return jspace::Status(false, filename + " was written on a machine with another byte order");
+    }
+    if (jspace::model_cache_version != header.version) {
+      std::ostringstream msg;
+      msg << filename << " has format version " << header.version
+	  << " but we need version " << jspace::model_cache_version;
+      return jspace::Status(false, msg.str());
+    }
+    return jspace::Status();
+  }
+
+}
+
+
+namespace jspace {
+
+
+  uint64_t compute_model_hash(std::string const & description)
+  {
+    return fnv1a(description.data(), description.size());
+  }
+
+
+  Status compute_model_file_hash(std::string const & filename, uint64_t & hash)
+  {
+    std::string contents;
+    Status const st(read_file(filename, contents));
+    if ( ! st) {
+      return st;
+    }
+    hash = compute_model_hash(contents);
+    return st;
+  }
+
+
+  Status write_model_cache(std::string const & filename,
+			   uint64_t source_hash,
+			   tao_tree_info_s const & tree,
+			   constraint_spec_s const & constraints)
+  {
+    if ( ! tree.root) {
+      return Status(false, "no root node");
+    }
+
+    std::vector<taoDNode *> order;
+    collect_nodes(tree.root, order);
+    if (order.size() != tree.info.size()) {
+      std::ostringstream msg;
+      msg << "tree has " << order.size() << " nodes but " << tree.info.size() << " info entries";
+      return Status(false, msg.str());
+    }
+
+    std::string names;
+    std::vector<cache_node_s> records(order.size());
+    for (size_t ii(0); ii < order.size(); ++ii) {
+      taoDNode * node(order[ii]);
+      cache_node_s & rec(records[ii]);
+      memset(&rec, 0, sizeof(rec));
+
+      rec.id = node->getID();
+      if ((0 > rec.id) || (tree.info.size() <= static_cast<size_t>(rec.id))
+	  || (tree.info[rec.id].node != node)) {
+	std::ostringstream msg;
+	msg << "node ID " << rec.id << " does not match the tree info (unsorted tree?)";
+	return Status(false, msg.str());
+      }
+      tao_node_info_s const & info(tree.info[rec.id]);
+      rec.parent_id = node->getDParent()->getID();
+
+      taoJoint * joint(node->getJointList());
+      if (( ! joint) || (0 != joint->getNext())) {
+	std::ostringstream msg;
+	msg << "node ID " << rec.id << " does not have exactly one joint";
+	return Status(false, msg.str());
+      }
+      if (dynamic_cast<taoJointPrismatic *>(joint)) {
+	rec.joint_type = 'p';
+	rec.joint_axis = dynamic_cast<taoJointDOF1 *>(joint)->getAxis();
+      }
+      else if (dynamic_cast<taoJointRevolute *>(joint)) {
+	rec.joint_type = 'r';
+	rec.joint_axis = dynamic_cast<taoJointDOF1 *>(joint)->getAxis();
+      }
+      else if (dynamic_cast<taoJointSpherical *>(joint)) {
+	rec.joint_type = 's';
+	rec.joint_axis = TAO_AXIS_S;
+      }
+      else {
+	std::ostringstream msg;
+	msg << "node ID " << rec.id << " has an unsupported joint type";
+	return Status(false, msg.str());
+      }
+      rec.damping = joint->getDamping();
+      rec.joint_inertia = joint->getInertia();
+
+      rec.is_constrained = *node->isConstrained();
+      rec.link_name = add_name(names, info.link_name);
+      rec.joint_name = add_name(names, info.joint_name);
+
+      deFrame const * home(node->frameHome());
+      for (size_t jj(0); jj < 3; ++jj) {
+	rec.home_translation[jj] = home->translation()[jj];
+      }
+      for (size_t jj(0); jj < 4; ++jj) {
+	rec.home_rotation[jj] = home->rotation()[jj];
+      }
+      rec.mass = *node->mass();
+      for (size_t jj(0); jj < 3; ++jj) {
+	rec.center[jj] = (*node->center())[jj];
+	for (size_t kk(0); kk < 3; ++kk) {
+	  rec.inertia[3 * jj + kk] = node->inertia()->elementAt(jj, kk);
+	}
+      }
+      rec.rotor_inertia = *node->rotorInertia();
+      rec.gear_ratio = *node->gearRatio();
+      rec.limit_lower = info.limit_lower;
+      rec.limit_upper = info.limit_upper;
+    }
+    pad8(names);
+
+    cache_writer constraint_writer;
+    write_constraints(constraint_writer, constraints);
+    uint32_t const constraints_size(constraint_writer.buf.size());
+    pad8(constraint_writer.buf);
+
+    std::string body;
+    if ( ! records.empty()) {
+      body.append(reinterpret_cast<char const *>(&records[0]), records.size() * sizeof(cache_node_s));
+    }
+    body.append(names);
+    body.append(constraint_writer.buf);
+
+    cache_header_s header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = model_cache_version;
+    header.byte_order = cache_byte_order;
+    header.source_hash = source_hash;
+    header.checksum = fnv1a(body.data(), body.size());
+    header.node_count = records.size();
+    header.names_size = names.size();
+    header.constraints_size = constraints_size;
+    deFrame const * root_frame(tree.root->frameHome());
+    for (size_t jj(0); jj < 3; ++jj) {
+      header.root_translation[jj] = root_frame->translation()[jj];
+    }
+    for (size_t jj(0); jj < 4; ++jj) {
+      header.root_rotation[jj] = root_frame->rotation()[jj];
+    }
+
+    // Write to a temporary file and rename it, so that a concurrent
+    // reader never sees a half-written cache.
+    std::string const tmpname(filename + ".tmp");
+    {
+      std::ofstream os(tmpname.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+      if ( ! os) {
+	return Status(false, "could not open " + tmpname + " for writing");
+      }
+      os.write(reinterpret_cast<char const *>(&header), sizeof(header));
+      os.write(body.data(), body.size());
+      if ( ! os) {
+	return Status(false, "error writing " + tmpname);
+      }
+    }
+    if (0 != rename(tmpname.c_str(), filename.c_str())) {
+      remove(tmpname.c_str());
+      return Status(false, "could not rename " + tmpname + " to " + filename);
+    }
+
+    return Status();
+  }
+
+
+  Status read_model_cache_hash(std::string const & filename,
+			       uint64_t & source_hash)
+  {
+    std::ifstream is(filename.c_str(), std::ios::in | std::ios::binary);
+    if ( ! is) {
+      return Status(false, "could not open " + filename);
+    }
+    std::string contents(sizeof(cache_header_s), '\0');
+    is.read(&contents[0], contents.size());
+    contents.resize(is.gcount());
+    cache_header_s header;
+    Status const st(check_header(filename, contents, header));
+    if (st) {
+      source_hash = header.source_hash;
+    }
+    return st;
+  }
+
+
+  Status read_model_cache(std::string const & filename,
+			  uint64_t expected_hash,
+			  tao_tree_info_s ** tree,
+			  constraint_spec_s & constraints)
+  {
+    std::string contents;
+    Status st(read_file(filename, contents));
+    if ( ! st) {
+      return st;
+    }
+    cache_header_s header;
+    st = check_header(filename, contents, header);
+    if ( ! st) {
+      return st;
+    }
+    if ((0 != expected_hash) && (expected_hash != header.source_hash)) {
+      return Status(false, filename + " is stale (source hash mismatch)");
+    }
+
+    size_t const body_size(contents.size() - sizeof(header));
+    size_t const records_size(header.node_count * sizeof(cache_node_s));
+    if ((header.node_count > body_size / sizeof(cache_node_s))
+	|| (body_size != records_size + header.names_size + (header.constraints_size + 7) / 8 * 8)) {
+      return Status(false, filename + " is truncated or has inconsistent section sizes");
+    }
+    char const * body(contents.data() + sizeof(header));
+    if (header.checksum != fnv1a(body, body_size)) {
+      return Status(false, filename + " is corrupt (checksum mismatch)");
+    }
+    char const * names(body + records_size);
+    if ((0 < header.names_size) && ('\0' != names[header.names_size - 1])) {
+      return Status(false, filename + " has an unterminated name table");
+    }
+
+    constraint_spec_s spec;
+    char const * cbegin(names + header.names_size);
+    cache_reader rr(cbegin, cbegin + header.constraints_size);
+    if ( ! read_constraints(rr, header.constraints_size / 4, spec)) {
+      return Status(false, filename + " has an invalid constraint section");
+    }
+
+    deFrame root_frame;
+    root_frame.translation().set(header.root_translation[0],
+				 header.root_translation[1],
+				 header.root_translation[2]);
+    root_frame.rotation().set(header.root_rotation[0], header.root_rotation[1],
+			      header.root_rotation[2], header.root_rotation[3]);
+    taoNodeRoot * root(new taoNodeRoot(root_frame));
+    root->setIsFixed(1);
+    root->setID(-1);
+
+    tao_tree_info_s * info(new tao_tree_info_s());
+    info->root = root;
+    info->info.resize(header.node_count);
+
+    for (size_t ii(0); ii < header.node_count; ++ii) {
+      cache_node_s rec;
+      memcpy(&rec, body + ii * sizeof(rec), sizeof(rec));
+
+      std::ostringstream msg;
+      taoDNode * parent(0);
+      if ((0 > rec.id) || (header.node_count <= static_cast<uint32_t>(rec.id))
+	  || (0 != info->info[rec.id].node)) {
+	msg << "invalid or duplicate node ID " << rec.id;
+      }
+      else if (-1 == rec.parent_id) {
+	parent = root;
+      }
+      else if ((0 > rec.parent_id) || (header.node_count <= static_cast<uint32_t>(rec.parent_id))
+	       || (0 == info->info[rec.parent_id].node)) {
+	msg << "node ID " << rec.id << " has invalid parent ID " << rec.parent_id;
+      }
+      else {
+	parent = info->info[rec.parent_id].node;
+      }
+      if ((rec.link_name >= header.names_size) || (rec.joint_name >= header.names_size)) {
+	msg << "node ID " << rec.id << " has invalid name offsets";
+      }
+
+      taoJoint * joint(0);
+      if (msg.str().empty()) {
+	if ((0 > rec.joint_axis) || (TAO_AXIS_Z < rec.joint_axis)) {
+	  rec.joint_axis = TAO_AXIS_Z; // only matters for 1-DOF joints, checked below
+	  if ('s' != rec.joint_type) {
+	    msg << "node ID " << rec.id << " has an invalid joint axis";
+	  }
+	}
+	switch (rec.joint_type) {
+	case 'p':
+	  joint = new taoJointPrismatic(static_cast<taoAxis>(rec.joint_axis));
+	  joint->setDVar(new taoVarDOF1);
+	  break;
+	case 'r':
+	  joint = new taoJointRevolute(static_cast<taoAxis>(rec.joint_axis));
+	  joint->setDVar(new taoVarDOF1);
+	  break;
+	case 's':
+	  joint = new taoJointSpherical();
+	  joint->setDVar(new taoVarSpherical);
+	  break;
+	default:
+	  msg << "node ID " << rec.id << " has invalid joint type " << rec.joint_type;
+	}
+      }
+
+      if ( ! msg.str().empty()) {
+	// The nodes created so far are linked into the tree, so
+	// deleting the info (which deletes the root) frees them.
+	delete joint;
+	delete info;
+	return Status(false, filename + ": " + msg.str());
+      }
+
+      deFrame home;
+      home.translation().set(rec.home_translation[0], rec.home_translation[1], rec.home_translation[2]);
+      home.rotation().set(rec.home_rotation[0], rec.home_rotation[1],
+			  rec.home_rotation[2], rec.home_rotation[3]);
+      taoNode * node(new taoNode(parent, &home));
+
+      *node->mass() = rec.mass;
+      for (size_t jj(0); jj < 3; ++jj) {
+	(*node->center())[jj] = rec.center[jj];
+	for (size_t kk(0); kk < 3; ++kk) {
+	  node->inertia()->elementAt(jj, kk) = rec.inertia[3 * jj + kk];
+	}
+      }
+      node->setID(rec.id);
+      *node->rotorInertia() = rec.rotor_inertia;
+      *node->gearRatio() = rec.gear_ratio;
+      *node->isConstrained() = rec.is_constrained;
+
+      joint->reset();
+      joint->setDamping(rec.damping);
+      joint->setInertia(rec.joint_inertia);
+      node->addJoint(joint);
+      node->addABNode();
+
+      tao_node_info_s & entry(info->info[rec.id]);
+      entry.id = rec.id;
+      entry.node = node;
+      entry.joint = joint;
+      entry.link_name = names + rec.link_name;
+      entry.joint_name = names + rec.joint_name;
+      entry.limit_lower = rec.limit_lower;
+      entry.limit_upper = rec.limit_upper;
+    }
+
+    taoDynamics::initialize(root);
+
+    *tree = info;
+    constraints = spec;
+    return Status();
+  }
+
+}
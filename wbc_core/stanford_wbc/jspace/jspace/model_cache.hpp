@@ -0,0 +1,108 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef JSPACE_MODEL_CACHE_HPP
+#define JSPACE_MODEL_CACHE_HPP
+
+#include <jspace/Status.hpp>
+#include <stdint.h>
+#include <string>
+
+namespace jspace {
+
+  struct tao_tree_info_s;
+  struct constraint_spec_s;
+
+
+  /**
+     Version of the binary model cache format. Caches written with a
+     different version are treated as stale.
+  */
+  static uint32_t const model_cache_version(1);
+
+
+  /**
+     Hash of a robot description (e.g. the contents of a SAI XML file
+     or the URDF string from the parameter server), stored in the
+     model cache so that a loader can tell whether the cache is still
+     up to date. This is 64-bit FNV-1a, which is plenty to detect an
+     edited file but obviously not a cryptographic hash.
+  */
+  uint64_t compute_model_hash(std::string const & description);
+
+  /** Convenience wrapper which reads the given file and hashes its
+      contents with compute_model_hash(). */
+  Status compute_model_file_hash(std::string const & filename, uint64_t & hash);
+
+
+  /**
+     Write a TAO tree, along with its names, joint limits, and
+     constraint specification, to a binary model cache.
+
+     The file starts with a fixed-size header (magic, version, byte
+     order marker, the source hash, and a checksum of the rest),
+     followed by one fixed-size record per node, a table of node
+     names, and the serialized constraint specification. The node
+     records are laid out such that each parent precedes its
+     children, and they carry everything that the SAI XML parser
+     would otherwise have to compute (the mass properties as stored
+     inside TAO, the home frames, joint types and axes, and the
+     parent of each node). All records are 8-byte aligned, so the
+     file can also be mapped into memory as-is.
+
+     The tree must have passed Model::init() or at least
+     tao_tree_info_s::sort(), i.e. each node ID must correspond to its
+     index in the info vector.
+  */
+  Status write_model_cache(std::string const & filename,
+			   uint64_t source_hash,
+			   tao_tree_info_s const & tree,
+			   constraint_spec_s const & constraints);
+
+
+  /**
+     Read only the header of a model cache, for checking whether it is
+     stale. Fails if the file does not exist, is not a model cache,
+     or was written with another format version or byte order.
+  */
+  Status read_model_cache_hash(std::string const & filename,
+			       uint64_t & source_hash);
+
+
+  /**
+     Recreate the TAO tree and constraint specification that were
+     written with write_model_cache(). The tree is ready to be passed
+     to Model::init(), and the caller takes ownership of it.
+
+     If expected_hash is non-zero, the cache is rejected (without
+     creating anything) unless it was written for that source hash.
+     Pass zero to accept the cache regardless of its source.
+  */
+  Status read_model_cache(std::string const & filename,
+			  uint64_t expected_hash,
+			  tao_tree_info_s ** tree,
+			  constraint_spec_s & constraints);
+
+}
+
+#endif // JSPACE_MODEL_CACHE_HPP
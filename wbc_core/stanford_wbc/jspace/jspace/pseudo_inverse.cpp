@@ -29,21 +29,24 @@
 
 using namespace std;
 
-namespace jspace {
-
-  void pseudoInverse(Matrix const & matrix,
-		     double sigmaThreshold,
-		     Matrix & invMatrix,
-		     Vector * opt_sigmaOut)
+namespace {
+  
+  // Shared by the double and float overloads.
+  
+  template<typename MatrixT, typename VectorT, typename Scalar>
+  void pseudo_inverse_impl(MatrixT const & matrix,
+			   Scalar sigmaThreshold,
+			   MatrixT & invMatrix,
+			   VectorT * opt_sigmaOut)
   {
     if ((1 == matrix.rows()) && (1 == matrix.cols())) {
       // workaround for Eigen2
       invMatrix.resize(1, 1);
       if (matrix.coeff(0, 0) > sigmaThreshold) {
-	invMatrix.coeffRef(0, 0) = 1.0 / matrix.coeff(0, 0);
+	invMatrix.coeffRef(0, 0) = Scalar(1) / matrix.coeff(0, 0);
       }
       else {
-	invMatrix.coeffRef(0, 0) = 0.0;
+	invMatrix.coeffRef(0, 0) = Scalar(0);
       }
       if (opt_sigmaOut) {
 	opt_sigmaOut->resize(1);
@@ -52,14 +55,14 @@ namespace jspace {
       return;
     }
     
-    Eigen::SVD<Matrix> svd(matrix);
+    Eigen::SVD<MatrixT> svd(matrix);
     // not sure if we need to svd.sort()... probably not
     int const nrows(svd.singularValues().rows());
-    Matrix invS;
-    invS = Matrix::Zero(nrows, nrows);
+    MatrixT invS;
+    invS = MatrixT::Zero(nrows, nrows);
     for (int ii(0); ii < nrows; ++ii) {
       if (svd.singularValues().coeff(ii) > sigmaThreshold) {
-	invS.coeffRef(ii, ii) = 1.0 / svd.singularValues().coeff(ii);
+	invS.coeffRef(ii, ii) = Scalar(1) / svd.singularValues().coeff(ii);
       }
     }
     invMatrix = svd.matrixU() * invS * svd.matrixU().transpose();
@@ -68,4 +71,58 @@ namespace jspace {
     }
   }
   
+  
+  template<typename MatrixT>
+  void update_nullspace_impl(MatrixT const & phijt,
+			     MatrixT const & lstar,
+			     MatrixT const & jstar,
+			     MatrixT & nstar)
+  {
+    // k-by-n, then k-by-n again, so nothing here is n-by-n except
+    // the final outer product which gets accumulated in place
+    MatrixT const jn(jstar * nstar);
+    MatrixT const ljn(lstar * jn);
+    nstar -= phijt * ljn;
+  }
+  
+}
+
+
+namespace jspace {
+
+  void pseudoInverse(Matrix const & matrix,
+		     double sigmaThreshold,
+		     Matrix & invMatrix,
+		     Vector * opt_sigmaOut)
+  {
+    pseudo_inverse_impl(matrix, sigmaThreshold, invMatrix, opt_sigmaOut);
+  }
+  
+  
+  void pseudoInverse(MatrixF const & matrix,
+		     float sigmaThreshold,
+		     MatrixF & invMatrix,
+		     VectorF * opt_sigmaOut)
+  {
+    pseudo_inverse_impl(matrix, sigmaThreshold, invMatrix, opt_sigmaOut);
+  }
+  
+  
+  void updateNullspace(Matrix const & phijt,
+		       Matrix const & lstar,
+		       Matrix const & jstar,
+		       Matrix & nstar)
+  {
+    update_nullspace_impl(phijt, lstar, jstar, nstar);
+  }
+  
+  
+  void updateNullspace(MatrixF const & phijt,
+		       MatrixF const & lstar,
+		       MatrixF const & jstar,
+		       MatrixF & nstar)
+  {
+    update_nullspace_impl(phijt, lstar, jstar, nstar);
+  }
+  
 }
@@ -44,6 +44,45 @@ namespace jspace {
 		     Matrix & invMatrix,
 		     Vector * opt_sigmaOut = 0);
   
+  /** Single precision version of pseudoInverse(). */
+  void pseudoInverse(MatrixF const & matrix,
+		     float sigmaThreshold,
+		     MatrixF & invMatrix,
+		     VectorF * opt_sigmaOut = 0);
+  
+  /**
+     Project a dynamically consistent nullspace past one more task
+     of a hierarchy, i.e. compute
+
+     \verbatim
+     nstar <- (I - phijt * lstar * jstar) * nstar
+     \endverbatim
+
+     where phijt is phi * jstar^T (usually the caller needs that
+     product anyway, so it gets passed in instead of phi). The dense
+     version of this costs a couple of n-by-n products, whereas
+     jstar has only as many rows as the task has dimensions. So this
+     is evaluated as the rank-k update
+
+     \verbatim
+     nstar -= phijt * (lstar * (jstar * nstar))
+     \endverbatim
+
+     which costs O(k*n^2) instead of O(n^3) for a task of dimension
+     k. The result is the same as the dense expression up to
+     round-off.
+  */
+  void updateNullspace(Matrix const & phijt,
+		       Matrix const & lstar,
+		       Matrix const & jstar,
+		       Matrix & nstar);
+  
+  /** Single precision version of updateNullspace(). */
+  void updateNullspace(MatrixF const & phijt,
+		       MatrixF const & lstar,
+		       MatrixF const & jstar,
+		       MatrixF & nstar);
+  
 }
 
 #endif // JSPACE_PSEUDO_INVERSE_HPP
@@ -28,6 +28,7 @@
 
 #include <jspace/tao_util.hpp>
 #include <jspace/wrap_eigen.hpp>
+#include <jspace/constraint_library.hpp>
 #include <tao/matrix/TaoDeMath.h>	
 #include <map>
 #include <string>
@@ -54,6 +55,10 @@ namespace jspace {
 	  should try to work with a jspace::tao_tree_info_s in the first
 	  place... */
       jspace::tao_tree_info_s * createTreeInfo();
+      
+      /** The optional <constraints> section of the XML file. Empty
+	  if there was none. */
+      jspace::constraint_spec_s const & getConstraintSpec() const { return constraintSpec_; }
     
     private:
       taoNodeRoot* rootNode_; 
@@ -68,6 +73,7 @@ namespace jspace {
       jspace::Vector defaultJointPosVec_;
       jspace::Vector upperJointLimitVec_;
       jspace::Vector lowerJointLimitVec_;
+      jspace::constraint_spec_s constraintSpec_;
       
       taoDNode* findNodeID( taoDNode*, int);
     };
@@ -26,7 +26,9 @@
 #include "sai_brep_parser.hpp"
 #include "sai_brep.hpp"
 #include <tao/dynamics/tao.h>
-#include <wbc_tinyxml/wbc_tinyxml.h>
+#include <wbc_tinyxml/wbc_tinyxmlinsitu.h>
+#include <sstream>
+#include <stdlib.h>
 
 using namespace wbc_tinyxml;
 using namespace std;
@@ -39,13 +41,14 @@ namespace jspace {
     parse(string const & fileName)
       throw(std::runtime_error)
     {
-      TiXmlDocument doc;
-      doc.LoadFile(fileName.c_str());
-      if (doc.Error())
+      // The in-situ document maps the file and parses it in place,
+      // which avoids the per-node string copies of TiXmlDocument.
+      TiXmlInSituDocument doc;
+      if ( ! doc.LoadFile(fileName.c_str()))
 	throw runtime_error("jspace::test::BRParser::parse(" + fileName
 			    + "): tinyxml error: " + doc.ErrorDesc());
     
-      TiXmlElement* rootElement = doc.RootElement();
+      TiXmlInSituNode* rootElement = doc.RootElement();
       string tag = rootElement->Value();
       if ("dynworld" != tag)
 	throw runtime_error("jspace::test::BRParser::parse(" + fileName
@@ -58,17 +61,166 @@ namespace jspace {
       lowerJointLimitMap_.clear();
       exploreRobot(rootElement->FirstChildElement());
       
+      TiXmlInSituNode * constraints(rootElement->FirstChildElement("constraints"));
+      if (constraints) {
+	try {
+	  exploreConstraints(constraints);
+	}
+	catch (std::runtime_error const & ee) {
+	  delete robot_;
+	  throw runtime_error("jspace::test::BRParser::parse(" + fileName + "): " + ee.what());
+	}
+      }
+      
       return robot_;
     }
+    
+    
+    static string child_text(TiXmlInSituNode * parent, char const * tag, bool required)
+      throw(std::runtime_error)
+    {
+      TiXmlInSituNode * element(parent->FirstChildElement(tag));
+      if (( ! element) || ( ! element->GetText())) {
+	if (required) {
+	  throw runtime_error(string("<") + parent->Value() + "> requires <" + tag + ">");
+	}
+	return "";
+      }
+      string text(element->GetText());
+      size_t const begin(text.find_first_not_of(" \t\n"));
+      if (string::npos == begin) {
+	return "";
+      }
+      return text.substr(begin, text.find_last_not_of(" \t\n") - begin + 1);
+    }
+    
+    
+    // Text of a leaf element like <mass> or <pos>, empty if there is
+    // none. Points into the document, so there is no copy.
+    static char const * node_text(TiXmlInSituNode const * element)
+    {
+      char const * text(element->GetText());
+      return text ? text : "";
+    }
+    
+    
+    static double parse_double(string const & text)
+      throw(std::runtime_error)
+    {
+      double value;
+      if (1 != sscanf(text.c_str(), "%lf", &value)) {
+	throw runtime_error("invalid number `" + text + "'");
+      }
+      return value;
+    }
+    
+    
+    // comma separated, like the <pos> and <gravity> tags
+    static jspace::Vector parse_vector(string const & text)
+    {
+      vector<double> values;
+      char const * token(text.c_str());
+      for (;;) {
+	char * end;
+	double const value(strtod(token, &end));
+	if (end != token) {
+	  values.push_back(value);
+	}
+	token = strchr(end, ',');
+	if ( ! token) {
+	  break;
+	}
+	++token;
+      }
+      jspace::Vector vv(values.size());
+      for (size_t ii(0); ii < values.size(); ++ii) {
+	vv[ii] = values[ii];
+      }
+      return vv;
+    }
+    
+    
+    void BRParser::
+    exploreConstraints(TiXmlInSituNode * constraints)
+      throw(std::runtime_error)
+    {
+      jspace::constraint_spec_s & spec(robot_->constraintSpec_);
+      
+      for (TiXmlInSituNode * element(constraints->FirstChildElement());
+	   0 != element; element = element->NextSiblingElement()) {
+	string const tag(element->Value());
+	
+	if ("rollingWheel" == tag) {
+	  jspace::rolling_wheel_s wheel;
+	  wheel.wheel = child_text(element, "wheel", true);
+	  wheel.base = child_text(element, "base", true);
+	  wheel.radius = parse_double(child_text(element, "radius", true));
+	  wheel.direction = parse_vector(child_text(element, "direction", true));
+	  string const frame(child_text(element, "directionFrame", false));
+	  if (frame.empty() || ("wheel" == frame)) {
+	    wheel.direction_in_base = false;
+	  }
+	  else if ("base" == frame) {
+	    wheel.direction_in_base = true;
+	  }
+	  else {
+	    throw runtime_error("invalid <directionFrame> `" + frame + "' (should be wheel or base)");
+	  }
+	  spec.rolling_wheel.push_back(wheel);
+	}
+	
+	else if ("coupledJoint" == tag) {
+	  jspace::coupled_joint_s coupling;
+	  coupling.master = child_text(element, "master", true);
+	  coupling.slave = child_text(element, "slave", true);
+	  string const ratio(child_text(element, "ratio", false));
+	  coupling.ratio = ratio.empty() ? 1.0 : parse_double(ratio);
+	  spec.coupled_joint.push_back(coupling);
+	}
+	
+	else if ("fixedContact" == tag) {
+	  jspace::fixed_contact_s contact;
+	  contact.node = child_text(element, "node", true);
+	  string const point(child_text(element, "point", false));
+	  contact.point = point.empty() ? jspace::Vector(jspace::Vector::Zero(3)) : parse_vector(point);
+	  string const mask(child_text(element, "mask", false));
+	  contact.mask = mask.empty() ? jspace::Vector(jspace::Vector::Ones(6)) : parse_vector(mask);
+	  spec.fixed_contact.push_back(contact);
+	}
+	
+	else if ("floatingBase" == tag) {
+	  jspace::floating_base_s base;
+	  istringstream is(child_text(element, "orientation", true));
+	  for (size_t ii(0); ii < 3; ++ii) {
+	    string name;
+	    if ( ! getline(is, name, ',')) {
+	      throw runtime_error("<orientation> requires three comma-separated joint names");
+	    }
+	    size_t const begin(name.find_first_not_of(" \t\n"));
+	    if (string::npos == begin) {
+	      throw runtime_error("<orientation> contains an empty joint name");
+	    }
+	    base.orientation[ii] = name.substr(begin, name.find_last_not_of(" \t\n") - begin + 1);
+	  }
+	  base.offset = parse_vector(child_text(element, "offset", false));
+	  base.sign = parse_vector(child_text(element, "sign", false));
+	  spec.floating_base.push_back(base);
+	}
+	
+	else {
+	  throw runtime_error("invalid constraint <" + tag + ">");
+	}
+      }
+    }
   
   
     void BRParser::
-    exploreRobot(TiXmlElement * element)
+    exploreRobot(TiXmlInSituNode * element)
     {
       // get the value associated to the element
-      string tag = element->Value();
+      char const * tag = element->Value();
 
-      if( strcmp(tag.c_str(), "baseNode") == 0 ) {
+      if( strcmp(tag, "baseNode") == 0 ) {
 
 	// Explores root node
 	exploreJointNode(element);
@@ -82,7 +234,7 @@ namespace jspace {
 	robot_->rootNode_->setID( (deInt) -1 );
       
 	// Get the first joint node
-	TiXmlElement* nextJNPtr = getChildJointNode( element->FirstChildElement() );
+	TiXmlInSituNode* nextJNPtr = getChildJointNode( element->FirstChildElement() );
 
 	// Create recursively all tao nodes (Depth First Search)
 	DFS_JointNodes( nextJNPtr, nodeID_ );
@@ -107,7 +259,7 @@ namespace jspace {
   
   
     void BRParser::
-    DFS_JointNodes(TiXmlElement * jointNodePtr, int parentNodeID)
+    DFS_JointNodes(TiXmlInSituNode * jointNodePtr, int parentNodeID)
       throw(std::runtime_error)
     {
       // XXXX to do: verify that some minimum amount of values have been
@@ -121,7 +273,7 @@ namespace jspace {
 			rotorInertia_, gearRatio_, isConstrained_);
 
       // Get joint node child
-      TiXmlElement* childJNPtr = getChildJointNode( jointNodePtr->FirstChildElement() );
+      TiXmlInSituNode* childJNPtr = getChildJointNode( jointNodePtr->FirstChildElement() );
 
       // Scan children
       if ( childJNPtr ) {
@@ -141,11 +293,11 @@ namespace jspace {
   
   
     void BRParser::
-    exploreJointNode(TiXmlElement * element)
+    exploreJointNode(TiXmlInSituNode * element)
       throw(std::runtime_error)
     {
       element = element->FirstChildElement();
-      string tag = element->Value();
+      char const * tag = element->Value();
       double x,y,z;
       double val;
       int intVal;
@@ -154,16 +306,19 @@ namespace jspace {
       homeF_.translation().zero();
       homeF_.rotation().identity();
       com_.zero();
+      rotorInertia_ = 0;
+      gearRatio_ = 0;
+      isConstrained_ = 0;
 
-      while ( element && strcmp( tag.c_str(), "jointNode" ) != 0 ) {
+      while ( element && strcmp( tag, "jointNode" ) != 0 ) {
 
 	// found tag /robotName
-	if( strcmp( tag.c_str(), "robotName" ) == 0 )
-	  robotName_ = element->FirstChild()->Value();
+	if( strcmp( tag, "robotName" ) == 0 )
+	  robotName_ = node_text(element);
     
 	// FOUND TAG "gravity":
-	if ( strcmp( tag.c_str(), "gravity" ) == 0 ) {
-	  const char* str = element->FirstChild()->Value();
+	if ( strcmp( tag, "gravity" ) == 0 ) {
+	  const char* str = node_text(element);
 	  sscanf(str, "%lf,%lf,%lf",&x,&y,&z);
 	  robot_->grav_[0] = x;
 	  robot_->grav_[1] = y;
@@ -171,58 +326,58 @@ namespace jspace {
 	}
 
 	// FOUND TAG "/JOINTNAME":
-	if ( strcmp( tag.c_str(), "jointName") == 0 )
+	if ( strcmp( tag, "jointName") == 0 )
 	  {
-	    jointName_ = element->FirstChild()->Value();
+	    jointName_ = node_text(element);
 	    jointIsFree_ = false;
 	    if( jointName_.find("free",0) != std::string::npos ) jointIsFree_ = true;
 	  }
 
 	// FOUND TAG "/LINKNAME":
-	else if ( strcmp( tag.c_str(), "linkName") == 0 )
+	else if ( strcmp( tag, "linkName") == 0 )
 	  {
-	    linkName_ = element->FirstChild()->Value();
+	    linkName_ = node_text(element);
 	  }
     
 	// FOUND TAG "ID":
-	if ( strcmp( tag.c_str(), "ID" ) == 0 ) {
-	  const char* str = element->FirstChild()->Value();
+	if ( strcmp( tag, "ID" ) == 0 ) {
+	  const char* str = node_text(element);
 	  sscanf(str, "%d",&nodeID_);
 	}
 
 	// FOUND TAG "pos":
-	if ( strcmp( tag.c_str(), "pos" ) == 0 ) {
-	  const char* str = element->FirstChild()->Value();
+	if ( strcmp( tag, "pos" ) == 0 ) {
+	  const char* str = node_text(element);
 	  sscanf(str, "%lf,%lf,%lf",&x,&y,&z);
 	  homeF_.translation().set((deFloat)x, (deFloat)y, (deFloat)z);
 	}
 
 	// Found tag "defaultJointPosition":
-	if ( strcmp( tag.c_str(), "defaultJointPosition" ) == 0 ) {
-	  const char* str = element->FirstChild()->Value();
+	if ( strcmp( tag, "defaultJointPosition" ) == 0 ) {
+	  const char* str = node_text(element);
 	  float blah;		// more robust wrt Float being double or float
 	  sscanf(str, "%f", &blah);	// no one ever checks retvals, do they???
 	  defaultJointPos_ = blah;
 	}
 	// Found tag "upperJointLimit":
-	if ( strcmp( tag.c_str(), "upperJointLimit" ) == 0 ) {
-	  const char* str = element->FirstChild()->Value();
+	if ( strcmp( tag, "upperJointLimit" ) == 0 ) {
+	  const char* str = node_text(element);
 	  float blah;		// more robust wrt Float being double or float
 	  sscanf(str, "%f", &blah);	// no one ever checks retvals, do they???
 	  upperJointLimit_ = blah;
 	}
 
 	// Found tag "lowerJointLimit":
-	if ( strcmp( tag.c_str(), "lowerJointLimit" ) == 0 ) {
-	  const char* str = element->FirstChild()->Value();
+	if ( strcmp( tag, "lowerJointLimit" ) == 0 ) {
+	  const char* str = node_text(element);
 	  float blah;		// more robust wrt Float being double or float
 	  sscanf(str, "%f", &blah);	// no one ever checks retvals, do they???
 	  lowerJointLimit_ = blah;
 	}
 
 	// FOUND TAG "rot":
-	else if ( strcmp( tag.c_str(), "rot" ) == 0 ) {
-	  const char* str = element->FirstChild()->Value();
+	else if ( strcmp( tag, "rot" ) == 0 ) {
+	  const char* str = node_text(element);
 	  sscanf(str, "%lf,%lf,%lf,%lf",&x,&y,&z,&val);
 	  rotAxis_.set((deFloat)x,(deFloat)y,(deFloat)z);
 	  rotAngle_ = (deFloat)val;
@@ -230,16 +385,16 @@ namespace jspace {
 	}
 
 	// FOUND TAG "opID":
-	else if ( strcmp( tag.c_str(), "opID" ) == 0 ) {
+	else if ( strcmp( tag, "opID" ) == 0 ) {
 	  int opID(0);
-	  const char* str = element->FirstChild()->Value();
+	  const char* str = node_text(element);
 	  sscanf(str, "%d",&opID);
 	  opID_ = opID;
 	}
 
 	// FOUND TAG "type":
-	else if ( strcmp( tag.c_str(), "type" ) == 0 ) {
-	  string const typeJoint(element->FirstChild()->Value());
+	else if ( strcmp( tag, "type" ) == 0 ) {
+	  string const typeJoint(node_text(element));
 	  switch (typeJoint[0]) {
 	  case 'p': case 'P': type_ = 'p'; break;
 	  case 'r': case 'R': type_ = 'r'; break;
@@ -251,8 +406,8 @@ namespace jspace {
 	}
 
 	// FOUND TAG "axis":
-	else if ( strcmp( tag.c_str(), "axis" ) == 0 ) {
-	  string const typeAxis(element->FirstChild()->Value());
+	else if ( strcmp( tag, "axis" ) == 0 ) {
+	  string const typeAxis(node_text(element));
 	  switch (typeAxis[0]) {
 	  case 'x': case 'X': axis_ = 'x'; break;
 	  case 'y': case 'Y': axis_ = 'y'; break;
@@ -264,44 +419,44 @@ namespace jspace {
 	}
       
 	// FOUND TAG "mass":
-	else if ( strcmp( tag.c_str(), "mass" ) == 0 ) {
-	  const char* str = element->FirstChild()->Value();
+	else if ( strcmp( tag, "mass" ) == 0 ) {
+	  const char* str = node_text(element);
 	  sscanf(str, "%lf",&val);
 	  mass_ = (deFloat)val;
 	  robot_->totalMass_ += mass_;
 	}
 
 	// FOUND TAG "inertia":
-	else if ( strcmp( tag.c_str(), "inertia" ) ==  0 ) {
-	  const char* str = element->FirstChild()->Value();
+	else if ( strcmp( tag, "inertia" ) ==  0 ) {
+	  const char* str = node_text(element);
 	  sscanf(str, "%lf,%lf,%lf",&x,&y,&z);
 	  inertia_.set((deFloat)x,(deFloat)y,(deFloat)z);
 	}
 
 	// FOUND TAG "com":
-	else if ( strcmp( tag.c_str(), "com" ) == 0 )  {
-	  const char* str = element->FirstChild()->Value();
+	else if ( strcmp( tag, "com" ) == 0 )  {
+	  const char* str = node_text(element);
 	  sscanf(str, "%lf,%lf,%lf",&x,&y,&z);
 	  com_.set((deFloat)x,(deFloat)y,(deFloat)z);
 	}
 
 	// FOUND TAG "rotorInertia":
-	else if ( strcmp( tag.c_str(), "rotorInertia" ) == 0 )  {
-	  const char* str = element->FirstChild()->Value();
+	else if ( strcmp( tag, "rotorInertia" ) == 0 )  {
+	  const char* str = node_text(element);
 	  sscanf(str, "%lf",&val);
 	  rotorInertia_ = (deFloat)val;
 	}
 
 	// FOUND TAG "gearRatio":
-	else if ( strcmp( tag.c_str(), "gearRatio" ) == 0 )  {
-	  const char* str = element->FirstChild()->Value();
+	else if ( strcmp( tag, "gearRatio" ) == 0 )  {
+	  const char* str = node_text(element);
 	  sscanf(str, "%lf",&val);
 	  gearRatio_ = (deFloat)val;
 	}
 
 	// FOUND TAG "constrained":
-	else if ( strcmp( tag.c_str(), "constrained" ) == 0 )  {
-	  const char* str = element->FirstChild()->Value();
+	else if ( strcmp( tag, "constrained" ) == 0 )  {
+	  const char* str = node_text(element);
 	  sscanf(str, "%d",&intVal);
 	  isConstrained_ = (deInt)intVal;
 	}
@@ -320,23 +475,19 @@ namespace jspace {
     }
 
 
-    TiXmlElement * BRParser::
-    getChildJointNode(TiXmlElement * element)
+    TiXmlInSituNode * BRParser::
+    getChildJointNode(TiXmlInSituNode * element)
     {
       // get the value the element
-      string tag = element->Value();
-
-      // get the value associated to its child
-      string str = element->FirstChild()->Value();
+      char const * tag = element->Value();
 
-      while ( element && strcmp( tag.c_str(), "jointNode" ) != 0 ) {
+      while ( element && strcmp( tag, "jointNode" ) != 0 ) {
 
 	// Move to the next chidren
 	element = element->NextSiblingElement();
 
 	if (element) {
-	  tag = element->Value();		
-	  str = element->FirstChild()->Value();
+	  tag = element->Value();
 	}
       }
 
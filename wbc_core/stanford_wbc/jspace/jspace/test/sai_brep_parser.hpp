@@ -31,7 +31,7 @@
 #include <stdexcept>
 
 namespace wbc_tinyxml {
-  class TiXmlElement;
+  class TiXmlInSituNode;
 }
 
 namespace jspace {
@@ -162,16 +162,20 @@ namespace jspace {
       deFloat rotAngle_;
       
       /** Depth First Search on joint nodes. */
-      void DFS_JointNodes(wbc_tinyxml::TiXmlElement *, int) throw(std::runtime_error);
+      void DFS_JointNodes(wbc_tinyxml::TiXmlInSituNode *, int) throw(std::runtime_error);
     
       /** Search for child xml joint node. */
-      wbc_tinyxml::TiXmlElement * getChildJointNode(wbc_tinyxml::TiXmlElement *);
+      wbc_tinyxml::TiXmlInSituNode * getChildJointNode(wbc_tinyxml::TiXmlInSituNode *);
       
       /** Read data xml joint nodes. */
-      void exploreJointNode(wbc_tinyxml::TiXmlElement *) throw(std::runtime_error);
+      void exploreJointNode(wbc_tinyxml::TiXmlInSituNode *) throw(std::runtime_error);
     
       /** Searches for the base node and creates a branching robot using DFS algorithm. */
-      void exploreRobot(wbc_tinyxml::TiXmlElement *);
+      void exploreRobot(wbc_tinyxml::TiXmlInSituNode *);
+      
+      /** Read the optional constraint specification, which sits in a
+	  <constraints> element next to the <baseNode>. */
+      void exploreConstraints(wbc_tinyxml::TiXmlInSituNode *) throw(std::runtime_error);
       
       /** Create tao node and link it to parent node */
       void  createTreeOfNodes(int nodeID,
@@ -27,32 +27,88 @@
 #include "sai_brep_parser.hpp"
 #include "sai_brep.hpp"
 #include "../Model.hpp"
+#include "../model_cache.hpp"
+#include "../tao_util.hpp"
 
 namespace jspace {
   namespace test {
 
+    static Model * create_model(std::string const & filename,
+				jspace::tao_tree_info_s * kg_tree,
+				jspace::constraint_spec_s const & constraint_spec,
+				bool enable_coriolis_centrifugal) throw(std::runtime_error)
+    {
+      Model * model(new Model());
+      std::ostringstream msg;
+      if ( 0 != model->init(kg_tree, enable_coriolis_centrifugal, &msg)) {
+	delete model;
+	throw std::runtime_error("jspace::parse_sai_xml_file(" + filename
+				 + "): model::init() failed: " + msg.str());
+      }
+      
+      if ( ! constraint_spec.empty()) {
+	GenericConstraint * constraint(new GenericConstraint(constraint_spec));
+	Status const st(constraint->init(*model));
+	if ( ! st) {
+	  delete constraint;
+	  delete model;
+	  throw std::runtime_error("jspace::parse_sai_xml_file(" + filename
+				   + "): invalid constraints: " + st.errstr);
+	}
+	model->setConstraint(constraint);
+      }
+      
+      return model;
+    }
+    
+    
     Model * parse_sai_xml_file(std::string const & filename,
 			       bool enable_coriolis_centrifugal) throw(std::runtime_error)
     {
       test::BRParser brp;
       test::BranchingRepresentation * brep(brp.parse(filename));
+      jspace::constraint_spec_s const constraint_spec(brep->getConstraintSpec());
       jspace::tao_tree_info_s * kg_tree(brep->createTreeInfo());
-      jspace::tao_tree_info_s * cc_tree(0);
-      if (enable_coriolis_centrifugal) {
-	delete brep;
-	brep = brp.parse(filename);
-	cc_tree = brep->createTreeInfo();
-      }
       delete brep;
+      
+      return create_model(filename, kg_tree, constraint_spec, enable_coriolis_centrifugal);
+    }
     
+    
+    Model * parse_sai_xml_file_cached(std::string const & filename,
+				      std::string const & cache_filename,
+				      bool enable_coriolis_centrifugal,
+				      std::ostream * msg) throw(std::runtime_error)
+    {
+      uint64_t hash;
+      Status st(compute_model_file_hash(filename, hash));
+      if ( ! st) {
+	throw std::runtime_error("jspace::parse_sai_xml_file_cached(" + filename + "): " + st.errstr);
+      }
+      
       Model * model(new Model());
-      std::ostringstream msg;
-      if ( 0 != model->init(kg_tree, cc_tree, &msg)) {
-	delete model;
-	throw std::runtime_error("jspace::parse_sai_xml_file(" + filename
-				 + "): model::init() failed: " + msg.str());
+      std::ostringstream init_msg;
+      if (0 == model->init(cache_filename, hash, enable_coriolis_centrifugal, &init_msg)) {
+	return model;
       }
-      return model;
+      delete model;
+      if (msg) {
+	*msg << "rebuilding model cache " << cache_filename << " from " << filename
+	     << "\n  reason: " << init_msg.str();
+      }
+      
+      test::BRParser brp;
+      test::BranchingRepresentation * brep(brp.parse(filename));
+      jspace::constraint_spec_s const constraint_spec(brep->getConstraintSpec());
+      jspace::tao_tree_info_s * kg_tree(brep->createTreeInfo());
+      delete brep;
+      
+      st = write_model_cache(cache_filename, hash, *kg_tree, constraint_spec);
+      if (( ! st) && msg) {
+	*msg << "failed to write model cache " << cache_filename << ": " << st.errstr << "\n";
+      }
+      
+      return create_model(filename, kg_tree, constraint_spec, enable_coriolis_centrifugal);
     }
 
   }  
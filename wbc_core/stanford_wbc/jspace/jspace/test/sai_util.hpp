@@ -28,12 +28,27 @@
 
 #include <stdexcept>
 #include <string>
+#include <iosfwd>
 
 namespace jspace {
   class Model;
   namespace test {
     Model * parse_sai_xml_file(std::string const & filename,
 			       bool enable_coriolis_centrifugal) throw(std::runtime_error);
+    
+    /**
+       Like parse_sai_xml_file(), but loads the model from a binary
+       model cache (see jspace/model_cache.hpp) if that cache was
+       built from the current contents of the XML file. Otherwise,
+       the XML file gets parsed and the cache is (re)written for the
+       next time. Failing to write the cache is not an error, it just
+       gets reported to msg (if non-NULL) along with a note when the
+       cache gets rebuilt.
+    */
+    Model * parse_sai_xml_file_cached(std::string const & filename,
+				      std::string const & cache_filename,
+				      bool enable_coriolis_centrifugal,
+				      std::ostream * msg) throw(std::runtime_error);
   }
 }
 
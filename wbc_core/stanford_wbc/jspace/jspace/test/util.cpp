@@ -24,6 +24,10 @@
 */
 
 #include "util.hpp"
+#include <tao/matrix/TaoDeTypes.h>
+#include <limits>
+#include <algorithm>
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
@@ -31,6 +35,14 @@
 
 using namespace std;
 
+
+// Values coming out of TAO carry deFloat round-off, which is float if
+// TAO was built with TAO_FLOAT, and finite differences amplify it to
+// about epsilon^(2/3). Below this magnitude the checks compare
+// absolute instead of relative differences.
+static double const smart_epsilon(std::max(1e-6, 1e1 * pow(std::numeric_limits<deFloat>::epsilon(), 2.0 / 3)));
+
+
 namespace jspace {
   namespace test {
     
@@ -68,7 +80,7 @@ namespace jspace {
       jspace::Matrix delta(nrows, ncolumns);
       for (int ii(0); ii < nrows; ++ii) {
 	for (int jj(0); jj < ncolumns; ++jj) {
-	  delta.coeffRef(ii, jj) = fabs(smart_delta(have.coeff(ii, jj), want.coeff(ii, jj)));
+	  delta.coeffRef(ii, jj) = fabs(smart_delta(have.coeff(ii, jj), want.coeff(ii, jj), smart_epsilon));
 	  if (delta.coeff(ii, jj) > precision) {
 	    maxdelta = delta.coeff(ii, jj);
 	  }
@@ -129,7 +141,7 @@ namespace jspace {
       double maxdelta(0);
       jspace::Vector delta(nelems);
       for (int ii(0); ii < nelems; ++ii) {
-	delta.coeffRef(ii) = fabs(smart_delta(have[ii], want[ii]));
+	delta.coeffRef(ii) = fabs(smart_delta(have[ii], want[ii], smart_epsilon));
 	if (delta.coeff(ii) > precision) {
 	  maxdelta = delta.coeff(ii);
 	}
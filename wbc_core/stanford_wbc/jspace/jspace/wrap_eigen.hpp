@@ -38,6 +38,11 @@ namespace jspace {
   typedef Eigen::VectorXd Vector;
   typedef Eigen::MatrixXd Matrix;
   
+  // Single precision counterparts, for the optional float32 path of
+  // the controller math (see uta_opspace::ControllerNG).
+  typedef Eigen::VectorXf VectorF;
+  typedef Eigen::MatrixXf MatrixF;
+  
   // ...an idea that needs more thought...
   // typedef Eigen::Map<Eigen::VectorXd> VectorMap;
   // inline VectorMap map(std::vector<double> & from) { return Vector::Map(&from[0], from.size()); }
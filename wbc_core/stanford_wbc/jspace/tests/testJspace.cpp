@@ -27,18 +27,30 @@
 #include <jspace/test/model_library.hpp>
 #include <jspace/test/util.hpp>
 #include <jspace/test/sai_brep_parser.hpp>
+#include <jspace/test/sai_util.hpp>
 #include <tao/dynamics/taoNode.h>
 #include <tao/dynamics/taoDynamics.h>
 #include <tao/dynamics/taoJoint.h>
 #include <jspace/tao_dump.hpp>
+#include <jspace/tao_util.hpp>
+#include <jspace/DynamicsDerivatives.hpp>
+#include <jspace/model_cache.hpp>
+#include <jspace/NameTable.hpp>
 #include <jspace/vector_util.hpp>
 #include <jspace/controller_library.hpp>
 #include <jspace/strutil.hpp>
+#include <jspace/pseudo_inverse.hpp>
+#include <jspace/DenseQP.hpp>
+#include <jspace/Constraint.hpp>
+#include "puma_kingen.hpp"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <gtest/gtest.h>
 #include <errno.h>
+#include <limits>
+#include <algorithm>
+#include <math.h>
 
 #include <Eigen/SVD>
 #include <Eigen/LU>
@@ -47,6 +59,26 @@ using namespace std;
 using namespace jspace;
 using namespace jspace::test;
 
+
+// TAO computes in float if the build defines DE_PRECISION_FLOAT
+// (TAO_FLOAT in CMake). Checks of quantities that come out of TAO use
+// these to scale their tolerance and finite difference step with it.
+
+static double tao_tolerance(double tolerance)
+{
+  return std::max(tolerance, 1e2 * std::numeric_limits<deFloat>::epsilon());
+}
+
+static double tao_step(double step)
+{
+  return std::max(step, pow(std::numeric_limits<deFloat>::epsilon(), 1.0 / 3));
+}
+
+static double tao_fd_tolerance(double tolerance)
+{
+  return std::max(tolerance, 1e2 * pow(std::numeric_limits<deFloat>::epsilon(), 2.0 / 3));
+}
+
 static std::string create_puma_frames() throw(runtime_error);
 
 
@@ -81,6 +113,49 @@ TEST (jspaceModel, state)
 }
 
 
+TEST (jspaceModel, state_buffer)
+{
+  jspace::Model * model(0);
+  jspace::Model * ref(0);
+  try {
+    model = create_puma_model();
+    ref = create_puma_model();
+    int const ndof(model->getNDOF());
+    jspace::State state_in(ndof, ndof, 0);
+    for (int ii(0); ii < ndof; ++ii) {
+      state_in.position_[ii] = -3 + ii * 0.5;
+      state_in.velocity_[ii] = 3 - ii * 0.25;
+    }
+    ref->update(state_in);
+    
+    jspace::State & buffer(model->getStateBuffer());
+    buffer.init(ndof, ndof, 0);
+    double const * const storage(buffer.position_.data());
+    for (int ii(0); ii < ndof; ++ii) {
+      buffer.position_[ii] = state_in.position_[ii];
+      buffer.velocity_[ii] = state_in.velocity_[ii];
+    }
+    size_t const version(model->getStateVersion());
+    model->update(buffer);
+    EXPECT_EQ (version + 1, model->getStateVersion());
+    EXPECT_EQ (storage, model->getState().position_.data())
+      << "setState() on its own buffer should not reallocate";
+    EXPECT_TRUE (model->getState().equal(state_in, jspace::State::COMPARE_ALL, 1e-6));
+    EXPECT_TRUE (model->getFullState().equal(state_in, jspace::State::COMPARE_ALL, 1e-6));
+    
+    jspace::Matrix A_model, A_ref;
+    ASSERT_TRUE (model->getMassInertia(A_model));
+    ASSERT_TRUE (ref->getMassInertia(A_ref));
+    std::ostringstream msg;
+    EXPECT_TRUE (check_matrix("mass_inertia", A_ref, A_model, 1e-9, msg)) << msg.str();
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+  delete ref;
+}
+
 TEST (jspaceModel, branching)
 {
   jspace::Model * model(0);
@@ -129,6 +204,56 @@ TEST (jspaceModel, branching)
 }
 
 
+
+TEST (jspaceModel, aliases)
+{
+  jspace::Model * model(0);
+  try {
+    model = create_puma_model();
+    EXPECT_EQ ((void*)0, model->getNodeByName("gripper"));
+    EXPECT_EQ ((void*)0, model->getNodeByJointName("shoulder-nonexistent"));
+    EXPECT_FALSE (model->addAlias("gripper", "no-such-link"));
+    EXPECT_FALSE (model->addAlias("elbow", "base")) << "alias shadowing a joint name";
+    ASSERT_TRUE (model->addAlias("gripper", "end-effector"));
+    EXPECT_FALSE (model->addAlias("gripper", "base")) << "alias registered twice";
+    EXPECT_EQ (model->getNode(5), model->getNodeByName("gripper"));
+    EXPECT_EQ ((void*)0, model->getNodeByJointName("gripper"));
+    ASSERT_TRUE (model->addAlias("shoulder", "shoulder-pitch"));
+    EXPECT_EQ (model->getNode(1), model->getNodeByJointName("shoulder"));
+    EXPECT_EQ (model->getNode(5), model->getNodeByName("gripper")) << "earlier alias lost";
+    EXPECT_EQ (model->getNode(0), model->getNodeByName("base")) << "real name lost";
+    
+    // a Jacobian for a node of another model must be refused
+    jspace::Model * other(create_puma_model());
+    Matrix J;
+    EXPECT_FALSE (model->computeJacobian(other->getNode(2), J));
+    EXPECT_TRUE (model->computeJacobian(model->getNode(2), J));
+    delete other;
+    
+    jspace::NameTable table;
+    for (int ii(0); ii < 500; ++ii) {
+      std::ostringstream name;
+      name << "link" << ii;
+      ASSERT_TRUE (table.add(name.str(), ii));
+    }
+    EXPECT_FALSE (table.add("link7", 1000));
+    EXPECT_EQ (-1, table.find("link7")) << "lookup before build() should fail";
+    table.build();
+    for (int ii(0); ii < 500; ++ii) {
+      std::ostringstream name;
+      name << "link" << ii;
+      EXPECT_EQ (ii, table.find(name.str()));
+    }
+    EXPECT_EQ (-1, table.find("link500"));
+    EXPECT_EQ (-1, table.find(""));
+    EXPECT_EQ (1024, table.capacity()) << "table should not grow beyond twice the names";
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
 TEST (jspaceModel, kinematics)
 {
   jspace::Model * model(0);
@@ -894,6 +1019,74 @@ TEST (jspaceModel, mass_inertia_fork_4R)
 }
 
 
+TEST (jspaceModel, sparse_jacobian_fork_4R)
+{
+  jspace::Model * model(0);
+  try {
+    model = create_fork_4R_model();
+    jspace::State state(4, 4, 0);
+    srand(23);
+    
+    for (size_t trial(0); trial < 20; ++trial) {
+      state.position_ = M_PI * Vector::Random(4);
+      state.velocity_ = Vector::Random(4);
+      model->update(state);
+      Matrix const mm(Matrix::Random(4, 4));
+      Matrix const rhs(Matrix::Random(4, 3));
+      Vector const force(Vector::Random(6));
+      
+      for (size_t ii(0); ii < 4; ++ii) {
+	taoDNode * node(model->getNode(ii));
+	ASSERT_NE ((void*)0, node) << "no node with ID " << ii;
+	Matrix dense;
+	ASSERT_TRUE (model->computeJacobian(node, dense));
+	jspace::SparseJacobian sparse;
+	ASSERT_TRUE (model->computeJacobian(node, sparse));
+	
+	// nodes 2 and 3 branch off node 1, so neither depends on the other
+	size_t const nancestors[] = { 1, 2, 3, 3 };
+	ASSERT_EQ (nancestors[ii], sparse.getColumns().size()) << "node " << ii;
+	EXPECT_EQ (ii, sparse.getColumns().back()) << "node " << ii;
+	
+	std::ostringstream msg;
+	msg << "node " << ii << " q = " << state.position_ << "\n";
+	Matrix expanded;
+	sparse.toDense(expanded);
+	EXPECT_TRUE (check_matrix("toDense", dense, expanded, 1e-9, msg)) << msg.str();
+	
+	Matrix prod;
+	sparse.multiply(rhs, prod);
+	EXPECT_TRUE (check_matrix("multiply", dense * rhs, prod, 1e-9, msg)) << msg.str();
+	
+	Vector vel;
+	sparse.multiply(state.velocity_, vel);
+	EXPECT_TRUE (check_vector("velocity", dense * state.velocity_, vel, 1e-9, msg)) << msg.str();
+	
+	Vector tau;
+	sparse.transposeMultiply(force, tau);
+	EXPECT_TRUE (check_vector("transposeMultiply", dense.transpose() * force, tau, 1e-9, msg))
+	  << msg.str();
+	
+	Matrix quad;
+	sparse.quadratic(mm, quad);
+	EXPECT_TRUE (check_matrix("quadratic", dense * mm * dense.transpose(), quad, 1e-9, msg))
+	  << msg.str();
+	
+	jspace::SparseJacobian linear;
+	sparse.getRows(0, 3, linear);
+	linear.toDense(expanded);
+	EXPECT_TRUE (check_matrix("getRows", dense.block(0, 0, 3, 4), expanded, 1e-9, msg))
+	  << msg.str();
+      }
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
 TEST (jspaceModel, mass_inertia_RR)
 {
   typedef jspace::Model * (*create_model_t)();
@@ -994,6 +1187,431 @@ TEST (jspaceModel, mass_inertia_5R_nonzero)
 }
 
 
+TEST (jspaceModel, bias_forces_5R)
+{
+  jspace::Model * model(0);
+  try {
+    model = create_unit_mass_5R_model();
+    jspace::State state(5, 5, 0);
+    std::ostringstream msg;
+    srand(17);
+    
+    for (size_t trial(0); trial < 10; ++trial) {
+      state.position_ = Vector::Random(5);
+      state.velocity_ = Vector::Zero(5);
+      model->update(state);
+      Vector g_static, b_static;
+      Matrix mm_static;
+      ASSERT_TRUE (model->getGravity(g_static));
+      ASSERT_TRUE (model->getCoriolisCentrifugal(b_static));
+      ASSERT_TRUE (model->getMassInertia(mm_static));
+      EXPECT_TRUE (check_vector("Coriolis-centrifugal at rest", Vector::Zero(5), b_static, 1e-9, msg)) << msg.str();
+      
+      // velocities must not leak into gravity and mass-inertia, and
+      // Coriolis-centrifugal effects are quadratic in the velocities
+      state.velocity_ = Vector::Random(5);
+      model->update(state);
+      Vector gg, bb, bias;
+      Matrix mm;
+      ASSERT_TRUE (model->getGravity(gg));
+      ASSERT_TRUE (model->getCoriolisCentrifugal(bb));
+      ASSERT_TRUE (model->getBiasForces(bias));
+      ASSERT_TRUE (model->getMassInertia(mm));
+      EXPECT_TRUE (check_vector("gravity", g_static, gg, 1e-9, msg)) << msg.str();
+      EXPECT_TRUE (check_matrix("mass inertia", mm_static, mm, 1e-9, msg)) << msg.str();
+      EXPECT_TRUE (check_vector("bias", gg + bb, bias, 1e-9, msg)) << msg.str();
+      
+      state.velocity_ *= 2;
+      model->update(state);
+      Vector bb2;
+      ASSERT_TRUE (model->getCoriolisCentrifugal(bb2));
+      EXPECT_TRUE (check_vector("doubled velocity", 4 * bb, bb2, 1e-9, msg)) << msg.str();
+      
+      // compare with the TAO reference, which zeroes the velocities
+      // for gravity and runs separate sweeps
+      taoDNode * root(model->_getKGMTree()->root);
+      std::vector<deFloat> tao_g(5), tao_b(5);
+      deVector3 earth;
+      earth.set(0, 0, -9.81);
+      taoDynamics::computeG(root, &earth, 5, &tao_g[0]);
+      taoDynamics::computeB(root, 5, &tao_b[0]);
+      Vector tao_gv(5), tao_bv(5);
+      for (size_t ii(0); ii < 5; ++ii) {
+	tao_gv[ii] = tao_g[ii];
+	tao_bv[ii] = tao_b[ii];
+      }
+      model->getGravity(gg);
+      EXPECT_TRUE (check_vector("TAO gravity", tao_gv, gg, 1e-9, msg)) << msg.str();
+      EXPECT_TRUE (check_vector("TAO Coriolis-centrifugal", tao_bv, bb2, 1e-9, msg)) << msg.str();
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+static void check_jdot_qdot(jspace::Model * model, size_t ndof)
+{
+  jspace::State state(ndof, ndof, 0);
+  Vector const offset(Vector::Random(3));
+  double const hh(tao_step(1e-6));
+  
+  for (size_t trial(0); trial < 5; ++trial) {
+    Vector const qq(Vector::Random(ndof));
+    Vector const qd(Vector::Random(ndof));
+    state.velocity_ = qd;
+    
+    for (size_t id(0); id < ndof; ++id) {
+      taoDNode * node(model->getNode(id));
+      ASSERT_NE ((void*)0, node);
+      
+      // The Jacobian of a point attached to the node, finite
+      // differenced along the velocity, should match Jdot * qdot.
+      Matrix jplus, jminus;
+      jspace::Transform frame;
+      state.position_ = qq + hh * qd;
+      model->update(state);
+      ASSERT_TRUE (model->computeGlobalFrame(node, offset[0], offset[1], offset[2], frame));
+      ASSERT_TRUE (model->computeJacobian(node, frame.translation(), jplus));
+      state.position_ = qq - hh * qd;
+      model->update(state);
+      ASSERT_TRUE (model->computeGlobalFrame(node, offset[0], offset[1], offset[2], frame));
+      ASSERT_TRUE (model->computeJacobian(node, frame.translation(), jminus));
+      
+      state.position_ = qq;
+      model->update(state);
+      ASSERT_TRUE (model->computeGlobalFrame(node, offset[0], offset[1], offset[2], frame));
+      Vector jdqd;
+      ASSERT_TRUE (model->computeJdotQdot(node,
+					   frame.translation()[0],
+					   frame.translation()[1],
+					   frame.translation()[2],
+					   jdqd));
+      Vector const want((jplus - jminus) * qd / (2 * hh));
+      std::ostringstream msg;
+      msg << "node " << id << " trial " << trial << "\n";
+      EXPECT_TRUE (check_vector("Jdot qdot", want, jdqd, tao_fd_tolerance(1e-6), msg)) << msg.str();
+    }
+  }
+}
+
+
+TEST (jspaceModel, jdot_qdot)
+{
+  jspace::Model * model(0);
+  try {
+    srand(23);
+    model = create_unit_mass_RP_model();
+    check_jdot_qdot(model, 2);
+    delete model;
+    model = 0;
+    model = create_fork_4R_model();
+    check_jdot_qdot(model, model->getNDOF());
+    delete model;
+    model = 0;
+    model = create_puma_model();
+    check_jdot_qdot(model, model->getNDOF());
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, coriolis_matrix_5R)
+{
+  jspace::Model * model(0);
+  try {
+    model = create_unit_mass_5R_model();
+    jspace::State state(5, 5, 0);
+    std::ostringstream msg;
+    srand(29);
+    
+    for (size_t trial(0); trial < 10; ++trial) {
+      state.position_ = Vector::Random(5);
+      state.velocity_ = 3 * Vector::Random(5);
+      model->update(state);
+      Matrix cmat;
+      Vector bb;
+      ASSERT_TRUE (model->computeCoriolisMatrix(cmat));
+      ASSERT_TRUE (model->getCoriolisCentrifugal(bb));
+      EXPECT_TRUE (check_vector("C qdot", bb, cmat * state.velocity_, tao_tolerance(1e-9), msg)) << msg.str();
+      
+      // C is linear in the velocities, and computing it must leave
+      // the model state alone
+      Vector bb_after;
+      model->computeBiasForces();
+      ASSERT_TRUE (model->getCoriolisCentrifugal(bb_after));
+      EXPECT_TRUE (check_vector("unchanged bias", bb, bb_after, 1e-9, msg)) << msg.str();
+      state.velocity_ *= -0.5;
+      model->update(state);
+      Matrix chalf;
+      ASSERT_TRUE (model->computeCoriolisMatrix(chalf));
+      EXPECT_TRUE (check_matrix("scaled C", -0.5 * cmat, chalf, tao_tolerance(1e-9), msg)) << msg.str();
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, dynamics_derivatives)
+{
+  jspace::Model * model(0);
+  try {
+    srand(31);
+    for (size_t im(0); im < 4; ++im) {
+      switch (im) {
+      case 0: model = create_unit_mass_5R_model(); break;
+      case 1: model = create_unit_mass_RP_model(); break;
+      case 2: model = create_fork_4R_model(); break;
+      default: model = create_puma_model();
+      }
+      size_t const ndof(model->getNDOF());
+      jspace::State state(ndof, ndof, 0);
+      for (size_t trial(0); trial < 3; ++trial) {
+	state.position_ = Vector::Random(ndof);
+	state.velocity_ = Vector::Random(ndof);
+	std::ostringstream msg;
+	msg << "model " << im << " trial " << trial << "\n";
+	jspace::Status const st(jspace::check_dynamics_derivatives(*model, state, Vector::Random(ndof),
+								    tao_step(1e-6), tao_fd_tolerance(1e-5), &msg));
+	EXPECT_TRUE (st.ok) << st.errstr << "\n" << msg.str();
+      }
+      delete model;
+      model = 0;
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, model_cache)
+{
+  jspace::Model * model(0);
+  try {
+    std::string const fname(create_tmpfile("model.cache.XXXXXX", ""));
+    srand(17);
+    for (size_t im(0); im < 3; ++im) {
+      switch (im) {
+      case 0: model = create_unit_mass_RP_model(); break;
+      case 1: model = create_fork_4R_model(); break;
+      default: model = create_puma_model();
+      }
+      jspace::constraint_spec_s spec;
+      spec.coupled_joint.resize(1);
+      spec.coupled_joint[0].master = "master";
+      spec.coupled_joint[0].slave = "slave";
+      spec.coupled_joint[0].ratio = -0.5;
+      jspace::Status st(jspace::write_model_cache(fname, 1234, *model->_getKGMTree(), spec));
+      ASSERT_TRUE (st.ok) << st.errstr;
+      
+      jspace::tao_tree_info_s * tree(0);
+      jspace::constraint_spec_s spec_check;
+      st = jspace::read_model_cache(fname, 4321, &tree, spec_check);
+      EXPECT_FALSE (st.ok) << "cache for another source hash should be rejected";
+      st = jspace::read_model_cache(fname, 1234, &tree, spec_check);
+      ASSERT_TRUE (st.ok) << st.errstr;
+      ASSERT_EQ (1, spec_check.coupled_joint.size());
+      EXPECT_EQ ("slave", spec_check.coupled_joint[0].slave);
+      EXPECT_EQ (-0.5, spec_check.coupled_joint[0].ratio);
+      delete tree;
+      {
+	jspace::Model broken;
+	EXPECT_EQ (-7, broken.init(fname, 1234, true, 0)) << "constraint on unknown joints should be rejected";
+      }
+      
+      st = jspace::write_model_cache(fname, 1234, *model->_getKGMTree(), jspace::constraint_spec_s());
+      ASSERT_TRUE (st.ok) << st.errstr;
+      jspace::Model cached;
+      std::ostringstream msg;
+      ASSERT_EQ (0, cached.init(fname, 1234, true, &msg)) << msg.str();
+      size_t const ndof(model->getNDOF());
+      ASSERT_EQ (ndof, cached.getNDOF());
+      for (size_t ii(0); ii < ndof; ++ii) {
+	EXPECT_EQ (model->getJointName(ii), cached.getJointName(ii));
+	EXPECT_EQ (model->_getKGMTree()->info[ii].link_name, cached._getKGMTree()->info[ii].link_name);
+      }
+      
+      jspace::State state(ndof, ndof, 0);
+      for (size_t trial(0); trial < 3; ++trial) {
+	state.position_ = Vector::Random(ndof);
+	state.velocity_ = Vector::Random(ndof);
+	model->update(state);
+	cached.update(state);
+	Matrix A, A_check, J, J_check;
+	Vector g, g_check, b, b_check;
+	ASSERT_TRUE (model->getMassInertia(A_check));
+	ASSERT_TRUE (cached.getMassInertia(A));
+	ASSERT_TRUE (model->getGravity(g_check));
+	ASSERT_TRUE (cached.getGravity(g));
+	ASSERT_TRUE (model->getCoriolisCentrifugal(b_check));
+	ASSERT_TRUE (cached.getCoriolisCentrifugal(b));
+	ASSERT_TRUE (model->computeJacobian(model->getNode(ndof - 1), J_check));
+	ASSERT_TRUE (cached.computeJacobian(cached.getNode(ndof - 1), J));
+	msg << "model " << im << " trial " << trial << "\n";
+	EXPECT_TRUE (check_matrix("A", A_check, A, 1e-12, msg)) << msg.str();
+	EXPECT_TRUE (check_vector("g", g_check, g, 1e-12, msg)) << msg.str();
+	EXPECT_TRUE (check_vector("b", b_check, b, 1e-12, msg)) << msg.str();
+	EXPECT_TRUE (check_matrix("J", J_check, J, 1e-12, msg)) << msg.str();
+      }
+      delete model;
+      model = 0;
+    }
+    
+    // Records which pass the checksum but are invalid have to be
+    // rejected after some nodes already got created, without leaking
+    // or double-freeing them. The offsets follow the layout in
+    // model_cache.cpp: a 104 byte header with the checksum at byte
+    // 24 and the node count at byte 32, then 240 byte records starting with the id, parent_id,
+    // joint_type, and joint_axis as int32.
+    model = create_puma_model();
+    ASSERT_TRUE (jspace::write_model_cache(fname, 1234, *model->_getKGMTree(),
+					   jspace::constraint_spec_s()).ok);
+    std::string good;
+    {
+      std::ifstream is(fname.c_str(), std::ios::in | std::ios::binary);
+      std::ostringstream os;
+      os << is.rdbuf();
+      good = os.str();
+    }
+    size_t const header_size(104);
+    size_t const record_size(240);
+    uint32_t node_count;
+    memcpy(&node_count, &good[32], sizeof(node_count));
+    ASSERT_EQ (model->getNNodes(), node_count);
+    size_t const last(header_size + (node_count - 1) * record_size);
+    ASSERT_LE (last + record_size, good.size());
+    for (size_t field(1); field < 4; ++field) {
+      std::string bad(good);
+      int32_t const value(3 == field ? 17 : (1 == field ? 42 : 'x'));
+      memcpy(&bad[last + 4 * field], &value, sizeof(value));
+      uint64_t const checksum(jspace::compute_model_hash(bad.substr(header_size)));
+      memcpy(&bad[24], &checksum, sizeof(checksum));
+      {
+	std::ofstream os(fname.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	os.write(bad.data(), bad.size());
+      }
+      jspace::tao_tree_info_s * tree(0);
+      jspace::constraint_spec_s spec;
+      jspace::Status const st(jspace::read_model_cache(fname, 1234, &tree, spec));
+      EXPECT_FALSE (st.ok) << "invalid field " << field << " in the last record should be rejected";
+      EXPECT_EQ ((jspace::tao_tree_info_s*) 0, tree);
+    }
+    delete model;
+    model = 0;
+    
+    std::ofstream corrupt(fname.c_str(), std::ios::out | std::ios::in | std::ios::binary);
+    corrupt.seekp(200);
+    corrupt.put('x');
+    corrupt.close();
+    jspace::Model cached;
+    EXPECT_EQ (-6, cached.init(fname, 1234, true, 0)) << "corrupted cache should be rejected";
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceModel, kingen_puma)
+{
+  // puma_kingen.hpp gets generated from examples/puma.xml by
+  // wbc_kingen, see tests/CMakeLists.txt
+  jspace::Model * model(0);
+  try {
+    model = create_puma_model();
+    size_t const ndof(model->getNDOF());
+    ASSERT_EQ (ndof, static_cast<size_t>(puma::ndof));
+    taoDNode * hand(model->getNodeByName("end-effector"));
+    taoDNode * elbow(model->getNodeByName("lower_arm"));
+    ASSERT_NE ((void*) 0, hand);
+    ASSERT_NE ((void*) 0, elbow);
+    
+    jspace::State state(ndof, ndof, 0);
+    srand(42);
+    for (size_t trial(0); trial < 5; ++trial) {
+      state.position_ = 3 * Vector::Random(ndof);
+      model->update(state);
+      std::ostringstream msg;
+      msg << "trial " << trial << " q = " << state.position_.transpose() << "\n";
+      
+      Vector g_check;
+      ASSERT_TRUE (model->getGravity(g_check));
+      
+      for (size_t ic(0); ic < 2; ++ic) {
+	taoDNode * const node((0 == ic) ? hand : elbow);
+	Vector offset(Vector::Zero(3));
+	if (1 == ic) {
+	  offset << 0.1, -0.2, 0.3;
+	}
+	Transform frame_check;
+	Matrix J_check;
+	ASSERT_TRUE (model->computeGlobalFrame(node, offset, frame_check));
+	ASSERT_TRUE (model->computeJacobian(node, frame_check.translation(), J_check));
+	
+	double pos[3], rot[3][3], J[6][6], g[6];
+	std::vector<int> joint;
+	if (0 == ic) {
+	  puma::hand::fk(state.position_.data(), pos, rot);
+	  puma::hand::jacobian(state.position_.data(), J);
+	  puma::hand::gravity(state.position_.data(), g);
+	  joint.assign(puma::hand::joint, puma::hand::joint + puma::hand::njoints);
+	}
+	else {
+	  double J3[6][3];
+	  puma::elbow::fk(state.position_.data(), pos, rot);
+	  puma::elbow::jacobian(state.position_.data(), J3);
+	  puma::elbow::gravity(state.position_.data(), g);
+	  joint.assign(puma::elbow::joint, puma::elbow::joint + puma::elbow::njoints);
+	  for (size_t ii(0); ii < 6; ++ii) {
+	    for (size_t jj(0); jj < joint.size(); ++jj) {
+	      J[ii][jj] = J3[ii][jj];
+	    }
+	  }
+	}
+	
+	Vector pos_gen(3), g_gen(joint.size()), g_sub(joint.size());
+	Matrix rot_gen(3, 3), J_gen(Matrix::Zero(6, ndof));
+	for (size_t ii(0); ii < 3; ++ii) {
+	  pos_gen[ii] = pos[ii];
+	  for (size_t jj(0); jj < 3; ++jj) {
+	    rot_gen.coeffRef(ii, jj) = rot[ii][jj];
+	  }
+	}
+	for (size_t jj(0); jj < joint.size(); ++jj) {
+	  for (size_t ii(0); ii < 6; ++ii) {
+	    J_gen.coeffRef(ii, joint[jj]) = J[ii][jj];
+	  }
+	  g_gen[jj] = g[jj];
+	  g_sub[jj] = g_check[joint[jj]];
+	}
+	msg << "chain " << ic << "\n";
+	Vector const pos_check(frame_check.translation());
+	Matrix const rot_check(frame_check.linear());
+	EXPECT_TRUE (check_vector("pos", pos_check, pos_gen, tao_tolerance(1e-9), msg)) << msg.str();
+	EXPECT_TRUE (check_matrix("rot", rot_check, rot_gen, tao_tolerance(1e-9), msg)) << msg.str();
+	EXPECT_TRUE (check_matrix("J", J_check, J_gen, tao_tolerance(1e-9), msg)) << msg.str();
+	EXPECT_TRUE (check_vector("g", g_sub, g_gen, tao_tolerance(1e-9), msg)) << msg.str();
+      }
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
 TEST (jspaceModel, mass_inertia_RP)
 {
   jspace::Model * model(0);
@@ -1102,6 +1720,518 @@ TEST (jspaceController, mass_inertia_compensation_RR)
 }
 
 
+TEST (jspaceLinalg, nullspace_update)
+{
+  // Randomized task hierarchies, comparing the rank-k nullspace
+  // update against the dense expression it replaces.
+  srand(17);
+  for (size_t ndof(2); ndof <= 19; ndof += 3) {
+    for (size_t trial(0); trial < 5; ++trial) {
+      Matrix const rr(Matrix::Random(ndof, ndof));
+      Matrix const phi(rr * rr.transpose() + 0.1 * Matrix::Identity(ndof, ndof));
+      Matrix nstar_dense(Matrix::Identity(ndof, ndof));
+      Matrix nstar_rank(Matrix::Identity(ndof, ndof));
+      size_t remaining(ndof);
+      for (size_t level(0); remaining > 0; ++level) {
+	size_t const kk(1 + (rand() % remaining));
+	remaining -= kk;
+	Matrix const jac(Matrix::Random(kk, ndof));
+	Matrix const jstar(jac * nstar_dense);
+	Matrix const phijt(phi * jstar.transpose());
+	Matrix lstar;
+	pseudoInverse(jstar * phijt, 1e-4, lstar, 0);
+	
+	Matrix const nnext((Matrix::Identity(ndof, ndof) - phi * jstar.transpose() * lstar * jstar)
+			   * nstar_dense);
+	nstar_dense = nnext;
+	updateNullspace(phijt, lstar, jstar, nstar_rank);
+	
+	std::ostringstream msg;
+	msg << "ndof " << ndof << " trial " << trial << " level " << level << " task dim " << kk << "\n";
+	pretty_print(nstar_dense, msg, "  want", "    ");
+	pretty_print(nstar_rank, msg, "  have", "    ");
+	EXPECT_TRUE (check_matrix("nstar", nstar_dense, nstar_rank, 1e-6, msg)) << msg.str();
+      }
+    }
+  }
+}
+
+
+TEST (jspaceLinalg, single_precision)
+{
+  // The float overloads should track the double ones up to float
+  // rounding, relative to the magnitude of the result.
+  srand(23);
+  for (size_t ndof(2); ndof <= 14; ndof += 3) {
+    Matrix const rr(Matrix::Random(ndof, ndof));
+    Matrix const phi(rr * rr.transpose() + Matrix::Identity(ndof, ndof));
+    jspace::MatrixF const phi_f(phi.cast<float>());
+    Matrix nstar(Matrix::Identity(ndof, ndof));
+    jspace::MatrixF nstar_f(jspace::MatrixF::Identity(ndof, ndof));
+    size_t remaining(ndof);
+    for (size_t level(0); remaining > 0; ++level) {
+      size_t const kk(1 + (rand() % remaining));
+      remaining -= kk;
+      Matrix const jac(Matrix::Random(kk, ndof));
+      Matrix const jstar(jac * nstar);
+      Matrix const phijt(phi * jstar.transpose());
+      Matrix lstar;
+      pseudoInverse(jstar * phijt, 1e-4, lstar, 0);
+      updateNullspace(phijt, lstar, jstar, nstar);
+      
+      jspace::MatrixF const jstar_f(jac.cast<float>() * nstar_f);
+      jspace::MatrixF const phijt_f(phi_f * jstar_f.transpose());
+      jspace::MatrixF lstar_f;
+      pseudoInverse(jstar_f * phijt_f, 1e-4f, lstar_f, 0);
+      updateNullspace(phijt_f, lstar_f, jstar_f, nstar_f);
+      
+      std::ostringstream msg;
+      msg << "ndof " << ndof << " level " << level << " task dim " << kk << "\n";
+      pretty_print(lstar, msg, "  lstar", "    ");
+      pretty_print(Matrix(lstar_f.cast<double>()), msg, "  lstar_f", "    ");
+      EXPECT_LT ((lstar - lstar_f.cast<double>()).norm(), 1e-3 * (1 + lstar.norm())) << msg.str();
+      EXPECT_LT ((nstar - nstar_f.cast<double>()).norm(), 1e-3 * (1 + nstar.norm())) << msg.str();
+    }
+  }
+}
+
+
+TEST (jspaceLinalg, dense_qp_box)
+{
+  // With a diagonal Hessian and bounds on the variables only, the
+  // solution is the clamped unconstrained minimum.
+  srand(31);
+  DenseQP qp;
+  qp.init(8, 0, 16);
+  for (size_t trial(0); trial < 20; ++trial) {
+    size_t const nvar(1 + (rand() % 8));
+    Vector want(nvar);
+    qp.getHessian().setZero();
+    qp.getInequalityMatrix().setZero();
+    for (size_t ii(0); ii < nvar; ++ii) {
+      double const hh(0.5 + Vector::Random(1)[0] + 1);
+      double const ff(2.0 * Vector::Random(1)[0]);
+      double const lo(- 0.5 - 0.5 * (rand() % 2));
+      double const hi(0.5 + 0.5 * (rand() % 2));
+      qp.getHessian()(ii, ii) = hh;
+      qp.getGradient()[ii] = ff;
+      qp.getInequalityMatrix()(2 * ii, ii) = 1;
+      qp.getInequalityVector()[2 * ii] = lo;
+      qp.getInequalityMatrix()(2 * ii + 1, ii) = -1;
+      qp.getInequalityVector()[2 * ii + 1] = -hi;
+      want[ii] = - ff / hh;
+      if (want[ii] < lo) {
+	want[ii] = lo;
+      }
+      else if (want[ii] > hi) {
+	want[ii] = hi;
+      }
+    }
+    Status const st(qp.solve(nvar, 0, 2 * nvar));
+    ASSERT_TRUE (st.ok) << "trial " << trial << ": " << st.errstr;
+    Vector const have(qp.getSolution().segment(0, nvar));
+    std::ostringstream msg;
+    msg << "trial " << trial << "\n";
+    EXPECT_TRUE (check_vector("x", want, have, 1e-9, msg)) << msg.str();
+  }
+}
+
+
+TEST (jspaceLinalg, dense_qp_kkt)
+{
+  // Random feasible problems (the constraints are built around a
+  // random point), checked for feasibility and for non-negative
+  // multipliers of the active inequalities.
+  srand(37);
+  DenseQP qp;
+  qp.init(10, 2, 20);
+  for (size_t nvar(3); nvar <= 10; ++nvar) {
+    for (size_t trial(0); trial < 5; ++trial) {
+      size_t const neq(trial % 3);
+      size_t const nineq(2 * nvar);
+      Matrix const rr(Matrix::Random(nvar, nvar));
+      Matrix const hh(rr * rr.transpose() + 0.1 * Matrix::Identity(nvar, nvar));
+      Vector const ff(Vector::Random(nvar) * 5);
+      Matrix const ceq(Matrix::Random(neq, nvar));
+      Matrix const cin(Matrix::Random(nineq, nvar));
+      Vector const x0(Vector::Random(nvar) * 0.1);
+      Vector slack(Vector::Random(nineq));
+      slack = slack.cwise().abs();
+      Vector const deq(ceq * x0);
+      Vector const din(cin * x0 - slack);
+      
+      qp.getHessian().block(0, 0, nvar, nvar) = hh;
+      qp.getGradient().segment(0, nvar) = ff;
+      qp.getEqualityMatrix().block(0, 0, neq, nvar) = ceq;
+      qp.getEqualityVector().segment(0, neq) = deq;
+      qp.getInequalityMatrix().block(0, 0, nineq, nvar) = cin;
+      qp.getInequalityVector().segment(0, nineq) = din;
+      
+      std::ostringstream msg;
+      msg << "nvar " << nvar << " trial " << trial << "\n";
+      Status st(qp.solve(nvar, neq, nineq));
+      ASSERT_TRUE (st.ok) << msg.str() << st.errstr;
+      size_t const first_iterations(qp.getNIterations());
+      Vector const xx(qp.getSolution().segment(0, nvar));
+      
+      Vector const eq_err(ceq * xx - deq);
+      for (size_t ii(0); ii < neq; ++ii) {
+	EXPECT_NEAR (0, eq_err[ii], 1e-8) << msg.str() << "equality " << ii;
+      }
+      Vector const in_err(cin * xx - din);
+      size_t nactive(0);
+      for (size_t ii(0); ii < nineq; ++ii) {
+	EXPECT_GE (in_err[ii], -1e-8) << msg.str() << "inequality " << ii;
+	if (qp.isActive(ii)) {
+	  EXPECT_NEAR (0, in_err[ii], 1e-8) << msg.str() << "active inequality " << ii;
+	  ++nactive;
+	}
+      }
+      EXPECT_EQ (nactive, qp.getNActive()) << msg.str();
+      
+      // H x + f = C^T lambda, with lambda >= 0 for inequalities
+      Matrix cc(neq + nactive, nvar);
+      cc.block(0, 0, neq, nvar) = ceq;
+      for (size_t ii(0), jj(neq); ii < nineq; ++ii) {
+	if (qp.isActive(ii)) {
+	  cc.row(jj++) = cin.row(ii);
+	}
+      }
+      Vector const grad(hh * xx + ff);
+      if (0 == cc.rows()) {
+	EXPECT_LT (grad.norm(), 1e-8) << msg.str();
+      }
+      else {
+	Matrix ccti;
+	pseudoInverse(cc * cc.transpose(), 1e-10, ccti, 0);
+	Vector const lambda(ccti * (cc * grad));
+	EXPECT_LT ((grad - cc.transpose() * lambda).norm(), 1e-6) << msg.str();
+	for (size_t ii(neq); ii < neq + nactive; ++ii) {
+	  EXPECT_GE (lambda[ii], -1e-8) << msg.str() << "multiplier " << ii;
+	}
+      }
+      
+      // the same problem again starts from the active set
+      st = qp.solve(nvar, neq, nineq);
+      ASSERT_TRUE (st.ok) << msg.str() << st.errstr;
+      EXPECT_LE (qp.getNIterations(), first_iterations) << msg.str();
+    }
+  }
+}
+
+
+TEST (jspaceLinalg, dense_qp_infeasible)
+{
+  DenseQP qp;
+  qp.init(2, 1, 2);
+  qp.getHessian() = Matrix::Identity(2, 2);
+  qp.getGradient() = Vector::Zero(2);
+  qp.getInequalityMatrix() << 1, 0, -1, 0;
+  qp.getInequalityVector() << 1, 0; // x0 >= 1 and x0 <= 0
+  EXPECT_FALSE (qp.solve(2, 0, 2).ok);
+  EXPECT_TRUE (qp.solve(2, 0, 1).ok);
+  EXPECT_NEAR (1, qp.getSolution()[0], 1e-12);
+  qp.getEqualityMatrix() << 1, 1;
+  qp.getEqualityVector() << 3;
+  EXPECT_TRUE (qp.solve(2, 1, 1).ok);
+  EXPECT_NEAR (1.5, qp.getSolution()[0], 1e-12);
+  EXPECT_NEAR (1.5, qp.getSolution()[1], 1e-12);
+  qp.getHessian()(1, 1) = -1;
+  EXPECT_FALSE (qp.solve(2, 0, 0).ok);
+}
+
+
+namespace {
+  
+  // Couples joints 1 and 2 of the 5R model, a bit like the Dreamer
+  // torso, and counts how often it gets asked to update Jc.
+  class Coupled5RConstraint
+    : public jspace::Constraint
+  {
+  public:
+    explicit Coupled5RConstraint(bool sparse = false): nupdates_(0) {
+      U_ = Matrix::Zero(4, 5);
+      U_(0, 0) = 1; U_(1, 1) = 1; U_(2, 3) = 1; U_(3, 4) = 1;
+      Jc_ = Matrix::Zero(1, 5);
+      Jc_(0, 1) = 1; Jc_(0, 2) = -1;
+      if (sparse) {
+	jc_columns_.push_back(2);
+	jc_columns_.push_back(1);
+      }
+    }
+    
+    virtual Status updateJc(Model const & model) {
+      ++nupdates_;
+      Status ok;
+      return ok;
+    }
+    
+    virtual void getFullState(State const & state, State & fullState) {
+      fullState = state;
+    }
+    
+    size_t nupdates_;
+  };
+  
+}
+
+
+TEST (jspaceConstraint, cached_projection)
+{
+  jspace::Model * model(0);
+  try {
+    model = create_unit_mass_5R_model();
+    Coupled5RConstraint constraint;
+    jspace::State state(5, 5, 0);
+    
+    for (double qq(-M_PI); qq <= M_PI; qq += 2 * M_PI / 7) {
+      for (size_t ii(0); ii < 5; ++ii) {
+	state.position_[ii] = qq * (ii + 1) / 5.0;
+      }
+      model->update(state);
+      size_t const nupdates(constraint.nupdates_);
+      
+      Status st(constraint.updateProjection(*model));
+      ASSERT_TRUE (st) << "updateProjection failed: " << st.errstr;
+      ASSERT_EQ (nupdates + 1, constraint.nupdates_);
+      st = constraint.updateProjection(*model);
+      ASSERT_TRUE (st) << "second updateProjection failed: " << st.errstr;
+      EXPECT_EQ (nupdates + 1, constraint.nupdates_) << "same model state should not trigger an update";
+      
+      Matrix ainv;
+      ASSERT_TRUE (model->getInverseMassInertia(ainv));
+      Matrix UNc, UNcBar;
+      ASSERT_TRUE (constraint.getUNc(ainv, UNc));
+      ASSERT_TRUE (constraint.getUNcBar(ainv, UNcBar));
+      
+      std::ostringstream msg;
+      msg << "Checking cached projection for q = " << state.position_ << "\n";
+      jspace::constraint_projection_s const & projection(constraint.getProjection());
+      EXPECT_TRUE (check_matrix("UNc", UNc, projection.UNc, 1e-6, msg)) << msg.str();
+      EXPECT_TRUE (check_matrix("UNcBar", UNcBar, projection.UNcBar, 1e-6, msg)) << msg.str();
+      EXPECT_TRUE (check_matrix("phi", UNc * ainv * UNc.transpose(), projection.phi, 1e-6, msg)) << msg.str();
+      
+      // same configuration, new state version: reused without update
+      model->update(state);
+      st = constraint.updateProjection(*model);
+      ASSERT_TRUE (st) << "updateProjection failed: " << st.errstr;
+      EXPECT_EQ (nupdates + 1, constraint.nupdates_) << "unchanged configuration should not trigger an update";
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+TEST (jspaceConstraint, sparse_projection)
+{
+  jspace::Model * model(0);
+  try {
+    model = create_unit_mass_5R_model();
+    Coupled5RConstraint dense;
+    Coupled5RConstraint sparse(true);
+    jspace::State state(5, 5, 0);
+    
+    for (double qq(-M_PI); qq <= M_PI; qq += 2 * M_PI / 7) {
+      for (size_t ii(0); ii < 5; ++ii) {
+	state.position_[ii] = qq * (ii + 1) / 5.0;
+      }
+      model->update(state);
+      ASSERT_TRUE (dense.updateProjection(*model));
+      ASSERT_TRUE (sparse.updateProjection(*model));
+      
+      std::ostringstream msg;
+      msg << "Checking sparse projection for q = " << state.position_ << "\n";
+      jspace::constraint_projection_s const & dp(dense.getProjection());
+      jspace::constraint_projection_s const & sp(sparse.getProjection());
+      EXPECT_TRUE (check_matrix("Nc", dp.Nc, sp.Nc, 1e-9, msg)) << msg.str();
+      EXPECT_TRUE (check_matrix("UNcBar", dp.UNcBar, sp.UNcBar, 1e-9, msg)) << msg.str();
+    }
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+static char const * coupled_RRR_xml =
+  "<?xml version=\"1.0\" ?>\n"
+  "<dynworld>\n"
+  "  <baseNode>\n"
+  "    <gravity>0, 0, -9.81</gravity>\n"
+  "    <pos>0, 0, 0</pos>\n"
+  "    <rot>1, 0, 0, 0</rot>\n"
+  "    <jointNode>\n"
+  "      <jointName>j0</jointName>\n"
+  "      <linkName>l0</linkName>\n"
+  "      <ID>0</ID>\n"
+  "      <type>R</type>\n"
+  "      <axis>Z</axis>\n"
+  "      <mass>1</mass>\n"
+  "      <inertia>0, 0, 0</inertia>\n"
+  "      <com>1, 0, 0</com>\n"
+  "      <pos>0, 0, 0</pos>\n"
+  "      <rot>1, 0, 0, 0</rot>\n"
+  "      <constrained>0</constrained>\n"
+  "      <jointNode>\n"
+  "        <jointName>j1</jointName>\n"
+  "        <linkName>l1</linkName>\n"
+  "        <ID>1</ID>\n"
+  "        <type>R</type>\n"
+  "        <axis>Z</axis>\n"
+  "        <mass>1</mass>\n"
+  "        <inertia>0, 0, 0</inertia>\n"
+  "        <com>1, 0, 0</com>\n"
+  "        <pos>1, 0, 0</pos>\n"
+  "        <rot>1, 0, 0, 0</rot>\n"
+  "        <constrained>0</constrained>\n"
+  "        <jointNode>\n"
+  "          <jointName>j2</jointName>\n"
+  "          <linkName>l2</linkName>\n"
+  "          <ID>2</ID>\n"
+  "          <type>R</type>\n"
+  "          <axis>Z</axis>\n"
+  "          <mass>1</mass>\n"
+  "          <inertia>0, 0, 0</inertia>\n"
+  "          <com>1, 0, 0</com>\n"
+  "          <pos>1, 0, 0</pos>\n"
+  "          <rot>1, 0, 0, 0</rot>\n"
+  "          <constrained>1</constrained>\n"
+  "        </jointNode>\n"
+  "      </jointNode>\n"
+  "    </jointNode>\n"
+  "  </baseNode>\n"
+  "  <constraints>\n"
+  "    <coupledJoint>\n"
+  "      <master>j1</master>\n"
+  "      <slave>j2</slave>\n"
+  "      <ratio>2</ratio>\n"
+  "    </coupledJoint>\n"
+  "  </constraints>\n"
+  "</dynworld>\n";
+
+
+TEST (jspaceConstraint, xml_coupled_joint)
+{
+  jspace::Model * model(0);
+  try {
+    std::string const fname(create_tmpfile("coupled_RRR.xml.XXXXXX", coupled_RRR_xml));
+    model = parse_sai_xml_file(fname, false);
+    ASSERT_EQ (model->getNDOF(), 3);
+    ASSERT_EQ (model->getUnconstrainedNDOF(), 2);
+    jspace::Constraint * constraint(model->getConstraint());
+    ASSERT_NE ((jspace::Constraint*) 0, constraint) << "constraint should have been created from XML";
+    
+    Matrix U, Jc;
+    ASSERT_TRUE (constraint->getU(U));
+    ASSERT_TRUE (constraint->getJc(Jc));
+    Matrix U_check(Matrix::Zero(2, 3));
+    U_check(0, 0) = 1;
+    U_check(1, 1) = 1;
+    Matrix Jc_check(Matrix::Zero(1, 3));
+    Jc_check(0, 1) = 2;
+    Jc_check(0, 2) = -1;
+    std::ostringstream msg;
+    EXPECT_TRUE (check_matrix("U", U_check, U, 1e-9, msg)) << msg.str();
+    EXPECT_TRUE (check_matrix("Jc", Jc_check, Jc, 1e-9, msg)) << msg.str();
+    
+    jspace::State state(2, 2, 0);
+    state.position_ << 0.3, -0.2;
+    state.velocity_ << 0.1, 0.5;
+    model->update(state);
+    ASSERT_TRUE (constraint->updateProjection(*model));
+    Vector const & fullpos(model->getFullState().position_);
+    Vector const & fullvel(model->getFullState().velocity_);
+    ASSERT_EQ (fullpos.rows(), 3);
+    EXPECT_NEAR (fullpos[0], 0.3, 1e-9);
+    EXPECT_NEAR (fullpos[1], -0.2, 1e-9);
+    EXPECT_NEAR (fullpos[2], -0.4, 1e-9) << "slave should be twice the master";
+    EXPECT_NEAR (fullvel[2], 1.0, 1e-9) << "slave should be twice the master";
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
+
+TEST (jspaceConstraint, xml_cached)
+{
+  jspace::Model * model(0);
+  try {
+    std::string const fname(create_tmpfile("coupled_RRR.xml.XXXXXX", coupled_RRR_xml));
+    std::string const cachefname(fname + ".cache");
+    remove(cachefname.c_str());
+    for (size_t pass(0); pass < 3; ++pass) {
+      if (2 == pass) {
+	// editing the XML file has to invalidate the cache
+	std::ofstream os(fname.c_str(), std::ios::out | std::ios::app);
+	os << "<!-- edited -->\n";
+      }
+      std::ostringstream msg;
+      model = parse_sai_xml_file_cached(fname, cachefname, false, &msg);
+      if (1 == pass) {
+	EXPECT_TRUE (msg.str().empty()) << "second pass should use the cache\n" << msg.str();
+      }
+      else {
+	EXPECT_NE (std::string::npos, msg.str().find("rebuilding"))
+	  << "pass " << pass << " should rebuild the cache\n" << msg.str();
+      }
+      ASSERT_EQ (model->getNDOF(), 3);
+      ASSERT_EQ (model->getUnconstrainedNDOF(), 2);
+      ASSERT_NE ((jspace::Constraint*) 0, model->getConstraint()) << "constraint should be restored from the cache";
+      
+      jspace::State state(2, 2, 0);
+      state.position_ << 0.3, -0.2;
+      state.velocity_ << 0.1, 0.5;
+      model->update(state);
+      ASSERT_TRUE (model->getConstraint()->updateProjection(*model));
+      EXPECT_NEAR (model->getFullState().position_[2], -0.4, 1e-9) << "slave should be twice the master";
+      delete model;
+      model = 0;
+    }
+    remove(cachefname.c_str());
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+TEST (jspaceConstraint, builtin_spec)
+{
+  jspace::constraint_spec_s spec;
+  EXPECT_FALSE (get_builtin_constraint_spec("no_such_robot", spec));
+  ASSERT_TRUE (get_builtin_constraint_spec("Dreamer_Base", spec));
+  EXPECT_EQ (3, spec.rolling_wheel.size());
+  EXPECT_EQ (1, spec.floating_base.size());
+  EXPECT_EQ (0, spec.coupled_joint.size());
+  ASSERT_TRUE (get_builtin_constraint_spec("Dreamer_Torso", spec));
+  EXPECT_EQ (0, spec.rolling_wheel.size());
+  EXPECT_EQ (1, spec.coupled_joint.size());
+  ASSERT_TRUE (get_builtin_constraint_spec("Dreamer_Full", spec));
+  EXPECT_EQ (3, spec.rolling_wheel.size());
+  EXPECT_EQ (1, spec.floating_base.size());
+  EXPECT_EQ (1, spec.coupled_joint.size());
+  
+  // The builtin names only work on trees that have the right joints.
+  jspace::Model * model(0);
+  try {
+    model = create_unit_mass_5R_model();
+    EXPECT_EQ (0, model->setConstraint("Dreamer_Torso"));
+    EXPECT_EQ ((jspace::Constraint*) 0, model->getConstraint());
+  }
+  catch (std::exception const & ee) {
+    ADD_FAILURE () << "exception " << ee.what();
+  }
+  delete model;
+}
+
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -23,6 +23,7 @@
 #define OPSPACE_FACTORY_HPP
 
 #include <jspace/Status.hpp>
+#include <opspace/factory_cache.hpp>
 #include <boost/shared_ptr.hpp>
 #include <vector>
 #include <map>
@@ -150,6 +151,37 @@ namespace opspace {
     */
     Status parseStream(std::istream & yaml_istream);
     
+    /**
+       Like parseFile(), but instantiates the tasks and skills from a
+       binary skill cache (see opspace/factory_cache.hpp) if that
+       cache was built from the current contents of the YAML
+       file. Otherwise, the YAML file gets parsed and the cache is
+       (re)written for the next time. Failing to write the cache is
+       not an error, it just gets reported to msg (if non-NULL) along
+       with a note when the cache gets rebuilt.
+       
+       The cache holds everything that this Factory creates, so this
+       method refuses to work on a Factory that already contains
+       tasks or skills.
+    */
+    Status parseFileCached(std::string const & yaml_filename,
+			   std::string const & cache_filename,
+			   std::ostream * msg);
+    
+    /**
+       Create and configure the tasks and skills recorded in a
+       compiled specification, and append them to the tables. Each
+       type name gets resolved only once, regardless of how many
+       instances use it. Nothing gets appended if anything fails.
+    */
+    Status instantiate(FactorySpec const & spec);
+    
+    /**
+       The compiled specification of everything in the task and skill
+       tables, as recorded by parseStream() and instantiate().
+    */
+    FactorySpec const & getSpec() const { return spec_; }
+    
     /**
        The task table contains pointers to all task instances ever
        created by this Factory, in the order that they were
@@ -191,6 +223,7 @@ namespace opspace {
     
     task_table_t task_table_;
     skill_table_t skill_table_;
+    FactorySpec spec_;
   };
   
 }
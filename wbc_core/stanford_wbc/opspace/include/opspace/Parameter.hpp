@@ -287,6 +287,14 @@ namespace opspace {
 				       Matrix * matrix,
 				       parameter_flags_t flags = PARAMETER_FLAG_DEFAULT);
     
+    /**
+       Declare a parameter of a custom Parameter subclass, for
+       example one that does more than just write the value. The
+       parameter gets registered under its name_ and deleted along
+       with this ParameterReflection.
+    */
+    Parameter * declareParameter(Parameter * parameter);
+    
   private:
     parameter_lookup_t parameter_lookup_;
   };
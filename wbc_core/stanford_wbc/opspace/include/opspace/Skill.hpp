@@ -108,6 +108,18 @@ namespace opspace {
     virtual task_table_t const * getTaskTable() = 0;
     
     virtual Status init(Model const & model);
+    
+    /**
+       Called when the skill becomes active after another one, see
+       SkillSwitch. This happens inside the servo tick and after
+       init() has already succeeded once, so implementations should
+       avoid allocating memory. The default calls Task::handoff() for
+       all task instances in the slots, which makes e.g. trajectory
+       tasks restart from the current state of the model while they
+       keep their goals.
+    */
+    virtual Status handoff(Model const & model);
+    
     virtual Status checkJStarSV(Task const * task, Vector const & sv) { Status ok; return ok; }
     
     inline std::string const & getName() const { return name_; }
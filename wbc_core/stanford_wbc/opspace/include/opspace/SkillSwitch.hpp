@@ -0,0 +1,120 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+
+#ifndef OPSPACE_SKILL_SWITCH_HPP
+#define OPSPACE_SKILL_SWITCH_HPP
+
+#include <opspace/Skill.hpp>
+#include <opspace/Factory.hpp>
+
+namespace opspace {
+  
+  
+  /**
+     Holds a set of skills that all get initialized up front, and
+     selects which one of them is active. The "skill" parameter is the
+     index of the requested skill. It can be written at any time and
+     from any thread (for example through the parameter channels of
+     the ReflectionRegistry), see request(), and takes effect at the
+     next call to update(), which the servo loop makes at the start of
+     each tick. Switching thus never costs more than one tick, and
+     does not re-run the expensive parts of Skill::init() inside the
+     control loop.
+     
+     When a skill gets activated, its Skill::handoff() method is
+     called, which by default re-initializes its tasks from the
+     current state of the model. Trajectory tasks therefore start from
+     where the robot actually is, instead of jumping to wherever they
+     were left when the skill was last active.
+     
+     The read-only parameters "active", "latency", "max_latency", and
+     "switches" report the index of the active skill, the number of
+     ticks between the most recent request and the actual switch, the
+     maximum of that over all switches, and the number of switches
+     since init(). The latency is one tick unless update() does not
+     get called at every tick.
+  */
+  class SkillSwitch
+    : public ParameterReflection
+  {
+  public:
+    explicit SkillSwitch(std::string const & name);
+    
+    virtual Status check(int const * param, int value) const;
+    
+    /**
+       Request a switch to the skill with the given index. This is
+       what writing the "skill" parameter ends up calling. The index
+       and the current tick get published together in a single atomic
+       write, so it is safe to call this while another thread is
+       inside update().
+    */
+    Status request(int index);
+    
+    /**
+       Initialize all given skills and activate the one whose index
+       is currently stored in the "skill" parameter (zero by default).
+    */
+    Status init(Model const & model, Factory::skill_table_t const & skills);
+    
+    /**
+       Perform a pending switch, if any. Call this once per tick,
+       before using getActive(). If the handoff to the requested skill
+       fails, the previously active skill stays in place and the
+       pending request is dropped, unless a newer one came in
+       meanwhile.
+    */
+    Status update(Model const & model);
+    
+    /** \return The index of the given skill name, or -1 if there is
+	no skill of that name. */
+    int findSkill(std::string const & name) const;
+    
+    /** \return The active skill, or zero if init() has not succeeded
+	yet. */
+    inline Skill * getActive() const
+    { return (0 > active_) ? 0 : skills_[active_].get(); }
+    
+    inline int getActiveIndex() const { return active_; }
+    
+    inline Factory::skill_table_t const & getSkillTable() const { return skills_; }
+    
+    virtual void dump(std::ostream & os,
+		      std::string const & title,
+		      std::string const & prefix) const;
+    
+  protected:
+    Factory::skill_table_t skills_;
+    int request_;		// most recent request, as reflected
+    long long pending_;		// request index and tick, see request()
+    int active_;
+    int latency_;
+    int max_latency_;
+    int nswitches_;
+    int tick_;
+  };
+  
+}
+
+#endif // OPSPACE_SKILL_SWITCH_HPP
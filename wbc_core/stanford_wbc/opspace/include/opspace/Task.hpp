@@ -102,6 +102,17 @@ namespace opspace {
     */
     virtual Status init(Model const & model) = 0;
     
+    /**
+       Called instead of init() when the skill that contains this task
+       gets re-activated at runtime (see Skill::handoff()), i.e. inside
+       the servo tick. Implementations must not allocate memory and
+       must keep the goals that have been set. Tasks which follow a
+       trajectory should restart it from the current state of the
+       robot at their next update(). The default does nothing, which
+       is right for tasks that recompute everything in update().
+    */
+    virtual Status handoff(Model const & model);
+    
     /**
        Abstract, implemented by subclasses in order to compute the
        current task state, the command acceleration, and the
@@ -145,6 +156,18 @@ namespace opspace {
        set by subclasses in their update() method.
     */
     Matrix const & getJacobian() const { return jacobian_; }
+    
+    /**
+       \return A column-sparse version of getJacobian(), or NULL if
+       the task does not provide one. Tasks whose Jacobian only
+       involves the ancestors of a single node (e.g. a hand or head
+       position) can opt into this by setting sparse_jacobian_ and
+       has_sparse_jacobian_ in their update() method, which allows
+       Controller implementations to skip the zero columns. The dense
+       jacobian_ still has to be set as well.
+    */
+    jspace::SparseJacobian const * getSparseJacobian() const
+    { return has_sparse_jacobian_ ? &sparse_jacobian_ : 0; }
 
     Vector const & getForce() const { return force_; }
 
@@ -166,6 +189,8 @@ namespace opspace {
     Vector actual_;
     Vector command_;
     Matrix jacobian_;
+    jspace::SparseJacobian sparse_jacobian_;
+    bool has_sparse_jacobian_;
     Vector force_;
     
     /** Parameter "sigma_threshold", SVD cutoff value for pseudo
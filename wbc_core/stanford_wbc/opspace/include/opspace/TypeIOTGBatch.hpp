@@ -0,0 +1,200 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef OPSPACE_TYPE_I_OTG_BATCH_HPP
+#define OPSPACE_TYPE_I_OTG_BATCH_HPP
+
+#include <jspace/wrap_eigen.hpp>
+#include <reflexxes_otg/TypeIOTG.h>
+#include <vector>
+
+namespace opspace {
+
+  using jspace::Vector;
+
+
+  /**
+     Computes the same trajectories as reflexxes_otg::TypeIOTG, but
+     for any number of independent groups of DOF at once. Each group
+     corresponds to one TypeIOTG instance: its DOF are time
+     synchronized with each other, but not with the DOF of other
+     groups. For example, JointLimitTask uses one single-DOF group per
+     joint.
+
+     Instead of building the polynomial segments of each DOF one
+     after the other, next() runs over flat arrays that hold all DOF
+     of all groups, and evaluates the profile at the next cycle in
+     straight-line code. When compiling for AVX (e.g. with
+     -DTAO_SIMD=AVX), four DOF get processed per instruction, unless
+     DE_NO_SIMD is defined. The arithmetic is the same as in TypeIOTG,
+     so the results match to the last bit.
+
+     The current state is double buffered: next() writes into the
+     spare buffer and then makes it the current one, so nothing gets
+     copied. The references returned by position() and velocity()
+     thus change after each call to next().
+
+     Groups can also be switched to phase synchronization, see
+     setPhaseSync().
+  */
+  class TypeIOTGBatch
+  {
+  public:
+    double const dt_seconds_;
+
+    explicit TypeIOTGBatch(double dt_seconds);
+
+    /**
+       Append a group of ndof time-synchronized DOF. They occupy the
+       entries getGroupBegin() to getGroupBegin() + ndof - 1 of the
+       state and parameter vectors, and their position and velocity
+       is initialized to zero. Groups start out enabled.
+
+       \return The index of the new group.
+    */
+    size_t addGroup(size_t ndof);
+
+    /** Remove all groups. */
+    void clear();
+
+    inline size_t getNDOF() const { return sync_time_.size(); }
+    inline size_t getNGroups() const { return group_begin_.size(); }
+    inline size_t getGroupBegin(size_t group) const { return group_begin_[group]; }
+    inline size_t getGroupSize(size_t group) const { return group_size_[group]; }
+
+    /**
+       Disabled groups keep their position and velocity, and their
+       parameters do not get checked by next().
+    */
+    inline void setEnabled(size_t group, bool enabled) { enabled_[group] = enabled; }
+    inline bool isEnabled(size_t group) const { return enabled_[group]; }
+
+    /**
+       Phase-synchronized groups move along the straight line from
+       their current position to the goal, such that all their DOF
+       start and arrive together. The one-dimensional profile along
+       that line takes the shortest time allowed by the tightest
+       per-DOF velocity and acceleration limit. It gets planned when
+       the goal or the limits change (or the state was modified from
+       the outside), and then simply evaluated at each cycle.
+
+       If the group is moving at the time of planning, and its
+       velocity does not point along the line to the goal, a straight
+       line is not possible. In that case, the DOF move as if phase
+       synchronization were disabled until their velocity allows a
+       straight line again, typically when they come to rest at the
+       goal.
+    */
+    void setPhaseSync(size_t group, bool enabled);
+    inline bool isPhaseSync(size_t group) const { return phase_sync_[group]; }
+
+    /**
+       Advance all enabled groups by one cycle. The arrays have
+       getNDOF() entries.
+
+       Groups for which TypeIOTG would report an error keep their
+       current state. Their result is available from getResult().
+
+       \return The first error code in group order, if any group
+       failed. Otherwise TypeIOTG::OTG_WORKING if at least one group
+       is still moving, or TypeIOTG::OTG_FINAL_STATE_REACHED if all
+       enabled groups have arrived at their goal.
+    */
+    int next(double const * maxvel,
+	     double const * maxacc,
+	     double const * goal);
+
+    inline int next(Vector const & maxvel,
+		    Vector const & maxacc,
+		    Vector const & goal)
+    { return next(maxvel.data(), maxacc.data(), goal.data()); }
+
+    /** The TypeIOTG::TypeIOTGResult of the last call to next() for
+	the given group. */
+    inline int getResult(size_t group) const { return result_[group]; }
+
+    inline Vector & position()             { return pos_[current_]; }
+    inline Vector const & position() const { return pos_[current_]; }
+    inline Vector & velocity()             { return vel_[current_]; }
+    inline Vector const & velocity() const { return vel_[current_]; }
+
+  protected:
+    /** Profile along the line of a phase-synchronized group, with the
+	path parameter going from zero at the start to one at the
+	goal. */
+    struct path_plan_s {
+      bool valid;
+      bool arrived;
+      size_t tick;
+      double vel;		// initial path velocity
+      double maxvel;
+      double maxacc;
+      double duration;
+      double ss;		// path position and velocity at the last tick
+      double sd;
+    };
+
+    bool checkPlan(size_t group,
+		   double const * pos, double const * vel,
+		   double const * maxvel, double const * maxacc,
+		   double const * goal) const;
+
+    bool createPlan(size_t group,
+		    double const * pos, double const * vel,
+		    double const * maxvel, double const * maxacc,
+		    double const * goal);
+
+    int followPlan(size_t group, double * npos, double * nvel);
+
+    /** Enabled groups without error that do not follow a plan. */
+    inline bool isPerDOF(size_t group) const
+    { return enabled_[group] && (0 <= result_[group]) && ( ! planned_[group]); }
+
+    std::vector<size_t> group_begin_;
+    std::vector<size_t> group_size_;
+    std::vector<bool> enabled_;
+    std::vector<int> result_;
+    std::vector<bool> phase_sync_;
+    std::vector<bool> planned_;
+    std::vector<path_plan_s> plan_;
+
+    int current_;
+    Vector pos_[2];
+    Vector vel_[2];
+
+    // per-DOF scratch space for next()
+    std::vector<double> time_;
+    std::vector<double> sync_time_;
+    std::vector<double> status_;
+
+    // per-DOF data of the current phase-synchronized plans
+    std::vector<double> plan_start_;
+    std::vector<double> plan_delta_;
+    std::vector<double> plan_goal_;
+    std::vector<double> plan_maxvel_;
+    std::vector<double> plan_maxacc_;
+  };
+
+}
+
+#endif // OPSPACE_TYPE_I_OTG_BATCH_HPP
@@ -22,8 +22,7 @@
 #ifndef OPSPACE_TYPE_I_OTG_CURSOR_HPP
 #define OPSPACE_TYPE_I_OTG_CURSOR_HPP
 
-#include <jspace/wrap_eigen.hpp>
-#include <reflexxes_otg/TypeIOTG.h>
+#include <opspace/TypeIOTGBatch.hpp>
 
 namespace opspace {
   
@@ -41,6 +40,10 @@ namespace opspace {
      The idea is that you simply initialize it by setting the starting
      position() and velocity(), and then repeatedly call next() to
      advance to the next desired position and velocity.
+
+     Internally, this is a TypeIOTGBatch with a single group, so the
+     references returned by position() and velocity() switch between
+     two buffers at each call to next().
   */
   class TypeIOTGCursor
   {
@@ -76,21 +79,34 @@ namespace opspace {
     int next(double maxvel,
 	     double maxacc,
 	     double goal);
+
+    /**
+       Move all DOF along a straight line to the goal, such that they
+       arrive at the same time. See TypeIOTGBatch::setPhaseSync() for
+       the details. This is off by default, in which case each DOF
+       takes its own minimum-time trajectory (within the time of the
+       slowest one), so the path in general is not straight.
+    */
+    inline void setPhaseSync(bool enabled) { otg_.setPhaseSync(0, enabled); }
+    inline bool isPhaseSync() const { return otg_.isPhaseSync(0); }
+
+    /**
+       Make the next call to next() return OTG_WORKING with the given
+       position and velocity, instead of computing them. This is for
+       following a trajectory which was generated elsewhere, such as a
+       ViaPointTrajectory. After the last streamed state, next()
+       simply continues from there toward its goal.
+    */
+    void stream(Vector const & pos, Vector const & vel);
     
-    inline Vector & position()             { return pos_clean_; }
-    inline Vector const & position() const { return pos_clean_; }
-    inline Vector & velocity()             { return vel_clean_; }
-    inline Vector const & velocity() const { return vel_clean_; }
+    inline Vector & position()             { return otg_.position(); }
+    inline Vector const & position() const { return otg_.position(); }
+    inline Vector & velocity()             { return otg_.velocity(); }
+    inline Vector const & velocity() const { return otg_.velocity(); }
     
   protected:
-    typedef Eigen::Matrix<bool, Eigen::Dynamic, 1> boolvec_t;
-    
-    TypeIOTG otg_;
-    boolvec_t selection_;
-    Vector pos_clean_;
-    Vector vel_clean_;
-    Vector pos_dirty_;
-    Vector vel_dirty_;
+    TypeIOTGBatch otg_;
+    bool streamed_;
   };
   
 }
@@ -0,0 +1,115 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef OPSPACE_VIA_POINT_TRAJECTORY_HPP
+#define OPSPACE_VIA_POINT_TRAJECTORY_HPP
+
+#include <jspace/Status.hpp>
+#include <jspace/wrap_eigen.hpp>
+#include <vector>
+
+namespace opspace {
+
+  using jspace::Status;
+  using jspace::Vector;
+  using jspace::Matrix;
+
+
+  /**
+     A trajectory through a sequence of via points, consisting of
+     straight constant-velocity segments joined by parabolic blends
+     (constant acceleration). It starts at rest at the first point,
+     rounds the corners at the intermediate points without stopping,
+     and comes to rest at the last one. The velocity and acceleration
+     of each dimension stay within the given limits.
+
+     All the work happens in compute(), which is meant to be called
+     when the via points become known (typically from Skill::init()).
+     Afterwards, evaluate() just looks up the segment and evaluates a
+     polynomial of at most second degree, so it can be called at each
+     control cycle. The usual way to follow the trajectory is to
+     stream its samples into a task, e.g. with
+     PureCartPosTrjTask::stream().
+
+     The corners get cut: at an intermediate point where the velocity
+     changes by dv during a blend of duration tb, the trajectory passes
+     at a distance of |dv| * tb / 8.
+  */
+  class ViaPointTrajectory
+  {
+  public:
+    ViaPointTrajectory();
+
+    /**
+       Compute the trajectory from start through the given points.
+
+       \param start Where the trajectory starts (at rest).
+       \param points The via points, concatenated into one vector
+       which has a multiple of start.rows() entries. This is how the
+       multi-position skills store them in their parameters.
+       \param maxvel Velocity limit, either one per dimension or a
+       single value for all of them.
+       \param maxacc Acceleration limit, same dimension rules as
+       maxvel.
+    */
+    Status compute(Vector const & start,
+		   Vector const & points,
+		   Vector const & maxvel,
+		   Vector const & maxacc);
+
+    /** Forget the trajectory. isValid() returns false afterwards. */
+    void clear();
+
+    inline bool isValid() const { return ! time_.empty(); }
+    inline size_t getNDim() const { return points_.rows(); }
+
+    /** Number of points, including the start. */
+    inline size_t getNPoints() const { return time_.size(); }
+
+    /** Time at which the trajectory comes to rest at the last point. */
+    double getDuration() const;
+
+    /**
+       Index of the point that the trajectory is heading for at the
+       given time, i.e. the point whose blend has not yet been
+       completed. This is getNPoints() - 1 at and after the end.
+    */
+    size_t getTarget(double time) const;
+
+    /**
+       Compute the position, velocity, and acceleration at the given
+       time. Times before zero and after getDuration() yield the
+       start and end points, at rest.
+    */
+    void evaluate(double time, Vector & pos, Vector & vel, Vector & acc) const;
+
+  protected:
+    Matrix points_;		// one column per point
+    Matrix velocity_;		// one column per straight segment
+    std::vector<double> time_;	// when the (unblended) straight segments meet the points
+    std::vector<double> blend_;	// duration of the blend around each point
+  };
+
+}
+
+#endif // OPSPACE_VIA_POINT_TRAJECTORY_HPP
@@ -0,0 +1,146 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+
+#ifndef OPSPACE_FACTORY_CACHE_HPP
+#define OPSPACE_FACTORY_CACHE_HPP
+
+#include <opspace/Parameter.hpp>
+#include <stdint.h>
+#include <vector>
+
+namespace opspace {
+  
+  
+  /**
+     Version of the binary skill cache format. Caches written with a
+     different version are treated as stale.
+  */
+  static uint32_t const factory_cache_version(1);
+  
+  
+  /**
+     Compiled form of a task and skill specification. It records what
+     the YAML parser did to create and configure the instances, such
+     that Factory::instantiate() can repeat it without going through
+     YAML again: the type of each instance, the parameters that were
+     set and the values they ended up with, and the tasks that were
+     assigned to the slots of each skill.
+     
+     Type names and parameter (or slot) names are pooled into the
+     types and handles tables, and the instances refer to them by
+     index. Slot assignments refer to tasks by their index in the
+     tasks vector.
+  */
+  class FactorySpec
+  {
+  public:
+    struct value_s {
+      uint32_t handle;
+      parameter_type_t type;
+      int integer;
+      double real;
+      std::string string;
+      Vector vector;
+    };
+    
+    struct slot_s {
+      uint32_t handle;
+      uint32_t task;
+    };
+    
+    struct instance_s {
+      uint32_t type;
+      std::string name;
+      std::vector<value_s> values;
+      std::vector<slot_s> slots;
+    };
+    
+    typedef std::vector<std::pair<std::string, Parameter const *> > parameter_list_t;
+    typedef std::vector<std::pair<std::string, size_t> > slot_list_t;
+    
+    std::vector<std::string> types;
+    std::vector<std::string> handles;
+    std::vector<instance_s> tasks;
+    std::vector<instance_s> skills;
+    
+    void clear();
+    
+    /**
+       Record a task instance, along with the current values of the
+       given parameters (as set by the parser). Matrix parameters are
+       not supported and get skipped.
+    */
+    void appendTask(std::string const & type,
+		    std::string const & name,
+		    parameter_list_t const & parameters);
+    
+    /**
+       Record a skill instance. The slot list maps slot names to
+       indices into the tasks vector.
+    */
+    void appendSkill(std::string const & type,
+		     std::string const & name,
+		     parameter_list_t const & parameters,
+		     slot_list_t const & slots);
+    
+    /**
+       Append all instances of another spec, re-pooling its names and
+       shifting its slot assignments to refer to the tasks appended
+       from it.
+    */
+    void append(FactorySpec const & other);
+    
+  protected:
+    uint32_t pool(std::vector<std::string> & table, std::string const & name);
+    instance_s compile(std::string const & type,
+		       std::string const & name,
+		       parameter_list_t const & parameters);
+  };
+  
+  
+  /**
+     Write a FactorySpec to a binary skill cache. The layout follows
+     the jspace model cache: a fixed-size header (magic, version, byte
+     order marker, source hash, and a checksum of the rest), followed
+     by the name tables and the instance records.
+  */
+  Status write_factory_cache(std::string const & filename,
+			     uint64_t source_hash,
+			     FactorySpec const & spec);
+  
+  
+  /**
+     Read a FactorySpec that was written by write_factory_cache(). If
+     expected_hash is non-zero, the cache is rejected unless it was
+     written for that source hash. Fails if the file does not exist,
+     is not a skill cache, was written with another format version or
+     byte order, or is corrupt.
+  */
+  Status read_factory_cache(std::string const & filename,
+			    uint64_t expected_hash,
+			    FactorySpec & spec);
+  
+}
+
+#endif // OPSPACE_FACTORY_CACHE_HPP
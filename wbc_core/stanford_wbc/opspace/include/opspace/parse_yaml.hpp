@@ -51,6 +51,9 @@ namespace opspace {
     std::string type;
     std::string name;
     
+    /** The parameters that were set, in the order they appeared. */
+    FactorySpec::parameter_list_t parameters;
+    
     /** After successfully parsing a YAML node, this contains the
 	pointer to the freshly created task. If something goes wrong,
 	task will be zero.
@@ -71,6 +74,13 @@ namespace opspace {
     std::string type;
     std::string name;
     
+    /** The parameters that were set, in the order they appeared. */
+    FactorySpec::parameter_list_t parameters;
+    
+    /** The slot assignments, as indices into the task table of the
+	Factory. */
+    FactorySpec::slot_list_t slots;
+    
     /** After successfully parsing a YAML node, this contains the
 	pointer to the freshly created skill. If something goes
 	wrong, skill will be zero.
@@ -88,10 +98,14 @@ namespace opspace {
   public:
     TaskTableParser(Factory const & factory,
 		    Factory::task_table_t & task_table,
-		    std::ostream * optional_dbg_os = 0);
+		    std::ostream * optional_dbg_os = 0,
+		    FactorySpec * optional_spec = 0);
     
     TaskParser task_parser;    
     Factory::task_table_t & task_table;
+    
+    /** If non-zero, each created task also gets recorded here. */
+    FactorySpec * spec;
   };
   
   
@@ -101,10 +115,14 @@ namespace opspace {
   public:
     SkillTableParser(Factory const & factory,
 			Factory::skill_table_t & skill_table,
-			std::ostream * optional_dbg_os = 0);
+			std::ostream * optional_dbg_os = 0,
+			FactorySpec * optional_spec = 0);
     
     SkillParser skill_parser;    
     Factory::skill_table_t & skill_table;
+    
+    /** If non-zero, each created skill also gets recorded here. */
+    FactorySpec * spec;
   };  
   
   
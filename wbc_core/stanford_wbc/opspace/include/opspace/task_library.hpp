@@ -31,6 +31,7 @@
 namespace opspace {
   
   class TypeIOTGCursor;
+  class TypeIOTGBatch;
   
 
   /**
@@ -268,6 +269,9 @@ namespace opspace {
      - dt_seconds (real): iteration timestep, for trajectory generation
      - trjgoal (vector): trajectory end point
      - maxacc (vector): maximum acceleration of the trajectory
+     - phase_sync (integer): if non-zero, all dimensions move along a
+       straight line and arrive at the same time (see
+       TypeIOTGCursor::setPhaseSync())
      
      Subclasses should call initTrajectoryTask() from their init(),
      and computeTrajectoryCommand() from their computeCommand().
@@ -293,6 +297,24 @@ namespace opspace {
 		     std::string const & title,
 		     std::string const & prefix) const;
     
+    /**
+       Follow the given position and velocity (and add the given
+       acceleration to the command) at the next update, instead of
+       advancing the trajectory toward trjgoal. Calling this at each
+       cycle streams an externally generated trajectory, for example
+       a ViaPointTrajectory, into the task. When the stream stops,
+       the task continues toward trjgoal from the last streamed
+       state, so it is a good idea to set trjgoal to the end of the
+       streamed trajectory.
+    */
+    Status stream(Vector const & pos, Vector const & vel, Vector const & acc);
+    
+    /**
+       Makes the next update restart the trajectory from the current
+       position and velocity, toward the same trjgoal.
+    */
+    virtual Status handoff(Model const & model);
+    
   protected:
     typedef PDTask::saturation_policy_t saturation_policy_t;
     
@@ -321,6 +343,9 @@ namespace opspace {
     Vector trjgoal_;
     Vector maxacc_;
     mutable Vector qh_maxvel_;	// grr, cursor always needs multi-dim maxvel, even if saturation_norm
+    int phase_sync_;
+    Vector stream_acc_;
+    bool reseed_;		// set by handoff(), cleared by computeTrajectoryCommand()
   };
   
   
@@ -385,6 +410,7 @@ namespace opspace {
     virtual Status check(Vector const * param, Vector const & value) const;
     virtual Status check(double const * param, double const & value) const;
     virtual Status init(Model const & model);
+    virtual Status handoff(Model const & model);
     virtual Status update(Model const & model);
     
     virtual void dbg(std::ostream & os,
@@ -409,8 +435,11 @@ namespace opspace {
     Vector lower_stop_;
     Vector lower_trigger_;
     
-    std::vector<TypeIOTGCursor *> cursor_;
+    // One single-DOF group per joint, enabled once the joint has
+    // entered its trigger zone.
+    TypeIOTGBatch * otg_;
     Vector goal_;
+    bool reseed_;
 
     void updateState(Model const & model);
   };
@@ -512,6 +541,10 @@ namespace opspace {
   /**
      Joint space positioning using acceleration bounded trajectories
      with no velocity saturation
+
+     Set the phase_sync parameter to a non-zero value in order to
+     have all joints arrive at the same time, moving along a straight
+     line in joint space (see TypeIOTGCursor::setPhaseSync()).
    */
   class PureJPosTrjTask
     : public Task
@@ -521,11 +554,15 @@ namespace opspace {
     explicit PureJPosTrjTask(std::string const & name);
 
     virtual Status init(Model const & model);
+    virtual Status handoff(Model const & model);
     virtual Status update(Model const & model);
     virtual void dbg(std::ostream & os,
 		     std::string const & title,
 		     std::string const & prefix) const;
     
+    /** See TrajectoryTask::stream(). */
+    Status stream(Vector const & pos, Vector const & vel, Vector const & acc);
+    
     Vector kp_;
     Vector kd_;
     TypeIOTGCursor * cursor_;
@@ -533,11 +570,21 @@ namespace opspace {
     Vector trjgoal_;
     Vector maxacc_;
     Vector maxvel_;
+    int phase_sync_;
+    Vector stream_acc_;
+    bool reseed_;
   };
 
   /**
      Cartesian space positioning using acceleration bounded trajectories
      with no velocity saturation
+
+     Set the jdot_qdot parameter to a non-zero value in order to
+     subtract the velocity-product acceleration Jdot * qdot of the
+     control point from the command (see Model::computeJdotQdot()).
+
+     With a non-zero phase_sync parameter, the control point moves
+     along a straight line to trjgoal.
    */
   class PureCartPosTrjTask
     : public Task
@@ -547,11 +594,15 @@ namespace opspace {
     explicit PureCartPosTrjTask(std::string const & name);
 
     virtual Status init(Model const & model);
+    virtual Status handoff(Model const & model);
     virtual Status update(Model const & model);
     virtual void dbg(std::ostream & os,
 		     std::string const & title,
 		     std::string const & prefix) const;
 
+    /** See TrajectoryTask::stream(). */
+    Status stream(Vector const & pos, Vector const & vel, Vector const & acc);
+
   protected:
     virtual taoDNode const * updateActual(Model const & model);
     int end_effector_id_;
@@ -564,6 +615,10 @@ namespace opspace {
     Vector trjgoal_;
     Vector maxacc_;
     Vector maxvel_;
+    int jdot_qdot_;
+    int phase_sync_;
+    Vector stream_acc_;
+    bool reseed_;
 
   };
 
@@ -607,6 +662,7 @@ namespace opspace {
       - omega(float): frequency of rotation
       - xdir(vector)
       - ydir(vector) Together xdir and ydir define the plane of the circle
+      - jdot_qdot(int): non-zero to compensate for Jdot * qdot
 
    */
   class TestFFCartCircleTask
@@ -634,6 +690,7 @@ namespace opspace {
     Vector center_position_;
     double radius_;
     double omega_;
+    int jdot_qdot_;
   };
 
   class TestSpherePosTask
@@ -725,11 +782,15 @@ namespace opspace {
     explicit TestBaseControlTask(std::string const & name);
 
     virtual Status init(Model const & model);
+    virtual Status handoff(Model const & model);
     virtual Status update(Model const & model);
     virtual void dbg(std::ostream & os,
 		     std::string const & title,
 		     std::string const & prefix) const;
 
+    /** See TrajectoryTask::stream(). */
+    Status stream(Vector const & pos, Vector const & vel, Vector const & acc);
+
   protected:
     virtual taoDNode const * updateActual(Model const & model);
     int end_effector_id_;
@@ -743,7 +804,8 @@ namespace opspace {
     Vector maxacc_;
     Vector maxvel_;
     Vector tau_sensor_;
-
+    Vector stream_acc_;
+    bool reseed_;
   };
 
   class TestRemoteVelControlTask
@@ -24,7 +24,9 @@
 #include <opspace/task_library.hpp>
 #include <opspace/skill_library.hpp>
 #include <opspace/parse_yaml.hpp>
+#include <jspace/model_cache.hpp>
 #include <fstream>
+#include <sstream>
 #include <stdexcept>
 
 using jspace::pretty_print;
@@ -149,8 +151,8 @@ namespace opspace {
     try {
       YAML::Parser parser(yaml_istream);
       YAML::Node doc;
-      TaskTableParser task_table_parser(*this, task_table_, dbg__);
-      SkillTableParser skill_table_parser(*this, skill_table_, dbg__);
+      TaskTableParser task_table_parser(*this, task_table_, dbg__, &spec_);
+      SkillTableParser skill_table_parser(*this, skill_table_, dbg__, &spec_);
       
       parser.GetNextDocument(doc); // <sigh>this'll have merge conflicts again</sigh>
       //while (parser.GetNextDocument(doc)) {
@@ -194,6 +196,148 @@ namespace opspace {
   }
   
   
+  Status Factory::
+  parseFileCached(std::string const & yaml_filename,
+		  std::string const & cache_filename,
+		  std::ostream * msg)
+  {
+    if (( ! task_table_.empty()) || ( ! skill_table_.empty())) {
+      return Status(false, "parseFileCached() needs an empty Factory");
+    }
+    
+    std::ifstream is(yaml_filename.c_str());
+    if ( ! is) {
+      return Status(false, "could not open file `" + yaml_filename + "' for reading");
+    }
+    std::ostringstream yaml;
+    yaml << is.rdbuf();
+    uint64_t const hash(jspace::compute_model_hash(yaml.str()));
+    
+    FactorySpec cached;
+    Status st(read_factory_cache(cache_filename, hash, cached));
+    if (st) {
+      st = instantiate(cached);
+      if (st) {
+	return st;
+      }
+    }
+    if (msg) {
+      *msg << "rebuilding skill cache " << cache_filename << " from " << yaml_filename
+	   << "\n  reason: " << st.errstr << "\n";
+    }
+    
+    st = parseString(yaml.str());
+    if ( ! st) {
+      return st;
+    }
+    Status const wst(write_factory_cache(cache_filename, hash, spec_));
+    if (( ! wst) && msg) {
+      *msg << "failed to write skill cache " << cache_filename << ": " << wst.errstr << "\n";
+    }
+    return st;
+  }
+  
+  
+  static Status set_parameter(ParameterReflection & instance,
+			      std::string const & key,
+			      FactorySpec::value_s const & value)
+  {
+    Parameter * param(instance.lookupParameter(key, value.type));
+    if ( ! param) {
+      return Status(false, "no parameter called `" + key + "' in `" + instance.getName() + "'");
+    }
+    Status st;
+    switch (value.type) {
+    case PARAMETER_TYPE_INTEGER:
+      st = param->set(value.integer);
+      break;
+    case PARAMETER_TYPE_STRING:
+      st = param->set(value.string);
+      break;
+    case PARAMETER_TYPE_REAL:
+      st = param->set(value.real);
+      break;
+    default:
+      st = param->set(value.vector);
+    }
+    if ( ! st) {
+      st.errstr = "setting parameter `" + key + "' of `" + instance.getName() + "' failed: " + st.errstr;
+    }
+    return st;
+  }
+  
+  
+  Status Factory::
+  instantiate(FactorySpec const & spec)
+  {
+    init_shops();
+    
+    // Resolve each type name once. Task and skill types share the
+    // table, so either lookup may legitimately come up empty.
+    std::vector<ShopAPI<Task> *> task_shops(spec.types.size(), 0);
+    std::vector<ShopAPI<Skill> *> skill_shops(spec.types.size(), 0);
+    for (size_t ii(0); ii < spec.types.size(); ++ii) {
+      task_shop_t::const_iterator it(task_shop__.find(spec.types[ii]));
+      if (task_shop__.end() != it) {
+	task_shops[ii] = it->second.get();
+      }
+      skill_shop_t::const_iterator is(skill_shop__.find(spec.types[ii]));
+      if (skill_shop__.end() != is) {
+	skill_shops[ii] = is->second.get();
+      }
+    }
+    
+    task_table_t tasks;
+    for (size_t ii(0); ii < spec.tasks.size(); ++ii) {
+      FactorySpec::instance_s const & inst(spec.tasks[ii]);
+      if ( ! task_shops[inst.type]) {
+	return Status(false, "no task type `" + spec.types[inst.type] + "'");
+      }
+      boost::shared_ptr<Task> task(task_shops[inst.type]->create(inst.name));
+      for (size_t jj(0); jj < inst.values.size(); ++jj) {
+	Status const st(set_parameter(*task, spec.handles[inst.values[jj].handle], inst.values[jj]));
+	if ( ! st) {
+	  return st;
+	}
+      }
+      tasks.push_back(task);
+    }
+    
+    skill_table_t skills;
+    for (size_t ii(0); ii < spec.skills.size(); ++ii) {
+      FactorySpec::instance_s const & inst(spec.skills[ii]);
+      if ( ! skill_shops[inst.type]) {
+	return Status(false, "no skill type `" + spec.types[inst.type] + "'");
+      }
+      boost::shared_ptr<Skill> skill(skill_shops[inst.type]->create(inst.name));
+      for (size_t jj(0); jj < inst.values.size(); ++jj) {
+	Status const st(set_parameter(*skill, spec.handles[inst.values[jj].handle], inst.values[jj]));
+	if ( ! st) {
+	  return st;
+	}
+      }
+      for (size_t jj(0); jj < inst.slots.size(); ++jj) {
+	std::string const & slot_name(spec.handles[inst.slots[jj].handle]);
+	boost::shared_ptr<TaskSlotAPI> slot(skill->lookupSlot(slot_name));
+	if ( ! slot) {
+	  return Status(false, "skill `" + inst.name + "' has no slot `" + slot_name + "'");
+	}
+	Status const st(slot->assign(tasks[inst.slots[jj].task]));
+	if ( ! st) {
+	  return Status(false, "assigning to skill `" + inst.name + "' slot `" + slot_name
+			+ "' failed: " + st.errstr);
+	}
+      }
+      skills.push_back(skill);
+    }
+    
+    task_table_.insert(task_table_.end(), tasks.begin(), tasks.end());
+    skill_table_.insert(skill_table_.end(), skills.begin(), skills.end());
+    spec_.append(spec);
+    return Status();
+  }
+  
+  
   Factory::task_table_t const & Factory::
   getTaskTable() const
   {
@@ -497,6 +497,14 @@ namespace opspace {
   }
   
   
+  Parameter * ParameterReflection::
+  declareParameter(Parameter * parameter)
+  {
+    parameter_lookup_.insert(std::make_pair(parameter->name_, parameter));
+    return parameter;
+  }
+  
+  
   template<typename parameter_t, typename storage_t>
   bool maybe_append(std::vector<ParameterLog::log_s<parameter_t, storage_t> > & collection,
 		    Parameter const * parameter)
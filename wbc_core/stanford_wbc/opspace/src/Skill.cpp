@@ -34,7 +34,8 @@ namespace opspace {
   
   Skill::
   Skill(std::string const & name)
-    : ParameterReflection("skill", name)
+    : ParameterReflection("skill", name),
+      name_(name)
   {
   }
   
@@ -87,6 +88,21 @@ namespace opspace {
   }
   
   
+  Status Skill::
+  handoff(Model const & model)
+  {
+    for (slot_map_t::const_iterator is(slot_map_.begin()); is != slot_map_.end(); ++is) {
+      for (size_t it(0); it < is->second->getNInstances(); ++it) {
+	Status const st(is->second->getInstance(it)->handoff(model));
+	if ( ! st) {
+	  return st;
+	}
+      }
+    }
+    return Status();
+  }
+  
+  
   boost::shared_ptr<TaskSlotAPI> Skill::
   lookupSlot(std::string const & name)
   {
@@ -0,0 +1,212 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+
+#include <opspace/SkillSwitch.hpp>
+
+using boost::shared_ptr;
+
+
+namespace {
+  
+  // The pending request and the tick at which it was made share one
+  // word, so that writers and update() always see a matching pair.
+  
+  inline long long pack_request(int index, int tick)
+  {
+    return (static_cast<long long>(tick) << 32) | static_cast<unsigned int>(index);
+  }
+  
+  inline int request_index(long long pending)
+  {
+    return static_cast<int>(pending & 0xffffffffLL);
+  }
+  
+  inline int request_tick(long long pending)
+  {
+    return static_cast<int>(pending >> 32);
+  }
+  
+  
+  /** The "skill" parameter: writing it goes through
+      SkillSwitch::request() instead of just storing the value. */
+  class SkillRequestParameter
+    : public opspace::IntegerParameter
+  {
+  public:
+    SkillRequestParameter(opspace::SkillSwitch * skill_switch, int * instance)
+      : opspace::IntegerParameter("skill", opspace::PARAMETER_FLAG_DEFAULT, skill_switch, instance),
+	skill_switch_(skill_switch)
+    {
+    }
+    
+    virtual jspace::Status set(int integer)
+    {
+      return skill_switch_->request(integer);
+    }
+    
+  protected:
+    opspace::SkillSwitch * skill_switch_;
+  };
+  
+}
+
+
+namespace opspace {
+  
+  
+  SkillSwitch::
+  SkillSwitch(std::string const & name)
+    : ParameterReflection("switch", name),
+      request_(0),
+      pending_(pack_request(0, 0)),
+      active_(-1),
+      latency_(0),
+      max_latency_(0),
+      nswitches_(0),
+      tick_(0)
+  {
+    declareParameter(new SkillRequestParameter(this, &request_));
+    declareParameter("active", &active_, PARAMETER_FLAG_READONLY);
+    declareParameter("latency", &latency_, PARAMETER_FLAG_READONLY);
+    declareParameter("max_latency", &max_latency_, PARAMETER_FLAG_READONLY);
+    declareParameter("switches", &nswitches_, PARAMETER_FLAG_READONLY);
+  }
+  
+  
+  Status SkillSwitch::
+  check(int const * param, int value) const
+  {
+    if (param == &request_) {
+      if ((0 > value) || (( ! skills_.empty()) && (value >= static_cast<int>(skills_.size())))) {
+	return Status(false, "invalid skill index");
+      }
+    }
+    return Status();
+  }
+  
+  
+  Status SkillSwitch::
+  request(int index)
+  {
+    Status const st(check(&request_, index));
+    if ( ! st) {
+      return st;
+    }
+    request_ = index;
+    __sync_lock_test_and_set(&pending_, pack_request(index, __sync_fetch_and_add(&tick_, 0)));
+    return st;
+  }
+  
+  
+  Status SkillSwitch::
+  init(Model const & model, Factory::skill_table_t const & skills)
+  {
+    if (skills.empty()) {
+      return Status(false, "no skills");
+    }
+    if (request_ >= static_cast<int>(skills.size())) {
+      return Status(false, "invalid skill index");
+    }
+    for (size_t ii(0); ii < skills.size(); ++ii) {
+      Status const st(skills[ii]->init(model));
+      if ( ! st) {
+	return Status(false, "skill `" + skills[ii]->getName() + "': " + st.errstr);
+      }
+    }
+    skills_ = skills;
+    active_ = request_;
+    latency_ = 0;
+    max_latency_ = 0;
+    nswitches_ = 0;
+    tick_ = 0;
+    pending_ = pack_request(request_, 0);
+    return Status();
+  }
+  
+  
+  Status SkillSwitch::
+  update(Model const & model)
+  {
+    if (0 > active_) {
+      return Status(false, "not initialized");
+    }
+    int const tick(__sync_add_and_fetch(&tick_, 1));
+    
+    // Read the request only once: it can get written by another
+    // thread while we are in here.
+    long long const pending(__sync_fetch_and_add(&pending_, 0));
+    int const next(request_index(pending));
+    if (next == active_) {
+      return Status();
+    }
+    
+    Status const st(skills_[next]->handoff(model));
+    if ( ! st) {
+      // drop the failed request, unless a newer one came in
+      __sync_bool_compare_and_swap(&pending_, pending, pack_request(active_, tick));
+      return st;
+    }
+    active_ = next;
+    latency_ = tick - request_tick(pending);
+    if (latency_ > max_latency_) {
+      max_latency_ = latency_;
+    }
+    ++nswitches_;
+    return st;
+  }
+  
+  
+  int SkillSwitch::
+  findSkill(std::string const & name) const
+  {
+    for (size_t ii(0); ii < skills_.size(); ++ii) {
+      if (name == skills_[ii]->getName()) {
+	return ii;
+      }
+    }
+    return -1;
+  }
+  
+  
+  void SkillSwitch::
+  dump(std::ostream & os,
+       std::string const & title,
+       std::string const & prefix) const
+  {
+    if ( ! title.empty()) {
+      os << title << "\n";
+    }
+    os << prefix << "switch " << instance_name_ << "\n";
+    ParameterReflection::dump(os, prefix + "  parameters:", prefix + "    ");
+    os << prefix << "  skills:\n";
+    for (size_t ii(0); ii < skills_.size(); ++ii) {
+      os << prefix << "    [" << ii << "] " << skills_[ii]->getName();
+      if (static_cast<int>(ii) == active_) {
+	os << " (active)";
+      }
+      os << "\n";
+    }
+  }
+  
+}
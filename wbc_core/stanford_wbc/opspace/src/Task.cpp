@@ -33,6 +33,7 @@ namespace opspace {
   Task::
   Task(std::string const & name)
     : ParameterReflection("task", name),
+      has_sparse_jacobian_(false),
       sigma_threshold_(1.0e-2)
   {
     declareParameter("sigma_threshold", &sigma_threshold_);
@@ -45,6 +46,14 @@ namespace opspace {
   }
   
   
+  Status Task::
+  handoff(Model const & model)
+  {
+    Status ok;
+    return ok;
+  }
+  
+  
   void Task::
   dump(std::ostream & os, std::string const & title, std::string const & prefix) const
   {
@@ -0,0 +1,641 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include <opspace/TypeIOTGBatch.hpp>
+#include <reflexxes_otg/TypeIOTGMath.h>
+#include <math.h>
+
+#if ! defined(DE_NO_SIMD) && defined(__AVX__)
+# define OPSPACE_OTG_AVX
+# include <immintrin.h>
+#endif
+
+
+namespace {
+
+  //////////////////////////////////////////////////
+  // Lane primitives. The trajectory code below is written once as
+  // templates over the lane type T and mask type M, and instantiated
+  // for plain doubles (T=double, M=bool) and, when compiling for
+  // AVX, for four doubles at a time. Selecting between values instead
+  // of branching is what allows the latter. Note that all branches of
+  // the profile then get computed, which makes 2-wide SSE2 lanes
+  // slower than the scalar code (whose branches predict well).
+
+  inline double sel(bool mask, double aa, double bb) { return mask ? aa : bb; }
+  inline bool lt(double aa, double bb)     { return aa < bb; }
+  inline bool le(double aa, double bb)     { return aa <= bb; }
+  inline bool not_le(double aa, double bb) { return ! (aa <= bb); }
+  inline bool not_ge(double aa, double bb) { return ! (aa >= bb); }
+  inline bool mask_and(bool aa, bool bb)   { return aa && bb; }
+  inline bool mask_or(bool aa, bool bb)    { return aa || bb; }
+  inline bool mask_not(bool aa)            { return ! aa; }
+  inline double abs_val(double aa)         { return fabs(aa); }
+  inline double sqrt0(double aa)           { return (aa <= 0.0) ? 0.0 : sqrt(aa); }
+
+#ifdef OPSPACE_OTG_AVX
+
+  struct lane4 {
+    __m256d v;
+    inline lane4() {}
+    inline lane4(__m256d vv): v(vv) {}
+    inline explicit lane4(double dd): v(_mm256_set1_pd(dd)) {}
+  };
+
+  struct mask4 {
+    __m256d m;
+    inline mask4() {}
+    inline explicit mask4(__m256d mm): m(mm) {}
+  };
+
+  inline lane4 operator + (lane4 aa, lane4 bb) { return _mm256_add_pd(aa.v, bb.v); }
+  inline lane4 operator - (lane4 aa, lane4 bb) { return _mm256_sub_pd(aa.v, bb.v); }
+  inline lane4 operator * (lane4 aa, lane4 bb) { return _mm256_mul_pd(aa.v, bb.v); }
+  inline lane4 operator / (lane4 aa, lane4 bb) { return _mm256_div_pd(aa.v, bb.v); }
+  inline lane4 operator - (lane4 aa) { return _mm256_xor_pd(aa.v, _mm256_set1_pd(-0.0)); }
+
+  inline lane4 sel(mask4 mask, lane4 aa, lane4 bb)
+  { return _mm256_or_pd(_mm256_and_pd(mask.m, aa.v), _mm256_andnot_pd(mask.m, bb.v)); }
+  inline mask4 lt(lane4 aa, lane4 bb)     { return mask4(_mm256_cmp_pd(aa.v, bb.v, _CMP_LT_OQ)); }
+  inline mask4 le(lane4 aa, lane4 bb)     { return mask4(_mm256_cmp_pd(aa.v, bb.v, _CMP_LE_OQ)); }
+  inline mask4 not_le(lane4 aa, lane4 bb) { return mask4(_mm256_cmp_pd(aa.v, bb.v, _CMP_NLE_UQ)); }
+  inline mask4 not_ge(lane4 aa, lane4 bb) { return mask4(_mm256_cmp_pd(aa.v, bb.v, _CMP_NGE_UQ)); }
+  inline mask4 mask_and(mask4 aa, mask4 bb) { return mask4(_mm256_and_pd(aa.m, bb.m)); }
+  inline mask4 mask_or(mask4 aa, mask4 bb)  { return mask4(_mm256_or_pd(aa.m, bb.m)); }
+  inline mask4 mask_not(mask4 aa)
+  { return mask4(_mm256_xor_pd(aa.m, _mm256_castsi256_pd(_mm256_set1_epi32(-1)))); }
+  inline lane4 abs_val(lane4 aa) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), aa.v); }
+  inline lane4 sqrt0(lane4 aa)
+  { return sel(le(aa, lane4(0.0)), lane4(0.0), lane4(_mm256_sqrt_pd(aa.v))); }
+
+#endif // OPSPACE_OTG_AVX
+
+
+  //////////////////////////////////////////////////
+  // The profile of a DOF consists of up to two braking segments
+  // (down to maxvel, and down to zero if the goal would otherwise be
+  // overshot), followed by accelerate / hold / decelerate / rest. In
+  // TypeIOTG, the velocity is mirrored to be non-negative at the
+  // start and again after braking to zero. The expressions below
+  // are copied from TypeIOTGDecision.cpp and TypeIOTGProfiles.cpp,
+  // with the same evaluation order.
+
+  template<typename T, typename M>
+  struct prefix_s {
+    T sign0, pos0, vel0;	// frame of the braking segments
+    M brake_vmax;		// !Decision_2002
+    T end_vmax;
+    T pos1, vel1;
+    M brake_zero;		// !Decision_2003
+    T end_zero;
+    T sign, pos, vel, goal;	// frame of the remaining segments
+    T elapsed;
+    T time;			// step 1 execution time of the braking segments
+  };
+
+
+  template<typename T, typename M>
+  inline void compute_prefix(T pos, T vel, T maxvel, T maxacc, T goal,
+			     prefix_s<T, M> & pp)
+  {
+    T const zero(0.0);
+    T const half(0.5);
+
+    M const flip(lt(vel, zero));
+    pp.sign0 = sel(flip, T(-1.0), T(1.0));
+    pp.pos0 = sel(flip, -pos, pos);
+    pp.vel0 = sel(flip, -vel, vel);
+    goal = sel(flip, -goal, goal);
+
+    pp.brake_vmax = not_le(pp.vel0, maxvel);
+    T const tvmax((pp.vel0 - maxvel) / maxacc);
+    pp.end_vmax = abs_val(tvmax);
+    pp.pos1 = sel(pp.brake_vmax, pp.pos0 + half * (pp.vel0 * pp.vel0 - maxvel * maxvel) / maxacc, pp.pos0);
+    pp.vel1 = sel(pp.brake_vmax, maxvel, pp.vel0);
+    pp.time = sel(pp.brake_vmax, tvmax, zero);
+    T const elapsed(sel(pp.brake_vmax, pp.end_vmax, zero));
+
+    T const stop(pp.pos1 + half * (pp.vel1 * pp.vel1) / maxacc);
+    pp.brake_zero = not_le(stop, goal);
+    T const tzero(pp.vel1 / maxacc);
+    pp.end_zero = elapsed + abs_val(tzero);
+    pp.time = sel(pp.brake_zero, pp.time + tzero, pp.time);
+    pp.elapsed = sel(pp.brake_zero, pp.end_zero, elapsed);
+    pp.sign = sel(pp.brake_zero, -pp.sign0, pp.sign0);
+    pp.pos = sel(pp.brake_zero, -stop, pp.pos1);
+    pp.vel = sel(pp.brake_zero, -zero, pp.vel1);
+    pp.goal = sel(pp.brake_zero, -goal, goal);
+  }
+
+
+  /** Minimum execution time, TypeIOTG::CalculateMinimumSynchronizationTime() */
+  template<typename T, typename M>
+  inline T execution_time(T pos, T vel, T maxvel, T maxacc, T goal)
+  {
+    prefix_s<T, M> pp;
+    compute_prefix(pos, vel, maxvel, maxacc, goal, pp);
+    T const half(0.5);
+    T const two(2.0);
+    M const trap(le(pp.pos + (two * (maxvel * maxvel) - pp.vel * pp.vel) / (two * maxacc), pp.goal));
+    T const ttrap((pp.goal - pp.pos) / maxvel + (maxvel - pp.vel + half * (pp.vel * pp.vel) / maxvel) / maxacc);
+    T const ttri((two * sqrt0(maxacc * (pp.goal - pp.pos) + half * (pp.vel * pp.vel)) - pp.vel) / maxacc);
+    return pp.time + sel(trap, ttrap, ttri);
+  }
+
+
+  /**
+     State after dt seconds when synchronized to sync_time,
+     TypeIOTG::SynchronizeTrajectory() followed by
+     TypeIOTG::CalculateOutputValues(). The status is 0 while
+     moving, 1 in the final segment, and -1 if dt lies beyond all
+     segments.
+  */
+  template<typename T, typename M>
+  inline void state_at(T pos, T vel, T maxvel, T maxacc, T goal, T sync_time, T dt,
+		       T & npos, T & nvel, T & status)
+  {
+    prefix_s<T, M> pp;
+    compute_prefix(pos, vel, maxvel, maxacc, goal, pp);
+    T const zero(0.0);
+    T const half(0.5);
+    T const two(2.0);
+    T const four(4.0);
+
+    // ProfileStep2PosTrap and ProfileStep2NegHldNegLin
+    T const remaining(sync_time - pp.elapsed);
+    T const hold_trap(half * (maxacc * remaining + pp.vel)
+		      - half * sqrt0(four * maxacc * (pp.pos - pp.goal)
+				     + maxacc * remaining * (maxacc * remaining + two * pp.vel)
+				     - pp.vel * pp.vel));
+    T const denominator(two * maxacc * remaining - two * pp.vel);
+    T const hold_neg((two * maxacc * (pp.goal - pp.pos) - pp.vel * pp.vel) / denominator);
+    M const trap(mask_or(pp.brake_zero,
+			 le(pp.pos + sync_time * pp.vel - half * (pp.vel * pp.vel) / maxacc, pp.goal)));
+    M const degenerate(mask_and(mask_not(trap), lt(abs_val(denominator), T(OTG_DENOMINATOR_EPSILON))));
+    T const hold(sel(trap, hold_trap, sel(degenerate, pp.vel, hold_neg)));
+    T const time2(sel(degenerate, pp.elapsed,
+		      pp.elapsed + sel(trap, hold - pp.vel, pp.vel - hold) / maxacc));
+    T const time3(sel(degenerate, pp.elapsed, sync_time - hold / maxacc));
+    T const pos2(sel(degenerate, pp.pos, pp.pos + half * (time2 - pp.elapsed) * (hold + pp.vel)));
+    T const pos3(sel(degenerate, pp.pos, pp.goal - half * (sync_time - time3) * hold));
+    T const acc1(sel(trap, maxacc, -maxacc));
+
+    // Pick the first segment that ends after dt. Going backwards
+    // and overwriting yields the same as searching forwards.
+    M before(not_ge(dt, T(OTG_INFINITY)));
+    npos = pp.sign * pp.goal;
+    nvel = zero;
+    status = sel(before, T(1.0), T(-1.0));
+
+    T xx(dt - time3);
+    before = not_ge(dt, sync_time);
+    npos = sel(before, pp.sign * ((-half * maxacc) * xx * xx + hold * xx + pos3), npos);
+    nvel = sel(before, pp.sign * (-maxacc * xx + hold), nvel);
+    status = sel(before, zero, status);
+
+    xx = dt - time2;
+    before = not_ge(dt, time3);
+    npos = sel(before, pp.sign * (hold * xx + pos2), npos);
+    nvel = sel(before, pp.sign * hold, nvel);
+    status = sel(before, zero, status);
+
+    xx = dt - pp.elapsed;
+    before = not_ge(dt, time2);
+    npos = sel(before, pp.sign * ((half * acc1) * xx * xx + pp.vel * xx + pp.pos), npos);
+    nvel = sel(before, pp.sign * (acc1 * xx + pp.vel), nvel);
+    status = sel(before, zero, status);
+
+    xx = dt - pp.end_vmax;
+    before = mask_and(pp.brake_zero, not_ge(dt, pp.end_zero));
+    xx = sel(pp.brake_vmax, xx, dt);
+    npos = sel(before, pp.sign0 * ((-half * maxacc) * xx * xx + pp.vel1 * xx + pp.pos1), npos);
+    nvel = sel(before, pp.sign0 * (-maxacc * xx + pp.vel1), nvel);
+    status = sel(before, zero, status);
+
+    xx = dt;
+    before = mask_and(pp.brake_vmax, not_ge(dt, pp.end_vmax));
+    npos = sel(before, pp.sign0 * ((-half * maxacc) * xx * xx + pp.vel0 * xx + pp.pos0), npos);
+    nvel = sel(before, pp.sign0 * (-maxacc * xx + pp.vel0), nvel);
+    status = sel(before, zero, status);
+  }
+
+
+  void compute_execution_time(size_t ndof,
+			      double const * pos,
+			      double const * vel,
+			      double const * maxvel,
+			      double const * maxacc,
+			      double const * goal,
+			      double * time)
+  {
+    size_t ii(0);
+#ifdef OPSPACE_OTG_AVX
+    for (/**/; ii + 4 <= ndof; ii += 4) {
+      lane4 const tt(execution_time<lane4, mask4>(_mm256_loadu_pd(pos + ii),
+						   _mm256_loadu_pd(vel + ii),
+						   _mm256_loadu_pd(maxvel + ii),
+						   _mm256_loadu_pd(maxacc + ii),
+						   _mm256_loadu_pd(goal + ii)));
+      _mm256_storeu_pd(time + ii, tt.v);
+    }
+#endif // OPSPACE_OTG_AVX
+    for (/**/; ii < ndof; ++ii) {
+      time[ii] = execution_time<double, bool>(pos[ii], vel[ii], maxvel[ii], maxacc[ii], goal[ii]);
+    }
+  }
+
+
+  void compute_state(size_t ndof,
+		     double dt,
+		     double const * pos,
+		     double const * vel,
+		     double const * maxvel,
+		     double const * maxacc,
+		     double const * goal,
+		     double const * sync_time,
+		     double * npos,
+		     double * nvel,
+		     double * status)
+  {
+    size_t ii(0);
+#ifdef OPSPACE_OTG_AVX
+    lane4 const dt4(dt);
+    for (/**/; ii + 4 <= ndof; ii += 4) {
+      lane4 pp, vv, ss;
+      state_at<lane4, mask4>(_mm256_loadu_pd(pos + ii),
+			     _mm256_loadu_pd(vel + ii),
+			     _mm256_loadu_pd(maxvel + ii),
+			     _mm256_loadu_pd(maxacc + ii),
+			     _mm256_loadu_pd(goal + ii),
+			     _mm256_loadu_pd(sync_time + ii),
+			     dt4, pp, vv, ss);
+      _mm256_storeu_pd(npos + ii, pp.v);
+      _mm256_storeu_pd(nvel + ii, vv.v);
+      _mm256_storeu_pd(status + ii, ss.v);
+    }
+#endif // OPSPACE_OTG_AVX
+    for (/**/; ii < ndof; ++ii) {
+      state_at<double, bool>(pos[ii], vel[ii], maxvel[ii], maxacc[ii], goal[ii], sync_time[ii], dt,
+			     npos[ii], nvel[ii], status[ii]);
+    }
+  }
+
+}
+
+
+namespace opspace {
+
+
+  TypeIOTGBatch::
+  TypeIOTGBatch(double dt_seconds)
+    : dt_seconds_(dt_seconds),
+      current_(0)
+  {
+  }
+
+
+  size_t TypeIOTGBatch::
+  addGroup(size_t ndof)
+  {
+    size_t const begin(getNDOF());
+    size_t const group(group_begin_.size());
+    group_begin_.push_back(begin);
+    group_size_.push_back(ndof);
+    enabled_.push_back(true);
+    result_.push_back(TypeIOTG::OTG_FINAL_STATE_REACHED);
+    phase_sync_.push_back(false);
+    planned_.push_back(false);
+    path_plan_s plan;
+    plan.valid = false;
+    plan_.push_back(plan);
+
+    for (size_t ib(0); ib < 2; ++ib) {
+      Vector pos(Vector::Zero(begin + ndof));
+      Vector vel(Vector::Zero(begin + ndof));
+      for (size_t ii(0); ii < begin; ++ii) {
+	pos[ii] = pos_[ib][ii];
+	vel[ii] = vel_[ib][ii];
+      }
+      pos_[ib] = pos;
+      vel_[ib] = vel;
+    }
+    time_.resize(begin + ndof);
+    sync_time_.resize(begin + ndof);
+    status_.resize(begin + ndof);
+    plan_start_.resize(begin + ndof);
+    plan_delta_.resize(begin + ndof);
+    plan_goal_.resize(begin + ndof);
+    plan_maxvel_.resize(begin + ndof);
+    plan_maxacc_.resize(begin + ndof);
+
+    return group;
+  }
+
+
+  void TypeIOTGBatch::
+  clear()
+  {
+    group_begin_.clear();
+    group_size_.clear();
+    enabled_.clear();
+    result_.clear();
+    phase_sync_.clear();
+    planned_.clear();
+    plan_.clear();
+    current_ = 0;
+    for (size_t ib(0); ib < 2; ++ib) {
+      pos_[ib].resize(0);
+      vel_[ib].resize(0);
+    }
+    time_.clear();
+    sync_time_.clear();
+    status_.clear();
+    plan_start_.clear();
+    plan_delta_.clear();
+    plan_goal_.clear();
+    plan_maxvel_.clear();
+    plan_maxacc_.clear();
+  }
+
+
+  void TypeIOTGBatch::
+  setPhaseSync(size_t group, bool enabled)
+  {
+    if (enabled != phase_sync_[group]) {
+      phase_sync_[group] = enabled;
+      plan_[group].valid = false;
+    }
+  }
+
+
+  bool TypeIOTGBatch::
+  checkPlan(size_t group,
+	    double const * pos, double const * vel,
+	    double const * maxvel, double const * maxacc,
+	    double const * goal) const
+  {
+    path_plan_s const & plan(plan_[group]);
+    if ( ! plan.valid) {
+      return false;
+    }
+    size_t const begin(group_begin_[group]);
+    size_t const end(begin + group_size_[group]);
+    for (size_t ii(begin); ii < end; ++ii) {
+      if ((goal[ii] != plan_goal_[ii])
+	  || (maxvel[ii] != plan_maxvel_[ii])
+	  || (maxacc[ii] != plan_maxacc_[ii])) {
+	return false;
+      }
+      // The state should be what followPlan() wrote at the last tick,
+      // otherwise someone has moved the group elsewhere.
+      double const ppos(plan.arrived ? plan_goal_[ii] : plan_start_[ii] + plan.ss * plan_delta_[ii]);
+      double const pvel(plan.arrived ? 0.0 : plan.sd * plan_delta_[ii]);
+      if ((fabs(pos[ii] - ppos) > 1e-12 * (1.0 + fabs(ppos)))
+	  || (fabs(vel[ii] - pvel) > 1e-12 * (1.0 + fabs(pvel)))) {
+	return false;
+      }
+    }
+    return true;
+  }
+
+
+  bool TypeIOTGBatch::
+  createPlan(size_t group,
+	     double const * pos, double const * vel,
+	     double const * maxvel, double const * maxacc,
+	     double const * goal)
+  {
+    path_plan_s & plan(plan_[group]);
+    plan.valid = false;
+
+    size_t const begin(group_begin_[group]);
+    size_t const end(begin + group_size_[group]);
+    double dd(0.0);
+    double vd(0.0);
+    double vmax(1.0);
+    for (size_t ii(begin); ii < end; ++ii) {
+      double const delta(goal[ii] - pos[ii]);
+      dd += delta * delta;
+      vd += vel[ii] * delta;
+      if (fabs(vel[ii]) > vmax) {
+	vmax = fabs(vel[ii]);
+      }
+    }
+    if (0.0 == dd) {
+      return false;
+    }
+
+    double const sd0(vd / dd);
+    double svmax(OTG_INFINITY);
+    double samax(OTG_INFINITY);
+    for (size_t ii(begin); ii < end; ++ii) {
+      double const delta(goal[ii] - pos[ii]);
+      if (fabs(vel[ii] - sd0 * delta) > 1e-9 * vmax) {
+	return false;		// not moving along the line
+      }
+      double const dabs(fabs(delta));
+      if (dabs > 0.0) {
+	if (maxvel[ii] / dabs < svmax) {
+	  svmax = maxvel[ii] / dabs;
+	}
+	if (maxacc[ii] / dabs < samax) {
+	  samax = maxacc[ii] / dabs;
+	}
+      }
+      plan_start_[ii] = pos[ii];
+      plan_delta_[ii] = delta;
+      plan_goal_[ii] = goal[ii];
+      plan_maxvel_[ii] = maxvel[ii];
+      plan_maxacc_[ii] = maxacc[ii];
+    }
+
+    plan.vel = sd0;
+    plan.maxvel = svmax;
+    plan.maxacc = samax;
+    plan.duration = execution_time<double, bool>(0.0, sd0, svmax, samax, 1.0);
+    plan.tick = 0;
+    plan.ss = 0.0;
+    plan.sd = sd0;
+    plan.arrived = false;
+    plan.valid = true;
+    return true;
+  }
+
+
+  int TypeIOTGBatch::
+  followPlan(size_t group, double * npos, double * nvel)
+  {
+    path_plan_s & plan(plan_[group]);
+    ++plan.tick;
+    double status;
+    state_at<double, bool>(0.0, plan.vel, plan.maxvel, plan.maxacc, 1.0, plan.duration,
+			   plan.tick * dt_seconds_, plan.ss, plan.sd, status);
+    if (0.0 > status) {
+      plan.valid = false;
+      return TypeIOTG::OTG_ERROR;
+    }
+    plan.arrived = (0.0 < status);
+
+    size_t const begin(group_begin_[group]);
+    size_t const end(begin + group_size_[group]);
+    if (plan.arrived) {
+      for (size_t ii(begin); ii < end; ++ii) {
+	npos[ii] = plan_goal_[ii];
+	nvel[ii] = 0.0;
+      }
+      return TypeIOTG::OTG_FINAL_STATE_REACHED;
+    }
+    for (size_t ii(begin); ii < end; ++ii) {
+      npos[ii] = plan_start_[ii] + plan.ss * plan_delta_[ii];
+      nvel[ii] = plan.sd * plan_delta_[ii];
+    }
+    return TypeIOTG::OTG_WORKING;
+  }
+
+
+  int TypeIOTGBatch::
+  next(double const * maxvel,
+       double const * maxacc,
+       double const * goal)
+  {
+    size_t const ndof(getNDOF());
+    if (0 == ndof) {
+      return TypeIOTG::OTG_FINAL_STATE_REACHED;
+    }
+    size_t const ngroups(group_begin_.size());
+    int const spare(1 - current_);
+    double const * pos(pos_[current_].data());
+    double const * vel(vel_[current_].data());
+    double * npos(pos_[spare].data());
+    double * nvel(vel_[spare].data());
+
+    // Check the parameters, and see which phase-synchronized groups
+    // have (or can get) a plan.
+    for (size_t ig(0); ig < ngroups; ++ig) {
+      result_[ig] = TypeIOTG::OTG_FINAL_STATE_REACHED;
+      planned_[ig] = false;
+      if ( ! enabled_[ig]) {
+	continue;
+      }
+      size_t const begin(group_begin_[ig]);
+      size_t const end(begin + group_size_[ig]);
+      for (size_t ii(begin); ii < end; ++ii) {
+	if (maxvel[ii] < OTG_MIN_VALUE_FOR_MAXVELOCITY) {
+	  result_[ig] = TypeIOTG::OTG_MAX_VELOCITY_ERROR;
+	  break;
+	}
+	if (maxacc[ii] < OTG_MIN_VALUE_FOR_MAXACCELERATION) {
+	  result_[ig] = TypeIOTG::OTG_MAX_ACCELERATION_ERROR;
+	  break;
+	}
+      }
+      if (phase_sync_[ig] && (0 <= result_[ig])) {
+	planned_[ig] = checkPlan(ig, pos, vel, maxvel, maxacc, goal)
+	  || createPlan(ig, pos, vel, maxvel, maxacc, goal);
+      }
+    }
+
+    // All other enabled groups get synchronized to their slowest
+    // DOF, as in TypeIOTG::GetNextMotionState_Position(). Each
+    // contiguous run of such groups goes through the kernels in one
+    // piece.
+    size_t ig(0);
+    while (ig < ngroups) {
+      if ( ! isPerDOF(ig)) {
+	++ig;
+	continue;
+      }
+      size_t jg(ig + 1);
+      while ((jg < ngroups) && isPerDOF(jg)) {
+	++jg;
+      }
+      size_t const begin(group_begin_[ig]);
+      size_t const end(group_begin_[jg - 1] + group_size_[jg - 1]);
+
+      compute_execution_time(end - begin, pos + begin, vel + begin,
+			     maxvel + begin, maxacc + begin, goal + begin, &time_[begin]);
+      for (size_t kg(ig); kg < jg; ++kg) {
+	size_t const kbegin(group_begin_[kg]);
+	size_t const kend(kbegin + group_size_[kg]);
+	double tsync(0.0);
+	for (size_t ii(kbegin); ii < kend; ++ii) {
+	  if (time_[ii] > tsync) {
+	    tsync = time_[ii];
+	  }
+	}
+	for (size_t ii(kbegin); ii < kend; ++ii) {
+	  sync_time_[ii] = tsync;
+	}
+      }
+
+      compute_state(end - begin, dt_seconds_, pos + begin, vel + begin,
+		    maxvel + begin, maxacc + begin, goal + begin, &sync_time_[begin],
+		    npos + begin, nvel + begin, &status_[begin]);
+
+      for (size_t kg(ig); kg < jg; ++kg) {
+	size_t const kbegin(group_begin_[kg]);
+	size_t const kend(kbegin + group_size_[kg]);
+	for (size_t ii(kbegin); ii < kend; ++ii) {
+	  if (0 > status_[ii]) {
+	    result_[kg] = TypeIOTG::OTG_ERROR;
+	    break;
+	  }
+	  if (0 == status_[ii]) {
+	    result_[kg] = TypeIOTG::OTG_WORKING;
+	  }
+	}
+      }
+
+      ig = jg;
+    }
+
+    int result(TypeIOTG::OTG_FINAL_STATE_REACHED);
+    bool failed(false);
+    for (size_t ig(0); ig < ngroups; ++ig) {
+      if (planned_[ig]) {
+	result_[ig] = followPlan(ig, npos, nvel);
+      }
+      if (( ! enabled_[ig]) || (0 > result_[ig])) {
+	size_t const begin(group_begin_[ig]);
+	size_t const end(begin + group_size_[ig]);
+	for (size_t ii(begin); ii < end; ++ii) {
+	  npos[ii] = pos[ii];
+	  nvel[ii] = vel[ii];
+	}
+      }
+      if (enabled_[ig] && ( ! failed)) {
+	if (0 > result_[ig]) {
+	  result = result_[ig];
+	  failed = true;
+	}
+	else if (TypeIOTG::OTG_WORKING == result_[ig]) {
+	  result = TypeIOTG::OTG_WORKING;
+	}
+      }
+    }
+
+    current_ = spare;
+    return result;
+  }
+
+}
@@ -28,16 +28,10 @@ namespace opspace {
   TypeIOTGCursor(size_t ndof, double dt_seconds)
     : ndof_(ndof),
       dt_seconds_(dt_seconds),
-      otg_(ndof, dt_seconds)
+      otg_(dt_seconds),
+      streamed_(false)
   {
-    pos_clean_ = Vector::Zero(ndof);
-    vel_clean_ = Vector::Zero(ndof);
-    pos_dirty_ = Vector::Zero(ndof);
-    vel_dirty_ = Vector::Zero(ndof);
-    selection_.resize(ndof);
-    for (size_t ii(0); ii < ndof; ++ii) {
-      selection_[ii] = true;
-    }
+    otg_.addGroup(ndof);
   }
   
   
@@ -46,19 +40,11 @@ namespace opspace {
        Vector const & maxacc,
        Vector const & goal)
   {
-    int const result(otg_.GetNextMotionState_Position(pos_clean_.data(),
-						      vel_clean_.data(),
-						      maxvel.data(),
-						      maxacc.data(),
-						      goal.data(),
-						      selection_.data(),
-						      pos_dirty_.data(),
-						      vel_dirty_.data()));
-    if (0 <= result) {
-      pos_clean_ = pos_dirty_;
-      vel_clean_ = vel_dirty_;
+    if (streamed_) {
+      streamed_ = false;
+      return TypeIOTG::OTG_WORKING;
     }
-    return result;
+    return otg_.next(maxvel, maxacc, goal);
   }
   
   
@@ -70,19 +56,20 @@ namespace opspace {
     if (ndof_ != 1) {
       return -1000;
     }
-    int const result(otg_.GetNextMotionState_Position(pos_clean_.data(),
-						      vel_clean_.data(),
-						      &maxvel,
-						      &maxacc,
-						      &goal,
-						      selection_.data(),
-						      pos_dirty_.data(),
-						      vel_dirty_.data()));
-    if (0 <= result) {
-      pos_clean_ = pos_dirty_;
-      vel_clean_ = vel_dirty_;
+    if (streamed_) {
+      streamed_ = false;
+      return TypeIOTG::OTG_WORKING;
     }
-    return result;
+    return otg_.next(&maxvel, &maxacc, &goal);
+  }
+  
+  
+  void TypeIOTGCursor::
+  stream(Vector const & pos, Vector const & vel)
+  {
+    otg_.position() = pos;
+    otg_.velocity() = vel;
+    streamed_ = true;
   }
   
   
@@ -0,0 +1,277 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include <opspace/ViaPointTrajectory.hpp>
+#include <math.h>
+
+
+namespace {
+
+  bool blow_up(jspace::Vector const & in, size_t ndim, jspace::Vector & out)
+  {
+    if (static_cast<size_t>(in.rows()) == ndim) {
+      out = in;
+      return true;
+    }
+    if (1 == in.rows()) {
+      out = in[0] * jspace::Vector::Ones(ndim);
+      return true;
+    }
+    return false;
+  }
+
+
+  /** Segment velocities and blend durations for the given segment durations. */
+  void compute_blends(jspace::Matrix const & points,
+		      jspace::Vector const & maxacc,
+		      std::vector<double> const & duration,
+		      jspace::Matrix & vel,
+		      std::vector<double> & blend)
+  {
+    size_t const ndim(points.rows());
+    size_t const nseg(duration.size());
+    for (size_t kk(0); kk < nseg; ++kk) {
+      if (duration[kk] > 0) {
+	vel.col(kk) = (points.col(kk + 1) - points.col(kk)) / duration[kk];
+      }
+      else {
+	vel.col(kk) = jspace::Vector::Zero(ndim);
+      }
+    }
+    for (size_t kk(0); kk <= nseg; ++kk) {
+      blend[kk] = 0;
+      for (size_t ii(0); ii < ndim; ++ii) {
+	double const vin((kk > 0) ? vel(ii, kk - 1) : 0.0);
+	double const vout((kk < nseg) ? vel(ii, kk) : 0.0);
+	double const tt(fabs(vout - vin) / maxacc[ii]);
+	if (tt > blend[kk]) {
+	  blend[kk] = tt;
+	}
+      }
+    }
+  }
+
+}
+
+
+namespace opspace {
+
+
+  ViaPointTrajectory::
+  ViaPointTrajectory()
+  {
+  }
+
+
+  void ViaPointTrajectory::
+  clear()
+  {
+    points_.resize(0, 0);
+    velocity_.resize(0, 0);
+    time_.clear();
+    blend_.clear();
+  }
+
+
+  Status ViaPointTrajectory::
+  compute(Vector const & start,
+	  Vector const & points,
+	  Vector const & maxvel,
+	  Vector const & maxacc)
+  {
+    clear();
+
+    size_t const ndim(start.rows());
+    if (0 == ndim) {
+      return Status(false, "empty start position");
+    }
+    if ((0 == points.rows()) || (0 != points.rows() % ndim)) {
+      return Status(false, "number of via point entries is not a multiple of the dimension");
+    }
+    Vector vmax, amax;
+    if ( ! blow_up(maxvel, ndim, vmax)) {
+      return Status(false, "invalid maxvel dimension");
+    }
+    if ( ! blow_up(maxacc, ndim, amax)) {
+      return Status(false, "invalid maxacc dimension");
+    }
+    for (size_t ii(0); ii < ndim; ++ii) {
+      if (vmax[ii] <= 0) {
+	return Status(false, "maxvel has to be positive");
+      }
+      if (amax[ii] <= 0) {
+	return Status(false, "maxacc has to be positive");
+      }
+    }
+
+    size_t const npoints(1 + points.rows() / ndim);
+    size_t const nseg(npoints - 1);
+    Matrix pp(ndim, npoints);
+    pp.col(0) = start;
+    for (size_t kk(1); kk < npoints; ++kk) {
+      for (size_t ii(0); ii < ndim; ++ii) {
+	pp(ii, kk) = points[ndim * (kk - 1) + ii];
+      }
+    }
+
+    // Start with each straight segment at the velocity limit of its
+    // slowest dimension. Segments which are too short to hold half of
+    // the blends at either end then need to be lengthened, which
+    // lowers their velocity and thus changes the blends. First relax
+    // the durations toward what the blends need (this may also
+    // shorten segments again which were lengthened too much), then
+    // lengthen them until everything fits. The latter overshoots by
+    // one percent to make sure it does not take forever.
+    std::vector<double> shortest(nseg, 0.0);
+    for (size_t kk(0); kk < nseg; ++kk) {
+      for (size_t ii(0); ii < ndim; ++ii) {
+	double const tt(fabs(pp(ii, kk + 1) - pp(ii, kk)) / vmax[ii]);
+	if (tt > shortest[kk]) {
+	  shortest[kk] = tt;
+	}
+      }
+    }
+    std::vector<double> duration(shortest);
+    Matrix vel(ndim, nseg);
+    std::vector<double> blend(npoints);
+    static size_t const nrelax(100);
+    for (size_t iteration(0); /**/; ++iteration) {
+      compute_blends(pp, amax, duration, vel, blend);
+      bool fits(true);
+      for (size_t kk(0); kk < nseg; ++kk) {
+	double const need(0.5 * (blend[kk] + blend[kk + 1]));
+	if (iteration < nrelax) {
+	  duration[kk] = 0.5 * (duration[kk] + need);
+	  if (duration[kk] < shortest[kk]) {
+	    duration[kk] = shortest[kk];
+	  }
+	}
+	else if (need > duration[kk]) {
+	  duration[kk] = 1.01 * need;
+	  fits = false;
+	}
+      }
+      if (iteration < nrelax) {
+	continue;
+      }
+      if (fits) {
+	break;
+      }
+      if (iteration >= nrelax + 1000) {
+	return Status(false, "failed to fit the blends between the via points");
+      }
+    }
+
+    points_ = pp;
+    velocity_ = vel;
+    blend_ = blend;
+    time_.resize(npoints);
+    time_[0] = 0.5 * blend[0];
+    for (size_t kk(0); kk < nseg; ++kk) {
+      time_[kk + 1] = time_[kk] + duration[kk];
+    }
+
+    Status ok;
+    return ok;
+  }
+
+
+  double ViaPointTrajectory::
+  getDuration() const
+  {
+    if (time_.empty()) {
+      return 0;
+    }
+    return time_.back() + 0.5 * blend_.back();
+  }
+
+
+  size_t ViaPointTrajectory::
+  getTarget(double time) const
+  {
+    // The blends do not overlap, so their end times are sorted.
+    size_t lo(0);
+    size_t hi(time_.size());
+    while (lo < hi) {
+      size_t const mid((lo + hi) / 2);
+      if (time_[mid] + 0.5 * blend_[mid] > time) {
+	hi = mid;
+      }
+      else {
+	lo = mid + 1;
+      }
+    }
+    if (lo >= time_.size()) {
+      return time_.size() - 1;
+    }
+    return lo;
+  }
+
+
+  void ViaPointTrajectory::
+  evaluate(double time, Vector & pos, Vector & vel, Vector & acc) const
+  {
+    size_t const ndim(points_.rows());
+    size_t const nseg(velocity_.cols());
+    pos.resize(ndim);
+    vel.resize(ndim);
+    acc.resize(ndim);
+    if (time_.empty()) {
+      return;
+    }
+
+    size_t const kk(getTarget(time));
+    double const begin(time_[kk] - 0.5 * blend_[kk]);
+
+    if ((kk == nseg) && (time >= time_[kk] + 0.5 * blend_[kk])) {
+      pos = points_.col(kk);
+      vel = Vector::Zero(ndim);
+      acc = Vector::Zero(ndim);
+    }
+    else if (time >= begin) {
+      // blend around point kk
+      double const xx(time - begin);
+      for (size_t ii(0); ii < ndim; ++ii) {
+	double const vin((kk > 0) ? velocity_(ii, kk - 1) : 0.0);
+	double const vout((kk < nseg) ? velocity_(ii, kk) : 0.0);
+	double const aa((blend_[kk] > 0) ? (vout - vin) / blend_[kk] : 0.0);
+	pos[ii] = points_(ii, kk) - 0.5 * vin * blend_[kk] + vin * xx + 0.5 * aa * xx * xx;
+	vel[ii] = vin + aa * xx;
+	acc[ii] = aa;
+      }
+    }
+    else if (0 == kk) {
+      // not started yet
+      pos = points_.col(0);
+      vel = Vector::Zero(ndim);
+      acc = Vector::Zero(ndim);
+    }
+    else {
+      // straight segment from point kk-1 to point kk
+      pos = points_.col(kk - 1) + (time - time_[kk - 1]) * velocity_.col(kk - 1);
+      vel = velocity_.col(kk - 1);
+      acc = Vector::Zero(ndim);
+    }
+  }
+
+}
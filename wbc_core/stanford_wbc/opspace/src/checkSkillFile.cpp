@@ -39,7 +39,13 @@ int main(int argc, char ** argv)
   Status st;
   Factory::setDebugStream(&cout);
     try {
-      st = factory.parseFile(argv[1]);
+      if (argc > 3) {
+	// also compile the skill file into a cache, e.g. for the servo
+	st = factory.parseFileCached(argv[1], argv[3], &cout);
+      }
+      else {
+	st = factory.parseFile(argv[1]);
+      }
       if ( ! st) {
 	std::cout << "ERROR parsing skill file `" << argv[1]
 		  << "':\n  " << st.errstr << "\n";
@@ -0,0 +1,465 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+
+#include <opspace/factory_cache.hpp>
+#include <jspace/model_cache.hpp>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+#include <stdio.h>
+
+
+namespace {
+  
+  char const cache_magic[8] = { 'W', 'B', 'C', 'S', 'K', 'I', 'L', 'L' };
+  uint32_t const cache_byte_order(0x01020304);
+  
+  
+  struct cache_header_s {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t source_hash;
+    uint64_t checksum;		// of everything that follows the header
+    uint64_t body_size;
+  };
+  
+  
+  class cache_writer {
+  public:
+    std::string buf;
+    
+    void u32(uint32_t value) {
+      buf.append(reinterpret_cast<char const *>(&value), sizeof(value));
+    }
+    
+    void f64(double value) {
+      buf.append(reinterpret_cast<char const *>(&value), sizeof(value));
+    }
+    
+    void str(std::string const & value) {
+      u32(value.size());
+      buf.append(value);
+    }
+    
+    void vec(jspace::Vector const & value) {
+      u32(value.size());
+      for (int ii(0); ii < value.size(); ++ii) {
+	f64(value[ii]);
+      }
+    }
+  };
+  
+  
+  class cache_reader {
+  public:
+    cache_reader(char const * begin, char const * end)
+      : pos_(begin), end_(end), ok_(true) {}
+    
+    bool ok() const { return ok_ && (pos_ == end_); }
+    
+    void raw(void * dst, size_t len) {
+      if ( ! ok_ || (static_cast<size_t>(end_ - pos_) < len)) {
+	ok_ = false;
+	memset(dst, 0, len);
+	return;
+      }
+      memcpy(dst, pos_, len);
+      pos_ += len;
+    }
+    
+    uint32_t u32() {
+      uint32_t value;
+      raw(&value, sizeof(value));
+      return value;
+    }
+    
+    double f64() {
+      double value;
+      raw(&value, sizeof(value));
+      return value;
+    }
+    
+    std::string str() {
+      uint32_t const len(u32());
+      if ( ! ok_ || (static_cast<size_t>(end_ - pos_) < len)) {
+	ok_ = false;
+	return "";
+      }
+      std::string value(pos_, len);
+      pos_ += len;
+      return value;
+    }
+    
+    jspace::Vector vec() {
+      uint32_t const len(u32());
+      if ( ! ok_ || (static_cast<size_t>(end_ - pos_) < len * sizeof(double))) {
+	ok_ = false;
+	return jspace::Vector();
+      }
+      jspace::Vector value(len);
+      for (uint32_t ii(0); ii < len; ++ii) {
+	value[ii] = f64();
+      }
+      return value;
+    }
+    
+    /** Counts come from the file, so cap them before resizing
+	anything: each entry takes at least four bytes. */
+    bool count(size_t & value) {
+      value = u32();
+      return ok_ && (value <= static_cast<size_t>(end_ - pos_) / 4);
+    }
+    
+  private:
+    char const * pos_;
+    char const * end_;
+    bool ok_;
+  };
+  
+  
+  void write_instances(cache_writer & ww, std::vector<opspace::FactorySpec::instance_s> const & instances)
+  {
+    ww.u32(instances.size());
+    for (size_t ii(0); ii < instances.size(); ++ii) {
+      opspace::FactorySpec::instance_s const & inst(instances[ii]);
+      ww.u32(inst.type);
+      ww.str(inst.name);
+      ww.u32(inst.values.size());
+      for (size_t jj(0); jj < inst.values.size(); ++jj) {
+	opspace::FactorySpec::value_s const & value(inst.values[jj]);
+	ww.u32(value.handle);
+	ww.u32(value.type);
+	switch (value.type) {
+	case opspace::PARAMETER_TYPE_INTEGER:
+	  ww.u32(static_cast<uint32_t>(value.integer));
+	  break;
+	case opspace::PARAMETER_TYPE_STRING:
+	  ww.str(value.string);
+	  break;
+	case opspace::PARAMETER_TYPE_REAL:
+	  ww.f64(value.real);
+	  break;
+	default:
+	  ww.vec(value.vector);
+	}
+      }
+      ww.u32(inst.slots.size());
+      for (size_t jj(0); jj < inst.slots.size(); ++jj) {
+	ww.u32(inst.slots[jj].handle);
+	ww.u32(inst.slots[jj].task);
+      }
+    }
+  }
+  
+  
+  bool read_instances(cache_reader & rr,
+		      opspace::FactorySpec const & spec,
+		      size_t ntasks,
+		      std::vector<opspace::FactorySpec::instance_s> & instances)
+  {
+    size_t count;
+    if ( ! rr.count(count)) {
+      return false;
+    }
+    instances.resize(count);
+    for (size_t ii(0); ii < count; ++ii) {
+      opspace::FactorySpec::instance_s & inst(instances[ii]);
+      inst.type = rr.u32();
+      if (inst.type >= spec.types.size()) {
+	return false;
+      }
+      inst.name = rr.str();
+      size_t nvalues;
+      if ( ! rr.count(nvalues)) {
+	return false;
+      }
+      inst.values.resize(nvalues);
+      for (size_t jj(0); jj < nvalues; ++jj) {
+	opspace::FactorySpec::value_s & value(inst.values[jj]);
+	value.handle = rr.u32();
+	if (value.handle >= spec.handles.size()) {
+	  return false;
+	}
+	value.type = static_cast<opspace::parameter_type_t>(rr.u32());
+	switch (value.type) {
+	case opspace::PARAMETER_TYPE_INTEGER:
+	  value.integer = static_cast<int>(rr.u32());
+	  break;
+	case opspace::PARAMETER_TYPE_STRING:
+	  value.string = rr.str();
+	  break;
+	case opspace::PARAMETER_TYPE_REAL:
+	  value.real = rr.f64();
+	  break;
+	case opspace::PARAMETER_TYPE_VECTOR:
+	  value.vector = rr.vec();
+	  break;
+	default:
+	  return false;
+	}
+      }
+      size_t nslots;
+      if ( ! rr.count(nslots)) {
+	return false;
+      }
+      inst.slots.resize(nslots);
+      for (size_t jj(0); jj < nslots; ++jj) {
+	inst.slots[jj].handle = rr.u32();
+	inst.slots[jj].task = rr.u32();
+	if ((inst.slots[jj].handle >= spec.handles.size()) || (inst.slots[jj].task >= ntasks)) {
+	  return false;
+	}
+      }
+    }
+    return true;
+  }
+  
+}
+
+
+namespace opspace {
+  
+  
+  void FactorySpec::
+  clear()
+  {
+    types.clear();
+    handles.clear();
+    tasks.clear();
+    skills.clear();
+  }
+  
+  
+  uint32_t FactorySpec::
+  pool(std::vector<std::string> & table, std::string const & name)
+  {
+    for (size_t ii(0); ii < table.size(); ++ii) {
+      if (name == table[ii]) {
+	return ii;
+      }
+    }
+    table.push_back(name);
+    return table.size() - 1;
+  }
+  
+  
+  FactorySpec::instance_s FactorySpec::
+  compile(std::string const & type,
+	  std::string const & name,
+	  parameter_list_t const & parameters)
+  {
+    instance_s inst;
+    inst.type = pool(types, type);
+    inst.name = name;
+    for (size_t ii(0); ii < parameters.size(); ++ii) {
+      Parameter const * param(parameters[ii].second);
+      value_s value;
+      value.handle = pool(handles, parameters[ii].first);
+      value.type = param->type_;
+      value.integer = 0;
+      value.real = 0;
+      switch (param->type_) {
+      case PARAMETER_TYPE_INTEGER:
+	value.integer = *param->getInteger();
+	break;
+      case PARAMETER_TYPE_STRING:
+	value.string = *param->getString();
+	break;
+      case PARAMETER_TYPE_REAL:
+	value.real = *param->getReal();
+	break;
+      case PARAMETER_TYPE_VECTOR:
+	value.vector = *param->getVector();
+	break;
+      default:
+	continue;
+      }
+      inst.values.push_back(value);
+    }
+    return inst;
+  }
+  
+  
+  void FactorySpec::
+  appendTask(std::string const & type,
+	     std::string const & name,
+	     parameter_list_t const & parameters)
+  {
+    tasks.push_back(compile(type, name, parameters));
+  }
+  
+  
+  void FactorySpec::
+  appendSkill(std::string const & type,
+	      std::string const & name,
+	      parameter_list_t const & parameters,
+	      slot_list_t const & slots)
+  {
+    skills.push_back(compile(type, name, parameters));
+    instance_s & inst(skills.back());
+    for (size_t ii(0); ii < slots.size(); ++ii) {
+      slot_s slot;
+      slot.handle = pool(handles, slots[ii].first);
+      slot.task = slots[ii].second;
+      inst.slots.push_back(slot);
+    }
+  }
+  
+  
+  void FactorySpec::
+  append(FactorySpec const & other)
+  {
+    size_t const task_offset(tasks.size());
+    for (int which(0); which < 2; ++which) {
+      std::vector<instance_s> const & src(which ? other.skills : other.tasks);
+      std::vector<instance_s> & dst(which ? skills : tasks);
+      for (size_t ii(0); ii < src.size(); ++ii) {
+	dst.push_back(src[ii]);
+	instance_s & inst(dst.back());
+	inst.type = pool(types, other.types[inst.type]);
+	for (size_t jj(0); jj < inst.values.size(); ++jj) {
+	  inst.values[jj].handle = pool(handles, other.handles[inst.values[jj].handle]);
+	}
+	for (size_t jj(0); jj < inst.slots.size(); ++jj) {
+	  inst.slots[jj].handle = pool(handles, other.handles[inst.slots[jj].handle]);
+	  inst.slots[jj].task += task_offset;
+	}
+      }
+    }
+  }
+  
+  
+  Status write_factory_cache(std::string const & filename,
+			     uint64_t source_hash,
+			     FactorySpec const & spec)
+  {
+    cache_writer ww;
+    ww.u32(spec.types.size());
+    for (size_t ii(0); ii < spec.types.size(); ++ii) {
+      ww.str(spec.types[ii]);
+    }
+    ww.u32(spec.handles.size());
+    for (size_t ii(0); ii < spec.handles.size(); ++ii) {
+      ww.str(spec.handles[ii]);
+    }
+    write_instances(ww, spec.tasks);
+    write_instances(ww, spec.skills);
+    
+    cache_header_s header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = factory_cache_version;
+    header.byte_order = cache_byte_order;
+    header.source_hash = source_hash;
+    header.checksum = jspace::compute_model_hash(ww.buf);
+    header.body_size = ww.buf.size();
+    
+    // Same as for the model cache: write to a temporary file and
+    // rename it, so that a concurrent reader never sees half of it.
+    std::string const tmpname(filename + ".tmp");
+    {
+      std::ofstream os(tmpname.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+      if ( ! os) {
+	return Status(false, "could not open " + tmpname + " for writing");
+      }
+      os.write(reinterpret_cast<char const *>(&header), sizeof(header));
+      os.write(ww.buf.data(), ww.buf.size());
+      if ( ! os) {
+	return Status(false, "error writing " + tmpname);
+      }
+    }
+    if (0 != rename(tmpname.c_str(), filename.c_str())) {
+      remove(tmpname.c_str());
+      return Status(false, "could not rename " + tmpname + " to " + filename);
+    }
+    
+    return Status();
+  }
+  
+  
+  Status read_factory_cache(std::string const & filename,
+			    uint64_t expected_hash,
+			    FactorySpec & spec)
+  {
+    std::ifstream is(filename.c_str(), std::ios::in | std::ios::binary);
+    if ( ! is) {
+      return Status(false, "could not open " + filename);
+    }
+    std::ostringstream buf;
+    buf << is.rdbuf();
+    std::string const contents(buf.str());
+    
+    cache_header_s header;
+    if (contents.size() < sizeof(header)) {
+      return Status(false, filename + " is too small to be a skill cache");
+    }
+    memcpy(&header, contents.data(), sizeof(header));
+    if (0 != memcmp(header.magic, cache_magic, sizeof(cache_magic))) {
+      return Status(false, filename + " is not a skill cache");
+    }
+    if (cache_byte_order != header.byte_order) {
+      return Status(false, filename + " was written on a machine with another byte order");
+    }
+    if (factory_cache_version != header.version) {
+      std::ostringstream msg;
+      msg << filename << " has format version " << header.version
+	  << " but we need version " << factory_cache_version;
+      return Status(false, msg.str());
+    }
+    if ((0 != expected_hash) && (expected_hash != header.source_hash)) {
+      return Status(false, filename + " is stale (source hash mismatch)");
+    }
+    if (contents.size() - sizeof(header) != header.body_size) {
+      return Status(false, filename + " is truncated");
+    }
+    std::string const body(contents, sizeof(header));
+    if (header.checksum != jspace::compute_model_hash(body)) {
+      return Status(false, filename + " is corrupt (checksum mismatch)");
+    }
+    
+    FactorySpec tmp;
+    cache_reader rr(body.data(), body.data() + body.size());
+    size_t count;
+    bool ok(rr.count(count));
+    for (size_t ii(0); ok && (ii < count); ++ii) {
+      tmp.types.push_back(rr.str());
+    }
+    ok = ok && rr.count(count);
+    for (size_t ii(0); ok && (ii < count); ++ii) {
+      tmp.handles.push_back(rr.str());
+    }
+    ok = ok
+      && read_instances(rr, tmp, 0, tmp.tasks)
+      && read_instances(rr, tmp, tmp.tasks.size(), tmp.skills)
+      && rr.ok();
+    if ( ! ok) {
+      return Status(false, filename + " has invalid records");
+    }
+    
+    spec = tmp;
+    return Status();
+  }
+  
+}
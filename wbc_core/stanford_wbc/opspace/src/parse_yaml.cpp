@@ -70,10 +70,12 @@ namespace opspace {
   TaskTableParser::
   TaskTableParser(Factory const & factory,
 		  Factory::task_table_t & task_table_,
-		  std::ostream * optional_dbg_os)
+		  std::ostream * optional_dbg_os,
+		  FactorySpec * optional_spec)
     : Parser(factory, optional_dbg_os),
       task_parser(factory, optional_dbg_os),
-      task_table(task_table_)
+      task_table(task_table_),
+      spec(optional_spec)
   {
   }
   
@@ -81,10 +83,12 @@ namespace opspace {
   SkillTableParser::
   SkillTableParser(Factory const & factory,
 		      Factory::skill_table_t & skill_table_,
-		      std::ostream * optional_dbg_os)
+		      std::ostream * optional_dbg_os,
+		      FactorySpec * optional_spec)
     : Parser(factory, optional_dbg_os),
       skill_parser(factory, optional_dbg_os),
-      skill_table(skill_table_)
+      skill_table(skill_table_),
+      spec(optional_spec)
   {
   }
   
@@ -214,6 +218,7 @@ namespace opspace {
   void operator >> (YAML::Node const & node, TaskParser & parser)
   {
     parser.task = 0;		// in case type or name is undefined
+    parser.parameters.clear();
     if (parser.dbg) {
       *parser.dbg << "DEBUG opspace::operator>>(YAML::Node &, task_parser_s &)\n"
 		  << "  reading type and name\n";
@@ -246,6 +251,7 @@ namespace opspace {
       }
       
       Parameter const * param(parse_parameter("task", parser.name, *parser.task, key, value));
+      parser.parameters.push_back(std::make_pair(key, param));
       if (parser.dbg) {
 	param->dump(*parser.dbg, "    ");
       }
@@ -257,6 +263,8 @@ namespace opspace {
   void operator >> (YAML::Node const & node, SkillParser & parser)
   {
     parser.skill = 0;		// in case type or name is undefined
+    parser.parameters.clear();
+    parser.slots.clear();
     if (parser.dbg) {
       *parser.dbg << "DEBUG opspace::operator>>(YAML::Node &, skill_parser_s &)\n"
 		  << "  reading type and name\n";
@@ -337,6 +345,13 @@ namespace opspace {
 				     + "' to skill `" + parser.name
 				     + "' slot `" + slot_name + "': " + st.errstr);
 	  }
+	  Factory::task_table_t const & task_table(parser.factory.getTaskTable());
+	  for (size_t ii(0); ii < task_table.size(); ++ii) {
+	    if (task_table[ii] == task) {
+	      parser.slots.push_back(std::make_pair(slot_name, ii));
+	      break;
+	    }
+	  }
 	  
 	  if (parser.dbg) {
 	    *parser.dbg << "  assigned task instance `" << task_name
@@ -350,6 +365,7 @@ namespace opspace {
 	// assume it's a parameter
 	Parameter const * param(parse_parameter("skill", parser.name,
 						*parser.skill, key, it.second()));
+	parser.parameters.push_back(std::make_pair(key, param));
 	if (parser.dbg) {
 	  param->dump(*parser.dbg, "    ");
 	}
@@ -368,6 +384,10 @@ namespace opspace {
 	throw std::runtime_error("failed to create task instance");
       }
       parser.task_table.push_back(shared_ptr<Task>(parser.task_parser.task));
+      if (parser.spec) {
+	parser.spec->appendTask(parser.task_parser.type, parser.task_parser.name,
+				parser.task_parser.parameters);
+      }
     }
   }
   
@@ -388,6 +408,10 @@ namespace opspace {
 	parser.skill_parser.skill->dump(*parser.dbg, "  adding to table: skill", "    ");
       }
       parser.skill_table.push_back(shared_ptr<Skill>(parser.skill_parser.skill));
+      if (parser.spec) {
+	parser.spec->appendSkill(parser.skill_parser.type, parser.skill_parser.name,
+				 parser.skill_parser.parameters, parser.skill_parser.slots);
+      }
     }
   }
   
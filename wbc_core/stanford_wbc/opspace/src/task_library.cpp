@@ -25,6 +25,7 @@
 
 #include <opspace/task_library.hpp>
 #include <opspace/TypeIOTGCursor.hpp>
+#include <opspace/TypeIOTGBatch.hpp>
 #include <jspace/constraint_library.hpp>
 
 using jspace::pretty_print;
@@ -437,15 +438,17 @@ namespace opspace {
       return Status(false, "invalid end_effector");
     }
     
-    Matrix Jfull;
+    jspace::SparseJacobian Jfull;
     if ( ! model.computeJacobian(end_effector_node_, actual_[0], actual_[1], actual_[2], Jfull)) {
       return Status(false, "failed to compute Jacobian (unsupported joint type?)");
     }
-    jacobian_ = Jfull.block(0, 0, 3, Jfull.cols());
+    Jfull.getRows(0, 3, sparse_jacobian_);
+    sparse_jacobian_.toDense(jacobian_);
+    has_sparse_jacobian_ = true;
     
-    return computePDCommand(actual_,
-			    jacobian_ * model.getState().velocity_,
-			    command_);
+    Vector velocity;
+    sparse_jacobian_.multiply(model.getFullState().velocity_, velocity);
+    return computePDCommand(actual_, velocity, command_);
   }
   
   
@@ -620,11 +623,14 @@ namespace opspace {
   TrajectoryTask(std::string const & name, saturation_policy_t saturation_policy)
     : PDTask(name, saturation_policy),
       cursor_(0),
-      dt_seconds_(-1)
+      dt_seconds_(-1),
+      phase_sync_(0),
+      reseed_(false)
   {
     declareParameter("dt_seconds", &dt_seconds_, PARAMETER_FLAG_NOLOG);
     declareParameter("trjgoal", &trjgoal_);
     declareParameter("maxacc", &maxacc_, PARAMETER_FLAG_NOLOG);
+    declareParameter("phase_sync", &phase_sync_, PARAMETER_FLAG_NOLOG);
   }
   
   
@@ -672,6 +678,7 @@ namespace opspace {
     trjgoal_ = initpos;
     cursor_->position() = initpos;
     cursor_->velocity() = Vector::Zero(ndim);
+    reseed_ = false;
     
     if (SATURATION_NORM == saturation_policy_) {
       qh_maxvel_ = maxvel_[0] * Vector::Ones(ndim);
@@ -693,6 +700,12 @@ namespace opspace {
       return Status(false, "not initialized");
     }
     
+    if (reseed_) {
+      cursor_->position() = curpos;
+      cursor_->velocity() = curvel;
+      reseed_ = false;
+    }
+    cursor_->setPhaseSync(0 != phase_sync_);
     int const trjstatus(cursor_->next(qh_maxvel_, maxacc_, trjgoal_));
     if (0 > trjstatus) {
       std::ostringstream msg;
@@ -704,7 +717,45 @@ namespace opspace {
     goalpos_ = cursor_->position();
     goalvel_ = cursor_->velocity();
     
-    return computePDCommand(curpos, curvel, command);
+    Status const st(computePDCommand(curpos, curvel, command));
+    if (st && (0 != stream_acc_.rows())) {
+      command += stream_acc_;
+      stream_acc_.resize(0);
+    }
+    return st;
+  }
+  
+  
+  Status TrajectoryTask::
+  stream(Vector const & pos, Vector const & vel, Vector const & acc)
+  {
+    if ( ! cursor_) {
+      return Status(false, "not initialized");
+    }
+    if ((cursor_->ndof_ != pos.rows())
+	|| (cursor_->ndof_ != vel.rows())
+	|| (cursor_->ndof_ != acc.rows())) {
+      return Status(false, "dimension mismatch");
+    }
+    cursor_->stream(pos, vel);
+    stream_acc_ = acc;
+    Status ok;
+    return ok;
+  }
+  
+  
+  Status TrajectoryTask::
+  handoff(Model const & model)
+  {
+    if ( ! cursor_) {
+      return Status(false, "not initialized");
+    }
+    // The subclasses compute the current position and velocity in
+    // their update() anyway, so just tell computeTrajectoryCommand()
+    // to start from there.
+    reseed_ = true;
+    Status ok;
+    return ok;
   }
   
   
@@ -814,15 +865,17 @@ namespace opspace {
       return Status(false, "updateActual() failed, did you specify a valid end_effector_id?");
     }
     
-    Matrix Jfull;
+    jspace::SparseJacobian Jfull;
     if ( ! model.computeJacobian(ee_node, actual_[0], actual_[1], actual_[2], Jfull)) {
       return Status(false, "failed to compute Jacobian (unsupported joint type?)");
     }
-    jacobian_ = Jfull.block(0, 0, 3, Jfull.cols());
+    Jfull.getRows(0, 3, sparse_jacobian_);
+    sparse_jacobian_.toDense(jacobian_);
+    has_sparse_jacobian_ = true;
     
-    return computeTrajectoryCommand(actual_,
-				    jacobian_ * model.getState().velocity_,
-				    command_);
+    Vector velocity;
+    sparse_jacobian_.multiply(model.getFullState().velocity_, velocity);
+    return computeTrajectoryCommand(actual_, velocity, command_);
   }
   
   
@@ -899,7 +952,9 @@ namespace opspace {
   JointLimitTask::
   JointLimitTask(std::string const & name)
     : Task(name),
-      dt_seconds_(-1)
+      dt_seconds_(-1),
+      otg_(0),
+      reseed_(false)
   {
     declareParameter("dt_seconds", &dt_seconds_, PARAMETER_FLAG_NOLOG);
     declareParameter("upper_stop_deg", &upper_stop_deg_, PARAMETER_FLAG_NOLOG);
@@ -916,9 +971,7 @@ namespace opspace {
   JointLimitTask::
   ~JointLimitTask()
   {
-    for (size_t ii(0); ii < cursor_.size(); ++ii) {
-      delete cursor_[ii];
-    }
+    delete otg_;
   }
   
   
@@ -932,9 +985,9 @@ namespace opspace {
 	}
       }
     }
-    if ( ! cursor_.empty()) {	// we are initialized
+    if (otg_) {	// we are initialized
       if ((param == &kp_) || (param == &kd_) || (param == &maxvel_) || (param == &maxacc_)) {
-	if (cursor_.size() != value.rows()) {
+	if (otg_->getNDOF() != value.rows()) {
 	  return Status(false, "invalid dimension");
 	}
       }
@@ -990,9 +1043,15 @@ namespace opspace {
     lower_stop_ = M_PI * lower_stop_deg_ / 180.0;
     lower_trigger_ = M_PI * lower_trigger_deg_ / 180.0;
     
-    cursor_.assign(ndof, 0);
+    delete otg_;
+    otg_ = new TypeIOTGBatch(dt_seconds_);
+    for (size_t ii(0); ii < ndof; ++ii) {
+      otg_->addGroup(1);
+      otg_->setEnabled(ii, false);
+    }
     goal_ = Vector::Zero(ndof);
     jacobian_.resize(0, 0);
+    reseed_ = false;
     
     // builds/updates jacobian, initializes cursors and goals, set actual_
     updateState(model);
@@ -1002,10 +1061,24 @@ namespace opspace {
   }
   
   
+  Status JointLimitTask::
+  handoff(Model const & model)
+  {
+    if ( ! otg_) {
+      return Status(false, "not initialized");
+    }
+    // restart the joints which are already being stopped from where
+    // they are now, at the next update()
+    reseed_ = true;
+    Status ok;
+    return ok;
+  }
+  
+  
   Status JointLimitTask::
   update(Model const & model)
   {
-    if (dt_seconds_ <= 0) {
+    if ((dt_seconds_ <= 0) || ( ! otg_)) {
       return Status(false, "not initialized");
     }
     
@@ -1013,12 +1086,24 @@ namespace opspace {
     command_.resize(jacobian_.rows());
     size_t task_index(0);
     
-    for (size_t joint_index(0); joint_index < cursor_.size(); ++joint_index) {
-      if (cursor_[joint_index]) {
-	if (0 > cursor_[joint_index]->next(maxvel_[joint_index], maxacc_[joint_index], goal_[joint_index])) {
-	  return Status(false, "trajectory generation error");
+    if (reseed_) {
+      for (size_t ii(0); ii < otg_->getNGroups(); ++ii) {
+	if (otg_->isEnabled(ii)) {
+	  otg_->position()[ii] = model.getState().position_[ii];
+	  otg_->velocity()[ii] = model.getState().velocity_[ii];
 	}
-	double com(kp_[joint_index] * (cursor_[joint_index]->position()[0] - actual_[task_index]));
+      }
+      reseed_ = false;
+    }
+    if (0 > otg_->next(maxvel_, maxacc_, goal_)) {
+      return Status(false, "trajectory generation error");
+    }
+    Vector const & trjpos(otg_->position());
+    Vector const & trjvel(otg_->velocity());
+    
+    for (size_t joint_index(0); joint_index < otg_->getNGroups(); ++joint_index) {
+      if (otg_->isEnabled(joint_index)) {
+	double com(kp_[joint_index] * (trjpos[joint_index] - actual_[task_index]));
 	if ((maxvel_[joint_index] > 1e-4) && (kd_[joint_index] > 1e-4)) {
 	  double const sat(fabs((com / maxvel_[joint_index]) / kd_[joint_index]));
 	  if (sat > 1.0) {
@@ -1027,7 +1112,7 @@ namespace opspace {
 	}
 	command_[task_index]
 	  = com
-	  + kd_[joint_index] * (cursor_[joint_index]->velocity()[0] - model.getState().velocity_[joint_index]);
+	  + kd_[joint_index] * (trjvel[joint_index] - model.getState().velocity_[joint_index]);
 	++task_index;
       }
     }
@@ -1046,24 +1131,24 @@ namespace opspace {
     size_t task_dimension(0);
     
     for (size_t ii(0); ii < ndof; ++ii) {
-      if (cursor_[ii]) {
+      if (otg_->isEnabled(ii)) {
 	++task_dimension;
       }
       else {
 	if (jpos[ii] > upper_trigger_[ii]) {
 	  ++task_dimension;
 	  dimension_changed = true;
-	  cursor_[ii] = new TypeIOTGCursor(1, dt_seconds_);
-	  cursor_[ii]->position()[0] = jpos[ii];
-	  cursor_[ii]->velocity()[0] = model.getState().velocity_[ii];
+	  otg_->setEnabled(ii, true);
+	  otg_->position()[ii] = jpos[ii];
+	  otg_->velocity()[ii] = model.getState().velocity_[ii];
 	  goal_[ii] = upper_stop_[ii];
 	}
 	else if (jpos[ii] < lower_trigger_[ii]) {
 	  ++task_dimension;
 	  dimension_changed = true;
-          cursor_[ii] = new TypeIOTGCursor(1, dt_seconds_);
-          cursor_[ii]->position()[0] = jpos[ii];
-          cursor_[ii]->velocity()[0] = model.getState().velocity_[ii];
+          otg_->setEnabled(ii, true);
+          otg_->position()[ii] = jpos[ii];
+          otg_->velocity()[ii] = model.getState().velocity_[ii];
           goal_[ii] = lower_stop_[ii];
 	}
       }
@@ -1073,7 +1158,7 @@ namespace opspace {
       jacobian_ = Matrix::Zero(task_dimension, ndof);
       size_t task_index(0);
       for (size_t joint_index(0); joint_index < ndof; ++joint_index) {
-	if (cursor_[joint_index]) {
+	if (otg_->isEnabled(joint_index)) {
 	  jacobian_.coeffRef(task_index, joint_index) = 1.0;
 	  ++task_index;
 	}
@@ -1083,7 +1168,7 @@ namespace opspace {
     actual_.resize(task_dimension);
     size_t task_index(0);
     for (size_t joint_index(0); joint_index < ndof; ++joint_index) {
-      if (cursor_[joint_index]) {
+      if (otg_->isEnabled(joint_index)) {
 	actual_[task_index] = jpos[joint_index];
 	++task_index;
       }
@@ -1100,7 +1185,7 @@ namespace opspace {
       os << title << "\n";
     }
     os << prefix << "joint limit task: `" << instance_name_ << "'\n";
-    if (cursor_.empty()) {
+    if ( ! otg_) {
       os << prefix << "  NOT INITIALIZED\n";
     }
     pretty_print(actual_, os, prefix + "  actual", prefix + "    ");
@@ -1164,7 +1249,7 @@ namespace opspace {
     
     jspace::Transform ee_transform;
     model.computeGlobalFrame(ee_node, Vector::Zero(3), ee_transform);
-    Matrix Jfull;
+    jspace::SparseJacobian Jfull;
     eepos_ = ee_transform.translation();
     if ( ! model.computeJacobian(ee_node,
 				 eepos_[0],
@@ -1174,7 +1259,9 @@ namespace opspace {
       return 0;
     }
     
-    jacobian_ = Jfull.block(3, 0, 3, Jfull.cols());
+    Jfull.getRows(3, 3, sparse_jacobian_);
+    sparse_jacobian_.toDense(jacobian_);
+    has_sparse_jacobian_ = true;
     
     actual_x_ = ee_transform.linear().block(0, 0, 3, 1);
     actual_y_ = ee_transform.linear().block(0, 1, 3, 1);
@@ -1185,15 +1272,7 @@ namespace opspace {
     actual_.block(3, 0, 3, 1) = actual_y_;
     actual_.block(6, 0, 3, 1) = actual_z_;
     
-    jspace::Constraint* constraint = model.getConstraint();
-    if (constraint) {
-      jspace::State fullState(model.getNDOF(),model.getNDOF(),6);
-      constraint->getFullState(model.getState(),fullState);
-      velocity_ = jacobian_*fullState.velocity_;
-    }
-    else {
-      velocity_ = jacobian_*model.getState().velocity_;
-    }
+    sparse_jacobian_.multiply(model.getFullState().velocity_, velocity_);
     
     return ee_node;
   }
@@ -1294,15 +1373,7 @@ namespace opspace {
     }
 
     Vector vel;
-    jspace::Constraint* constraint = model.getConstraint();
-    if (constraint) {
-      jspace::State fullState(model.getNDOF(),model.getNDOF(),6);
-      constraint->getFullState(model.getState(),fullState);
-      vel = jacobian_*fullState.velocity_;
-    }
-    else {
-      vel = jacobian_*model.getState().velocity_;
-    }
+    vel = jacobian_ * model.getFullState().velocity_;
 
     command_ = Vector(kp_.cwise()*(goalpos_ - actual_) + kd_.cwise()*(goalvel_ - vel));
 
@@ -1412,7 +1483,9 @@ namespace opspace {
   PureJPosTrjTask(std::string const & name)
     : Task(name),
       cursor_(0),
-      dt_seconds_(-1)
+      dt_seconds_(-1),
+      phase_sync_(0),
+      reseed_(false)
   {
     declareParameter("kp", &kp_);
     declareParameter("kd", &kd_);
@@ -1420,6 +1493,7 @@ namespace opspace {
     declareParameter("trjgoal", &trjgoal_);
     declareParameter("maxacc", &maxacc_, PARAMETER_FLAG_NOLOG);
     declareParameter("maxvel", &maxvel_, PARAMETER_FLAG_NOLOG);
+    declareParameter("phase_sync", &phase_sync_, PARAMETER_FLAG_NOLOG);
   }
   
   
@@ -1491,6 +1565,7 @@ namespace opspace {
     trjgoal_ = model.getState().position_;
     cursor_->position() = trjgoal_;
     cursor_->velocity() = Vector::Zero(ndim);
+    reseed_ = false;
 
     Vector constrained;
     if (model.getConstrained(constrained)) {
@@ -1515,6 +1590,18 @@ namespace opspace {
   }
   
   
+  Status PureJPosTrjTask::
+  handoff(Model const & model)
+  {
+    if ( ! cursor_) {
+      return Status(false, "not initialized");
+    }
+    reseed_ = true;
+    Status ok;
+    return ok;
+  }
+  
+  
   Status PureJPosTrjTask::
   update(Model const & model)
   {
@@ -1522,6 +1609,12 @@ namespace opspace {
       return Status(false, "not initialized");
     }
     
+    if (reseed_) {
+      cursor_->position() = model.getState().position_;
+      cursor_->velocity() = model.getState().velocity_;
+      reseed_ = false;
+    }
+    cursor_->setPhaseSync(0 != phase_sync_);
     int const trjstatus(cursor_->next(maxvel_, maxacc_, trjgoal_));
     if (0 > trjstatus) {
       std::ostringstream msg;
@@ -1531,6 +1624,28 @@ namespace opspace {
     }
     actual_ = model.getState().position_;
     command_ = kp_.cwise()*(cursor_->position() - actual_) + kd_.cwise()*(cursor_->velocity() - model.getState().velocity_);
+    if (0 != stream_acc_.rows()) {
+      command_ += stream_acc_;
+      stream_acc_.resize(0);
+    }
+    Status ok;
+    return ok;
+  }
+
+
+  Status PureJPosTrjTask::
+  stream(Vector const & pos, Vector const & vel, Vector const & acc)
+  {
+    if ( ! cursor_) {
+      return Status(false, "not initialized");
+    }
+    if ((cursor_->ndof_ != pos.rows())
+	|| (cursor_->ndof_ != vel.rows())
+	|| (cursor_->ndof_ != acc.rows())) {
+      return Status(false, "dimension mismatch");
+    }
+    cursor_->stream(pos, vel);
+    stream_acc_ = acc;
     Status ok;
     return ok;
   }
@@ -1564,7 +1679,10 @@ namespace opspace {
       control_point_(Vector::Zero(3)),
       end_effector_node_(0),
       cursor_(0),
-      dt_seconds_(-1)
+      dt_seconds_(-1),
+      jdot_qdot_(0),
+      phase_sync_(0),
+      reseed_(false)
   {
     declareParameter("end_effector", &end_effector_id_ );
     declareParameter("kp", &kp_);
@@ -1574,6 +1692,8 @@ namespace opspace {
     declareParameter("trjgoal", &trjgoal_);
     declareParameter("maxacc", &maxacc_);
     declareParameter("maxvel", &maxvel_);
+    declareParameter("jdot_qdot", &jdot_qdot_, PARAMETER_FLAG_NOLOG);
+    declareParameter("phase_sync", &phase_sync_, PARAMETER_FLAG_NOLOG);
   }
 
   PureCartPosTrjTask::
@@ -1649,12 +1769,25 @@ namespace opspace {
     trjgoal_ = actual_;
     cursor_->position() = trjgoal_;
     cursor_->velocity() = Vector::Zero(ndim);
+    reseed_ = false;
 
     Status ok;
     return ok;
   }
 
 
+  Status PureCartPosTrjTask::
+  handoff(Model const & model)
+  {
+    if ( ! cursor_) {
+      return Status(false, "not initialized");
+    }
+    reseed_ = true;
+    Status ok;
+    return ok;
+  }
+
+
   Status PureCartPosTrjTask::
   update(Model const & model) {
     end_effector_node_ = updateActual(model);
@@ -1666,6 +1799,15 @@ namespace opspace {
       return Status(false, "not initialized");
     }
     
+    Vector vel;
+    vel = jacobian_ * model.getFullState().velocity_;
+
+    if (reseed_) {
+      cursor_->position() = actual_;
+      cursor_->velocity() = vel;
+      reseed_ = false;
+    }
+    cursor_->setPhaseSync(0 != phase_sync_);
     int const trjstatus(cursor_->next(maxvel_, maxacc_, trjgoal_));
     if (0 > trjstatus) {
       std::ostringstream msg;
@@ -1674,20 +1816,39 @@ namespace opspace {
       return Status(false, msg.str());
     }
 
-    Vector vel;
-    jspace::Constraint* constraint = model.getConstraint();
-    if (constraint) {
-      jspace::State fullState(model.getNDOF(),model.getNDOF(),6);
-      constraint->getFullState(model.getState(),fullState);
-      vel = jacobian_*fullState.velocity_;
+    command_ = kp_.cwise()*(cursor_->position() - actual_);
+    command_ += kd_.cwise()*(cursor_->velocity() - vel);
+
+    if (jdot_qdot_) {
+      Vector jdqd;
+      if ( ! model.computeJdotQdot(end_effector_node_, actual_[0], actual_[1], actual_[2], jdqd)) {
+	return Status(false, "computeJdotQdot() failed");
+      }
+      command_ -= jdqd.block(0, 0, 3, 1);
     }
-    else {
-      vel = jacobian_*model.getState().velocity_;
+
+    if (0 != stream_acc_.rows()) {
+      command_ += stream_acc_;
+      stream_acc_.resize(0);
     }
 
-    command_ = kp_.cwise()*(cursor_->position() - actual_);
-    command_ += kd_.cwise()*(cursor_->velocity() - vel);
+    Status ok;
+    return ok;
+  }
 
+  Status PureCartPosTrjTask::
+  stream(Vector const & pos, Vector const & vel, Vector const & acc)
+  {
+    if ( ! cursor_) {
+      return Status(false, "not initialized");
+    }
+    if ((cursor_->ndof_ != pos.rows())
+	|| (cursor_->ndof_ != vel.rows())
+	|| (cursor_->ndof_ != acc.rows())) {
+      return Status(false, "dimension mismatch");
+    }
+    cursor_->stream(pos, vel);
+    stream_acc_ = acc;
     Status ok;
     return ok;
   }
@@ -1852,7 +2013,8 @@ namespace opspace {
       end_effector_node_(0),
       center_position_(Vector::Zero(3)),
       radius_(-1),
-      omega_(-1)
+      omega_(-1),
+      jdot_qdot_(0)
   {
     declareParameter("end_effector", &end_effector_id_, PARAMETER_FLAG_NOLOG);
     declareParameter("kp", &kp_, PARAMETER_FLAG_NOLOG);
@@ -1861,6 +2023,7 @@ namespace opspace {
     declareParameter("center_position", &center_position_);
     declareParameter("radius", &radius_);
     declareParameter("omega", &omega_);
+    declareParameter("jdot_qdot", &jdot_qdot_, PARAMETER_FLAG_NOLOG);
   }
 
   Status TestFFCartCircleTask::
@@ -1913,6 +2076,14 @@ namespace opspace {
 
     command_ = a_des - kd_*( jacobian_ * model.getState().velocity_ - v_des) - kp_* ( actual_ - x_des);
 
+    if (jdot_qdot_) {
+      Vector jdqd;
+      if ( ! model.computeJdotQdot(end_effector_node_, actual_[0], actual_[1], actual_[2], jdqd)) {
+	return Status(false, "computeJdotQdot() failed");
+      }
+      command_ -= jdqd.block(0, 0, 3, 1);
+    }
+
     Status ok;
     return ok;
   }
@@ -2124,11 +2295,8 @@ namespace opspace {
       actual_[0] = cart_pos[0];
       actual_[1] = cart_pos[1];
 
-      jspace::Constraint* constraint = model.getConstraint();
-      if (constraint) {
-	jspace::State fullState(model.getNDOF(),model.getNDOF(),6);
-	constraint->getFullState(model.getState(),fullState);
-	actual_[2] = fullState.position_[5];
+      if (model.getConstraint()) {
+	actual_[2] = model.getFullState().position_[5];
       }
       else {
 	Matrix ee_ori(ee_transform.linear());
@@ -2234,15 +2402,7 @@ namespace opspace {
     actual_.block(6, 0, 3, 1) = actual_y_;
     actual_.block(9, 0, 3, 1) = actual_z_;
     
-    jspace::Constraint* constraint = model.getConstraint();
-    if (constraint) {
-      jspace::State fullState(model.getNDOF(),model.getNDOF(),6);
-      constraint->getFullState(model.getState(),fullState);
-      velocity_ = jacobian_*fullState.velocity_;
-    }
-    else {
-      velocity_ = jacobian_*model.getState().velocity_;
-    }
+    velocity_ = jacobian_ * model.getFullState().velocity_;
     
     return ee_node;
   }
@@ -2302,7 +2462,8 @@ namespace opspace {
       control_point_(Vector::Zero(3)),
       end_effector_node_(0),
       cursor_(0),
-      dt_seconds_(-1)
+      dt_seconds_(-1),
+      reseed_(false)
   {
     declareParameter("end_effector", &end_effector_id_ );
     declareParameter("kp", &kp_);
@@ -2388,7 +2549,20 @@ namespace opspace {
     trjgoal_ = actual_;
     cursor_->position() = trjgoal_;
     cursor_->velocity() = Vector::Zero(ndim);
+    reseed_ = false;
+
+    Status ok;
+    return ok;
+  }
+
 
+  Status TestBaseControlTask::
+  handoff(Model const & model)
+  {
+    if ( ! cursor_) {
+      return Status(false, "not initialized");
+    }
+    reseed_ = true;
     Status ok;
     return ok;
   }
@@ -2405,6 +2579,14 @@ namespace opspace {
       return Status(false, "not initialized");
     }
     
+    Vector vel;
+    vel = jacobian_ * model.getFullState().velocity_;
+
+    if (reseed_) {
+      cursor_->position() = actual_;
+      cursor_->velocity() = vel;
+      reseed_ = false;
+    }
     int const trjstatus(cursor_->next(maxvel_, maxacc_, trjgoal_));
     if (0 > trjstatus) {
       std::ostringstream msg;
@@ -2413,20 +2595,31 @@ namespace opspace {
       return Status(false, msg.str());
     }
 
-    Vector vel;
-    jspace::Constraint* constraint = model.getConstraint();
-    if (constraint) {
-      jspace::State fullState(model.getNDOF(),model.getNDOF(),6);
-      constraint->getFullState(model.getState(),fullState);
-      vel = jacobian_*fullState.velocity_;
-    }
-    else {
-      vel = jacobian_*model.getState().velocity_;
-    }
-
     command_ = kp_.cwise()*(cursor_->position() - actual_);
     command_ += kd_.cwise()*(cursor_->velocity() - vel);
 
+    if (0 != stream_acc_.rows()) {
+      command_ += stream_acc_;
+      stream_acc_.resize(0);
+    }
+
+    Status ok;
+    return ok;
+  }
+
+  Status TestBaseControlTask::
+  stream(Vector const & pos, Vector const & vel, Vector const & acc)
+  {
+    if ( ! cursor_) {
+      return Status(false, "not initialized");
+    }
+    if ((cursor_->ndof_ != pos.rows())
+	|| (cursor_->ndof_ != vel.rows())
+	|| (cursor_->ndof_ != acc.rows())) {
+      return Status(false, "dimension mismatch");
+    }
+    cursor_->stream(pos, vel);
+    stream_acc_ = acc;
     Status ok;
     return ok;
   }
@@ -2461,11 +2654,8 @@ namespace opspace {
       actual_[0] = cart_pos[0];
       actual_[1] = cart_pos[1];
 
-   jspace::Constraint* constraint = model.getConstraint();
-      if (constraint) {
-	jspace::State fullState(model.getNDOF(),model.getNDOF(),6);
-	constraint->getFullState(model.getState(),fullState);
-	actual_[2] = fullState.position_[5];
+      if (model.getConstraint()) {
+	actual_[2] = model.getFullState().position_[5];
       }
       else {
 	Matrix ee_ori(ee_transform.linear());
@@ -2573,11 +2763,8 @@ namespace opspace {
       actual_[0] = cart_pos[0];
       actual_[1] = cart_pos[1];
 
-      jspace::Constraint* constraint = model.getConstraint();
-      if (constraint) {
-	jspace::State fullState(model.getNDOF(),model.getNDOF(),6);
-	constraint->getFullState(model.getState(),fullState);
-	actual_[2] = fullState.position_[5];
+      if (model.getConstraint()) {
+	actual_[2] = model.getFullState().position_[5];
       }
       else {
 	Matrix ee_ori(ee_transform.linear());
@@ -23,6 +23,11 @@
 #include <opspace/Skill.hpp>
 #include <opspace/Factory.hpp>
 #include <opspace/parse_yaml.hpp>
+#include <jspace/test/util.hpp>
+#include <jspace/model_cache.hpp>
+#include <sstream>
+#include <stdio.h>
+#include <unistd.h>
 #include <stdexcept>
 
 using namespace opspace;
@@ -148,6 +153,119 @@ TEST (parse, tasks_and_skills)
 }
 
 
+TEST (parse, cache)
+{
+  static char const * const yaml_string =
+    "- tasks:\n"
+    "  - type: opspace::CartPosTrjTask\n"
+    "    name: eepos\n"
+    "    dt_seconds: 0.002\n"
+    "    kp: [ 100.0 ]\n"
+    "    kd: [  20.0 ]\n"
+    "    maxvel: [ 0.5 ]\n"
+    "    maxacc: [ 1.5 ]\n"
+    "  - type: opspace::JPosTrjTask\n"
+    "    name: posture\n"
+    "    dt_seconds: 0.002\n"
+    "    kp: [ 400.0, 400.0, 400.0, 100.0, 100.0, 100.0 ]\n"
+    "    kd: [  40.0,  40.0,  40.0,  20.0,  20.0,  20.0 ]\n"
+    "    maxvel: [ 3.1416 ]\n"
+    "    maxacc: [ 6.2832 ]\n"
+    "- skills:\n"
+    "  - type: opspace::TaskPostureTrjSkill\n"
+    "    name: tpt\n"
+    "    slots:\n"
+    "      eepos: eepos\n"
+    "      posture: posture\n"
+    "  - type: opspace::GenericSkill\n"
+    "    name: generic\n"
+    "    slots:\n"
+    "      - task: posture\n"
+    "      - task: eepos\n";
+  
+  try {
+    Factory original;
+    Status st(original.parseString(yaml_string));
+    ASSERT_TRUE (st.ok) << st.errstr;
+    ASSERT_EQ (2, original.getSpec().tasks.size());
+    ASSERT_EQ (2, original.getSpec().skills.size());
+    ASSERT_EQ (2, original.getSpec().skills[1].slots.size());
+    EXPECT_EQ (1, original.getSpec().skills[1].slots[0].task);
+    
+    std::string const fname(jspace::test::create_tmpfile("skill.cache.XXXXXX", ""));
+    st = write_factory_cache(fname, 1234, original.getSpec());
+    ASSERT_TRUE (st.ok) << st.errstr;
+    FactorySpec spec;
+    EXPECT_FALSE (read_factory_cache(fname, 4321, spec).ok) << "cache for another source hash should be rejected";
+    st = read_factory_cache(fname, 1234, spec);
+    ASSERT_TRUE (st.ok) << st.errstr;
+    
+    Factory cached;
+    st = cached.instantiate(spec);
+    ASSERT_TRUE (st.ok) << st.errstr;
+    std::ostringstream original_dump, cached_dump;
+    original.dump(original_dump, "", "");
+    cached.dump(cached_dump, "", "");
+    EXPECT_EQ (original_dump.str(), cached_dump.str());
+    EXPECT_EQ (cached.findTask("posture"), cached.findSkill("generic")->lookupSlot("task")->getInstance(0));
+    
+    // unknown types make the whole instantiation fail
+    spec.types[spec.tasks[0].type] = "opspace::NoSuchTask";
+    Factory broken;
+    EXPECT_FALSE (broken.instantiate(spec).ok);
+    EXPECT_TRUE (broken.getTaskTable().empty());
+    
+    // a flipped byte in the body gets detected
+    {
+      FILE * ff(fopen(fname.c_str(), "r+b"));
+      ASSERT_TRUE (ff);
+      fseek(ff, -1, SEEK_END);
+      int const cc(fgetc(ff));
+      fseek(ff, -1, SEEK_END);
+      fputc(cc ^ 0xff, ff);
+      fclose(ff);
+    }
+    EXPECT_FALSE (read_factory_cache(fname, 1234, spec).ok);
+    
+    // the first parseFileCached() rebuilds the cache, the second one
+    // uses it, and editing the YAML file invalidates it
+    std::string const yaml_fname(jspace::test::create_tmpfile("skills.yaml.XXXXXX", yaml_string));
+    std::ostringstream msg;
+    Factory first;
+    st = first.parseFileCached(yaml_fname, fname, &msg);
+    ASSERT_TRUE (st.ok) << st.errstr;
+    EXPECT_NE (std::string::npos, msg.str().find("rebuilding")) << msg.str();
+    msg.str("");
+    Factory second;
+    st = second.parseFileCached(yaml_fname, fname, &msg);
+    ASSERT_TRUE (st.ok) << st.errstr;
+    EXPECT_TRUE (msg.str().empty()) << msg.str();
+    std::ostringstream second_dump;
+    second.dump(second_dump, "", "");
+    EXPECT_EQ (original_dump.str(), second_dump.str());
+    EXPECT_FALSE (second.parseFileCached(yaml_fname, fname, &msg).ok) << "needs an empty factory";
+    
+    std::string const edited(jspace::test::create_tmpfile("skills.yaml.XXXXXX",
+							  (std::string(yaml_string) + "\n").c_str()));
+    msg.str("");
+    Factory third;
+    st = third.parseFileCached(edited, fname, &msg);
+    ASSERT_TRUE (st.ok) << st.errstr;
+    EXPECT_NE (std::string::npos, msg.str().find("stale")) << msg.str();
+    
+    unlink(fname.c_str());
+    unlink(yaml_fname.c_str());
+    unlink(edited.c_str());
+  }
+  catch (YAML::Exception const & ee) {
+    ADD_FAILURE () << "unexpected YAML::Exception: " << ee.what();
+  }
+  catch (std::runtime_error const & ee) {
+    ADD_FAILURE () << "unexpected std::runtime_error: " << ee.what();
+  }
+}
+
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
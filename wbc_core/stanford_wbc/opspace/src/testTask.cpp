@@ -22,9 +22,14 @@
 #include <gtest/gtest.h>
 #include <opspace/task_library.hpp>
 #include <opspace/skill_library.hpp>
+#include <opspace/SkillSwitch.hpp>
 #include <opspace/ClassicTaskPostureController.hpp>
+#include <opspace/TypeIOTGCursor.hpp>
+#include <opspace/ViaPointTrajectory.hpp>
 #include <jspace/test/model_library.hpp>
 #include <err.h>
+#include <stdlib.h>
+#include <math.h>
 
 using jspace::Model;
 using jspace::State;
@@ -352,6 +357,339 @@ TEST (task, jlimit)
 }
 
 
+TEST (otg, batch)
+{
+  // Run the same loop as trjgen (in reflexxes_otg) with one TypeIOTG
+  // per group, and require that the batch produces exactly the same
+  // trajectories. Some velocities start above maxvel or towards the
+  // wrong direction, and some goals coincide with the start, in order
+  // to go through all profile types.
+  srand(4711);
+  for (size_t trial(0); trial < 200; ++trial) {
+    double const dt(1e-3 * (1 + trial % 10));
+    TypeIOTGBatch batch(dt);
+    vector<TypeIOTG*> otg;
+    size_t const ngroups(1 + trial % 4);
+    for (size_t ig(0); ig < ngroups; ++ig) {
+      size_t const nn(1 + (trial + ig) % 3);
+      batch.addGroup(nn);
+      otg.push_back(new TypeIOTG(nn, dt));
+    }
+    size_t const ndof(batch.getNDOF());
+    Vector maxvel(ndof), maxacc(ndof), goal(ndof);
+    vector<double> cpos(ndof), cvel(ndof), npos(ndof), nvel(ndof);
+    bool selection[3] = { true, true, true };
+    for (size_t ii(0); ii < ndof; ++ii) {
+      maxvel[ii] = 0.1 + 2.0 * rand() / RAND_MAX;
+      maxacc[ii] = 0.1 + 5.0 * rand() / RAND_MAX;
+      cpos[ii] = batch.position()[ii] = 4.0 * rand() / RAND_MAX - 2.0;
+      cvel[ii] = batch.velocity()[ii] = (0 == ii % 5) ? 0.0 : 8.0 * rand() / RAND_MAX - 4.0;
+      goal[ii] = (0 == ii % 7) ? cpos[ii] : 4.0 * rand() / RAND_MAX - 2.0;
+    }
+
+    for (size_t tick(0); tick < 100000; ++tick) {
+      int const result(batch.next(maxvel, maxacc, goal));
+      int expected(TypeIOTG::OTG_FINAL_STATE_REACHED);
+      for (size_t ig(0); ig < ngroups; ++ig) {
+	size_t const begin(batch.getGroupBegin(ig));
+	int const rr(otg[ig]->GetNextMotionState_Position(&cpos[begin], &cvel[begin],
+							  &maxvel[begin], &maxacc[begin],
+							  &goal[begin], selection,
+							  &npos[begin], &nvel[begin]));
+	ASSERT_EQ (rr, batch.getResult(ig)) << "trial " << trial << " tick " << tick << " group " << ig;
+	if (TypeIOTG::OTG_WORKING == rr) {
+	  expected = TypeIOTG::OTG_WORKING;
+	}
+      }
+      ASSERT_EQ (expected, result) << "trial " << trial << " tick " << tick;
+      for (size_t ii(0); ii < ndof; ++ii) {
+	ASSERT_EQ (npos[ii], batch.position()[ii]) << "trial " << trial << " tick " << tick << " dof " << ii;
+	ASSERT_EQ (nvel[ii], batch.velocity()[ii]) << "trial " << trial << " tick " << tick << " dof " << ii;
+      }
+      swap(cpos, npos);
+      swap(cvel, nvel);
+      if (TypeIOTG::OTG_FINAL_STATE_REACHED == result) {
+	break;
+      }
+    }
+
+    for (size_t ig(0); ig < ngroups; ++ig) {
+      delete otg[ig];
+    }
+  }
+
+  // disabled groups and groups with invalid limits keep their state
+  TypeIOTGBatch batch(1e-3);
+  batch.addGroup(2);
+  batch.addGroup(1);
+  batch.addGroup(1);
+  batch.setEnabled(2, false);
+  Vector maxvel(Vector::Ones(4)), maxacc(Vector::Ones(4)), goal(Vector::Ones(4));
+  maxvel[2] = 0.0;
+  batch.position()[2] = 0.5;
+  batch.position()[3] = -0.5;
+  EXPECT_EQ (TypeIOTG::OTG_MAX_VELOCITY_ERROR, batch.next(maxvel, maxacc, goal));
+  EXPECT_EQ (TypeIOTG::OTG_WORKING, batch.getResult(0));
+  EXPECT_EQ (TypeIOTG::OTG_MAX_VELOCITY_ERROR, batch.getResult(1));
+  EXPECT_EQ (0.5, batch.position()[2]);
+  EXPECT_EQ (-0.5, batch.position()[3]);
+  EXPECT_LT (0.0, batch.position()[0]);
+
+  // the cursor swaps buffers instead of copying
+  TypeIOTGCursor cursor(1, 1e-3);
+  double const * before(cursor.position().data());
+  EXPECT_EQ (TypeIOTG::OTG_WORKING, cursor.next(1.0, 1.0, 1.0));
+  EXPECT_NE (before, cursor.position().data());
+  EXPECT_EQ (TypeIOTG::OTG_WORKING, cursor.next(1.0, 1.0, 1.0));
+  EXPECT_EQ (before, cursor.position().data()) << "should be back to the first buffer";
+  TypeIOTGCursor cursor2(2, 1e-3);
+  EXPECT_EQ (-1000, cursor2.next(1.0, 1.0, 1.0));
+}
+
+
+TEST (otg, phase_sync)
+{
+  // Group 0 is phase synchronized and group 1 is not. The latter has
+  // to produce the same trajectory as in a batch of its own, and the
+  // former has to stay on the line from start to goal. The straight
+  // line cannot be faster than the per-DOF trajectories.
+  srand(4711);
+  for (size_t trial(0); trial < 50; ++trial) {
+    double const dt(1e-3 * (1 + trial % 10));
+    TypeIOTGBatch batch(dt);
+    batch.addGroup(3);
+    batch.addGroup(2);
+    batch.setPhaseSync(0, true);
+    TypeIOTGBatch perdof(dt);
+    perdof.addGroup(3);
+    perdof.addGroup(2);
+    Vector maxvel(5), maxacc(5), goal(5), start(5);
+    for (size_t ii(0); ii < 5; ++ii) {
+      maxvel[ii] = 0.1 + 2.0 * rand() / RAND_MAX;
+      maxacc[ii] = 0.1 + 5.0 * rand() / RAND_MAX;
+      start[ii] = batch.position()[ii] = perdof.position()[ii] = 4.0 * rand() / RAND_MAX - 2.0;
+      goal[ii] = 4.0 * rand() / RAND_MAX - 2.0;
+    }
+
+    size_t arrived(0), arrived_perdof(0);
+    for (size_t tick(1); tick < 100000; ++tick) {
+      int const result(batch.next(maxvel, maxacc, goal));
+      int const result_perdof(perdof.next(maxvel, maxacc, goal));
+      ASSERT_LE (0, result) << "trial " << trial << " tick " << tick;
+      for (size_t ii(3); ii < 5; ++ii) {
+	ASSERT_EQ (perdof.position()[ii], batch.position()[ii]) << "trial " << trial << " tick " << tick;
+	ASSERT_EQ (perdof.velocity()[ii], batch.velocity()[ii]) << "trial " << trial << " tick " << tick;
+      }
+      for (size_t ii(0); ii < 3; ++ii) {
+	ASSERT_GE (maxvel[ii] + 1e-9, fabs(batch.velocity()[ii])) << "trial " << trial << " tick " << tick;
+	for (size_t jj(ii + 1); jj < 3; ++jj) {
+	  double const cross((batch.position()[ii] - start[ii]) * (goal[jj] - start[jj])
+			     - (batch.position()[jj] - start[jj]) * (goal[ii] - start[ii]));
+	  ASSERT_NEAR (0.0, cross, 1e-9) << "trial " << trial << " tick " << tick;
+	}
+      }
+      if ((0 == arrived) && (TypeIOTG::OTG_FINAL_STATE_REACHED == batch.getResult(0))) {
+	arrived = tick;
+	for (size_t ii(0); ii < 3; ++ii) {
+	  EXPECT_EQ (goal[ii], batch.position()[ii]);
+	  EXPECT_EQ (0.0, batch.velocity()[ii]);
+	}
+      }
+      if ((0 == arrived_perdof) && (TypeIOTG::OTG_FINAL_STATE_REACHED == perdof.getResult(0))) {
+	arrived_perdof = tick;
+      }
+      if ((TypeIOTG::OTG_FINAL_STATE_REACHED == result)
+	  && (TypeIOTG::OTG_FINAL_STATE_REACHED == result_perdof)) {
+	break;
+      }
+    }
+    ASSERT_LT (0, arrived) << "trial " << trial;
+    EXPECT_LE (arrived_perdof, arrived + 1) << "trial " << trial;
+  }
+
+  // A goal change while moving sideways cannot be done along a
+  // straight line, so the cursor falls back to per-DOF trajectories
+  // until it comes to rest, after which it goes straight again.
+  TypeIOTGCursor cursor(2, 1e-3);
+  cursor.setPhaseSync(true);
+  Vector maxvel(Vector::Ones(2)), maxacc(Vector::Ones(2)), goal(Vector::Ones(2));
+  for (size_t tick(0); tick < 500; ++tick) {
+    ASSERT_EQ (TypeIOTG::OTG_WORKING, cursor.next(maxvel, maxacc, goal));
+    ASSERT_EQ (cursor.position()[0], cursor.position()[1]);
+  }
+  goal[1] = -1.0;
+  int result(TypeIOTG::OTG_WORKING);
+  for (size_t tick(0); (tick < 100000) && (TypeIOTG::OTG_WORKING == result); ++tick) {
+    result = cursor.next(maxvel, maxacc, goal);
+  }
+  EXPECT_EQ (TypeIOTG::OTG_FINAL_STATE_REACHED, result);
+  EXPECT_EQ (goal, cursor.position());
+  goal[0] = 3.0;
+  goal[1] = 1.0;
+  for (size_t tick(0); tick < 100; ++tick) {
+    ASSERT_EQ (TypeIOTG::OTG_WORKING, cursor.next(maxvel, maxacc, goal));
+    ASSERT_NEAR (cursor.position()[0] - 1.0, 1.0 + cursor.position()[1], 1e-12);
+  }
+}
+
+
+TEST (trajectory, via_points)
+{
+  // Sample random via point trajectories finely, and check that they
+  // respect the limits, are continuous in position and velocity, and
+  // start and end at rest.
+  srand(4711);
+  for (size_t trial(0); trial < 200; ++trial) {
+    size_t const ndim(1 + trial % 4);
+    size_t const npoints(1 + trial % 9);
+    Vector start(ndim), points(ndim * npoints), maxvel(ndim), maxacc(ndim);
+    for (size_t ii(0); ii < ndim; ++ii) {
+      start[ii] = 2.0 * rand() / RAND_MAX - 1.0;
+      maxvel[ii] = 0.1 + 1.0 * rand() / RAND_MAX;
+      maxacc[ii] = 0.1 + 3.0 * rand() / RAND_MAX;
+    }
+    for (size_t ii(0); ii < ndim * npoints; ++ii) {
+      // every now and then, repeat the start point
+      points[ii] = ((0 == trial % 7) && (ii < ndim)) ? start[ii] : 2.0 * rand() / RAND_MAX - 1.0;
+    }
+    ViaPointTrajectory trj;
+    Status const st(trj.compute(start, points, maxvel, maxacc));
+    ASSERT_TRUE (st.ok) << "trial " << trial << ": " << st.errstr;
+    ASSERT_EQ (npoints + 1, trj.getNPoints());
+
+    double const dt(1e-3);
+    Vector pos0, vel0, acc0, pos1, vel1, acc1;
+    trj.evaluate(0.0, pos0, vel0, acc0);
+    EXPECT_TRUE (pos0 == start) << "trial " << trial;
+    EXPECT_EQ (0.0, vel0.norm()) << "trial " << trial;
+    for (double tt(dt); tt < trj.getDuration() + 2 * dt; tt += dt) {
+      trj.evaluate(tt, pos1, vel1, acc1);
+      for (size_t ii(0); ii < ndim; ++ii) {
+	ASSERT_GE (maxvel[ii] + 1e-9, fabs(vel1[ii])) << "trial " << trial << " t " << tt;
+	ASSERT_GE (maxacc[ii] + 1e-9, fabs(acc1[ii])) << "trial " << trial << " t " << tt;
+	ASSERT_NEAR (pos0[ii] + 0.5 * dt * (vel0[ii] + vel1[ii]), pos1[ii], 1e-6)
+	  << "trial " << trial << " t " << tt;
+	ASSERT_GE (maxacc[ii] * dt + 1e-9, fabs(vel1[ii] - vel0[ii])) << "trial " << trial << " t " << tt;
+      }
+      pos0 = pos1;
+      vel0 = vel1;
+    }
+    EXPECT_TRUE (pos1 == Vector(points.segment(ndim * (npoints - 1), ndim))) << "trial " << trial;
+    EXPECT_EQ (0.0, vel1.norm()) << "trial " << trial;
+    EXPECT_EQ (npoints, trj.getTarget(trj.getDuration()));
+  }
+
+  // Going around a polygon does not stop at the corners, so it is
+  // faster than stopping at each of them would be.
+  Vector start(Vector::Zero(3)), points(3 * 16);
+  start[0] = 0.3;
+  for (size_t kk(0); kk < 16; ++kk) {
+    points[3 * kk] = 0.3 * cos(M_PI * (kk + 1) / 8);
+    points[3 * kk + 1] = 0.3 * sin(M_PI * (kk + 1) / 8);
+    points[3 * kk + 2] = 0.0;
+  }
+  ViaPointTrajectory trj;
+  ASSERT_TRUE (trj.compute(start, points, Vector::Ones(1), Vector::Ones(1)).ok);
+  double stop_and_go(0);
+  for (size_t kk(0); kk < 16; ++kk) {
+    double const side(2 * 0.3 * sin(M_PI / 16));
+    stop_and_go += 2 * sqrt(side);  // triangular profile at unit acceleration
+  }
+  EXPECT_GT (0.5 * stop_and_go, trj.getDuration());
+
+  Vector pos, vel, acc;
+  trj.evaluate(0.5 * trj.getDuration(), pos, vel, acc);
+  EXPECT_LT (0.1, vel.norm()) << "should still be moving half way";
+
+  // invalid arguments
+  EXPECT_FALSE (trj.compute(start, Vector::Zero(4), Vector::Ones(1), Vector::Ones(1)).ok);
+  EXPECT_FALSE (trj.compute(start, points, Vector::Ones(2), Vector::Ones(1)).ok);
+  EXPECT_FALSE (trj.compute(start, points, Vector::Ones(1), Vector::Zero(1)).ok);
+  EXPECT_FALSE (trj.isValid());
+
+  // a streamed state replaces one step of the cursor, which then
+  // continues from there
+  TypeIOTGCursor cursor(1, 1e-3);
+  cursor.stream(0.5 * Vector::Ones(1), Vector::Ones(1));
+  EXPECT_EQ (TypeIOTG::OTG_WORKING, cursor.next(1.0, 1.0, 1.0));
+  EXPECT_EQ (0.5, cursor.position()[0]);
+  EXPECT_EQ (1.0, cursor.velocity()[0]);
+  EXPECT_EQ (TypeIOTG::OTG_WORKING, cursor.next(1.0, 1.0, 1.0));
+  EXPECT_LT (0.5, cursor.position()[0]);
+}
+
+
+TEST (skill, switch)
+{
+  Model * puma(get_puma());
+  size_t const ndof(puma->getNDOF());
+  
+  shared_ptr<GenericSkill> posture(new GenericSkill("posture"));
+  posture->appendTask(create_sel_jp_task("all", Vector::Ones(ndof)));
+  shared_ptr<JPosTrjTask> trj(new JPosTrjTask("trj"));
+  trj->quickSetup(1e-3, 100.0, 20.0, 1.0, 2.0);
+  shared_ptr<GenericSkill> trajectory(new GenericSkill("trajectory"));
+  trajectory->appendTask(trj);
+  Factory::skill_table_t skills;
+  skills.push_back(posture);
+  skills.push_back(trajectory);
+  
+  SkillSwitch sw("switch");
+  EXPECT_FALSE (sw.getActive()) << "no active skill before init";
+  Status st(sw.init(*puma, skills));
+  ASSERT_TRUE (st.ok) << st.errstr;
+  EXPECT_EQ (posture.get(), sw.getActive());
+  EXPECT_EQ (1, sw.findSkill("trajectory"));
+  EXPECT_EQ (-1, sw.findSkill("nonexistent"));
+  
+  Parameter * skill(sw.lookupParameter("skill", PARAMETER_TYPE_INTEGER));
+  ASSERT_TRUE (skill);
+  EXPECT_FALSE (skill->set(2).ok) << "index out of range should be rejected";
+  EXPECT_FALSE (skill->set(-1).ok) << "negative index should be rejected";
+  EXPECT_FALSE (sw.lookupParameter("active")->set(1).ok) << "active should be read-only";
+  ASSERT_TRUE (sw.update(*puma).ok);
+  EXPECT_EQ (posture.get(), sw.getActive());
+  
+  // Move the robot, then switch: the trajectory has to start from
+  // the new position, not from where it was at init time, but it
+  // keeps heading for the goal it had.
+  State state(puma->getState());
+  Vector const goal(state.position_);
+  state.position_ += 0.1 * Vector::Ones(ndof);
+  state.velocity_ = Vector::Zero(ndof);
+  puma->update(state);
+  EXPECT_TRUE (skill->set(1).ok);
+  EXPECT_EQ (posture.get(), sw.getActive()) << "switch should wait for the next tick";
+  st = sw.update(*puma);
+  ASSERT_TRUE (st.ok) << st.errstr;
+  EXPECT_EQ (trajectory.get(), sw.getActive());
+  EXPECT_EQ (1, sw.getActiveIndex());
+  EXPECT_EQ (1, *sw.lookupParameter("latency")->getInteger());
+  EXPECT_EQ (1, *sw.lookupParameter("switches")->getInteger());
+  EXPECT_TRUE (goal == *trj->lookupParameter("trjgoal")->getVector()) << "handoff should keep the goal";
+  ASSERT_TRUE (trajectory->update(*puma).ok);
+  Vector const carrot(*trj->lookupParameter("goalpos")->getVector());
+  EXPECT_GT (1e-3, (carrot - state.position_).norm()) << "trajectory should restart from the current position";
+  EXPECT_GT (0.0, (carrot - state.position_).sum()) << "trajectory should move toward the goal";
+  
+  // Going back and forth between two ticks is not a switch.
+  EXPECT_TRUE (skill->set(0).ok);
+  EXPECT_TRUE (skill->set(1).ok);
+  ASSERT_TRUE (sw.update(*puma).ok);
+  EXPECT_EQ (trajectory.get(), sw.getActive());
+  EXPECT_EQ (1, *sw.lookupParameter("switches")->getInteger());
+  
+  // Writing the parameter and calling request() are the same thing.
+  EXPECT_FALSE (sw.request(2).ok) << "index out of range should be rejected";
+  EXPECT_TRUE (sw.request(0).ok);
+  EXPECT_EQ (0, *skill->getInteger());
+  ASSERT_TRUE (sw.update(*puma).ok);
+  EXPECT_EQ (posture.get(), sw.getActive());
+  EXPECT_EQ (1, *sw.lookupParameter("latency")->getInteger());
+  EXPECT_EQ (2, *sw.lookupParameter("switches")->getInteger());
+}
+
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -24,34 +24,24 @@
 #include <tao/matrix/TaoDeMath.h>
 #include "taoDNode.h"
 #include "taoABNode.h"
+#include "taoSweep.h"
 
 #include <assert.h>
 
-#ifndef DOXYGEN_SHOULD_SKIP_THIS
-
-class taoABDynamicsData
-{
-public:
-	deMatrix6 Ia;
-	deVector3 WxV;
-	deVector3 g;
-};
-
-class taoABDynamicsData2
-{
-public:
-	deVector3 WxV;
-	deVector3 g;
-};
-
-#endif // DOXYGEN_SHOULD_SKIP_THIS
+// All tree passes below loop over the preorder (outward) or postorder
+// (inward) of a taoSweep. Quantities of the parent which the
+// recursive formulation passed down as arguments (Vh, Ah, ...) are
+// looked up in the parent's taoABNode, or in the sweep's scratch
+// arrays, and the root of the subtree gets what the caller passed.
 
 void taoABDynamics::updateLocalXTreeOut(taoDNode* root)
 {
-	root->getABNode()->updateLocalX(*root->frameHome(), *root->frameLocal());
-
-	for (taoDNode* n = root->getDChild(); n != NULL; n = n->getDSibling())
-		updateLocalXTreeOut(n);
+	taoSweep* sweep = root->getSweep();
+	for (deInt i = 0; i < sweep->size(); i++)
+	{
+		taoDNode* n = sweep->node(i);
+		n->getABNode()->updateLocalX(*n->frameHome(), *n->frameLocal());
+	}
 }
 
 void taoABDynamics::resetInertia(taoDNode* node)
@@ -61,46 +51,52 @@ void taoABDynamics::resetInertia(taoDNode* node)
 
 void taoABDynamics::resetInertiaTreeOut(taoDNode* root)
 {
-	resetInertia(root);
-
-	for (taoDNode* n = root->getDChild(); n != NULL; n = n->getDSibling())
-		resetInertiaTreeOut(n);
+	taoSweep* sweep = root->getSweep();
+	for (deInt i = 0; i < sweep->size(); i++)
+		resetInertia(sweep->node(i));
 }
 
 void taoABDynamics::resetFlagTreeOut(taoDNode* root)
 {
-	root->getABNode()->setFlag(0);
-
-	for (taoDNode* n = root->getDChild(); n != NULL; n = n->getDSibling())
-		resetFlagTreeOut(n);
+	taoSweep* sweep = root->getSweep();
+	for (deInt i = 0; i < sweep->size(); i++)
+		sweep->node(i)->getABNode()->setFlag(0);
 }
 
 void taoABDynamics::opSpaceInertiaMatrixOut(taoDNode* root, const deMatrix6* Oah)
 {
-	deMatrix6* Oa = root->getABNode()->Omega();
-
-	root->getABNode()->osInertiaInv(*Oa, *Oah);
+	taoSweep* sweep = root->getSweep();
+	for (deInt i = 0; i < sweep->size(); i++)
+	{
+		taoABNode* ab = sweep->node(i)->getABNode();
+		deInt p = sweep->parent(i);
+		const deMatrix6* Oh = (p < 0) ? Oah : sweep->node(p)->getABNode()->Omega();
 
-	for (taoDNode* n = root->getDChild(); n != NULL; n = n->getDSibling())
-		opSpaceInertiaMatrixOut(n, Oa);
+		ab->osInertiaInv(*ab->Omega(), *Oh);
+	}
 }
 
 void taoABDynamics::globalJacobianOut(taoDNode* root)
 {
-	root->getABNode()->globalJacobian(*root->frameGlobal());
-
-	for (taoDNode* n = root->getDChild(); n != NULL; n = n->getDSibling())
-		globalJacobianOut(n);
+	taoSweep* sweep = root->getSweep();
+	for (deInt i = 0; i < sweep->size(); i++)
+	{
+		taoDNode* n = sweep->node(i);
+		n->getABNode()->globalJacobian(*n->frameGlobal());
+	}
 }
 
 void taoABDynamics::biasAccelerationOut(taoDNode* root, const deVector6* Hh)
 {
-	deVector6* H = root->getABNode()->H();
-
-	root->getABNode()->biasAcceleration(*H, *Hh);
+	taoSweep* sweep = root->getSweep();
+	for (deInt i = 0; i < sweep->size(); i++)
+	{
+		taoABNode* ab = sweep->node(i)->getABNode();
+		deInt p = sweep->parent(i);
+		const deVector6* Hp = (p < 0) ? Hh : sweep->node(p)->getABNode()->H();
 
-	for (taoDNode* n = root->getDChild(); n != NULL; n = n->getDSibling())
-		biasAccelerationOut(n, H);
+		ab->biasAcceleration(*ab->H(), *Hp);
+	}
 }
 
 // Oc = iXc^T Oi iXc  
@@ -174,33 +170,31 @@ deFloat taoABDynamics::effectiveMassInv(taoDNode* node, const deVector3* point,
 
 void taoABDynamics::compute_Jg_Omega_H(taoDNode* root, const deMatrix6* Oah, const deVector6* Hh)
 {
-	deMatrix6* Oa = root->getABNode()->Omega();
-	deVector6* H = root->getABNode()->H();
-
-	root->getABNode()->globalJacobian(*root->frameGlobal());
-	root->getABNode()->osInertiaInv(*Oa, *Oah);
-	root->getABNode()->biasAcceleration(*H, *Hh);
-
-	for (taoDNode* n = root->getDChild(); n != NULL; n = n->getDSibling())
-		compute_Jg_Omega_H(n, Oa, H);
+	taoSweep* sweep = root->getSweep();
+	for (deInt i = 0; i < sweep->size(); i++)
+	{
+		taoDNode* n = sweep->node(i);
+		taoABNode* ab = n->getABNode();
+		deInt p = sweep->parent(i);
+		const deMatrix6* Oh = (p < 0) ? Oah : sweep->node(p)->getABNode()->Omega();
+		const deVector6* Hp = (p < 0) ? Hh : sweep->node(p)->getABNode()->H();
+
+		ab->globalJacobian(*n->frameGlobal());
+		ab->osInertiaInv(*ab->Omega(), *Oh);
+		ab->biasAcceleration(*ab->H(), *Hp);
+	}
 }
 
 void taoABDynamics::_plusEq_Jg_ddQ(taoDNode* node, deVector6* A)
 {
-	if (!node->isRoot())
-	{
+	for (; !node->isRoot(); node = node->getDParent())
 		node->getABNode()->plusEq_Jg_ddQ(*A);
-		_plusEq_Jg_ddQ(node->getDParent(), A);
-	}
 }
 
 void taoABDynamics::add2Tau_JgT_F(taoDNode* node, const deVector6* Fg)
 {
-	if (!node->isRoot())
-	{
+	for (; !node->isRoot(); node = node->getDParent())
 		node->getABNode()->add2Tau_JgT_F(*Fg);
-		add2Tau_JgT_F(node->getDParent(), Fg);
-	}
 }
 
 // Tau = Je^T Fe + Tau_null
@@ -250,20 +244,16 @@ void taoABDynamics::opSpaceInvDynamics(taoDNode* opNode, deVector6* ddXn)
 
 void taoABDynamics::forwardDynamics(taoDNode* root, const deVector3* gravity)
 {
-	taoABDynamicsData data;
-	data.g = *gravity;
+	taoSweep* sweep = root->getSweep();
 
-	_forwardDynamicsOutIn(root, &data, NULL, NULL);
+	_forwardDynamicsOutIn(sweep, gravity);
 
-	_accelerationTreeOut(root, NULL);
+	_accelerationTreeOut(sweep);
 }
 
 void taoABDynamics::inverseDynamics(taoDNode* root, const deVector3* gravity)
 {
-	taoABDynamicsData2 data;
-	data.g = *gravity;
-
-	_inverseDynamicsOutIn(root, &data, NULL, NULL, NULL);
+	_inverseDynamicsOutIn(root->getSweep(), gravity);
 }
 
 void taoABDynamics::forwardDynamicsImpulse(taoDNode* contact, const deVector3* point, const deVector3* impulse, const deInt dist)
@@ -281,117 +271,247 @@ void taoABDynamics::_articulatedImpulsePathIn(taoDNode* contact, const deInt dis
 
 	contact->getABNode()->abImpulse(*(n->getABNode()->Pa()), !n->isRoot());
 
-	if (!n->isRoot())
+	while (!n->isRoot())
 	{
 		n->getABNode()->setFlag(1);
-		_articulatedImpulsePathIn(n, dist);
+		contact = n;
+		n = contact->getDParent();
+		contact->getABNode()->abImpulse(*(n->getABNode()->Pa()), !n->isRoot());
 	}
-	else
-		_velocityDeltaTreeOut(n, NULL, NULL, dist);
+
+	_velocityDeltaTreeOut(n->getSweep(), dist);
 }
 
 
-void taoABDynamics::_forwardDynamicsOutIn(taoDNode* root, taoABDynamicsData* datah, deVector6* Pah, const deVector6 *Vh)
+void taoABDynamics::_forwardDynamicsOutIn(taoSweep* sweep, const deVector3* gravity)
 {
-	taoABDynamicsData data;
-	deVector6* Pa = root->getABNode()->Pa();
-	deVector6* V = root->getABNode()->V();
-	deVector6 G;
+	const deInt size = sweep->size();
 
-	root->getABNode()->abInertiaInit(data.Ia);
+	// the caller's frame, as seen from the root of the subtree
+	deMatrix6 Iah;
+	deVector3 WxVh;
+	deVector3 gh = *gravity;
 
-	root->getABNode()->velocity(*V, data.WxV, *Vh, datah->WxV);
+	for (deInt i = 0; i < size; i++)
+	{
+		taoDNode* n = sweep->node(i);
+		taoABNode* ab = n->getABNode();
+		deInt p = sweep->parent(i);
+		deVector6* Pa = ab->Pa();
+		deVector6* V = ab->V();
+		const deVector6* Vh = (p < 0) ? NULL : sweep->node(p)->getABNode()->V();
+		deVector6 G;
+
+		ab->abInertiaInit(sweep->Ia[i]);
 
-	root->getABNode()->biasForce(*Pa, *V, data.WxV);
+		ab->velocity(*V, sweep->WxV[i], *Vh, (p < 0) ? WxVh : sweep->WxV[p]);
 
-	root->getABNode()->gravityForce(G, data.g, datah->g);
+		ab->biasForce(*Pa, *V, sweep->WxV[i]);
 
-	root->getABNode()->externalForce(*Pa, G, *root->force());
+		ab->gravityForce(G, sweep->g[i], (p < 0) ? gh : sweep->g[p]);
 
-	for (taoDNode* n = root->getDChild(); n != NULL; n = n->getDSibling())
-		_forwardDynamicsOutIn(n, &data, Pa, V);
+		ab->externalForce(*Pa, G, *n->force());
+	}
+
+	for (deInt k = 0; k < size; k++)
+	{
+		deInt i = sweep->post(k);
+		deInt p = sweep->parent(i);
+		taoDNode* n = sweep->node(i);
+		deVector6* Pah = (p < 0) ? NULL : sweep->node(p)->getABNode()->Pa();
 
-	root->getABNode()->abInertiaDepend(datah->Ia, *Pah, data.Ia, !root->isParentRoot());
+		n->getABNode()->abInertiaDepend((p < 0) ? Iah : sweep->Ia[p], *Pah, sweep->Ia[i], !n->isParentRoot());
+	}
 }
 
-void taoABDynamics::_inverseDynamicsOutIn(taoDNode* root, taoABDynamicsData2* datah, deVector6* Fh, const deVector6* Vh, const deVector6* Ah)
+void taoABDynamics::_inverseDynamicsOutIn(taoSweep* sweep, const deVector3* gravity)
 {
-	taoABDynamicsData2 data;
-	deVector6* F = root->getABNode()->Pa();
-	deVector6* A = root->getABNode()->A();
-	deVector6* V = root->getABNode()->V();
-	deVector6 P;
-	deVector6 G;
-
-	if (!root->getPropagate())
+	const deInt size = sweep->size();
+
+	deVector3 WxVh;
+	deVector3 gh = *gravity;
+
+	for (deInt i = 0; i < size; i++)
 	{
-		F->zero();
+		taoDNode* n = sweep->node(i);
+		taoABNode* ab = n->getABNode();
+		deVector6* F = ab->Pa();
+
+		if (!n->getPropagate())
+		{
+			F->zero();
+		}
+		else
+		{
+			deInt p = sweep->parent(i);
+			deVector6* A = ab->A();
+			deVector6* V = ab->V();
+			const deVector6* Vh = (p < 0) ? NULL : sweep->node(p)->getABNode()->V();
+			const deVector6* Ah = (p < 0) ? NULL : sweep->node(p)->getABNode()->A();
+			deVector6 P;
+			deVector6 G;
+
+			ab->velocity(*V, sweep->WxV[i], *Vh, (p < 0) ? WxVh : sweep->WxV[p]);
+
+			ab->biasForce(P, *V, sweep->WxV[i]);
+
+			ab->gravityForce(G, sweep->g[i], (p < 0) ? gh : sweep->g[p]);
+
+			ab->externalForce(P, G, *n->force());
+
+			ab->accelerationOnly(*A, *Ah);
+
+			ab->netForce(*F, *A, P);
+		}
 	}
-	else
-	{
-		root->getABNode()->velocity(*V, data.WxV, *Vh, datah->WxV);
 
-		root->getABNode()->biasForce(P, *V, data.WxV);
-		
-		root->getABNode()->gravityForce(G, data.g, datah->g);
+	_forceTreeIn(sweep);
+}
 
-		root->getABNode()->externalForce(P, G, *root->force());
+void taoABDynamics::inverseDynamicsSplit(taoDNode* root, const deVector3* gravity)
+{
+	taoSweep* sweep = root->getSweep();
+	const deInt size = sweep->size();
 
-		root->getABNode()->accelerationOnly(*A, *Ah);
+	deVector3 WxVh;
+	deVector3 gh = *gravity;
+	deVector6 zero;
+	zero.zero();
 
-		root->getABNode()->netForce(*F, *A, P);
+	for (deInt i = 0; i < size; i++)
+	{
+		taoDNode* n = sweep->node(i);
+		taoABNode* ab = n->getABNode();
+		deVector6* F = ab->Pa();
+
+		if (!n->getPropagate())
+		{
+			F->zero();
+			sweep->F[i].zero();
+		}
+		else
+		{
+			deInt p = sweep->parent(i);
+			deVector6* A = ab->A();
+			deVector6* V = ab->V();
+			const deVector6* Vh = (p < 0) ? NULL : sweep->node(p)->getABNode()->V();
+			const deVector6* Ah = (p < 0) ? NULL : sweep->node(p)->getABNode()->A();
+			deVector6 P;
+			deVector6 G;
+
+			ab->velocity(*V, sweep->WxV[i], *Vh, (p < 0) ? WxVh : sweep->WxV[p]);
+
+			ab->biasForce(P, *V, sweep->WxV[i]);
+
+			ab->gravityForce(G, sweep->g[i], (p < 0) ? gh : sweep->g[p]);
+
+			// the same operations as inverseDynamics(), but on a zero
+			// bias force, so that gravity comes out exactly the same
+			sweep->F[i] = zero;
+			ab->externalForce(sweep->F[i], G, *n->force());
+
+			ab->accelerationOnly(*A, *Ah);
+
+			ab->netForce(*F, *A, P);
+		}
 	}
 
-	for (taoDNode* n = root->getDChild(); n != NULL; n = n->getDSibling())
-		_inverseDynamicsOutIn(n, &data, F, V, A);
+	_forceTreeIn(sweep);
+}
+
+void taoABDynamics::gravityDynamicsIn(taoDNode* root)
+{
+	taoSweep* sweep = root->getSweep();
+	const deInt size = sweep->size();
 
-	root->getABNode()->force(*Fh, !root->isParentRoot());
+	for (deInt i = 0; i < size; i++)
+	{
+		deVector6* F = sweep->node(i)->getABNode()->Pa();
+		if (F != NULL)
+			*F = sweep->F[i];
+	}
+
+	_forceTreeIn(sweep);
 }
 
-void taoABDynamics::_accelerationTreeOut(taoDNode* root, const deVector6* Ah)
+void taoABDynamics::_forceTreeIn(taoSweep* sweep)
 {
-	deVector6* A = root->getABNode()->A();
+	for (deInt k = 0; k < sweep->size(); k++)
+	{
+		deInt i = sweep->post(k);
+		deInt p = sweep->parent(i);
+		taoDNode* n = sweep->node(i);
+		deVector6* Fh = (p < 0) ? NULL : sweep->node(p)->getABNode()->Pa();
 
-	root->getABNode()->acceleration(*A, *Ah);
+		n->getABNode()->force(*Fh, !n->isParentRoot());
+	}
+}
 
-	for (taoDNode* n = root->getDChild(); n != NULL; n = n->getDSibling())
-		_accelerationTreeOut(n, A);
+void taoABDynamics::_accelerationTreeOut(taoSweep* sweep)
+{
+	for (deInt i = 0; i < sweep->size(); i++)
+	{
+		taoABNode* ab = sweep->node(i)->getABNode();
+		deInt p = sweep->parent(i);
+		const deVector6* Ah = (p < 0) ? NULL : sweep->node(p)->getABNode()->A();
+
+		ab->acceleration(*ab->A(), *Ah);
+	}
 }
 
 
-void taoABDynamics::_velocityDeltaTreeOut(taoDNode* root, const deVector6* dVh, const deVector6* Vh, const deInt dist)
+void taoABDynamics::_velocityDeltaTreeOut(taoSweep* sweep, const deInt dist)
 {
-	deVector6 *V = root->getABNode()->V();
-	deVector6 dV;
+	for (deInt i = 0; i < sweep->size(); i++)
+	{
+		taoABNode* ab = sweep->node(i)->getABNode();
+		deInt p = sweep->parent(i);
+		const deVector6* dVh = (p < 0) ? NULL : &sweep->dV[p];
+		const deVector6* Vh = (p < 0) ? NULL : sweep->node(p)->getABNode()->V();
 
-	root->getABNode()->velocityDelta(dV, *dVh, dist);
-	root->getABNode()->velocityOnly(*V, *Vh);
-	
-	for (taoDNode* n = root->getDChild(); n != NULL; n = n->getDSibling())
-		_velocityDeltaTreeOut(n, &dV, V, dist);
+		ab->velocityDelta(sweep->dV[i], *dVh, dist);
+		ab->velocityOnly(*ab->V(), *Vh);
+	}
 }
 
 deFloat taoABDynamics::potentialEnergy(taoDNode* root, const deVector3* gh)
 {
-	deFloat E;
+	taoSweep* sweep = root->getSweep();
 
-	E = root->getABNode()->potentialEnergy(*gh, *root->frameGlobal(), *root->mass(), *root->center());
-
-	for (taoDNode* n = root->getDChild(); n != NULL; n = n->getDSibling())
-		E += potentialEnergy(n, gh);
+	for (deInt i = 0; i < sweep->size(); i++)
+	{
+		taoDNode* n = sweep->node(i);
+		sweep->E[i] = n->getABNode()->potentialEnergy(*gh, *n->frameGlobal(), *n->mass(), *n->center());
+	}
 
-	return E;
+	return _sumEnergyIn(sweep);
 }
 
 deFloat taoABDynamics::kineticEnergy(taoDNode* root, const deVector6* Vh)
 {
-	deFloat E;
-	deVector6* V = root->getABNode()->V();
+	taoSweep* sweep = root->getSweep();
 
-	E = root->getABNode()->kineticEnergy(*V, *Vh);
+	for (deInt i = 0; i < sweep->size(); i++)
+	{
+		taoABNode* ab = sweep->node(i)->getABNode();
+		deInt p = sweep->parent(i);
+		const deVector6* Vp = (p < 0) ? Vh : sweep->node(p)->getABNode()->V();
 
-	for (taoDNode* n = root->getDChild(); n != NULL; n = n->getDSibling())
-		E += kineticEnergy(n, V);
+		sweep->E[i] = ab->kineticEnergy(*ab->V(), *Vp);
+	}
+
+	return _sumEnergyIn(sweep);
+}
+
+// adds up the subtree sums in postorder, which keeps the order of the
+// floating point additions of the recursive formulation
+deFloat taoABDynamics::_sumEnergyIn(taoSweep* sweep)
+{
+	for (deInt k = 0; k < sweep->size() - 1; k++)
+	{
+		deInt i = sweep->post(k);
+		sweep->E[sweep->parent(i)] += sweep->E[i];
+	}
 
-	return E;
+	return sweep->E[0];
 }
@@ -31,8 +31,7 @@ class deMatrix6;
 class deVector3;
 class deVector6;
 class deFrame;
-class taoABDynamicsData;
-class taoABDynamicsData2;
+class taoSweep;
 
 //#ifndef DOXYGEN_SHOULD_SKIP_THIS
 
@@ -63,6 +62,23 @@ public:
 	 *	\post	tau is computed torque
 	 */
 	static void inverseDynamics(taoDNode* root, const deVector3* gravity);
+	//! inverse dynamics of the subtree with \a root, split into velocity and gravity terms
+	/*!
+	 *	Runs the outward pass of inverseDynamics() once, and keeps the
+	 *	forces due to \a gravity (and the external forces) apart from
+	 *	the ones due to the joint velocities. Then it propagates the
+	 *	latter inward.  Call gravityDynamicsIn() afterwards in order to
+	 *	propagate the former.
+	 *
+	 *	\pre	q, dq should be given, ddq has to be zero
+	 *	\post	tau is the Coriolis and centrifugal torque
+	 */
+	static void inverseDynamicsSplit(taoDNode* root, const deVector3* gravity);
+	//! completes inverseDynamicsSplit()
+	/*!
+	 *	\post	tau is the gravity (and external force) torque
+	 */
+	static void gravityDynamicsIn(taoDNode* root);
 
 	//! computes velocity changes given impulse
 	/*!
@@ -109,12 +125,14 @@ public:
 	static void resetInertia(taoDNode* node);
 
 private:
-	static void _forwardDynamicsOutIn(taoDNode* root, taoABDynamicsData* datah, deVector6* Pah, const deVector6* Vh);
-	static void _inverseDynamicsOutIn(taoDNode* root, taoABDynamicsData2* datah, deVector6* Fh, const deVector6* Vh, const deVector6* Ah);
-	static void _accelerationTreeOut(taoDNode* root, const deVector6* Ah);
+	static void _forwardDynamicsOutIn(taoSweep* sweep, const deVector3* gravity);
+	static void _inverseDynamicsOutIn(taoSweep* sweep, const deVector3* gravity);
+	static void _forceTreeIn(taoSweep* sweep);
+	static void _accelerationTreeOut(taoSweep* sweep);
 	static void _articulatedImpulsePathIn(taoDNode* contact, const deInt dist);
-	static void _velocityDeltaTreeOut(taoDNode* root, const deVector6* dVh, const deVector6* Vh, const deInt dist);
+	static void _velocityDeltaTreeOut(taoSweep* sweep, const deInt dist);
 	static void _plusEq_Jg_ddQ(taoDNode* node, deVector6* A);
+	static deFloat _sumEnergyIn(taoSweep* sweep);
 };
 
 //#endif // DOXYGEN_SHOULD_SKIP_THIS
@@ -0,0 +1,81 @@
+/* Copyright (c) 2005 Arachi, Inc. and Stanford University. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "taoDNode.h"
+#include "taoSweep.h"
+
+static void _bumpTopology(taoDNode* root)
+{
+	unsigned long* stamp = root->topologyStamp();
+	if (stamp != NULL)
+		++*stamp;
+}
+
+taoDNode::~taoDNode()
+{
+	delete _sweep;
+}
+
+taoSweep* taoDNode::getSweep()
+{
+	unsigned long* stamp = _tree->topologyStamp();
+
+	if (_sweep == NULL)
+		_sweep = new taoSweep;
+	if (stamp == NULL || _sweepRoot != _tree || _sweepTopology != *stamp)
+	{
+		_sweep->build(this);
+		_sweepRoot = _tree;
+		_sweepTopology = stamp ? *stamp : 0;
+	}
+	return _sweep;
+}
+
+void taoDNode::topologyChanged()
+{
+	// the tree this node was in has changed
+	_bumpTopology(_tree);
+
+	taoDNode* parent = getDParent();
+	taoDNode* root = parent ? parent->_tree : this;
+	if (root == _tree)
+		return;
+
+	// the subtree moved to another tree: relabel it, following the
+	// links without recursion, and mark that tree as changed too
+	taoDNode* n = this;
+	for (;;)
+	{
+		n->_tree = root;
+		if (n->getDChild() != NULL)
+		{
+			n = n->getDChild();
+			continue;
+		}
+		while (n != this && n->getDSibling() == NULL)
+			n = n->getDParent();
+		if (n == this)
+			break;
+		n = n->getDSibling();
+	}
+	_bumpTopology(root);
+}
@@ -32,6 +32,7 @@ class deVector3;
 class deVector6;
 class deFrame;
 class deMatrix3;
+class taoSweep;
 
 /*!
  *	\brief abstract node class for articulated body
@@ -42,8 +43,8 @@ class deMatrix3;
 class taoDNode : public taoCNode
 {
 public:
-	taoDNode() : _abNode(NULL), _propagate(1) {}
-	virtual ~taoDNode() {}
+	taoDNode() : _abNode(NULL), _propagate(1), _tree(this), _sweep(NULL), _sweepRoot(NULL), _sweepTopology(0) {}
+	virtual ~taoDNode();
 	virtual void sync(deFrame* local) = 0;
 	//!	indicates if this node is root
 	/*!	\retval	1	this node is root
@@ -111,9 +112,31 @@ public:
 	virtual taoDNode* getDSibling() = 0;
 	virtual taoDNode const* getDSibling() const = 0;
 
+	//!	\return	topology stamp of the tree, NULL unless this is its root
+	/*!	\remarks	taoNodeRoot keeps one; a detached subtree has none
+	 */
+	virtual unsigned long* topologyStamp() { return NULL; }
+
+	//!	\return	traversal order of the subtree rooted at this node
+	/*!	\remarks	built on first use, and again after the tree changed;
+	 *		subtrees that are not under a taoNodeRoot are rebuilt
+	 *		on every call
+	 */
+	taoSweep* getSweep();
+	//!	marks the traversal orders in the tree of this node as out of date
+	/*!	\remarks	call this after linking this node to or unlinking it
+	 *		from its parent; costs time in the size of the subtree
+	 *		of this node, but not in the depth of the tree
+	 */
+	void topologyChanged();
+
 private:
 	taoABNode* _abNode;
 	deInt _propagate;
+	taoDNode* _tree;
+	taoSweep* _sweep;
+	taoDNode* _sweepRoot;
+	unsigned long _sweepTopology;
 };
 
 #endif // _taoDNode_h
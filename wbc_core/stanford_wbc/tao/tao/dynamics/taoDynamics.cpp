@@ -30,6 +30,7 @@
 #include <tao/dynamics/taoDynamics.h>
 #include "taoDNode.h"
 #include "taoABDynamics.h"
+#include "taoSweep.h"
 #include <tao/utility/TaoDeMassProp.h>
 #include <tao/dynamics/taoJoint.h>
 #include <assert.h>
@@ -38,6 +39,10 @@
 
 void taoDynamics::initialize(taoDNode* root)
 {
+	// build the traversal order now, so that the passes below and
+	// all later calls find it up to date and do not allocate
+	root->topologyChanged();
+	root->getSweep();
 	taoABDynamics::updateLocalXTreeOut(root);
 	taoABDynamics::resetInertiaTreeOut(root);
 	taoABDynamics::resetFlagTreeOut(root);
@@ -46,23 +51,26 @@ void taoDynamics::initialize(taoDNode* root)
 
 void taoDynamics::reset(taoDNode* r)
 {
-	r->sync(r->frameHome());
-	for (taoDNode* n = r->getDChild(); n != NULL; n = n->getDSibling())
-		reset(n);
+	taoSweep* sweep = r->getSweep();
+	for (deInt i = 0; i < sweep->size(); i++)
+	{
+		taoDNode* n = sweep->node(i);
+		n->sync(n->frameHome());
+	}
 }
 
 void taoDynamics::updateTransformation(taoDNode* r)
 {
-	r->updateFrame();
-	for (taoDNode* n = r->getDChild(); n != NULL; n = n->getDSibling())
-		updateTransformation(n);
+	taoSweep* sweep = r->getSweep();
+	for (deInt i = 0; i < sweep->size(); i++)
+		sweep->node(i)->updateFrame();
 }
 
 void taoDynamics::integrate(taoDNode* r, deFloat dt)
 {
-	r->integrate(dt);
-	for (taoDNode* n = r->getDChild(); n != NULL; n = n->getDSibling())
-		integrate(n, dt);
+	taoSweep* sweep = r->getSweep();
+	for (deInt i = 0; i < sweep->size(); i++)
+		sweep->node(i)->integrate(dt);
 }
 
 void taoDynamics::globalJacobian(taoDNode* root)
@@ -130,15 +138,12 @@ deFloat taoDynamics::kineticEnergy(taoDNode* rootNode)
 // find dof : degrees of freedom
 deInt taoDynamics::computeDOF(taoDNode* root)
 {
-	taoJoint* j;
-	taoDNode* n;
+	taoSweep* sweep = root->getSweep();
 	deInt dof = 0;
 
-	for (j = root->getJointList(); j != NULL; j = j->getNext())
-		dof += j->getDOF();
-
-	for (n = root->getDChild(); n != NULL; n = n->getDSibling())
-		dof += computeDOF(n);
+	for (deInt i = 0; i < sweep->size(); i++)
+		for (taoJoint* j = sweep->node(i)->getJointList(); j != NULL; j = j->getNext())
+			dof += j->getDOF();
 
 	return dof;
 }
@@ -224,6 +229,25 @@ void taoDynamics::computeB(taoDNode* root, const deInt dof, deFloat* B)
 	_Write(root, &tau[0], TAO_TAU);
 }
 
+void taoDynamics::computeBG(taoDNode* root, const deVector3* gravity, const deInt dof, deFloat* B, deFloat* G)
+{
+	assert(dof == computeDOF(root));
+
+	// see invDynamics()
+	taoABDynamics::updateLocalXTreeOut(root); // YYY
+	deVector3 g;
+	g.inversedMultiply(root->frameGlobal()->rotation(), *gravity);
+	deVector6 A = *root->acceleration();
+	root->acceleration()->zero();
+
+	taoABDynamics::inverseDynamicsSplit(root, &g);
+	_Read(root, B, TAO_TAU);
+	taoABDynamics::gravityDynamicsIn(root);
+	_Read(root, G, TAO_TAU);
+
+	*root->acceleration() = A;
+}
+
 // Li = J Ai Jt
 void taoDynamics::computeOpSpaceInertiaMatrixInv(taoDNode* root, const deFloat* J, const deInt row, const deInt dof, const deFloat* Ainv, deFloat* Linv)
 {
@@ -353,63 +377,61 @@ void taoDynamics::computeAinv(taoDNode* root, const deInt dof, deFloat* Ainv)
 
 void taoDynamics::_Read(taoDNode* root, deFloat* v, flagType type)
 {
-	taoJoint* j;
-	taoDNode* n;
+	taoSweep* sweep = root->getSweep();
 
-	deInt id = root->getID();
-
-	for (j = root->getJointList(); j != NULL; j = j->getNext())
+	for (deInt i = 0; i < sweep->size(); i++)
 	{
-		switch (type)
+		deInt id = sweep->node(i)->getID();
+
+		for (taoJoint* j = sweep->node(i)->getJointList(); j != NULL; j = j->getNext())
 		{
-		case TAO_DDQ:
-			//j->getDDQ(v); // was
-			j->getDDQ(&v[id]);
-			break;
-		case TAO_DQ:
-			//j->getDQ(v); // was
-			j->getDQ(&v[id]);
-			break;
-		case TAO_TAU:
-			//j->getTau(v); //was
-			j->getTau(&v[id]);
-			break;
+			switch (type)
+			{
+			case TAO_DDQ:
+				//j->getDDQ(v); // was
+				j->getDDQ(&v[id]);
+				break;
+			case TAO_DQ:
+				//j->getDQ(v); // was
+				j->getDQ(&v[id]);
+				break;
+			case TAO_TAU:
+				//j->getTau(v); //was
+				j->getTau(&v[id]);
+				break;
+			}
+			//v += j->getDOF();
 		}
-		//v += j->getDOF();
 	}
-
-	for (n = root->getDChild(); n != NULL; n = n->getDSibling())
-		_Read(n, v, type);
 }
 
 void taoDynamics::_Write(taoDNode* root, deFloat* v, flagType type)
 {
-	taoJoint* j;
-	taoDNode* n;
+	taoSweep* sweep = root->getSweep();
 
-	deInt id = root->getID();
-
-	for (j = root->getJointList(); j != NULL; j = j->getNext())
+	for (deInt i = 0; i < sweep->size(); i++)
 	{
-		switch (type)
+		deInt id = sweep->node(i)->getID();
+
+		for (taoJoint* j = sweep->node(i)->getJointList(); j != NULL; j = j->getNext())
 		{
-		case TAO_DDQ:
-			//j->setDDQ(v); //was
-			j->setDDQ(&v[id]);
-			break;
-		case TAO_DQ:
-			//j->setDQ(v); //was
-			j->setDQ(&v[id]);
-			break;
-		case TAO_TAU:
-			//j->setTau(v); //was
-			j->setTau(&v[id]);
-			break;
+			switch (type)
+			{
+			case TAO_DDQ:
+				//j->setDDQ(v); // was
+				j->setDDQ(&v[id]);
+				break;
+			case TAO_DQ:
+				//j->setDQ(v); // was
+				j->setDQ(&v[id]);
+				break;
+			case TAO_TAU:
+				//j->setTau(v); //was
+				j->setTau(&v[id]);
+				break;
+			}
+			//v += j->getDOF();
 		}
-		//v += j->getDOF();
 	}
-
-	for (n = root->getDChild(); n != NULL; n = n->getDSibling())
-		_Write(n, v, type);
 }
 
@@ -96,6 +96,16 @@ public:
 	static void computeB(taoDNode* root, const deInt dof, deFloat* B);
 	//! computes gravitational forces, \a G (\a dof x 1) under \a gravity
 	static void computeG(taoDNode* root, deVector3* gravity, const deInt dof, deFloat* G);
+	//! computes \a B and \a G (\a dof x 1) together, in a single outward pass
+	/*!
+	 *	Unlike computeB() and computeG(), this does not save and
+	 *	restore the joint state, and it does not zero any velocities
+	 *	for computing \a G.  The bias torque is \a B + \a G.
+	 *
+	 *	\pre	q, dq should be given, ddq has to be zero
+	 *	\post	tau is \a G, which includes the external forces
+	 */
+	static void computeBG(taoDNode* root, const deVector3* gravity, const deInt dof, deFloat* B, deFloat* G);
 
 	//! compute the operational Space Inertia Matrix Inverse, \a Linv (\a row x \a row)
 	/*!
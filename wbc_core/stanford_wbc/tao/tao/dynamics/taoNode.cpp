@@ -23,6 +23,7 @@
 #include <tao/dynamics/taoNode.h>
 #include <tao/dynamics/taoJoint.h>
 #include "taoABNode.h"
+#include "taoSweep.h"
 #include <tao/dynamics/taoDynamics.h>
 
 #ifdef TAO_CONTROL
@@ -184,6 +185,7 @@ void taoNode::link(taoDNode* parent, deFrame const * home)
 	_parent = parent;
 	_sibling = (taoNode*)_parent->getDChild();
 	_parent->setDChild(this);
+	topologyChanged();
 	_frameHome = *home;
 	_frameLocal = _frameHome;
 	_frameGlobal = _frameHome;
@@ -205,6 +207,7 @@ void taoNode::unlink()
 	}
 	_sibling = NULL;
 	_parent = NULL;
+	topologyChanged();
 	deleteJointABNode();
 }
 
@@ -268,6 +271,9 @@ taoNodeRoot::taoNodeRoot(deFrame const & global)
 
 	_next = NULL;
 
+	// starts at one, so that nodes without a sweep see it as out of date
+	_topology = 1;
+
 	setABNode(new taoABNodeRoot);
 }
 
@@ -277,32 +283,35 @@ taoNodeRoot::~taoNodeRoot()
 	delete getController();
 #endif
 	delete getABNode();
-	if (_child)
-		_DeleteNodeTree(_child);
-}
 
-void taoNodeRoot::_DeleteNodeTree(taoDNode* r) 
-{ 
-	taoDNode* c = r->getDChild();
-	taoDNode* s = r->getDSibling();
-
-	if (c)
-		_DeleteNodeTree(c);
-	if (s)
-		_DeleteNodeTree(s);
-	delete r;
+	// Delete the nodes in postorder by following the links, which
+	// neither recurses nor allocates: cut each leaf off its parent
+	// before deleting it, until only the root is left.
+	taoDNode* n = this;
+	for (;;)
+	{
+		taoDNode* c = n->getDChild();
+		if (c != NULL)
+		{
+			n = c;
+			continue;
+		}
+		if (n == this)
+			break;
+		taoDNode* p = n->getDParent();
+		p->setDChild(n->getDSibling());
+		delete n;
+		n = p;
+	}
 }
 
 void taoNodeRoot::sync()
 {
-	_SyncNodeTree(this);
-}
-
-void taoNodeRoot::_SyncNodeTree(taoDNode* r)
-{
-	r->sync(r->frameLocal());
-
-	for (taoDNode* n = r->getDChild(); n != NULL; n = n->getDSibling())
-		_SyncNodeTree(n);
+	taoSweep* sweep = getSweep();
+	for (deInt i = 0; i < sweep->size(); i++)
+	{
+		taoDNode* n = sweep->node(i);
+		n->sync(n->frameLocal());
+	}
 }
 
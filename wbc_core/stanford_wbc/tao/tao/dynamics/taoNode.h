@@ -194,6 +194,8 @@ public:
 	virtual taoDNode* getDSibling() { return NULL; }
 	virtual taoDNode const* getDSibling() const { return NULL; }
 
+	virtual unsigned long* topologyStamp() { return &_topology; }
+
 	void setNext(taoNodeRoot* r) { _next = r; }
 	taoNodeRoot* getNext() { return _next; }
 
@@ -219,9 +221,7 @@ private:
 	taoNode* _child;
 
 	taoNodeRoot* _next;
-
-	void _DeleteNodeTree(taoDNode* r);
-	void _SyncNodeTree(taoDNode* r);
+	unsigned long _topology;
 };
 
 #endif // _taoNode_h
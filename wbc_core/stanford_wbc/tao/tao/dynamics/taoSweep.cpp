@@ -0,0 +1,69 @@
+/* Copyright (c) 2005 Arachi, Inc. and Stanford University. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "taoSweep.h"
+#include "taoDNode.h"
+
+void taoSweep::build(taoDNode* root)
+{
+	_node.clear();
+	_parent.clear();
+	_post.clear();
+
+	// Walk the tree using the parent and sibling links, which needs
+	// neither recursion nor an explicit stack.  A node is finished
+	// (and appended to the postorder) when we leave it for its
+	// sibling or its parent.
+	_node.push_back(root);
+	_parent.push_back(-1);
+	deInt cur = 0;
+	for (;;)
+	{
+		taoDNode* c = _node[cur]->getDChild();
+		if (c != NULL)
+		{
+			_node.push_back(c);
+			_parent.push_back(cur);
+			cur = (deInt) _node.size() - 1;
+			continue;
+		}
+		_post.push_back(cur);
+		while (cur != 0 && _node[cur]->getDSibling() == NULL)
+		{
+			cur = _parent[cur];
+			_post.push_back(cur);
+		}
+		if (cur == 0)
+			break;
+		_node.push_back(_node[cur]->getDSibling());
+		_parent.push_back(_parent[cur]);
+		cur = (deInt) _node.size() - 1;
+	}
+
+	size_t const n = _node.size();
+	Ia.resize(n);
+	WxV.resize(n);
+	g.resize(n);
+	dV.resize(n);
+	F.resize(n);
+	E.resize(n);
+}
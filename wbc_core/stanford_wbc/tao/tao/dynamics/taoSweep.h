@@ -0,0 +1,83 @@
+/* Copyright (c) 2005 Arachi, Inc. and Stanford University. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _taoSweep_h
+#define _taoSweep_h
+
+#include "taoTypes.h"
+#include <tao/matrix/TaoDeMath.h>
+#include <vector>
+
+class taoDNode;
+
+/*!
+ *	\brief		flattened traversal order of a subtree
+ *	\ingroup	taoDynamics
+ *
+ *	Lists the nodes of a subtree in depth-first preorder (parents
+ *	before children, siblings in getDSibling() order), together with
+ *	the index of each parent and the postorder (children before
+ *	parents).  The outward and inward passes of taoDynamics and
+ *	taoABDynamics loop over these arrays instead of recursing, so
+ *	their stack usage does not grow with the depth of the tree, and
+ *	they visit nodes in exactly the same order as the recursive
+ *	formulation did.
+ *
+ *	The scratch arrays hold per-node intermediate results of the
+ *	passes, so that no allocation happens after build().
+ *
+ *	\sa	taoDNode::getSweep()
+ */
+class taoSweep
+{
+public:
+	//!	rebuilds the traversal order of the subtree with \a root
+	/*!	\remarks	does not recurse, whatever the depth of the tree
+	 */
+	void build(taoDNode* root);
+
+	//!	number of nodes, including the root of the subtree
+	deInt size() const { return (deInt) _node.size(); }
+	//!	\return	node at position \a i in preorder, \a i = 0 is the root
+	taoDNode* node(deInt i) const { return _node[i]; }
+	//!	\return	preorder index of the parent of node \a i, -1 for the root
+	deInt parent(deInt i) const { return _parent[i]; }
+	//!	\return	preorder index of the \a k-th node in postorder
+	deInt post(deInt k) const { return _post[k]; }
+
+	//!	\name	scratch space, one entry per node (in preorder)
+	//@{
+	std::vector<deMatrix6> Ia;
+	std::vector<deVector3> WxV;
+	std::vector<deVector3> g;
+	std::vector<deVector6> dV;
+	std::vector<deVector6> F;
+	std::vector<deFloat> E;
+	//@}
+
+private:
+	std::vector<taoDNode*> _node;
+	std::vector<deInt> _parent;
+	std::vector<deInt> _post;
+};
+
+#endif // _taoSweep_h
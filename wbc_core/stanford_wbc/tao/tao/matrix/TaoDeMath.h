@@ -96,6 +96,7 @@
 #include "TaoDeVector3f.h"
 #include "TaoDeQuaternionf.h"
 #include "TaoDeMatrix3f.h"
+#include "TaoDeSimd.h"
 
 #ifdef __cplusplus
 
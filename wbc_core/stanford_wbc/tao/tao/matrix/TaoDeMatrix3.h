@@ -128,6 +128,7 @@ public:
 
 	friend class deVector3;
 	friend class deQuaternion;
+	friend class deMatrix6;
 
 private:
 	deFloat _data[DE_MATRIX3_ROW][DE_MATRIX3_COL];
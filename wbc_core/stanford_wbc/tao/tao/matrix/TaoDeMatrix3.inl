@@ -23,20 +23,36 @@
 #ifndef _deMatrix3_inl
 #define _deMatrix3_inl
 
-DE_MATH_API deFloat deMatrix3::det() const { return dedetM3(_data); }
-
-DE_MATH_API void deMatrix3::operator=(const deMatrix3& m) { deSetM3M3(_data, m._data); }
-DE_MATH_API void deMatrix3::zero() { deZeroM3(_data); }
-DE_MATH_API void deMatrix3::identity() { deIdentityM3(_data); }
-DE_MATH_API void deMatrix3::negate(const deMatrix3& m) { deNegateM3M3(_data, m._data); }
+// vectorized versions in TaoDeSimd.h, bit-identical to the scalar ones
+#ifdef DE_SIMD
+DE_MATH_API void deMatrix3::add(const deMatrix3& m1, const deMatrix3& m2) { deSimdAddM3M3M3(_data, m1._data, m2._data); }
+DE_MATH_API void deMatrix3::subtract(const deMatrix3& m1, const deMatrix3& m2) { deSimdSubM3M3M3(_data, m1._data, m2._data); }
+DE_MATH_API void deMatrix3::multiply(const deMatrix3& m1, const deMatrix3& m2) { deSimdMulM3M3M3(_data, m1._data, m2._data); }
+DE_MATH_API void deMatrix3::transposedMultiply(const deMatrix3& m1, const deMatrix3& m2) { deSimdMulM3M3tM3(_data, m1._data, m2._data); }
+DE_MATH_API void deMatrix3::multiplyTransposed(const deMatrix3& m1, const deMatrix3& m2) { deSimdMulM3M3M3t(_data, m1._data, m2._data); }
+DE_MATH_API void deMatrix3::operator+=(const deMatrix3& m) { deSimdAddM3M3(_data, m._data); }
+DE_MATH_API void deMatrix3::operator-=(const deMatrix3& m) { deSimdSubM3M3(_data, m._data); }
+DE_MATH_API void deMatrix3::crossMultiply(const deVector3& v, const deMatrix3& m) { deSimdMulM3V3xM3(_data, v, m._data); }
+DE_MATH_API void deMatrix3::multiplyTransposed(const deVector3& v1, const deVector3& v2) { deSimdMulM3V3V3t(_data, v1, v2); }
+#else
 DE_MATH_API void deMatrix3::add(const deMatrix3& m1, const deMatrix3& m2) { deAddM3M3M3(_data, m1._data, m2._data); }
 DE_MATH_API void deMatrix3::subtract(const deMatrix3& m1, const deMatrix3& m2) { deSubM3M3M3(_data, m1._data, m2._data); }
 DE_MATH_API void deMatrix3::multiply(const deMatrix3& m1, const deMatrix3& m2) { deMulM3M3M3(_data, m1._data, m2._data); }
 DE_MATH_API void deMatrix3::transposedMultiply(const deMatrix3& m1, const deMatrix3& m2) { deMulM3M3tM3(_data, m1._data, m2._data); }
 DE_MATH_API void deMatrix3::multiplyTransposed(const deMatrix3& m1, const deMatrix3& m2) { deMulM3M3M3t(_data, m1._data, m2._data); }
-DE_MATH_API void deMatrix3::multiply(const deMatrix3& m, const deFloat s) { deMulM3M3S1(_data, m._data, s); }
 DE_MATH_API void deMatrix3::operator+=(const deMatrix3& m) { deAddM3M3(_data, m._data); }
 DE_MATH_API void deMatrix3::operator-=(const deMatrix3& m) { deSubM3M3(_data, m._data); }
+DE_MATH_API void deMatrix3::crossMultiply(const deVector3& v, const deMatrix3& m) { deMulM3V3xM3(_data, v, m._data); }
+DE_MATH_API void deMatrix3::multiplyTransposed(const deVector3& v1, const deVector3& v2) { deMulM3V3V3t(_data, v1, v2); }
+#endif // DE_SIMD
+
+DE_MATH_API deFloat deMatrix3::det() const { return dedetM3(_data); }
+
+DE_MATH_API void deMatrix3::operator=(const deMatrix3& m) { deSetM3M3(_data, m._data); }
+DE_MATH_API void deMatrix3::zero() { deZeroM3(_data); }
+DE_MATH_API void deMatrix3::identity() { deIdentityM3(_data); }
+DE_MATH_API void deMatrix3::negate(const deMatrix3& m) { deNegateM3M3(_data, m._data); }
+DE_MATH_API void deMatrix3::multiply(const deMatrix3& m, const deFloat s) { deMulM3M3S1(_data, m._data, s); }
 DE_MATH_API void deMatrix3::operator*=(const deFloat s) { deMulM3S1(_data, s); }
 DE_MATH_API void deMatrix3::diagonal(const deFloat x, const deFloat y, const deFloat z) { deDiagonalM3S3(_data, x, y, z); }
 DE_MATH_API void deMatrix3::diagonal(const deVector3& v)  { deDiagonalM3V3(_data, v); }
@@ -48,8 +64,6 @@ DE_MATH_API void deMatrix3::inverseDet(const deMatrix3& m) { deInvertDetM3M3(_da
 DE_MATH_API void deMatrix3::inverseDetSPD(const deMatrix3& m) { deInvertDetSPDM3M3(_data, m._data); }
 DE_MATH_API void deMatrix3::ludecomp(const deMatrix3& m) { deLUdecomposeM3M3(_data, m._data); }
 DE_MATH_API void deMatrix3::transpose(const deMatrix3& m) { deTransposeM3M3(_data, m._data); }
-DE_MATH_API void deMatrix3::multiplyTransposed(const deVector3& v1, const deVector3& v2) { deMulM3V3V3t(_data, v1, v2); }
-DE_MATH_API void deMatrix3::crossMultiply(const deVector3& v, const deMatrix3& m) { deMulM3V3xM3(_data, v, m._data); }
 DE_MATH_API void deMatrix3::cross(const deVector3& v) { deSetM3V3x(_data, v); }
 DE_MATH_API void deMatrix3::multiplyCross(const deMatrix3& m, const deVector3& v) { deMulM3M3V3x(_data, m._data, v); }
 DE_MATH_API void deMatrix3::set(const deQuaternion& q) { deSetM3Q4(_data, q); }
@@ -100,6 +100,13 @@ void deMatrix6::similarityXformT(const deMatrix6& L, const deMatrix6& I)
 //                                A2*B0+A3*B2 A2*B1+A3*B3]
 void deMatrix6::multiply(const deMatrix6& m1, const deMatrix6& m2)
 {
+#ifdef DE_SIMD
+    // same arithmetic as below, without the temporaries
+    deSimdMulAddM3M3M3M3M3(_mat3[0]._data, m1._mat3[0]._data, m2._mat3[0]._data, m1._mat3[1]._data, m2._mat3[2]._data);
+    deSimdMulAddM3M3M3M3M3(_mat3[1]._data, m1._mat3[0]._data, m2._mat3[1]._data, m1._mat3[1]._data, m2._mat3[3]._data);
+    deSimdMulAddM3M3M3M3M3(_mat3[2]._data, m1._mat3[2]._data, m2._mat3[0]._data, m1._mat3[3]._data, m2._mat3[2]._data);
+    deSimdMulAddM3M3M3M3M3(_mat3[3]._data, m1._mat3[2]._data, m2._mat3[1]._data, m1._mat3[3]._data, m2._mat3[3]._data);
+#else
     deMatrix3 tmpM;
 
     _mat3[0].multiply(m1._mat3[0], m2._mat3[0]);
@@ -117,6 +124,7 @@ void deMatrix6::multiply(const deMatrix6& m1, const deMatrix6& m2)
 	_mat3[3].multiply(m1._mat3[2], m2._mat3[1]);
     tmpM.multiply(m1._mat3[3], m2._mat3[3]);
     _mat3[3] += tmpM;
+#endif // DE_SIMD
 }
 
 // this = m1^T * m2
@@ -125,6 +133,13 @@ void deMatrix6::multiply(const deMatrix6& m1, const deMatrix6& m2)
 //                                  A1^T*B0+A3^T*B2 A1^T*B1+A3^T*B3]
 void deMatrix6::transposedMultiply(const deMatrix6& m1, const deMatrix6& m2)
 {
+#ifdef DE_SIMD
+    // same arithmetic as below, without the temporaries
+    deSimdMulAddM3M3tM3M3tM3(_mat3[0]._data, m1._mat3[0]._data, m2._mat3[0]._data, m1._mat3[2]._data, m2._mat3[2]._data);
+    deSimdMulAddM3M3tM3M3tM3(_mat3[1]._data, m1._mat3[0]._data, m2._mat3[1]._data, m1._mat3[2]._data, m2._mat3[3]._data);
+    deSimdMulAddM3M3tM3M3tM3(_mat3[2]._data, m1._mat3[1]._data, m2._mat3[0]._data, m1._mat3[3]._data, m2._mat3[2]._data);
+    deSimdMulAddM3M3tM3M3tM3(_mat3[3]._data, m1._mat3[1]._data, m2._mat3[1]._data, m1._mat3[3]._data, m2._mat3[3]._data);
+#else
     deMatrix3 tmpM;
 
     _mat3[0].transposedMultiply(m1._mat3[0], m2._mat3[0]);
@@ -142,6 +157,7 @@ void deMatrix6::transposedMultiply(const deMatrix6& m1, const deMatrix6& m2)
     _mat3[3].transposedMultiply(m1._mat3[1], m2._mat3[1]);
     tmpM.transposedMultiply(m1._mat3[3], m2._mat3[3]);
     _mat3[3] += tmpM;
+#endif // DE_SIMD
 }
 
 // this = m1 * m2^T
@@ -150,6 +166,13 @@ void deMatrix6::transposedMultiply(const deMatrix6& m1, const deMatrix6& m2)
 //                                  A2*B0^T+A3*B1^T A2*B2^T+A3*B3^T]
 void deMatrix6::multiplyTransposed(const deMatrix6& m1, const deMatrix6& m2)
 {
+#ifdef DE_SIMD
+    // same arithmetic as below, without the temporaries
+    deSimdMulAddM3M3M3tM3M3t(_mat3[0]._data, m1._mat3[0]._data, m2._mat3[0]._data, m1._mat3[1]._data, m2._mat3[1]._data);
+    deSimdMulAddM3M3M3tM3M3t(_mat3[1]._data, m1._mat3[0]._data, m2._mat3[2]._data, m1._mat3[1]._data, m2._mat3[3]._data);
+    deSimdMulAddM3M3M3tM3M3t(_mat3[2]._data, m1._mat3[2]._data, m2._mat3[0]._data, m1._mat3[3]._data, m2._mat3[1]._data);
+    deSimdMulAddM3M3M3tM3M3t(_mat3[3]._data, m1._mat3[2]._data, m2._mat3[2]._data, m1._mat3[3]._data, m2._mat3[3]._data);
+#else
     deMatrix3 tmpM;
 
     _mat3[0].multiplyTransposed(m1._mat3[0], m2._mat3[0]);
@@ -167,6 +190,7 @@ void deMatrix6::multiplyTransposed(const deMatrix6& m1, const deMatrix6& m2)
     _mat3[3].multiplyTransposed(m1._mat3[2], m2._mat3[2]);
     tmpM.multiplyTransposed(m1._mat3[3], m2._mat3[3]);
     _mat3[3] += tmpM;
+#endif // DE_SIMD
 }
 
 // X = [ R 0; dxR R ]
@@ -0,0 +1,371 @@
+/* Copyright (c) 2005 Arachi, Inc. and Stanford University. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _deSimd_h
+#define _deSimd_h
+
+/*!
+ *	\ingroup deMath
+ *	\name	SIMD kernels
+ *
+ *	Vectorized versions of the 3x3 matrix and 3x1 vector primitives
+ *	that the articulated-body and spatial-transform code (deMatrix6,
+ *	deVector6, deTransform) spends most of its time in. Cross
+ *	products and the quaternion math behind deFrame stay scalar:
+ *	their SIMD versions were no faster (see the tao.math cases of
+ *	wbc_benchmark). A row (or vector) of three deFloat is held in
+ *	one AVX register, or in two SSE2 registers. The kernels perform
+ *	exactly the same multiplications and additions in the same order
+ *	as the scalar deMulM3M3M3() etc, so they give bit-identical
+ *	results (as long as the compiler does not contract the scalar
+ *	code into fused multiply-adds, see -ffp-contract).
+ *
+ *	The padding element of DE_PS2_VU rows is neither read nor
+ *	written, so the kernels work with either row layout.
+ *
+ *	DE_SIMD gets defined if the kernels are available, which
+ *	requires double precision and an SSE2 or AVX capable
+ *	compiler target. Define DE_NO_SIMD to force the portable
+ *	scalar code.
+ */
+//	@{
+
+#if defined(DE_PRECISION_DOUBLE) && ! defined(DE_NO_SIMD)
+# if defined(__AVX__)
+#  define DE_SIMD_AVX
+# elif defined(__SSE2__) || defined(_M_X64)
+#  define DE_SIMD_SSE2
+# endif
+#endif
+
+#if defined(DE_SIMD_AVX) || defined(DE_SIMD_SSE2)
+#define DE_SIMD
+
+#ifdef DE_SIMD_AVX
+
+#include <immintrin.h>
+
+typedef __m256d deSimdV3;
+
+/*
+ * Loads and stores go through the two 128 bit halves, because the
+ * scalar code that reads the results right afterwards cannot forward
+ * from a masked store.
+ */
+DE_MATH_API deSimdV3 deSimdLoad(const deFloat* p)
+{
+	return _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(p)), _mm_load_sd(p + 2), 1);
+}
+
+DE_MATH_API void deSimdStore(deFloat* p, const deSimdV3 a)
+{
+	_mm_storeu_pd(p, _mm256_castpd256_pd128(a));
+	_mm_store_sd(p + 2, _mm256_extractf128_pd(a, 1));
+}
+
+DE_MATH_API deSimdV3 deSimdSet(const deFloat x, const deFloat y, const deFloat z)
+{
+	return _mm256_set_pd(0, z, y, x);
+}
+
+DE_MATH_API deSimdV3 deSimdSplat(const deFloat s) { return _mm256_set1_pd(s); }
+DE_MATH_API deSimdV3 deSimdAdd(const deSimdV3 a, const deSimdV3 b) { return _mm256_add_pd(a, b); }
+DE_MATH_API deSimdV3 deSimdSub(const deSimdV3 a, const deSimdV3 b) { return _mm256_sub_pd(a, b); }
+DE_MATH_API deSimdV3 deSimdMul(const deSimdV3 a, const deSimdV3 b) { return _mm256_mul_pd(a, b); }
+
+#else // DE_SIMD_SSE2
+
+#include <emmintrin.h>
+
+typedef struct {
+	__m128d xy;
+	__m128d z;		/* upper half unused */
+} deSimdV3;
+
+DE_MATH_API deSimdV3 deSimdLoad(const deFloat* p)
+{
+	deSimdV3 r;
+	r.xy = _mm_loadu_pd(p);
+	r.z = _mm_load_sd(p + 2);
+	return r;
+}
+
+DE_MATH_API void deSimdStore(deFloat* p, const deSimdV3 a)
+{
+	_mm_storeu_pd(p, a.xy);
+	_mm_store_sd(p + 2, a.z);
+}
+
+DE_MATH_API deSimdV3 deSimdSet(const deFloat x, const deFloat y, const deFloat z)
+{
+	deSimdV3 r;
+	r.xy = _mm_set_pd(y, x);
+	r.z = _mm_set_sd(z);
+	return r;
+}
+
+DE_MATH_API deSimdV3 deSimdSplat(const deFloat s)
+{
+	deSimdV3 r;
+	r.xy = _mm_set1_pd(s);
+	r.z = r.xy;
+	return r;
+}
+
+DE_MATH_API deSimdV3 deSimdAdd(const deSimdV3 a, const deSimdV3 b)
+{
+	deSimdV3 r;
+	r.xy = _mm_add_pd(a.xy, b.xy);
+	r.z = _mm_add_sd(a.z, b.z);
+	return r;
+}
+
+DE_MATH_API deSimdV3 deSimdSub(const deSimdV3 a, const deSimdV3 b)
+{
+	deSimdV3 r;
+	r.xy = _mm_sub_pd(a.xy, b.xy);
+	r.z = _mm_sub_sd(a.z, b.z);
+	return r;
+}
+
+DE_MATH_API deSimdV3 deSimdMul(const deSimdV3 a, const deSimdV3 b)
+{
+	deSimdV3 r;
+	r.xy = _mm_mul_pd(a.xy, b.xy);
+	r.z = _mm_mul_sd(a.z, b.z);
+	return r;
+}
+
+#endif // DE_SIMD_AVX
+
+/* s0 * b0 + s1 * b1 + s2 * b2, evaluated left to right */
+DE_MATH_API deSimdV3 deSimdCombine(const deFloat s0, const deSimdV3 b0,
+				   const deFloat s1, const deSimdV3 b1,
+				   const deFloat s2, const deSimdV3 b2)
+{
+	deSimdV3 acc = deSimdMul(deSimdSplat(s0), b0);
+	acc = deSimdAdd(acc, deSimdMul(deSimdSplat(s1), b1));
+	return deSimdAdd(acc, deSimdMul(deSimdSplat(s2), b2));
+}
+
+DE_MATH_API void deSimdAddV3V3V3(deFloat* res, const deFloat* v1, const deFloat* v2)
+{
+	deSimdStore(res, deSimdAdd(deSimdLoad(v1), deSimdLoad(v2)));
+}
+
+DE_MATH_API void deSimdSubV3V3V3(deFloat* res, const deFloat* v1, const deFloat* v2)
+{
+	deSimdStore(res, deSimdSub(deSimdLoad(v1), deSimdLoad(v2)));
+}
+
+DE_MATH_API void deSimdAddV3V3(deFloat* res, const deFloat* v1)
+{
+	deSimdStore(res, deSimdAdd(deSimdLoad(res), deSimdLoad(v1)));
+}
+
+DE_MATH_API void deSimdSubV3V3(deFloat* res, const deFloat* v1)
+{
+	deSimdStore(res, deSimdSub(deSimdLoad(res), deSimdLoad(v1)));
+}
+
+/* res = m1 * v2 */
+DE_MATH_API void deSimdMulV3M3V3(deFloat* resv, const deFloat (*m1)[DE_MATRIX3_COL], const deFloat* v2)
+{
+	deSimdStore(resv, deSimdCombine(v2[0], deSimdSet(m1[0][0], m1[1][0], m1[2][0]),
+					v2[1], deSimdSet(m1[0][1], m1[1][1], m1[2][1]),
+					v2[2], deSimdSet(m1[0][2], m1[1][2], m1[2][2])));
+}
+
+/* res = m1^T * v2 */
+DE_MATH_API void deSimdMulV3M3tV3(deFloat* resv, const deFloat (*m1)[DE_MATRIX3_COL], const deFloat* v2)
+{
+	deSimdStore(resv, deSimdCombine(v2[0], deSimdLoad(m1[0]),
+					v2[1], deSimdLoad(m1[1]),
+					v2[2], deSimdLoad(m1[2])));
+}
+
+DE_MATH_API void deSimdAddM3M3(deFloat (*res)[DE_MATRIX3_COL], const deFloat (*m1)[DE_MATRIX3_COL])
+{
+	deSimdAddV3V3(res[0], m1[0]);
+	deSimdAddV3V3(res[1], m1[1]);
+	deSimdAddV3V3(res[2], m1[2]);
+}
+
+DE_MATH_API void deSimdSubM3M3(deFloat (*res)[DE_MATRIX3_COL], const deFloat (*m1)[DE_MATRIX3_COL])
+{
+	deSimdSubV3V3(res[0], m1[0]);
+	deSimdSubV3V3(res[1], m1[1]);
+	deSimdSubV3V3(res[2], m1[2]);
+}
+
+DE_MATH_API void deSimdAddM3M3M3(deFloat (*res)[DE_MATRIX3_COL], const deFloat (*m1)[DE_MATRIX3_COL], const deFloat (*m2)[DE_MATRIX3_COL])
+{
+	deSimdAddV3V3V3(res[0], m1[0], m2[0]);
+	deSimdAddV3V3V3(res[1], m1[1], m2[1]);
+	deSimdAddV3V3V3(res[2], m1[2], m2[2]);
+}
+
+DE_MATH_API void deSimdSubM3M3M3(deFloat (*res)[DE_MATRIX3_COL], const deFloat (*m1)[DE_MATRIX3_COL], const deFloat (*m2)[DE_MATRIX3_COL])
+{
+	deSimdSubV3V3V3(res[0], m1[0], m2[0]);
+	deSimdSubV3V3V3(res[1], m1[1], m2[1]);
+	deSimdSubV3V3V3(res[2], m1[2], m2[2]);
+}
+
+/* res = m1 * m2 */
+DE_MATH_API void deSimdMulM3M3M3(deFloat (*res)[DE_MATRIX3_COL], const deFloat (*m1)[DE_MATRIX3_COL], const deFloat (*m2)[DE_MATRIX3_COL])
+{
+	const deSimdV3 b0 = deSimdLoad(m2[0]);
+	const deSimdV3 b1 = deSimdLoad(m2[1]);
+	const deSimdV3 b2 = deSimdLoad(m2[2]);
+	const deSimdV3 r0 = deSimdCombine(m1[0][0], b0, m1[0][1], b1, m1[0][2], b2);
+	const deSimdV3 r1 = deSimdCombine(m1[1][0], b0, m1[1][1], b1, m1[1][2], b2);
+	const deSimdV3 r2 = deSimdCombine(m1[2][0], b0, m1[2][1], b1, m1[2][2], b2);
+	deSimdStore(res[0], r0);
+	deSimdStore(res[1], r1);
+	deSimdStore(res[2], r2);
+}
+
+/* res = m1^T * m2 */
+DE_MATH_API void deSimdMulM3M3tM3(deFloat (*res)[DE_MATRIX3_COL], const deFloat (*m1)[DE_MATRIX3_COL], const deFloat (*m2)[DE_MATRIX3_COL])
+{
+	const deSimdV3 b0 = deSimdLoad(m2[0]);
+	const deSimdV3 b1 = deSimdLoad(m2[1]);
+	const deSimdV3 b2 = deSimdLoad(m2[2]);
+	const deSimdV3 r0 = deSimdCombine(m1[0][0], b0, m1[1][0], b1, m1[2][0], b2);
+	const deSimdV3 r1 = deSimdCombine(m1[0][1], b0, m1[1][1], b1, m1[2][1], b2);
+	const deSimdV3 r2 = deSimdCombine(m1[0][2], b0, m1[1][2], b1, m1[2][2], b2);
+	deSimdStore(res[0], r0);
+	deSimdStore(res[1], r1);
+	deSimdStore(res[2], r2);
+}
+
+/* res = m1 * m2^T */
+DE_MATH_API void deSimdMulM3M3M3t(deFloat (*res)[DE_MATRIX3_COL], const deFloat (*m1)[DE_MATRIX3_COL], const deFloat (*m2)[DE_MATRIX3_COL])
+{
+	const deSimdV3 c0 = deSimdSet(m2[0][0], m2[1][0], m2[2][0]);
+	const deSimdV3 c1 = deSimdSet(m2[0][1], m2[1][1], m2[2][1]);
+	const deSimdV3 c2 = deSimdSet(m2[0][2], m2[1][2], m2[2][2]);
+	const deSimdV3 r0 = deSimdCombine(m1[0][0], c0, m1[0][1], c1, m1[0][2], c2);
+	const deSimdV3 r1 = deSimdCombine(m1[1][0], c0, m1[1][1], c1, m1[1][2], c2);
+	const deSimdV3 r2 = deSimdCombine(m1[2][0], c0, m1[2][1], c1, m1[2][2], c2);
+	deSimdStore(res[0], r0);
+	deSimdStore(res[1], r1);
+	deSimdStore(res[2], r2);
+}
+
+/* res = (v1 x) * m2 */
+DE_MATH_API void deSimdMulM3V3xM3(deFloat (*res)[DE_MATRIX3_COL], const deFloat* v1, const deFloat (*m2)[DE_MATRIX3_COL])
+{
+	const deSimdV3 b0 = deSimdLoad(m2[0]);
+	const deSimdV3 b1 = deSimdLoad(m2[1]);
+	const deSimdV3 b2 = deSimdLoad(m2[2]);
+	const deSimdV3 r0 = deSimdAdd(deSimdMul(deSimdSplat(-v1[2]), b1), deSimdMul(deSimdSplat(v1[1]), b2));
+	const deSimdV3 r1 = deSimdSub(deSimdMul(deSimdSplat(v1[2]), b0), deSimdMul(deSimdSplat(v1[0]), b2));
+	const deSimdV3 r2 = deSimdAdd(deSimdMul(deSimdSplat(-v1[1]), b0), deSimdMul(deSimdSplat(v1[0]), b1));
+	deSimdStore(res[0], r0);
+	deSimdStore(res[1], r1);
+	deSimdStore(res[2], r2);
+}
+
+/* res = a1 * b1 + a2 * b2, which is one block of a deMatrix6 product */
+DE_MATH_API void deSimdMulAddM3M3M3M3M3(deFloat (*res)[DE_MATRIX3_COL],
+					const deFloat (*a1)[DE_MATRIX3_COL], const deFloat (*b1)[DE_MATRIX3_COL],
+					const deFloat (*a2)[DE_MATRIX3_COL], const deFloat (*b2)[DE_MATRIX3_COL])
+{
+	const deSimdV3 p0 = deSimdLoad(b1[0]);
+	const deSimdV3 p1 = deSimdLoad(b1[1]);
+	const deSimdV3 p2 = deSimdLoad(b1[2]);
+	const deSimdV3 q0 = deSimdLoad(b2[0]);
+	const deSimdV3 q1 = deSimdLoad(b2[1]);
+	const deSimdV3 q2 = deSimdLoad(b2[2]);
+	const deSimdV3 r0 = deSimdAdd(deSimdCombine(a1[0][0], p0, a1[0][1], p1, a1[0][2], p2),
+				      deSimdCombine(a2[0][0], q0, a2[0][1], q1, a2[0][2], q2));
+	const deSimdV3 r1 = deSimdAdd(deSimdCombine(a1[1][0], p0, a1[1][1], p1, a1[1][2], p2),
+				      deSimdCombine(a2[1][0], q0, a2[1][1], q1, a2[1][2], q2));
+	const deSimdV3 r2 = deSimdAdd(deSimdCombine(a1[2][0], p0, a1[2][1], p1, a1[2][2], p2),
+				      deSimdCombine(a2[2][0], q0, a2[2][1], q1, a2[2][2], q2));
+	deSimdStore(res[0], r0);
+	deSimdStore(res[1], r1);
+	deSimdStore(res[2], r2);
+}
+
+/* res = a1 * b1^T + a2 * b2^T, which is one block of a deMatrix6::multiplyTransposed() */
+DE_MATH_API void deSimdMulAddM3M3M3tM3M3t(deFloat (*res)[DE_MATRIX3_COL],
+					  const deFloat (*a1)[DE_MATRIX3_COL], const deFloat (*b1)[DE_MATRIX3_COL],
+					  const deFloat (*a2)[DE_MATRIX3_COL], const deFloat (*b2)[DE_MATRIX3_COL])
+{
+	const deSimdV3 p0 = deSimdSet(b1[0][0], b1[1][0], b1[2][0]);
+	const deSimdV3 p1 = deSimdSet(b1[0][1], b1[1][1], b1[2][1]);
+	const deSimdV3 p2 = deSimdSet(b1[0][2], b1[1][2], b1[2][2]);
+	const deSimdV3 q0 = deSimdSet(b2[0][0], b2[1][0], b2[2][0]);
+	const deSimdV3 q1 = deSimdSet(b2[0][1], b2[1][1], b2[2][1]);
+	const deSimdV3 q2 = deSimdSet(b2[0][2], b2[1][2], b2[2][2]);
+	const deSimdV3 r0 = deSimdAdd(deSimdCombine(a1[0][0], p0, a1[0][1], p1, a1[0][2], p2),
+				      deSimdCombine(a2[0][0], q0, a2[0][1], q1, a2[0][2], q2));
+	const deSimdV3 r1 = deSimdAdd(deSimdCombine(a1[1][0], p0, a1[1][1], p1, a1[1][2], p2),
+				      deSimdCombine(a2[1][0], q0, a2[1][1], q1, a2[1][2], q2));
+	const deSimdV3 r2 = deSimdAdd(deSimdCombine(a1[2][0], p0, a1[2][1], p1, a1[2][2], p2),
+				      deSimdCombine(a2[2][0], q0, a2[2][1], q1, a2[2][2], q2));
+	deSimdStore(res[0], r0);
+	deSimdStore(res[1], r1);
+	deSimdStore(res[2], r2);
+}
+
+/* res = a1^T * b1 + a2^T * b2, which is one block of a deMatrix6::transposedMultiply() */
+DE_MATH_API void deSimdMulAddM3M3tM3M3tM3(deFloat (*res)[DE_MATRIX3_COL],
+					  const deFloat (*a1)[DE_MATRIX3_COL], const deFloat (*b1)[DE_MATRIX3_COL],
+					  const deFloat (*a2)[DE_MATRIX3_COL], const deFloat (*b2)[DE_MATRIX3_COL])
+{
+	const deSimdV3 p0 = deSimdLoad(b1[0]);
+	const deSimdV3 p1 = deSimdLoad(b1[1]);
+	const deSimdV3 p2 = deSimdLoad(b1[2]);
+	const deSimdV3 q0 = deSimdLoad(b2[0]);
+	const deSimdV3 q1 = deSimdLoad(b2[1]);
+	const deSimdV3 q2 = deSimdLoad(b2[2]);
+	const deSimdV3 r0 = deSimdAdd(deSimdCombine(a1[0][0], p0, a1[1][0], p1, a1[2][0], p2),
+				      deSimdCombine(a2[0][0], q0, a2[1][0], q1, a2[2][0], q2));
+	const deSimdV3 r1 = deSimdAdd(deSimdCombine(a1[0][1], p0, a1[1][1], p1, a1[2][1], p2),
+				      deSimdCombine(a2[0][1], q0, a2[1][1], q1, a2[2][1], q2));
+	const deSimdV3 r2 = deSimdAdd(deSimdCombine(a1[0][2], p0, a1[1][2], p1, a1[2][2], p2),
+				      deSimdCombine(a2[0][2], q0, a2[1][2], q1, a2[2][2], q2));
+	deSimdStore(res[0], r0);
+	deSimdStore(res[1], r1);
+	deSimdStore(res[2], r2);
+}
+
+/* res = v1 * v2^T */
+DE_MATH_API void deSimdMulM3V3V3t(deFloat (*res)[DE_MATRIX3_COL], const deFloat* v1, const deFloat* v2)
+{
+	const deSimdV3 b = deSimdLoad(v2);
+	const deSimdV3 r0 = deSimdMul(deSimdSplat(v1[0]), b);
+	const deSimdV3 r1 = deSimdMul(deSimdSplat(v1[1]), b);
+	const deSimdV3 r2 = deSimdMul(deSimdSplat(v1[2]), b);
+	deSimdStore(res[0], r0);
+	deSimdStore(res[1], r1);
+	deSimdStore(res[2], r2);
+}
+
+#endif // DE_SIMD
+//	@}
+
+#endif // _deSimd_h
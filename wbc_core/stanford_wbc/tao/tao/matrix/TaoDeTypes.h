@@ -40,8 +40,11 @@
  *	\ingroup deMath
  *	\name Basic data type
  */
+//	Double precision unless the build defines DE_PRECISION_FLOAT.
 //	@{
+#ifndef DE_PRECISION_FLOAT
 #define DE_PRECISION_DOUBLE
+#endif
 #ifndef DE_PRECISION_DOUBLE
 typedef float deFloat;
 #else
@@ -25,13 +25,28 @@
 
 //! This is a C++ inline class of deVector3.
 
+// vectorized versions in TaoDeSimd.h, bit-identical to the scalar ones
+#ifdef DE_SIMD
+DE_MATH_API void deVector3::operator+=(const deVector3& v) { deSimdAddV3V3(_data, v); }
+DE_MATH_API void deVector3::operator-=(const deVector3& v) { deSimdSubV3V3(_data, v); }
+DE_MATH_API void deVector3::add(const deVector3& v1, const deVector3& v2) { deSimdAddV3V3V3(_data, v1, v2); }
+DE_MATH_API void deVector3::subtract(const deVector3& v1, const deVector3& v2) { deSimdSubV3V3V3(_data, v1, v2); }
+DE_MATH_API void deVector3::multiply(const deMatrix3& m, const deVector3& v) { deSimdMulV3M3V3(_data, m._data, v); }
+DE_MATH_API void deVector3::transposedMultiply(const deMatrix3& m, const deVector3& v) { deSimdMulV3M3tV3(_data, m._data, v); }
+#else
+DE_MATH_API void deVector3::operator+=(const deVector3& v) { deAddV3V3(_data, v); }
+DE_MATH_API void deVector3::operator-=(const deVector3& v) { deSubV3V3(_data, v); }
+DE_MATH_API void deVector3::add(const deVector3& v1, const deVector3& v2) { deAddV3V3V3(_data, v1, v2); }
+DE_MATH_API void deVector3::subtract(const deVector3& v1, const deVector3& v2) { deSubV3V3V3(_data, v1, v2); }
+DE_MATH_API void deVector3::multiply(const deMatrix3& m, const deVector3& v) { deMulV3M3V3(_data, m._data, v); }
+DE_MATH_API void deVector3::transposedMultiply(const deMatrix3& m, const deVector3& v) { deMulV3M3tV3(_data, m._data, v); }
+#endif // DE_SIMD
+
 DE_MATH_API deInt deVector3::operator==(const deVector3& v) const { return deIsEqualV3V3(_data, v); }
 DE_MATH_API deFloat deVector3::dot(const deVector3& v) const { return deDotV3V3(_data, v); }
 DE_MATH_API deFloat deVector3::magnitude() const { return deMagnitudeV3(_data); }
 
 DE_MATH_API void deVector3::operator=(const deVector3& v) { deSetV3V3(_data, v); }
-DE_MATH_API void deVector3::operator+=(const deVector3& v) { deAddV3V3(_data, v); }
-DE_MATH_API void deVector3::operator-=(const deVector3& v) { deSubV3V3(_data, v); }
 DE_MATH_API void deVector3::operator*=(const deVector3& v) { deMulV3V3(_data, v); }
 DE_MATH_API void deVector3::operator*=(const deFloat s) { deMulV3S1(_data, s); }
 DE_MATH_API void deVector3::operator+=(const deFloat s) { deAddV3S1(_data, s); }
@@ -43,14 +58,10 @@ DE_MATH_API void deVector3::get(deFloat* v) const { deSetV3V3(v, _data); }
 DE_MATH_API void deVector3::minimum(const deVector3& v) { deMinV3V3(_data, v); }
 DE_MATH_API void deVector3::maximum(const deVector3& v) { deMaxV3V3(_data, v); }
 DE_MATH_API void deVector3::negate(const deVector3& v) { deNegateV3V3(_data, v); }
-DE_MATH_API void deVector3::add(const deVector3& v1, const deVector3& v2) { deAddV3V3V3(_data, v1, v2); }
-DE_MATH_API void deVector3::subtract(const deVector3& v1, const deVector3& v2) { deSubV3V3V3(_data, v1, v2); }
 DE_MATH_API void deVector3::multiply(const deVector3& v1, const deVector3& v2) { deMulV3V3V3(_data, v1, v2); }
 DE_MATH_API void deVector3::multiply(const deVector3& v, const deFloat s) { deMulV3V3S1(_data, v, s); }
 DE_MATH_API void deVector3::add(const deVector3& v, const deFloat s) { deAddV3V3S1(_data, v, s); }	
 DE_MATH_API void deVector3::crossMultiply(const deVector3& v1, const deVector3& v2) { deCrossV3V3V3(_data, v1, v2); }
-DE_MATH_API void deVector3::multiply(const deMatrix3& m, const deVector3& v) { deMulV3M3V3(_data, m._data, v); }
-DE_MATH_API void deVector3::transposedMultiply(const deMatrix3& m, const deVector3& v) { deMulV3M3tV3(_data, m._data, v); }
 DE_MATH_API void deVector3::multiply(const deTransform& t, const deVector3& v) {
 	deMulV3M3V3(_data, t.rotation()._data, v);
 	deAddV3V3(_data, t.translation());
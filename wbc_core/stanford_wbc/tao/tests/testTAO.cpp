@@ -24,7 +24,17 @@
 */
 
 #include <tao/utility/TaoDeMassProp.h>
+#include <tao/matrix/TaoDeMath.h>
+#include <tao/dynamics/taoNode.h>
+#include <tao/dynamics/taoJoint.h>
+#include <tao/dynamics/taoVar.h>
+#include <tao/dynamics/taoDynamics.h>
+#include <tao/dynamics/taoSweep.h>
 #include <gtest/gtest.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits>
+#include <algorithm>
 
 using namespace std;
 
@@ -188,29 +198,407 @@ TEST (mass_prop, translate_inertia)
   deMatrix3 check_inertia;
   check.get(&check_mass, &check_center, &check_inertia);
   
-  EXPECT_LT (fabs(check_mass - M), 1e-6)
+  // DE_PRECISION_FLOAT cannot resolve 1e-6 on inertias of this size
+  double const tolerance(std::max(1e-6, 1e2 * std::numeric_limits<deFloat>::epsilon()));
+  
+  EXPECT_LT (fabs(check_mass - M), tolerance)
     << "total mass: expected = " << M << " received = " << check_mass;
   for (int ii(0); ii < 3; ++ii) {
-    EXPECT_LT (fabs(check_center[ii] - com_d[ii]), 1e-6)
+    EXPECT_LT (fabs(check_center[ii] - com_d[ii]), tolerance)
       << "com[" << ii << "]: expected = " << com_d[ii] << " received = " << check_center[ii];
   }
   
-  EXPECT_LT (fabs(check_inertia.elementAt(0, 0) - Ixx_d), 1e-6)
+  EXPECT_LT (fabs(check_inertia.elementAt(0, 0) - Ixx_d), tolerance)
     << "Ixx: expected = " << Ixx_d << " received = " << check_inertia.elementAt(0, 0);
-  EXPECT_LT (fabs(check_inertia.elementAt(1, 1) - Iyy_d), 1e-6)
+  EXPECT_LT (fabs(check_inertia.elementAt(1, 1) - Iyy_d), tolerance)
     << "Iyy: expected = " << Iyy_d << " received = " << check_inertia.elementAt(1, 1);
-  EXPECT_LT (fabs(check_inertia.elementAt(2, 2) - Izz_d), 1e-6)
+  EXPECT_LT (fabs(check_inertia.elementAt(2, 2) - Izz_d), tolerance)
     << "Izz: expected = " << Izz_d << " received = " << check_inertia.elementAt(2, 2);
   
-  EXPECT_LT (fabs(check_inertia.elementAt(0, 1) + Ixy_d), 1e-6)
+  EXPECT_LT (fabs(check_inertia.elementAt(0, 1) + Ixy_d), tolerance)
     << "Ixy: expected = " << - Ixy_d << " received = " << check_inertia.elementAt(0, 1);
-  EXPECT_LT (fabs(check_inertia.elementAt(1, 2) + Iyz_d), 1e-6)
+  EXPECT_LT (fabs(check_inertia.elementAt(1, 2) + Iyz_d), tolerance)
     << "Iyz: expected = " << - Iyz_d << " received = " << check_inertia.elementAt(1, 2);
-  EXPECT_LT (fabs(check_inertia.elementAt(0, 2) + Izx_d), 1e-6)
+  EXPECT_LT (fabs(check_inertia.elementAt(0, 2) + Izx_d), tolerance)
     << "Izx: expected = " << - Izx_d << " received = " << check_inertia.elementAt(0, 2);
 }
 
 
+namespace {
+  
+  typedef deFloat row_t[DE_MATRIX3_COL];
+  
+  row_t * rows(deMatrix3 & mm)
+  {
+    return reinterpret_cast<row_t*>(static_cast<deFloat*>(mm));
+  }
+  
+  deFloat random_element()
+  {
+    return 2 * deFloat(rand()) / RAND_MAX - 1;
+  }
+  
+  void randomize(deMatrix3 & mm)
+  {
+    for (int ii(0); ii < 3; ++ii) {
+      for (int jj(0); jj < 3; ++jj) {
+	mm.elementAt(ii, jj) = random_element();
+      }
+    }
+  }
+  
+  void randomize(deVector3 & vv)
+  {
+    vv.set(random_element(), random_element(), random_element());
+  }
+  
+  void randomize(deMatrix6 & mm)
+  {
+    for (int ii(0); ii < 6; ++ii) {
+      for (int jj(0); jj < 6; ++jj) {
+	mm.elementAt(ii, jj) = random_element();
+      }
+    }
+  }
+  
+  // exact comparison, the vectorized kernels have to reproduce the
+  // scalar ones down to the last bit
+  bool identical(deMatrix3 const & lhs, deMatrix3 const & rhs)
+  {
+    for (int ii(0); ii < 3; ++ii) {
+      for (int jj(0); jj < 3; ++jj) {
+	if (lhs.elementAt(ii, jj) != rhs.elementAt(ii, jj)) {
+	  return false;
+	}
+      }
+    }
+    return true;
+  }
+  
+  bool identical(deVector3 const & lhs, deVector3 const & rhs)
+  {
+    return (lhs[0] == rhs[0]) && (lhs[1] == rhs[1]) && (lhs[2] == rhs[2]);
+  }
+  
+}
+
+
+TEST (math_kernels, matrix3)
+{
+  srand(42);
+  for (int trial(0); trial < 1000; ++trial) {
+    deMatrix3 m1, m2, have, want;
+    deVector3 v1, v2;
+    randomize(m1);
+    randomize(m2);
+    randomize(v1);
+    randomize(v2);
+    
+    have.multiply(m1, m2);
+    deMulM3M3M3(rows(want), rows(m1), rows(m2));
+    EXPECT_TRUE (identical(have, want)) << "multiply, trial " << trial;
+    
+    have.transposedMultiply(m1, m2);
+    deMulM3M3tM3(rows(want), rows(m1), rows(m2));
+    EXPECT_TRUE (identical(have, want)) << "transposedMultiply, trial " << trial;
+    
+    have.multiplyTransposed(m1, m2);
+    deMulM3M3M3t(rows(want), rows(m1), rows(m2));
+    EXPECT_TRUE (identical(have, want)) << "multiplyTransposed, trial " << trial;
+    
+    have.crossMultiply(v1, m2);
+    deMulM3V3xM3(rows(want), v1, rows(m2));
+    EXPECT_TRUE (identical(have, want)) << "crossMultiply, trial " << trial;
+    
+    have.multiplyTransposed(v1, v2);
+    deMulM3V3V3t(rows(want), v1, v2);
+    EXPECT_TRUE (identical(have, want)) << "outer product, trial " << trial;
+    
+    have.add(m1, m2);
+    deAddM3M3M3(rows(want), rows(m1), rows(m2));
+    EXPECT_TRUE (identical(have, want)) << "add, trial " << trial;
+    
+    have.subtract(m1, m2);
+    deSubM3M3M3(rows(want), rows(m1), rows(m2));
+    EXPECT_TRUE (identical(have, want)) << "subtract, trial " << trial;
+    
+    have = m1;
+    have += m2;
+    want = m1;
+    deAddM3M3(rows(want), rows(m2));
+    EXPECT_TRUE (identical(have, want)) << "operator+=, trial " << trial;
+    
+    have = m1;
+    have -= m2;
+    want = m1;
+    deSubM3M3(rows(want), rows(m2));
+    EXPECT_TRUE (identical(have, want)) << "operator-=, trial " << trial;
+  }
+}
+
+
+TEST (math_kernels, vector3)
+{
+  srand(43);
+  for (int trial(0); trial < 1000; ++trial) {
+    deMatrix3 mm;
+    deVector3 v1, v2, have, want;
+    randomize(mm);
+    randomize(v1);
+    randomize(v2);
+    
+    have.multiply(mm, v1);
+    deMulV3M3V3(want, rows(mm), v1);
+    EXPECT_TRUE (identical(have, want)) << "multiply, trial " << trial;
+    
+    have.transposedMultiply(mm, v1);
+    deMulV3M3tV3(want, rows(mm), v1);
+    EXPECT_TRUE (identical(have, want)) << "transposedMultiply, trial " << trial;
+    
+    have.add(v1, v2);
+    deAddV3V3V3(want, v1, v2);
+    EXPECT_TRUE (identical(have, want)) << "add, trial " << trial;
+    
+    have.subtract(v1, v2);
+    deSubV3V3V3(want, v1, v2);
+    EXPECT_TRUE (identical(have, want)) << "subtract, trial " << trial;
+    
+    have = v1;
+    have += v2;
+    want = v1;
+    deAddV3V3(want, v2);
+    EXPECT_TRUE (identical(have, want)) << "operator+=, trial " << trial;
+    
+    have = v1;
+    have -= v2;
+    want = v1;
+    deSubV3V3(want, v2);
+    EXPECT_TRUE (identical(have, want)) << "operator-=, trial " << trial;
+  }
+}
+
+
+TEST (math_kernels, matrix6)
+{
+  srand(44);
+  for (int trial(0); trial < 1000; ++trial) {
+    deMatrix6 m1, m2, have;
+    randomize(m1);
+    randomize(m2);
+    
+    // block-wise scalar references, in the order of the original
+    // implementation: [A0 A1;A2 A3]*[B0 B1;B2 B3] etc
+    have.multiply(m1, m2);
+    for (int ir(0); ir < 2; ++ir) {
+      for (int ic(0); ic < 2; ++ic) {
+	deMatrix3 want, tmp;
+	deMulM3M3M3(rows(want), rows(m1[ir][0]), rows(m2[0][ic]));
+	deMulM3M3M3(rows(tmp), rows(m1[ir][1]), rows(m2[1][ic]));
+	deAddM3M3(rows(want), rows(tmp));
+	EXPECT_TRUE (identical(have[ir][ic], want))
+	  << "multiply block " << ir << " " << ic << ", trial " << trial;
+      }
+    }
+    
+    have.transposedMultiply(m1, m2);
+    for (int ir(0); ir < 2; ++ir) {
+      for (int ic(0); ic < 2; ++ic) {
+	deMatrix3 want, tmp;
+	deMulM3M3tM3(rows(want), rows(m1[0][ir]), rows(m2[0][ic]));
+	deMulM3M3tM3(rows(tmp), rows(m1[1][ir]), rows(m2[1][ic]));
+	deAddM3M3(rows(want), rows(tmp));
+	EXPECT_TRUE (identical(have[ir][ic], want))
+	  << "transposedMultiply block " << ir << " " << ic << ", trial " << trial;
+      }
+    }
+    
+    have.multiplyTransposed(m1, m2);
+    for (int ir(0); ir < 2; ++ir) {
+      for (int ic(0); ic < 2; ++ic) {
+	deMatrix3 want, tmp;
+	deMulM3M3M3t(rows(want), rows(m1[ir][0]), rows(m2[ic][0]));
+	deMulM3M3M3t(rows(tmp), rows(m1[ir][1]), rows(m2[ic][1]));
+	deAddM3M3(rows(want), rows(tmp));
+	EXPECT_TRUE (identical(have[ir][ic], want))
+	  << "multiplyTransposed block " << ir << " " << ic << ", trial " << trial;
+      }
+    }
+  }
+}
+
+
+
+namespace {
+  
+  // Appends a link with a revolute joint. The ID doubles as the
+  // joint index, so use consecutive IDs starting at zero.
+  taoNode * add_link(taoDNode * parent, deInt id)
+  {
+    deFrame home;
+    home.identity();
+    home.translation().set(0.0, 0.0, 0.2);
+    taoNode * node(new taoNode(parent, &home));
+    
+    deFrame com;
+    com.identity();
+    com.translation().set(0.0, 0.02, 0.1);
+    deMassProp mp;
+    mp.inertia(0.01, 0.02, 0.03, &com);
+    mp.mass(1.5, &com);
+    mp.get(node->mass(), node->center(), node->inertia());
+    node->setID(id);
+    
+    taoJoint * joint(new taoJointRevolute(static_cast<taoAxis>(id % 3)));
+    joint->setDVar(new taoVarDOF1);
+    joint->reset();
+    joint->setDamping(0.0);
+    joint->setInertia(0.0);
+    node->addJoint(joint);
+    node->addABNode();
+    
+    return node;
+  }
+  
+  
+  taoNodeRoot * create_snake(deInt nlinks)
+  {
+    deFrame global;
+    global.identity();
+    taoNodeRoot * root(new taoNodeRoot(global));
+    taoDNode * parent(root);
+    for (deInt id(0); id < nlinks; ++id) {
+      parent = add_link(parent, id);
+    }
+    taoDynamics::initialize(root);
+    return root;
+  }
+  
+  
+  void check_order(taoSweep const * sweep)
+  {
+    deInt const size(sweep->size());
+    ASSERT_EQ (-1, sweep->parent(0));
+    std::vector<deInt> postpos(size, -1);
+    for (deInt kk(0); kk < size; ++kk) {
+      ASSERT_EQ (-1, postpos[sweep->post(kk)]) << "node " << sweep->post(kk) << " twice in postorder";
+      postpos[sweep->post(kk)] = kk;
+    }
+    for (deInt ii(1); ii < size; ++ii) {
+      deInt const pp(sweep->parent(ii));
+      EXPECT_LT (pp, ii) << "parent after child in preorder";
+      EXPECT_EQ (sweep->node(pp), sweep->node(ii)->getDParent());
+      EXPECT_LT (postpos[ii], postpos[pp]) << "parent before child in postorder";
+    }
+  }
+  
+}
+
+
+TEST (sweep, order)
+{
+  deFrame global;
+  global.identity();
+  taoNodeRoot root(global);
+  taoNode * n0(add_link(&root, 0));
+  add_link(n0, 1);
+  taoNode * n2(add_link(n0, 2));
+  add_link(n2, 3);
+  add_link(&root, 4);
+  taoDynamics::initialize(&root);
+  
+  taoSweep const * sweep(root.getSweep());
+  ASSERT_EQ (6, sweep->size());
+  check_order(sweep);
+  EXPECT_EQ (5, taoDynamics::computeDOF(&root));
+  
+  // linking a node has to invalidate the cached orders
+  taoSweep const * subtree(n2->getSweep());
+  ASSERT_EQ (2, subtree->size());
+  add_link(n2, 5);
+  EXPECT_EQ (3, n2->getSweep()->size());
+  sweep = root.getSweep();
+  ASSERT_EQ (7, sweep->size());
+  check_order(sweep);
+  EXPECT_EQ (6, taoDynamics::computeDOF(&root));
+}
+
+
+TEST (sweep, per_tree)
+{
+  deFrame global;
+  global.identity();
+  taoNodeRoot one(global);
+  taoNodeRoot two(global);
+  add_link(&one, 0);
+  taoDynamics::initialize(&one);
+  taoDynamics::initialize(&two);
+  ASSERT_EQ (2, one.getSweep()->size());
+  
+  // changing one tree must leave the orders of the others alone
+  unsigned long const stamp(*one.topologyStamp());
+  taoNode * n0(add_link(&two, 0));
+  add_link(n0, 1);
+  EXPECT_EQ (stamp, *one.topologyStamp());
+  EXPECT_EQ (2, one.getSweep()->size());
+  EXPECT_EQ (3, two.getSweep()->size());
+  check_order(two.getSweep());
+}
+
+
+TEST (sweep, snake)
+{
+  deInt const nlinks(30);
+  taoNodeRoot * root(create_snake(nlinks));
+  ASSERT_EQ (nlinks, taoDynamics::computeDOF(root));
+  
+  srand(42);
+  std::vector<taoJoint*> joint;
+  std::vector<deFloat> tau(nlinks);
+  taoSweep * sweep(root->getSweep());
+  for (deInt ii(1); ii < sweep->size(); ++ii) {
+    joint.push_back(sweep->node(ii)->getJointList());
+    deFloat val(random_element());
+    joint.back()->setQ(&val);
+    val = random_element();
+    joint.back()->setDQ(&val);
+    tau[ii - 1] = 10.0 * random_element();
+    joint.back()->setTau(&tau[ii - 1]);
+  }
+  taoDynamics::updateTransformation(root);
+  
+  // forward then inverse dynamics has to give back the torques
+  deVector3 gravity;
+  gravity.set(0.0, 0.0, -9.81);
+  taoDynamics::fwdDynamics(root, &gravity);
+  taoDynamics::invDynamics(root, &gravity);
+  // the round trip loses a few digits, more so with DE_PRECISION_FLOAT
+  double const tolerance(std::max(1e-6, 1e3 * std::numeric_limits<deFloat>::epsilon()));
+  for (deInt ii(0); ii < nlinks; ++ii) {
+    deFloat check;
+    joint[ii]->getTau(&check);
+    EXPECT_NEAR (tau[ii], check, tolerance * (1.0 + fabs(tau[ii]))) << "joint " << ii;
+  }
+  
+  delete root;
+}
+
+
+TEST (sweep, deep_chain)
+{
+  // Deep enough to overflow the stack if anything still recursed
+  // over the tree, including the destructor.
+  deInt const nlinks(200000);
+  taoNodeRoot * root(create_snake(nlinks));
+  ASSERT_EQ (nlinks, taoDynamics::computeDOF(root));
+  taoDynamics::updateTransformation(root);
+  deVector3 gravity;
+  gravity.set(0.0, 0.0, -9.81);
+  taoDynamics::invDynamics(root, &gravity);
+  taoDynamics::fwdDynamics(root, &gravity);
+  delete root;
+}
+
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
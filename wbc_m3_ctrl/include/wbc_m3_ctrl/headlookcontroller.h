@@ -3,6 +3,7 @@
 
 #include <jspace/State.hpp>
 #include <jspace/Status.hpp>
+#include <math.h>
 
 namespace wbc_m3_ctrl {
   	
@@ -25,44 +26,43 @@ namespace wbc_m3_ctrl {
     
     jspace::Status update(jspace::State const & state) {
       state_ = state;
-      double q1 = state_.position_[0];
-      double q2 = state_.position_[1];
-      double q3 = state_.position_[2];
-      double q4 = state_.position_[3];
-      double q5 = state_.position_[4];
-      double q6 = state_.position_[5];
-
-
-      //update jacobian and actual vectors
-      actual_x_[0] =  ((-(-cos(q1)*sin(q2)*sin(q3)+sin(q1)*cos(q3))*sin(q4)+cos(q1)*cos(q2)*cos(q4))*cos(q5)+(-(-cos(q1)*sin(q2)*sin(q3)+sin(q1)*cos(q3))*cos(q4)-cos(q1)*cos(q2)*sin(q4))*sin(q5))*cos(q6)-(cos(q1)*sin(q2)*cos(q3)+sin(q1)*sin(q3))*sin(q6);
-      actual_x_[1]= ((-cos(q2)*sin(q3)*sin(q4)+sin(q2)*cos(q4))*cos(q5)+(-cos(q2)*sin(q3)*cos(q4)-sin(q2)*sin(q4))*sin(q5))*cos(q6)+cos(q2)*cos(q3)*sin(q6);
-      actual_x_[2] =  ((-(-sin(q1)*sin(q2)*sin(q3)-cos(q1)*cos(q3))*sin(q4)+sin(q1)*cos(q2)*cos(q4))*cos(q5)+(-(-sin(q1)*sin(q2)*sin(q3)-cos(q1)*cos(q3))*cos(q4)-sin(q1)*cos(q2)*sin(q4))*sin(q5))*cos(q6)-(sin(q1)*sin(q2)*cos(q3)-cos(q1)*sin(q3))*sin(q6);
-      actual_y_[0]  = ((-(-cos(q1)*sin(q2)*sin(q3)+sin(q1)*cos(q3))*sin(q4)+cos(q1)*cos(q2)*cos(q4))*cos(q5)+(-(-cos(q1)*sin(q2)*sin(q3)+sin(q1)*cos(q3))*cos(q4)-cos(q1)*cos(q2)*sin(q4))*sin(q5))*sin(q6)-(cos(q1)*sin(q2)*cos(q3)+sin(q1)*sin(q3))*cos(q6);
-      actual_y_[1] = ((-cos(q2)*sin(q3)*sin(q4)+sin(q2)*cos(q4))*cos(q5)+(-cos(q2)*sin(q3)*cos(q4)-sin(q2)*sin(q4))*sin(q5))*sin(q6)+cos(q2)*cos(q3)*cos(q6);
-      actual_y_[2] = ((-(-sin(q1)*sin(q2)*sin(q3)-cos(q1)*cos(q3))*sin(q4)+sin(q1)*cos(q2)*cos(q4))*cos(q5)+(-(-sin(q1)*sin(q2)*sin(q3)-cos(q1)*cos(q3))*cos(q4)-sin(q1)*cos(q2)*sin(q4))*sin(q5))*sin(q6)-(sin(q1)*sin(q2)*cos(q3)-cos(q1)*sin(q3))*cos(q6);
-      actual_z_[0] = -(-(-cos(q1)*sin(q2)*sin(q3)+sin(q1)*cos(q3))*sin(q4)+cos(q1)*cos(q2)*cos(q4))*sin(q5)+(-(-cos(q1)*sin(q2)*sin(q3)+sin(q1)*cos(q3))*cos(q4)-cos(q1)*cos(q2)*sin(q4))*cos(q5);                                                                                                                                                                             
-      actual_z_[1] = -(-cos(q2)*sin(q3)*sin(q4)+sin(q2)*cos(q4))*sin(q5)+(-cos(q2)*sin(q3)*cos(q4)-sin(q2)*sin(q4))*cos(q5);
-      actual_z_[2] = -(-(-sin(q1)*sin(q2)*sin(q3)-cos(q1)*cos(q3))*sin(q4)+sin(q1)*cos(q2)*cos(q4))*sin(q5)+(-(-sin(q1)*sin(q2)*sin(q3)-cos(q1)*cos(q3))*cos(q4)-sin(q1)*cos(q2)*sin(q4))*cos(q5);
       
+      // Closed-form head kinematics, with one sine and cosine per
+      // joint and the products that appear in several entries
+      // computed only once, like the kernels written by wbc_kingen
+      // (which can replace this once the head is part of the robot
+      // model). aa, bb, and dd are the columns that joints 4 to 6 mix.
+      double const s1(sin(state_.position_[0])), c1(cos(state_.position_[0]));
+      double const s2(sin(state_.position_[1])), c2(cos(state_.position_[1]));
+      double const s3(sin(state_.position_[2])), c3(cos(state_.position_[2]));
+      double const s4(sin(state_.position_[3])), c4(cos(state_.position_[3]));
+      double const s5(sin(state_.position_[4])), c5(cos(state_.position_[4]));
+      double const s6(sin(state_.position_[5])), c6(cos(state_.position_[5]));
+      double const c1s2(c1 * s2);
+      double const s1s2(s1 * s2);
+      double const aa[3] = { s1 * c3 - c1s2 * s3, c2 * s3, - s1s2 * s3 - c1 * c3 };
+      double const bb[3] = { c1 * c2, s2, s1 * c2 };
+      double const dd[3] = { c1s2 * c3 + s1 * s3, - c2 * c3, s1s2 * c3 - c1 * s3 };
+      
+      //update jacobian and actual vectors
+      for (size_t ii(0); ii < 3; ++ii) {
+	double const a4(bb[ii] * c4 - aa[ii] * s4);
+	double const b4(- aa[ii] * c4 - bb[ii] * s4);
+	double const pp(a4 * c5 + b4 * s5);
+	actual_x_[ii] = pp * c6 - dd[ii] * s6;
+	actual_y_[ii] = pp * s6 - dd[ii] * c6;
+	actual_z_[ii] = b4 * c5 - a4 * s5;
+	jac_(ii,2) = bb[ii];
+	jac_(ii,3) = dd[ii];
+	jac_(ii,4) = dd[ii];
+	jac_(ii,5) = actual_z_[ii];
+      }
       jac_(0,0) = 0;
       jac_(1,0) = -1;
       jac_(2,0) = 0;
-      jac_(0,1) = -sin(q1);
+      jac_(0,1) = -s1;
       jac_(1,1) = 0;
-      jac_(2,1) = cos(q1);
-      jac_(0,2) = cos(q1)*cos(q2);
-      jac_(1,2) = sin(q2);
-      jac_(2,2) = sin(q1)*cos(q2);
-      jac_(0,3) = cos(q1)*sin(q2)*cos(q3)+sin(q1)*sin(q3);
-      jac_(1,3) = -cos(q2)*cos(q3);
-      jac_(2,3) = sin(q1)*sin(q2)*cos(q3)-cos(q1)*sin(q3);
-      jac_(0,4) = cos(q1)*sin(q2)*cos(q3)+sin(q1)*sin(q3);
-      jac_(1,4) = -cos(q2)*cos(q3);
-      jac_(2,4) = sin(q1)*sin(q2)*cos(q3)-cos(q1)*sin(q3);
-      jac_(0,5) = -(-(-cos(q1)*sin(q2)*sin(q3)+sin(q1)*cos(q3))*sin(q4)+cos(q1)*cos(q2)*cos(q4))*sin(q5)+(-(-cos(q1)*sin(q2)*sin(q3)+sin(q1)*cos(q3))*cos(q4)-cos(q1)*cos(q2)*sin(q4))*cos(q5);                                                                                                                                                                             
-      jac_(1,5) = -(-cos(q2)*sin(q3)*sin(q4)+sin(q2)*cos(q4))*sin(q5)+(-cos(q2)*sin(q3)*cos(q4)-sin(q2)*sin(q4))*cos(q5);
-      jac_(2,5) = -(-(-sin(q1)*sin(q2)*sin(q3)-cos(q1)*cos(q3))*sin(q4)+sin(q1)*cos(q2)*cos(q4))*sin(q5)+(-(-sin(q1)*sin(q2)*sin(q3)-cos(q1)*cos(q3))*cos(q4)-sin(q1)*cos(q2)*sin(q4))*cos(q5);
-
+      jac_(2,1) = c1;
 
       jspace::Status ok;
       return ok;
@@ -102,6 +102,7 @@ namespace wbc_m3_ctrl {
 	command[ii] = tau[ii];
       }
       command[6] = tau[5];
+      return command;
     }
 
     jspace::Vector cross(jspace::Vector v1, jspace::Vector v2) {
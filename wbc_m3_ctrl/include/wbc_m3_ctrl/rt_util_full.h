@@ -71,6 +71,18 @@ namespace wbc_m3_ctrl {
     
     virtual int cleanup(void) = 0;
     
+    /**
+       Where the RT thread should write the body state it reads from
+       shared memory. The default returns null, and the thread uses a
+       State of its own. Subclasses that pass the body state on to a
+       jspace::Model can return &model->getStateBuffer() here: the
+       sensor data then lands directly in the model, and the
+       body_state given to init() and update() is that very
+       buffer. This gets called once, before init(), and the returned
+       State gets resized to the M3 body dimensions if needed.
+    */
+    virtual jspace::State * getBodyStateBuffer() { return 0; }
+    
     virtual int slowdown(long long iteration,
 			 long long desired_ns,
 			 long long actual_ns) = 0;
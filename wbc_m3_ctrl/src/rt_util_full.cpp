@@ -62,6 +62,58 @@ namespace wbc_m3_ctrl {
   static int rt_thread_id(0);
   static long long rt_period_ns(-1); 
   
+  static double const deg_to_rad(M_PI / 180.0);
+  
+  
+  // Templated on the source so that it works whether the M3 headers
+  // define mReal as float or as double. Contiguous, branch-free, and
+  // with a loop-invariant factor, so the compiler can vectorize it.
+  template<typename src_t>
+  static inline void scale_into(double * dst, src_t const * src, size_t nn, double factor)
+  {
+    for (size_t ii(0); ii < nn; ++ii) {
+      dst[ii] = factor * src[ii];
+    }
+  }
+  
+  
+  // Single pass from the shared-memory status into the (already
+  // sized) states: degrees to radians for the joints, milli to SI
+  // for the wrench, and the IMU orientation flipped into the base
+  // frame, i.e. premultiplied by diag(-1, 1, -1).
+  static void ingest_status(M3UTATorqueShmSdsStatus const & shm_status,
+			    jspace::State & body_state,
+			    jspace::State & head_state,
+			    jspace::State & hand_state)
+  {
+    double * const body_pos(body_state.position_.data());
+    double * const body_vel(body_state.velocity_.data());
+    scale_into(body_pos,     shm_status.mobile_base.theta,    3, deg_to_rad);
+    scale_into(body_vel,     shm_status.mobile_base.thetadot, 3, deg_to_rad);
+    scale_into(body_pos + 3, shm_status.torso.theta,          2, deg_to_rad);
+    scale_into(body_vel + 3, shm_status.torso.thetadot,       2, deg_to_rad);
+    scale_into(body_pos + 5, shm_status.right_arm.theta,      7, deg_to_rad); // XXXX to do: hardcoded NDOF
+    scale_into(body_vel + 5, shm_status.right_arm.thetadot,   7, deg_to_rad);
+    
+    ///Force-Torque Sensor
+    scale_into(body_state.force_.data(), shm_status.right_arm.wrench, 6, 1.0e-3);
+    
+    scale_into(body_state.accelerometer_.data(), shm_status.mobile_base.imu.accelerometer, 3, 1.0);
+    scale_into(body_state.magnetometer_.data(), shm_status.mobile_base.imu.magnetometer, 3, 1.0);
+    scale_into(body_state.ang_vel_.data(), shm_status.mobile_base.imu.ang_vel, 3, 1.0);
+    for (size_t jj(0); jj < 3; ++jj) {
+      body_state.orientation_mtx_(0,jj) = - shm_status.mobile_base.imu.orientation_mtx[jj];
+      body_state.orientation_mtx_(1,jj) =   shm_status.mobile_base.imu.orientation_mtx[3+jj];
+      body_state.orientation_mtx_(2,jj) = - shm_status.mobile_base.imu.orientation_mtx[6+jj];
+    }
+    
+    scale_into(head_state.position_.data(), shm_status.head.theta,    12, deg_to_rad);
+    scale_into(head_state.velocity_.data(), shm_status.head.thetadot, 12, deg_to_rad);
+    scale_into(hand_state.position_.data(), shm_status.right_hand.theta,    5, deg_to_rad);
+    scale_into(hand_state.velocity_.data(), shm_status.right_hand.thetadot, 5, deg_to_rad);
+  }
+  
+  
   static void * rt_thread(void * arg)
   {
     M3Sds * sys;
@@ -72,7 +124,8 @@ namespace wbc_m3_ctrl {
     M3UTATorqueShmSdsStatus shm_status;
     M3UTATorqueShmSdsCommand shm_cmd;
     
-    jspace::State body_state(12, 12, 6);
+    jspace::State local_body_state(12, 12, 6);
+    jspace::State * body_state(rtutil->getBodyStateBuffer());
     jspace::State head_state(12, 12, 6);
     jspace::State hand_state( 5,  5, 6);
     jspace::Vector body_command(12);
@@ -87,6 +140,15 @@ namespace wbc_m3_ctrl {
     rt_thread_state = RT_THREAD_INIT;
     shutdown_request = 0;
     
+    if ( ! body_state) {
+      body_state = &local_body_state;
+    }
+    else if ((12 != body_state->position_.size())
+	     || (12 != body_state->velocity_.size())
+	     || (6 != body_state->force_.size())) {
+      body_state->init(12, 12, 6);
+    }
+    
     sys = (M3Sds*) rt_shm_alloc(nam2num(TORQUE_SHM), sizeof(M3Sds), USE_VMALLOC);
     if (sys) {
       fprintf(stderr, "found shared memory\n");
@@ -126,47 +188,9 @@ namespace wbc_m3_ctrl {
     rt_sem_wait(status_sem);
     memcpy(&shm_status, sys->status, sizeof(shm_status));
     rt_sem_signal(status_sem);
-
-    for (size_t ii(0); ii < 3; ++ii) {
-      body_state.position_[ii] = M_PI * shm_status.mobile_base.theta[ii] / 180.0;
-      body_state.velocity_[ii] = M_PI * shm_status.mobile_base.thetadot[ii] / 180.0;
-    }
-
-    for (size_t kk(3); kk < 5; ++kk) {
-      body_state.position_[kk] = M_PI * shm_status.torso.theta[kk-3] / 180.0;
-      body_state.velocity_[kk] = M_PI * shm_status.torso.thetadot[kk-3] / 180.0;
-    }	
-
-    for (size_t ii(5); ii < 12; ++ii) { // XXXX to do: hardcoded NDOF
-      body_state.position_[ii] = M_PI * shm_status.right_arm.theta[ii-5] / 180.0;
-      body_state.velocity_[ii] = M_PI * shm_status.right_arm.thetadot[ii-5] / 180.0;
-    }	
-
-    ///Force-Torque Sensor
-    for (size_t jj(0); jj < 6; ++jj) {
-      body_state.force_[jj] = 1.0e-3 * shm_status.right_arm.wrench[jj];
-    }
-
-    for (size_t ii(0); ii < 3; ++ii) {
-      body_state.accelerometer_[ii] = shm_status.mobile_base.imu.accelerometer[ii];
-      body_state.magnetometer_[ii] = shm_status.mobile_base.imu.magnetometer[ii];
-      body_state.ang_vel_[ii] = shm_status.mobile_base.imu.ang_vel[ii];
-      for (size_t jj(0); jj < 3; ++jj) {
-	body_state.orientation_mtx_(ii,jj) = shm_status.mobile_base.imu.orientation_mtx[3*ii+jj];
-      }
-    }
-
-    for (size_t ii(0); ii < 12; ++ii) {
-      head_state.position_[ii] = M_PI * shm_status.head.theta[ii] / 180.0;
-      head_state.velocity_[ii] = M_PI * shm_status.head.thetadot[ii] / 180.0;
-    }
-
-    for (size_t ii(0); ii < 5; ++ii) {
-      hand_state.position_[ii] = M_PI * shm_status.right_hand.theta[ii] / 180.0;
-      hand_state.velocity_[ii] = M_PI * shm_status.right_hand.thetadot[ii] / 180.0;
-    }
-
-    cb_status = rtutil->init(body_state, head_state, hand_state);
+    ingest_status(shm_status, *body_state, head_state, hand_state);
+    
+    cb_status = rtutil->init(*body_state, head_state, hand_state);
     if (0 != cb_status) {
       fprintf(stderr, "init callback returned %d\n", cb_status);
       rt_thread_state = RT_THREAD_ERROR;
@@ -199,88 +223,8 @@ namespace wbc_m3_ctrl {
       rt_sem_wait(status_sem);
       memcpy(&shm_status, sys->status, sizeof(shm_status));
       rt_sem_signal(status_sem);
-
-      for (size_t ii(0); ii < 3; ++ii) {
-	body_state.position_[ii] = M_PI * shm_status.mobile_base.theta[ii] / 180.0;
-	body_state.velocity_[ii] = M_PI * shm_status.mobile_base.thetadot[ii] / 180.0;
-      }
-      
-      for (size_t kk(3); kk < 5; ++kk) {
-	body_state.position_[kk] = M_PI * shm_status.torso.theta[kk-3] / 180.0;
-	body_state.velocity_[kk] = M_PI * shm_status.torso.thetadot[kk-3] / 180.0;
-      }	
-      
-      for (size_t ii(5); ii < 12; ++ii) { // XXXX to do: hardcoded NDOF
-	body_state.position_[ii] = M_PI * shm_status.right_arm.theta[ii-5] / 180.0;
-	body_state.velocity_[ii] = M_PI * shm_status.right_arm.thetadot[ii-5] / 180.0;
-      }	
-
-      ///Force-Torque Sensor
-      for (size_t jj(0); jj < 6; ++jj) {
-	body_state.force_[jj] = 1.0e-3 * shm_status.right_arm.wrench[jj];
-      }
-
-      jspace::Matrix mtx2(jspace::Matrix::Zero(3,3));
-      for (size_t ii(0); ii < 3; ++ii) {
-	body_state.accelerometer_[ii] = shm_status.mobile_base.imu.accelerometer[ii];
-	body_state.magnetometer_[ii] = shm_status.mobile_base.imu.magnetometer[ii];
-	body_state.ang_vel_[ii] = shm_status.mobile_base.imu.ang_vel[ii];
-	for (size_t jj(0); jj < 3; ++jj) {
-	  mtx2(ii,jj) = shm_status.mobile_base.imu.orientation_mtx[3*ii+jj];
-	}
-      }
-
-      jspace::Matrix R(jspace::Matrix::Zero(3,3));
-      R(0,0) = -1;
-      R(1,1) = 1;
-      R(2,2) = -1;
-
-      body_state.orientation_mtx_ = R *mtx2;
-
-
-      /*
-      std::cout << "Ori:\n";
-      for (size_t ii(0); ii< body_state.orientation_mtx_.rows(); ++ii) {
-	for (size_t jj(0); jj < body_state.orientation_mtx_.cols(); ++jj) {
-	  std::cout << body_state.orientation_mtx_(ii,jj) << "  ";
-	}
-	std::cout << "\n";
-      }*/
-
-      //body_state.orientation_mtx_ = jspace::Matrix::Identity(3,3);
+      ingest_status(shm_status, *body_state, head_state, hand_state);
       
-      /*body_state.orientation_mtx_(0,0) = cos(-0.175);
-      body_state.orientation_mtx_(0,1) = 0;     
-      body_state.orientation_mtx_(0,2) = sin(-0.175);
-      body_state.orientation_mtx_(1,0) = 0;
-      body_state.orientation_mtx_(1,1) = 1;
-      body_state.orientation_mtx_(1,2) = 0;
-      body_state.orientation_mtx_(2,0) = -sin(-0.175);
-      body_state.orientation_mtx_(2,1) = 0;
-      body_state.orientation_mtx_(2,2) = cos(-0.175);*/
-
-
-      /*      body_state.orientation_mtx_(0,0) = 0.976;
-      body_state.orientation_mtx_(0,1) = -0.1;     
-      body_state.orientation_mtx_(0,2) = -0.192;
-      body_state.orientation_mtx_(1,0) = 0.1;
-      body_state.orientation_mtx_(1,1) = 0.995;
-      body_state.orientation_mtx_(1,2) = 0.00136;
-      body_state.orientation_mtx_(2,0) = 0.192;
-      body_state.orientation_mtx_(2,1) = -0.00136;
-      body_state.orientation_mtx_(2,2) = 0.981;*/
-      
-      
-      for (size_t ii(0); ii < 12; ++ii) {
-	head_state.position_[ii] = M_PI * shm_status.head.theta[ii] / 180.0;
-	head_state.velocity_[ii] = M_PI * shm_status.head.thetadot[ii] / 180.0;
-      }
-      
-      for (size_t ii(0); ii < 5; ++ii) {
-	hand_state.position_[ii] = M_PI * shm_status.right_hand.theta[ii] / 180.0;
-	hand_state.velocity_[ii] = M_PI * shm_status.right_hand.thetadot[ii] / 180.0;
-      }
-
       if (0 != cb_status) {
 	fprintf(stderr, "update callback returned %d\n", cb_status);
 	rt_thread_state = RT_THREAD_ERROR;
@@ -288,7 +232,7 @@ namespace wbc_m3_ctrl {
 	continue;
       }
 
-      cb_status = rtutil->update(body_state, body_command, head_state, head_command, hand_state, hand_command);
+      cb_status = rtutil->update(*body_state, body_command, head_state, head_command, hand_state, hand_command);
       if (0 != cb_status) {
 	fprintf(stderr, "update callback returned %d\n", cb_status);
 	rt_thread_state = RT_THREAD_ERROR;
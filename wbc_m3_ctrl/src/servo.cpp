@@ -47,7 +47,10 @@
 #include <jspace/test/sai_util.hpp>
 #include <opspace/Skill.hpp>
 #include <opspace/Factory.hpp>
+#include <opspace/SkillSwitch.hpp>
 #include <uta_opspace/ControllerNG.hpp>
+#include <uta_opspace/ShadowEvaluator.hpp>
+#include <uta_opspace/SessionRecorder.hpp>
 #include <uta_opspace/HelloGoodbyeSkill.hpp>
 #include <uta_opspace/TaskOriPostureSkill.hpp>
 #include <uta_opspace/WriteSkill.hpp>
@@ -55,6 +58,7 @@
 #include <boost/scoped_ptr.hpp>
 #include <err.h>
 #include <signal.h>
+#include <fstream>
 
 using namespace wbc_m3_ctrl;
 using namespace opspace;
@@ -97,6 +101,14 @@ static long long servo_rate;
 static long long actual_servo_rate;
 static shared_ptr<ParamCallbacks> param_cbs;
 static shared_ptr<ControllerNG> controller;
+static shared_ptr<SkillSwitch> skill_switch;
+static int initial_skill(0);
+static shared_ptr<ShadowEvaluator> shadow;
+static vector<shared_ptr<Factory> > shadow_factories;
+static string shadow_log("");
+static shared_ptr<SessionRecorder> recorder;
+static string session_file("");
+static long long servo_tick(0);
 
 
 static void usage(int ecode, std::string msg)
@@ -107,16 +119,69 @@ static void usage(int ecode, std::string msg)
        "  -h               help (this message)\n"
        "  -v               verbose mode\n"
        "  -r  <filename>   robot specification (SAI XML format)\n"
+       "  -c  <filename>   binary model cache for the robot specification\n"
+       "                   (created or rebuilt if missing or out of date)\n"
        "  -f  <frequency>  servo rate (integer number in Hz, default 500Hz)\n"
-       "  -s  <filename>   skill specification (YAML file with tasks etc)",
+       "  -s  <filename>   skill specification (YAML file with tasks etc)\n"
+       "  -S  <filename>   binary skill cache for the skill specification\n"
+       "                   (created or rebuilt if missing or out of date)\n"
+       "  -k  <skillname>  initially active skill (default is the first one)\n"
+       "  -x  <skillname>  evaluate this skill in shadow mode, next to the live one\n"
+       "                   (can be given several times)\n"
+       "  -X  <filename>   skill specification for the shadow skills (default\n"
+       "                   is the one given with -s, e.g. use -X to try other gains)\n"
+       "  -L  <filename>   write the shadow commands to this file at shutdown\n"
+       "  -R  <filename>   record the session to this file, for offline replay\n"
+       "                   with wbc_replay",
        msg.c_str());
 }
 
 
+static jspace::Model * load_model(string const & robot_spec, string const & robot_cache)
+{
+  jspace::Model * result(0);
+  try {
+    static bool const enable_coriolis_centrifugal(false);
+    if (robot_cache.empty()) {
+      result = jspace::test::parse_sai_xml_file(robot_spec, enable_coriolis_centrifugal);
+    }
+    else {
+      result = jspace::test::parse_sai_xml_file_cached(robot_spec, robot_cache, enable_coriolis_centrifugal,
+						       verbose ? &cerr : 0);
+    }
+  }
+  catch (runtime_error const & ee) {
+    errx(EXIT_FAILURE,
+	 "exception while parsing robot specification\n"
+	 "  filename: %s\n"
+	 "  error: %s",
+	 robot_spec.c_str(), ee.what());
+  }
+  return result;
+}
+
+
+static Status parse_skills(Factory & ff, string const & skill_spec, string const & skill_cache)
+{
+  if (skill_spec.empty()) {
+    return ff.parseString(opspace_fallback_str);
+  }
+  if (skill_cache.empty()) {
+    return ff.parseFile(skill_spec);
+  }
+  return ff.parseFileCached(skill_spec, skill_cache, verbose ? &cerr : 0);
+}
+
+
 static void parse_options(int argc, char ** argv)
 {
   string skill_spec("");
+  string skill_cache("");
+  string skill_name("");
   string robot_spec("");
+  string robot_cache("");
+  vector<string> shadow_skills;
+  string shadow_spec("");
   servo_rate = 500;
   
   for (int ii(1); ii < argc; ++ii) {
@@ -127,7 +192,7 @@ static void parse_options(int argc, char ** argv)
       switch (argv[ii][1]) {
 	
       case 'h':
-	usage(EXIT_SUCCESS, "servo [-h] [-v] [-s skillspec] -r robotspec");
+	usage(EXIT_SUCCESS, "servo [-h] [-v] [-s skillspec] [-S skillcache] [-k skillname] [-x shadowskill] [-X shadowspec] [-L shadowlog] [-R session] [-c robotcache] -r robotspec");
 	
       case 'v':
 	verbose = true;
@@ -141,6 +206,14 @@ static void parse_options(int argc, char ** argv)
 	robot_spec = argv[ii];
  	break;
 	
+      case 'c':
+ 	++ii;
+ 	if (ii >= argc) {
+	  usage(EXIT_FAILURE, "-c requires parameter");
+ 	}
+	robot_cache = argv[ii];
+ 	break;
+	
       case 'f':
  	++ii;
  	if (ii >= argc) {
@@ -166,44 +239,77 @@ static void parse_options(int argc, char ** argv)
 	skill_spec = argv[ii];
  	break;
 	
+      case 'S':
+ 	++ii;
+ 	if (ii >= argc) {
+	  usage(EXIT_FAILURE, "-S requires parameter");
+ 	}
+	skill_cache = argv[ii];
+ 	break;
+	
+      case 'k':
+ 	++ii;
+ 	if (ii >= argc) {
+	  usage(EXIT_FAILURE, "-k requires parameter");
+ 	}
+	skill_name = argv[ii];
+ 	break;
+	
+      case 'x':
+ 	++ii;
+ 	if (ii >= argc) {
+	  usage(EXIT_FAILURE, "-x requires parameter");
+ 	}
+	shadow_skills.push_back(argv[ii]);
+ 	break;
+	
+      case 'X':
+ 	++ii;
+ 	if (ii >= argc) {
+	  usage(EXIT_FAILURE, "-X requires parameter");
+ 	}
+	shadow_spec = argv[ii];
+ 	break;
+	
+      case 'L':
+ 	++ii;
+ 	if (ii >= argc) {
+	  usage(EXIT_FAILURE, "-L requires parameter");
+ 	}
+	shadow_log = argv[ii];
+ 	break;
+	
+      case 'R':
+ 	++ii;
+ 	if (ii >= argc) {
+	  usage(EXIT_FAILURE, "-R requires parameter");
+ 	}
+	session_file = argv[ii];
+ 	break;
+	
       default:
 	usage(EXIT_FAILURE, "invalid option `" + string(argv[ii]) + "'");
       }
   }
   
-  try {
-    if (robot_spec.empty()) {
-      usage(EXIT_FAILURE, "no robot specification (see option -r)");
-    }
-    if (verbose) {
-      warnx("reading robot spec from %s", robot_spec.c_str());
-    }
-    static bool const enable_coriolis_centrifugal(false);
-    model.reset(jspace::test::parse_sai_xml_file(robot_spec, enable_coriolis_centrifugal));
+  if (robot_spec.empty()) {
+    usage(EXIT_FAILURE, "no robot specification (see option -r)");
   }
-  catch (runtime_error const & ee) {
-    errx(EXIT_FAILURE,
-	 "exception while parsing robot specification\n"
-	 "  filename: %s\n"
-	 "  error: %s",
-	 robot_spec.c_str(), ee.what());
+  if (verbose) {
+    warnx("reading robot spec from %s", robot_spec.c_str());
   }
+  model.reset(load_model(robot_spec, robot_cache));
   
   factory.reset(new Factory());
-  
-  Status st;
-  if (skill_spec.empty()) {
-    if (verbose) {
+  if (verbose) {
+    if (skill_spec.empty()) {
       warnx("using fallback task/posture skill");
     }
-    st = factory->parseString(opspace_fallback_str);
-  }
-  else {
-    if (verbose) {
+    else {
       warnx("reading skills from %s", skill_spec.c_str());
     }
-    st = factory->parseFile(skill_spec);
   }
+  Status st(parse_skills(*factory, skill_spec, skill_cache));
   if ( ! st) {
     errx(EXIT_FAILURE,
 	 "failed to parse skills\n"
@@ -214,6 +320,51 @@ static void parse_options(int argc, char ** argv)
   if (verbose) {
     factory->dump(cout, "*** parsed tasks and skills", "* ");
   }
+  
+  if ( ! skill_name.empty()) {
+    Factory::skill_table_t const & skills(factory->getSkillTable());
+    for (initial_skill = 0; initial_skill < static_cast<int>(skills.size()); ++initial_skill) {
+      if (skill_name == skills[initial_skill]->getName()) {
+	break;
+      }
+    }
+    if (initial_skill >= static_cast<int>(skills.size())) {
+      errx(EXIT_FAILURE, "no skill called `%s'", skill_name.c_str());
+    }
+  }
+  
+  // Each shadow lane gets its own model, skills, and controller, so
+  // that its worker thread shares nothing with the servo.
+  shadow.reset(new ShadowEvaluator(shadow_log.empty() ? 0 : 10000));
+  for (size_t ii(0); ii < shadow_skills.size(); ++ii) {
+    shared_ptr<Factory> ff(new Factory());
+    if (shadow_spec.empty()) {
+      st = parse_skills(*ff, skill_spec, skill_cache);
+    }
+    else {
+      st = ff->parseFile(shadow_spec);
+    }
+    if ( ! st) {
+      errx(EXIT_FAILURE, "failed to parse shadow skills: %s", st.errstr.c_str());
+    }
+    shared_ptr<Skill> skill(ff->findSkill(shadow_skills[ii]));
+    if ( ! skill) {
+      errx(EXIT_FAILURE, "no shadow skill called `%s'", shadow_skills[ii].c_str());
+    }
+    ostringstream name;
+    name << "shadow" << ii;
+    shared_ptr<jspace::Model> lane_model(load_model(robot_spec, robot_cache));
+    if (model->getConstraint() && ( ! lane_model->getConstraint())) {
+      errx(EXIT_FAILURE, "shadow model lacks the constraint of the live one");
+    }
+    st = shadow->addLane(name.str(), lane_model,
+			 shared_ptr<ControllerNG>(new ControllerNG("wbc_m3_ctrl::" + name.str())),
+			 skill);
+    if ( ! st) {
+      errx(EXIT_FAILURE, "failed to add shadow lane: %s", st.errstr.c_str());
+    }
+    shadow_factories.push_back(ff);
+  }
 }
 
 
@@ -236,10 +387,8 @@ namespace {
     : public RTUtil
   {
   public:
-    shared_ptr<Skill> skill;    
-    
     virtual int init(jspace::State const & state) {
-      if (skill) {
+      if (skill_switch->getActive()) {
 	warnx("Servo::init(): already initialized");
 	return -1;
       }
@@ -260,14 +409,28 @@ namespace {
 	return -4;
       }
       
-      skill = factory->getSkillTable()[0]; // XXXX to do: allow selection at runtime
-      status = skill->init(*model);
+      // All skills get initialized here, so that switching between
+      // them later only costs a handoff inside the servo tick.
+      status = skill_switch->init(*model, factory->getSkillTable());
       if ( ! status) {
-	warnx("Servo::init(): skill->init() failed: %s", status.errstr.c_str());
-	skill.reset();
+	warnx("Servo::init(): skill_switch->init() failed: %s", status.errstr.c_str());
 	return -5;
       }
       
+      status = shadow->start(state);
+      if ( ! status) {
+	warnx("Servo::init(): shadow->start() failed: %s", status.errstr.c_str());
+	return -6;
+      }
+      
+      if (recorder) {
+	status = recorder->open(session_file, state, state.position_.rows(), registry);
+	if ( ! status) {
+	  warnx("Servo::init(): recorder->open() failed: %s", status.errstr.c_str());
+	  return -7;
+	}
+      }
+      
       return 0;
     }
     
@@ -275,26 +438,42 @@ namespace {
     virtual int update(jspace::State const & state,
 		       jspace::Vector & command)
     {
-      if ( ! skill) {
+      if ( ! skill_switch->getActive()) {
 	warnx("Servo::update(): not initialized\n");
 	return -1;
       }
       
+      long long const t0(rt_get_cpu_time_ns());
       model->update(state);
       
-      jspace::Status status(controller->computeCommand(*model, *skill, command));
+      jspace::Status status(skill_switch->update(*model));
+      if ( ! status) {
+	// keep going with the previously active skill
+	warnx("Servo::update(): skill switch failed: %s", status.errstr.c_str());
+      }
+      
+      status = controller->computeCommand(*model, *skill_switch->getActive(), command);
       if ( ! status) {
 	warnx("Servo::update(): controller->computeCommand() failed: %s", status.errstr.c_str());
 	return -2;
       }
       
+      // Only copies into the lanes' mailboxes and the recorder's
+      // ring, the shadow skills and the file writes happen on other
+      // threads.
+      long long const dt(rt_get_cpu_time_ns() - t0);
+      shadow->submit(servo_tick, state, command, dt);
+      if (recorder) {
+	recorder->recordTick(servo_tick, state, command, dt);
+      }
+      ++servo_tick;
+      
       return 0;
     }
     
     
     virtual int cleanup(void)
     {
-      skill.reset();
       return 0;
     }
     
@@ -308,6 +487,17 @@ namespace {
     }
   };
   
+  
+  class RecordParameters
+    : public ParamCallbacks::Observer
+  {
+  public:
+    virtual void written(Parameter const * param)
+    {
+      recorder->recordParameter(param);
+    }
+  };
+  
 }
 
 
@@ -334,6 +524,13 @@ int main(int argc, char ** argv)
   
   controller.reset(new ControllerNG("wbc_m3_ctrl::servo"));
   param_cbs.reset(new ParamCallbacks());
+  skill_switch.reset(new SkillSwitch("wbc_m3_ctrl::servo"));
+  skill_switch->lookupParameter("skill")->set(initial_skill);
+  RecordParameters record_parameters;
+  if ( ! session_file.empty()) {
+    recorder.reset(new SessionRecorder(4096));
+    param_cbs->setObserver(&record_parameters);
+  }
   Servo servo;
   try {
     if (verbose) {
@@ -341,6 +538,7 @@ int main(int argc, char ** argv)
     }
     registry.reset(factory->createRegistry());
     registry->add(controller);
+    registry->add(skill_switch);
     param_cbs->init(node, registry, 1, 100);
     
     if (verbose) {
@@ -361,10 +559,11 @@ int main(int argc, char ** argv)
   
   while (ros::ok()) {
     ros::Time t1(ros::Time::now());
-    if (verbose) {
+    Skill * skill(skill_switch->getActive());
+    if (verbose && skill) {
       if (t1 - dbg_t0 > dbg_dt) {
 	dbg_t0 = t1;
-	servo.skill->dbg(cout, "\n\n**************************************************", "");
+	skill->dbg(cout, "\n\n**************************************************", "");
 	controller->dbg(cout, "--------------------------------------------------", "");
 	cout << "--------------------------------------------------\n";
 	jspace::pretty_print(model->getState().position_, cout, "jpos", "  ");
@@ -375,11 +574,21 @@ int main(int argc, char ** argv)
 	model->getGravity(gravity);
 	jspace::pretty_print(gravity, cout, "gravity", "  ");
 	cout << "servo rate: " << actual_servo_rate << "\n";
+	skill_switch->dump(cout, "", "");
+	if (0 < shadow->getNLanes()) {
+	  shadow->dump(cout, "shadow lanes:", "  ");
+	}
       }
     }
-    if (t1 - dump_t0 > dump_dt) {
+    if (skill && (t1 - dump_t0 > dump_dt)) {
       dump_t0 = t1;
-      controller->qhlog(*servo.skill, rt_get_cpu_time_ns() / 1000);
+      controller->qhlog(*skill, rt_get_cpu_time_ns() / 1000);
+    }
+    if (recorder && recorder->isOpen()) {
+      Status const st(recorder->flush());
+      if ( ! st) {
+	warnx("failed to record session: %s", st.errstr.c_str());
+      }
     }
     ros::spinOnce();
     usleep(10000);		// 100Hz-ish
@@ -387,4 +596,26 @@ int main(int argc, char ** argv)
   
   warnx("shutting down");
   servo.shutdown();
+  if (recorder) {
+    param_cbs->setObserver(0);
+    Status const st(recorder->close());
+    if ( ! st) {
+      warnx("failed to record session: %s", st.errstr.c_str());
+    }
+    warnx("recorded %lld ticks to %s (%lld dropped)",
+	  recorder->getNRecorded(), session_file.c_str(), recorder->getNDropped());
+  }
+  shadow->stop();
+  if (0 < shadow->getNLanes()) {
+    shadow->dump(cerr, "shadow lanes:", "  ");
+    if ( ! shadow_log.empty()) {
+      ofstream os(shadow_log.c_str());
+      if ( ! os) {
+	warnx("failed to open shadow log `%s'", shadow_log.c_str());
+      }
+      else {
+	shadow->writeLog(os);
+      }
+    }
+  }
 }
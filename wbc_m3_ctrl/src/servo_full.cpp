@@ -245,6 +245,16 @@ namespace {
   public:
     shared_ptr<Skill> skill;
     
+    // Have the RT thread write the body state straight into the
+    // model, so that model->update(body_state) does not copy it.
+    virtual jspace::State * getBodyStateBuffer()
+    {
+      if ( ! model) {
+	return 0;
+      }
+      return &model->getStateBuffer();
+    }
+    
     virtual int init(jspace::State const & body_state,
 		     jspace::State const & head_state,
 		     jspace::State const & hand_state) {
@@ -261,7 +271,7 @@ namespace {
 	return -3;
       }
       
-      if (!model->setConstraint("Dreamer_Full")) {
+      if (( ! model->getConstraint()) && ( ! model->setConstraint("Dreamer_Full"))) {
 	warnx("Servo::init(): model->setConstraint() failed: Is the Constraint defined?");
 	return -4;
       }
@@ -261,7 +261,7 @@ namespace {
 	return -3;
       }
       
-      if (!model->setConstraint("Dreamer_Torso")) {
+      if (( ! model->getConstraint()) && ( ! model->setConstraint("Dreamer_Torso"))) {
 	warnx("Servo::init(): model->setConstraint() failed. Constraint not setup?");
 	return -4;
       }
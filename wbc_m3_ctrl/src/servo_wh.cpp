@@ -254,7 +254,7 @@ namespace {
 	return -3;
       }
       
-      if(!model->setConstraint("Dreamer_Base")) {
+      if (( ! model->getConstraint()) && ( ! model->setConstraint("Dreamer_Base"))) {
 	warnx("Servo::init(): model->setConstraint() failed: Is the constraint defined?");
 	return -4;
       }
@@ -37,11 +37,16 @@
 #include <wbc_m3_ctrl/udp_util.h>
 #include <wbc_m3_ctrl/qh.h>
 
+// for timing the ticks that get recorded
+#include <rtai_sched.h>
+#include <rtai.h>
+
 #include <ros/ros.h>
 #include <jspace/test/sai_util.hpp>
 #include <opspace/Skill.hpp>
 #include <opspace/Factory.hpp>
 #include <uta_opspace/ControllerNG.hpp>
+#include <uta_opspace/SessionRecorder.hpp>
 #include <wbc_core/opspace_param_callbacks.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <err.h>
@@ -88,6 +93,9 @@ static shared_ptr<opspace::ReflectionRegistry> registry;
 static long long servo_rate;
 static shared_ptr<ParamCallbacks> param_cbs;
 static shared_ptr<ControllerNG> controller;
+static shared_ptr<SessionRecorder> recorder;
+static string session_file("");
+static long long servo_tick(0);
 
 
 static void usage(int ecode, std::string msg)
@@ -99,7 +107,9 @@ static void usage(int ecode, std::string msg)
        "  -v               verbose mode\n"
        "  -r  <filename>   robot specification (SAI XML format)\n"
        "  -f  <frequency>  servo rate (integer number in Hz, default 500Hz)\n"
-       "  -s  <filename>   skill specification (YAML file with tasks etc)",
+       "  -s  <filename>   skill specification (YAML file with tasks etc)\n"
+       "  -R  <filename>   record the session to this file, for offline replay\n"
+       "                   with wbc_replay -1",
        msg.c_str());
 }
 
@@ -118,7 +128,7 @@ static void parse_options(int argc, char ** argv)
       switch (argv[ii][1]) {
 	
       case 'h':
-	usage(EXIT_SUCCESS, "servo [-h] [-v] [-s skillspec] -r robotspec");
+	usage(EXIT_SUCCESS, "servo [-h] [-v] [-s skillspec] [-R session] -r robotspec");
 	
       case 'v':
 	verbose = true;
@@ -157,6 +167,14 @@ static void parse_options(int argc, char ** argv)
 	skill_spec = argv[ii];
  	break;
 	
+      case 'R':
+ 	++ii;
+ 	if (ii >= argc) {
+	  usage(EXIT_FAILURE, "-R requires parameter");
+ 	}
+	session_file = argv[ii];
+ 	break;
+	
       default:
 	usage(EXIT_FAILURE, "invalid option `" + string(argv[ii]) + "'");
       }
@@ -259,6 +277,15 @@ namespace {
 	return -5;
       }
       
+      if (recorder) {
+	status = recorder->open(session_file, state, state.position_.rows(), registry);
+	if ( ! status) {
+	  warnx("Servo::init(): recorder->open() failed: %s", status.errstr.c_str());
+	  skill.reset();
+	  return -6;
+	}
+      }
+      
       return 0;
     }
     
@@ -271,6 +298,7 @@ namespace {
 	return -1;
       }
       
+      long long const t0(rt_get_cpu_time_ns());
       model->update(state);
       
       jspace::Status status(controller->computeCommand(*model, *skill, command));
@@ -279,6 +307,11 @@ namespace {
 	return -2;
       }
       
+      if (recorder) {
+	recorder->recordTick(servo_tick, state, command, rt_get_cpu_time_ns() - t0);
+      }
+      ++servo_tick;
+      
       return 0;
     }
     
@@ -303,6 +336,17 @@ namespace {
     }
   };
   
+  
+  class RecordParameters
+    : public ParamCallbacks::Observer
+  {
+  public:
+    virtual void written(Parameter const * param)
+    {
+      recorder->recordParameter(param);
+    }
+  };
+  
 }
 
 
@@ -325,6 +369,11 @@ int main(int argc, char ** argv)
   Parameter * eepos_actual;
   controller.reset(new ControllerNG("wbc_m3_ctrl::servo"));
   param_cbs.reset(new ParamCallbacks());
+  RecordParameters record_parameters;
+  if ( ! session_file.empty()) {
+    recorder.reset(new SessionRecorder(4096));
+    param_cbs->setObserver(&record_parameters);
+  }
   Servo servo;
   try {
     m2s_fd = wbcnet::create_udp_server(WBC_M3_CTRL_M2S_PORT, AF_UNSPEC);
@@ -424,12 +473,30 @@ int main(int argc, char ** argv)
 	warnx("eepos_goal->set() failed: %s", st.errstr.c_str());
 	ros::shutdown();
       }
+      else if (recorder) {
+	recorder->recordParameter(eepos_goal);
+      }
     }
     
+    if (recorder) {
+      Status const st(recorder->flush());
+      if ( ! st) {
+	warnx("failed to record session: %s", st.errstr.c_str());
+      }
+    }
     ros::spinOnce();
   }
   
   warnx("shutting down");
   close(m2s_fd);
   servo.shutdown();
+  if (recorder) {
+    param_cbs->setObserver(0);
+    Status const st(recorder->close());
+    if ( ! st) {
+      warnx("failed to record session: %s", st.errstr.c_str());
+    }
+    warnx("recorded %lld ticks to %s (%lld dropped)",
+	  recorder->getNRecorded(), session_file.c_str(), recorder->getNDropped());
+  }
 }
@@ -26,6 +26,9 @@
 
 #include <ros/ros.h>
 #include <jspace/tao_dump.hpp>
+#include <jspace/tao_util.hpp>
+#include <jspace/model_cache.hpp>
+#include <jspace/constraint_library.hpp>
 #include <wbc_urdf/Model.hpp>
 #include <string.h>
 #include <errno.h>
@@ -40,13 +43,22 @@ int main(int argc, char*argv[])
   ros::NodeHandle nn("~");
   
   std::string format("SAI");
-  if (argc > 1) {
-    std::string arg(argv[1]);
+  std::string cache_filename("");
+  for (int iopt(1); iopt < argc; ++iopt) {
+    std::string arg(argv[iopt]);
     if (arg == "-l") {
       format = "Lotus";
     }
+    else if (arg == "-c") {
+      ++iopt;
+      if (iopt >= argc) {
+	errx(EXIT_FAILURE, "`-c' requires a file name for the binary model cache");
+      }
+      cache_filename = argv[iopt];
+    }
     else {
-      errx(EXIT_FAILURE, "invalid argument `%s', use `-l' to select Lotus format instead of SAI", argv[1]);
+      errx(EXIT_FAILURE, "invalid argument `%s', use `-l' to select Lotus format instead of SAI"
+	   " and `-c <file>' to also write a binary model cache", argv[iopt]);
     }
   }
   
@@ -77,6 +89,22 @@ int main(int argc, char*argv[])
     close(tmpfd);
     
     cout << "wrote the TAO tree in " << format << "  format to " << tmpname << "\n";
+    
+    if ( ! cache_filename.empty()) {
+      // hash the URDF string, so that loaders can tell when the
+      // robot description on the parameter server has changed
+      std::string urdf;
+      if ( ! nn.getParam("/robot_description", urdf)) {
+	throw runtime_error("could not get /robot_description for hashing");
+      }
+      jspace::Status const st(jspace::write_model_cache(cache_filename, jspace::compute_model_hash(urdf),
+							 *jspace_ros_model.tao_trees_[0],
+							 jspace::constraint_spec_s()));
+      if ( ! st) {
+	throw runtime_error("write_model_cache(): " + st.errstr);
+      }
+      cout << "wrote the binary model cache to " << cache_filename << "\n";
+    }
   }
   catch (exception const & ee) {
     ROS_ERROR ("EXCEPTION %s", ee.what());
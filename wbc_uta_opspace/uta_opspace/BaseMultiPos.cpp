@@ -16,12 +16,17 @@ namespace uta_opspace {
       threshold_(-1),
       vel_threshold_(-1),
       cur_row_(0),
-      forward_(true)
+      forward_(true),
+      blend_(0),
+      dt_seconds_(-1),
+      trj_(0),
+      trj_time_(0)
     {
       declareSlot("eepos", &ee_task_);
       declareParameter("eepos", &ee_pos_);
       declareParameter("threshold", &threshold_);
       declareParameter("vel_threshold", &vel_threshold_);
+      declareParameter("blend", &blend_);
   }
 
  Status BaseMultiPos::
@@ -69,9 +74,48 @@ namespace uta_opspace {
    st = ee_goal_->set(cur_eepos);
    if (!st) { return st; }
 
+   if (blend_) {
+     st = initBlend();
+   }
+
    return st;
   }
 
+
+  Status BaseMultiPos::
+  initBlend()
+  {
+    Parameter const * dt(ee_task_->lookupParameter("dt_seconds", PARAMETER_TYPE_REAL));
+    Parameter const * maxvel(ee_task_->lookupParameter("maxvel", PARAMETER_TYPE_VECTOR));
+    Parameter const * maxacc(ee_task_->lookupParameter("maxacc", PARAMETER_TYPE_VECTOR));
+    if (( ! dt) || ( ! maxvel) || ( ! maxacc)) {
+      return Status(false, "ee_task needs dt_seconds, maxvel, and maxacc for blending");
+    }
+    dt_seconds_ = *dt->getReal();
+
+    int const nrows(ee_pos_.rows() / 3);
+    Status st(approach_.compute(ee_task_->getActual(), ee_pos_,
+				*maxvel->getVector(), *maxacc->getVector()));
+    if ( ! st) { return st; }
+    if (nrows > 1) {
+      Vector reversed(ee_pos_.rows());
+      for (int ii(0); ii < nrows; ++ii) {
+	reversed.segment(3 * ii, 3) = ee_pos_.segment(3 * (nrows - 1 - ii), 3);
+      }
+      st = forward_trj_.compute(ee_pos_.segment(0, 3), ee_pos_.segment(3, 3 * (nrows - 1)),
+				*maxvel->getVector(), *maxacc->getVector());
+      if ( ! st) { return st; }
+      st = backward_trj_.compute(reversed.segment(0, 3), reversed.segment(3, 3 * (nrows - 1)),
+				 *maxvel->getVector(), *maxacc->getVector());
+      if ( ! st) { return st; }
+    }
+
+    trj_ = &approach_;
+    trj_time_ = 0;
+    forward_ = true;
+    return ee_goal_->set(Vector(ee_pos_.segment(3 * (nrows - 1), 3)));
+  }
+
  Status BaseMultiPos::
   update(Model const & model)
   {
@@ -82,24 +126,37 @@ namespace uta_opspace {
 
     size_t ndof(model.getUnconstrainedNDOF());
 
+    if (blend_) {
+      trj_time_ += dt_seconds_;
+      Vector pos, vel, acc;
+      trj_->evaluate(trj_time_, pos, vel, acc);
+      st = ee_task_->stream(pos, vel, acc);
+      if ( ! st) { return st; }
+    }
+
     for (size_t ii(0); ii < task_table_.size(); ++ii) {
       st = task_table_[ii]->update(model);
       if ( ! st) { return st; }
     }
+
+    if (blend_) {
+      int const nrows(ee_pos_.rows() / 3);
+      if ((nrows > 1) && (trj_time_ >= trj_->getDuration())) {
+	forward_ = ! forward_;
+	trj_ = forward_ ? &forward_trj_ : &backward_trj_;
+	cur_row_ = forward_ ? nrows - 1 : 0;
+	trj_time_ = 0;
+	st = ee_goal_->set(Vector(ee_pos_.segment(3 * cur_row_, 3)));
+      }
+      return st;
+    }
+
     for(int ii=0; ii<3; ii++) {
       cur_eepos[ii] = ee_pos_[3*cur_row_+ii];
     }
     
     delta = cur_eepos - ee_task_->getActual();
-    jspace::Constraint* constraint = model.getConstraint();
-    if (constraint) {
-      jspace::State fullState(model.getNDOF(),model.getNDOF(),6);
-      constraint->getFullState(model.getState(),fullState);
-      v_delta = ee_task_->getJacobian()*fullState.velocity_;
-    }
-    else {
-      v_delta = ee_task_->getJacobian()*model.getState().velocity_;
-    }
+    v_delta = ee_task_->getJacobian() * model.getFullState().velocity_;
     
     if (delta.norm() < threshold_ && v_delta.norm() < vel_threshold_) {
       if(forward_) {
@@ -28,12 +28,19 @@
 
 #include <opspace/Skill.hpp>
 #include <opspace/task_library.hpp>
+#include <opspace/ViaPointTrajectory.hpp>
 
 namespace uta_opspace {
   
   using namespace opspace;
   
   
+  /**
+     Drives the base back and forth through the eepos points, either
+     stopping at each of them (the default) or, with a non-zero blend
+     parameter, along ViaPointTrajectory passes which do not stop
+     until the end of the list. See also CartMultiPos.
+  */
   class BaseMultiPos
     : public Skill
   {
@@ -62,6 +69,15 @@ namespace uta_opspace {
     int cur_row_;
     bool forward_;
     
+    int blend_;
+    double dt_seconds_;
+    ViaPointTrajectory approach_;
+    ViaPointTrajectory forward_trj_;
+    ViaPointTrajectory backward_trj_;
+    ViaPointTrajectory const * trj_;
+    double trj_time_;
+    
+    Status initBlend();
   };
   
 }
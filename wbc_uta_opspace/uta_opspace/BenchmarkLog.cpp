@@ -0,0 +1,267 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include "BenchmarkLog.hpp"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+static string json_escape(string const & str)
+{
+  string result;
+  for (size_t ii(0); ii < str.size(); ++ii) {
+    char const cc(str[ii]);
+    if (('"' == cc) || ('\\' == cc)) {
+      result += '\\';
+      result += cc;
+    }
+    else if (cc < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", (int) cc);
+      result += buf;
+    }
+    else {
+      result += cc;
+    }
+  }
+  return result;
+}
+
+
+// Finds `"key": ` in the line and reads whatever follows it. Strings
+// are returned without their quotes (escapes are not resolved, our
+// IDs do not need them).
+static bool json_find(string const & line, string const & key, string & value)
+{
+  string const pattern("\"" + key + "\": ");
+  size_t pos(line.find(pattern));
+  if (string::npos == pos) {
+    return false;
+  }
+  pos += pattern.size();
+  if ((pos < line.size()) && ('"' == line[pos])) {
+    size_t const end(line.find('"', pos + 1));
+    if (string::npos == end) {
+      return false;
+    }
+    value = line.substr(pos + 1, end - pos - 1);
+    return true;
+  }
+  size_t const end(line.find_first_of(",}", pos));
+  value = line.substr(pos, end - pos);
+  return true;
+}
+
+
+namespace uta_opspace {
+
+
+  BenchmarkLog::
+  BenchmarkLog(std::string const & suite)
+    : suite_(suite)
+  {
+  }
+
+
+  long long BenchmarkLog::
+  getTimeNs()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+  }
+
+
+  benchmark_result_s const & BenchmarkLog::
+  run(std::string const & id,
+      BenchmarkCase & bcase,
+      size_t nsamples,
+      size_t batch)
+  {
+    // warm up, and figure out the batch size if necessary
+    long long const t0(getTimeNs());
+    for (size_t ii(0); ii < 3; ++ii) {
+      bcase.run();
+    }
+    if (0 == batch) {
+      long long const once((getTimeNs() - t0) / 3);
+      batch = 1;
+      if (once < 50000) {
+	batch = 50000 / (once > 0 ? once : 1);
+      }
+    }
+    if (0 == nsamples) {
+      nsamples = 1;
+    }
+
+    vector<double> sample(nsamples);
+    for (size_t is(0); is < nsamples; ++is) {
+      long long const start(getTimeNs());
+      for (size_t ib(0); ib < batch; ++ib) {
+	bcase.run();
+      }
+      sample[is] = double(getTimeNs() - start) / batch;
+    }
+
+    benchmark_result_s result;
+    result.id = id;
+    result.nsamples = nsamples;
+    result.batch = batch;
+    sort(sample.begin(), sample.end());
+    result.min_ns = sample.front();
+    result.max_ns = sample.back();
+    if (0 == nsamples % 2) {
+      result.median_ns = 0.5 * (sample[nsamples / 2 - 1] + sample[nsamples / 2]);
+    }
+    else {
+      result.median_ns = sample[nsamples / 2];
+    }
+    double sum(0);
+    for (size_t is(0); is < nsamples; ++is) {
+      sum += sample[is];
+    }
+    result.mean_ns = sum / nsamples;
+    double sumsq(0);
+    for (size_t is(0); is < nsamples; ++is) {
+      sumsq += pow(sample[is] - result.mean_ns, 2);
+    }
+    result.stddev_ns = sqrt(sumsq / nsamples);
+
+    results_.push_back(result);
+    return results_.back();
+  }
+
+
+  void BenchmarkLog::
+  add(benchmark_result_s const & result)
+  {
+    results_.push_back(result);
+  }
+
+
+  void BenchmarkLog::
+  writeJSON(std::ostream & os) const
+  {
+    char hostname[256];
+    if (0 != gethostname(hostname, sizeof(hostname))) {
+      hostname[0] = '\0';
+    }
+    hostname[sizeof(hostname) - 1] = '\0';
+
+    os << "{\n"
+       << "  \"suite\": \"" << json_escape(suite_) << "\",\n"
+       << "  \"timestamp\": " << time(0) << ",\n"
+       << "  \"hostname\": \"" << json_escape(hostname) << "\",\n"
+       << "  \"results\": [\n";
+    for (size_t ii(0); ii < results_.size(); ++ii) {
+      benchmark_result_s const & rr(results_[ii]);
+      char buf[512];
+      snprintf(buf, sizeof(buf),
+	       "\"nsamples\": %zu, \"batch\": %zu, \"min_ns\": %.1f, \"median_ns\": %.1f,"
+	       " \"mean_ns\": %.1f, \"max_ns\": %.1f, \"stddev_ns\": %.1f",
+	       rr.nsamples, rr.batch, rr.min_ns, rr.median_ns,
+	       rr.mean_ns, rr.max_ns, rr.stddev_ns);
+      os << "    { \"id\": \"" << json_escape(rr.id) << "\", " << buf << " }";
+      if (ii + 1 < results_.size()) {
+	os << ",";
+      }
+      os << "\n";
+    }
+    os << "  ]\n"
+       << "}\n";
+  }
+
+
+  void BenchmarkLog::
+  writeSummary(std::ostream & os) const
+  {
+    size_t width(0);
+    for (size_t ii(0); ii < results_.size(); ++ii) {
+      width = max(width, results_[ii].id.size());
+    }
+    for (size_t ii(0); ii < results_.size(); ++ii) {
+      benchmark_result_s const & rr(results_[ii]);
+      char buf[256];
+      snprintf(buf, sizeof(buf), "  median %12.3f us  min %12.3f us  stddev %10.3f us",
+	       1e-3 * rr.median_ns, 1e-3 * rr.min_ns, 1e-3 * rr.stddev_ns);
+      os << rr.id << string(width - rr.id.size(), ' ') << buf << "\n";
+    }
+  }
+
+
+  bool BenchmarkLog::
+  readBaseline(std::istream & is,
+	       std::map<std::string, double> & median_ns)
+  {
+    bool found(false);
+    string line;
+    while (getline(is, line)) {
+      string id, median;
+      if (json_find(line, "id", id) && json_find(line, "median_ns", median)) {
+	istringstream ms(median);
+	double value;
+	if (ms >> value) {
+	  median_ns[id] = value;
+	  found = true;
+	}
+      }
+    }
+    return found;
+  }
+
+
+  size_t BenchmarkLog::
+  compare(std::map<std::string, double> const & baseline,
+	  double tolerance,
+	  std::ostream & os) const
+  {
+    size_t nregressions(0);
+    for (size_t ii(0); ii < results_.size(); ++ii) {
+      benchmark_result_s const & rr(results_[ii]);
+      map<string, double>::const_iterator ib(baseline.find(rr.id));
+      if ((baseline.end() == ib) || (ib->second <= 0)) {
+	continue;
+      }
+      double const ratio(rr.median_ns / ib->second);
+      char buf[128];
+      snprintf(buf, sizeof(buf), " %12.3f us -> %12.3f us  (x%.3f)",
+	       1e-3 * ib->second, 1e-3 * rr.median_ns, ratio);
+      os << rr.id << buf;
+      if (ratio > 1.0 + tolerance) {
+	os << "  REGRESSION";
+	++nregressions;
+      }
+      os << "\n";
+    }
+    return nregressions;
+  }
+
+}
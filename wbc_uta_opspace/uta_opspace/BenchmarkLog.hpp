@@ -0,0 +1,137 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef UTA_OPSPACE_BENCHMARK_LOG_HPP
+#define UTA_OPSPACE_BENCHMARK_LOG_HPP
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace uta_opspace {
+
+
+  /**
+     Something that can be timed by BenchmarkLog::run(). Subclasses
+     put all the setup into their constructor and only the code that
+     should be measured into run(), which gets called many times in a
+     row and thus has to be idempotent (or at least cyclic, e.g. a
+     trajectory that flips its goal whenever it gets there).
+  */
+  class BenchmarkCase
+  {
+  public:
+    virtual ~BenchmarkCase() {}
+    virtual void run() = 0;
+  };
+
+
+  /**
+     Timing statistics of one benchmark case. All durations are per
+     call of BenchmarkCase::run(), in nanoseconds.
+  */
+  struct benchmark_result_s {
+    std::string id;
+    size_t nsamples;
+    size_t batch;
+    double min_ns;
+    double median_ns;
+    double mean_ns;
+    double max_ns;
+    double stddev_ns;
+  };
+
+
+  /**
+     Runs BenchmarkCase instances, accumulates their timing
+     statistics, and writes them out in a machine-readable JSON
+     format. Each result has a unique string ID such as
+     "dreamer/model.update", which is used to match it against a
+     previously recorded baseline when you want to check for
+     performance regressions between commits.
+
+     \note The JSON writer puts each result on a line of its own, and
+     readBaseline() relies on that, so it is not a general JSON
+     parser. Feed it files written by writeJSON().
+  */
+  class BenchmarkLog
+  {
+  public:
+    explicit BenchmarkLog(std::string const & suite);
+
+    /** Monotonic wall-clock time in nanoseconds. */
+    static long long getTimeNs();
+
+    /**
+       Time a benchmark case. It is first run a few times to warm up
+       caches, then nsamples measurements are taken, each of which
+       calls bcase.run() batch times in a row. If batch is zero, it
+       gets chosen such that each sample takes roughly 50
+       microseconds, which keeps the timer resolution out of the
+       picture for very quick cases.
+    */
+    benchmark_result_s const & run(std::string const & id,
+				   BenchmarkCase & bcase,
+				   size_t nsamples,
+				   size_t batch = 0);
+
+    /** Append a result that was measured by other means. */
+    void add(benchmark_result_s const & result);
+
+    std::vector<benchmark_result_s> const & getResults() const { return results_; }
+
+    void writeJSON(std::ostream & os) const;
+
+    /** Human-readable table, one line per result. */
+    void writeSummary(std::ostream & os) const;
+
+    /**
+       Read the median timings from a file produced by
+       writeJSON(). The given map is not cleared.
+
+       \return False if no result could be found in the stream.
+    */
+    static bool readBaseline(std::istream & is,
+			     std::map<std::string, double> & median_ns);
+
+    /**
+       Compare the median timings against a baseline, writing a line
+       for each result that has a baseline entry. Results which are
+       more than tolerance (relative, e.g. 0.1 for 10%) slower than
+       the baseline are flagged as regressions.
+
+       \return The number of regressions.
+    */
+    size_t compare(std::map<std::string, double> const & baseline,
+		   double tolerance,
+		   std::ostream & os) const;
+
+  protected:
+    std::string const suite_;
+    std::vector<benchmark_result_s> results_;
+  };
+
+}
+
+#endif // UTA_OPSPACE_BENCHMARK_LOG_HPP
@@ -5,6 +5,17 @@
 
 using boost::shared_ptr;
 
+
+namespace {
+
+  jspace::Status set_row(opspace::Parameter * goal, jspace::Vector const & rows, size_t ndim, int row)
+  {
+    return goal->set(jspace::Vector(rows.segment(ndim * row, ndim)));
+  }
+
+}
+
+
 namespace uta_opspace {
 
 
@@ -18,7 +29,11 @@ namespace uta_opspace {
       threshold_(-1),
       vel_threshold_(-1),
       cur_row_(0),
-      forward_(true)
+      forward_(true),
+      blend_(0),
+      dt_seconds_(-1),
+      trj_(0),
+      trj_time_(0)
     {
       declareSlot("eepos", &ee_task_);
       declareSlot("posture", &posture_);
@@ -26,6 +41,7 @@ namespace uta_opspace {
       declareParameter("posture", &posture_pos_);
       declareParameter("threshold", &threshold_);
       declareParameter("vel_threshold", &vel_threshold_);
+      declareParameter("blend", &blend_);
   }
 
  Status CartMultiPos::
@@ -98,9 +114,62 @@ namespace uta_opspace {
    st = posture_goal_->set(cur_posture);
    if (!st) { return st; }
 
+   if (blend_) {
+     st = initBlend();
+   }
+
    return st;
   }
 
+
+  Status CartMultiPos::
+  initBlend()
+  {
+    Parameter const * dt(ee_task_->lookupParameter("dt_seconds", PARAMETER_TYPE_REAL));
+    Parameter const * maxvel(ee_task_->lookupParameter("maxvel", PARAMETER_TYPE_VECTOR));
+    Parameter const * maxacc(ee_task_->lookupParameter("maxacc", PARAMETER_TYPE_VECTOR));
+    if (( ! dt) || ( ! maxvel) || ( ! maxacc)) {
+      return Status(false, "ee_task needs dt_seconds, maxvel, and maxacc for blending");
+    }
+    dt_seconds_ = *dt->getReal();
+
+    int const nrows(ee_pos_.rows() / 3);
+    Status st(approach_.compute(ee_task_->getActual(), ee_pos_,
+				*maxvel->getVector(), *maxacc->getVector()));
+    if ( ! st) { return st; }
+    if (nrows > 1) {
+      Vector reversed(ee_pos_.rows());
+      for (int ii(0); ii < nrows; ++ii) {
+	reversed.segment(3 * ii, 3) = ee_pos_.segment(3 * (nrows - 1 - ii), 3);
+      }
+      st = forward_trj_.compute(ee_pos_.segment(0, 3), ee_pos_.segment(3, 3 * (nrows - 1)),
+				*maxvel->getVector(), *maxacc->getVector());
+      if ( ! st) { return st; }
+      st = backward_trj_.compute(reversed.segment(0, 3), reversed.segment(3, 3 * (nrows - 1)),
+				 *maxvel->getVector(), *maxacc->getVector());
+      if ( ! st) { return st; }
+    }
+
+    trj_ = &approach_;
+    trj_time_ = 0;
+    forward_ = true;
+    return set_row(ee_goal_, ee_pos_, 3, nrows - 1);
+  }
+
+
+  int CartMultiPos::
+  getBlendRow() const
+  {
+    int const target(trj_->getTarget(trj_time_));
+    if (trj_ == &approach_) {
+      return (target > 0) ? target - 1 : 0;
+    }
+    if (trj_ == &forward_trj_) {
+      return target;
+    }
+    return ee_pos_.rows() / 3 - 1 - target;
+  }
+
  Status CartMultiPos::
   update(Model const & model)
   {
@@ -111,24 +180,48 @@ namespace uta_opspace {
 
     size_t ndof(model.getUnconstrainedNDOF());
 
+    if (blend_) {
+      trj_time_ += dt_seconds_;
+      Vector pos, vel, acc;
+      trj_->evaluate(trj_time_, pos, vel, acc);
+      st = ee_task_->stream(pos, vel, acc);
+      if ( ! st) { return st; }
+      int const row(getBlendRow());
+      if (row != cur_row_) {
+	cur_row_ = row;
+	st = set_row(posture_goal_, posture_pos_, ndof, cur_row_);
+	if ( ! st) { return st; }
+      }
+    }
+
     for (size_t ii(0); ii < task_table_.size(); ++ii) {
       st = task_table_[ii]->update(model);
       if ( ! st) { return st; }
     }
+
+    if (blend_) {
+      int const nrows(ee_pos_.rows() / 3);
+      if ((nrows > 1) && (trj_time_ >= trj_->getDuration())) {
+	if (forward_) {
+	  trj_ = &backward_trj_;
+	  st = set_row(ee_goal_, ee_pos_, 3, 0);
+	}
+	else {
+	  trj_ = &forward_trj_;
+	  st = set_row(ee_goal_, ee_pos_, 3, nrows - 1);
+	}
+	forward_ = ! forward_;
+	trj_time_ = 0;
+      }
+      return st;
+    }
+
     for(int ii=0; ii<3; ii++) {
       cur_eepos[ii] = ee_pos_[3*cur_row_+ii];
     }
     
     delta = cur_eepos - ee_task_->getActual();
-    jspace::Constraint* constraint = model.getConstraint();
-    if (constraint) {
-      jspace::State fullState(model.getNDOF(),model.getNDOF(),6);
-      constraint->getFullState(model.getState(),fullState);
-      v_delta = ee_task_->getJacobian()*fullState.velocity_;
-    }
-    else {
-      v_delta = ee_task_->getJacobian()*model.getState().velocity_;
-    }
+    v_delta = ee_task_->getJacobian() * model.getFullState().velocity_;
     
     if (delta.norm() < threshold_ && v_delta.norm() < vel_threshold_) {
       if(forward_) {
@@ -28,12 +28,21 @@
 
 #include <opspace/Skill.hpp>
 #include <opspace/task_library.hpp>
+#include <opspace/ViaPointTrajectory.hpp>
 
 namespace uta_opspace {
   
   using namespace opspace;
   
   
+  /**
+     Moves the end effector back and forth through the eepos points,
+     switching the posture along with them. By default, it waits at
+     each point until the distance and velocity fall below threshold
+     and vel_threshold. With a non-zero blend parameter, it instead
+     follows a ViaPointTrajectory which passes the points without
+     stopping. The trajectories get computed by init().
+  */
   class CartMultiPos
     : public Skill
   {
@@ -65,6 +74,16 @@ namespace uta_opspace {
     int cur_row_;
     bool forward_;
     
+    int blend_;
+    double dt_seconds_;
+    ViaPointTrajectory approach_; // from the initial position through all points
+    ViaPointTrajectory forward_trj_;
+    ViaPointTrajectory backward_trj_;
+    ViaPointTrajectory const * trj_;
+    double trj_time_;
+    
+    Status initBlend();
+    int getBlendRow() const;
   };
   
 }
@@ -0,0 +1,551 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include "ControllerHQP.hpp"
+#include <jspace/Model.hpp>
+#include <limits>
+#include <cmath>
+
+namespace {
+  
+  double const inf(std::numeric_limits<double>::infinity());
+  
+  // Relative to the largest row, rows of J_k Z below this are taken
+  // to be dependent when computing the nullspace for the next level.
+  double const rank_tolerance(1e-9);
+  
+}
+
+namespace uta_opspace {
+  
+  
+  ControllerHQP::
+  ControllerHQP(std::string const & name)
+    : Controller(name),
+      damping_(1e-6),
+      horizon_(0.05),
+      nactive_(0),
+      niterations_(0),
+      nlevels_(0),
+      ndof_(0),
+      max_task_dim_(0),
+      nrows_(0)
+  {
+    declareParameter("damping", &damping_);
+    declareParameter("horizon", &horizon_);
+    declareParameter("joint_lower", &joint_lower_);
+    declareParameter("joint_upper", &joint_upper_);
+    declareParameter("velocity_limit", &velocity_limit_);
+    declareParameter("torque_limit", &torque_limit_);
+    declareParameter("gamma", &gamma_, PARAMETER_FLAG_READONLY);
+    declareParameter("qdd", &qdd_, PARAMETER_FLAG_READONLY);
+    declareParameter("nactive", &nactive_, PARAMETER_FLAG_READONLY);
+    declareParameter("niterations", &niterations_, PARAMETER_FLAG_READONLY);
+    declareParameter("nlevels", &nlevels_, PARAMETER_FLAG_READONLY);
+  }
+  
+  
+  Status ControllerHQP::
+  check(double const * param, double value) const
+  {
+    if ((param == &damping_) && (value <= 0)) {
+      return Status(false, "damping must be positive");
+    }
+    if ((param == &horizon_) && (value <= 0)) {
+      return Status(false, "horizon must be positive");
+    }
+    Status ok;
+    return ok;
+  }
+  
+  
+  Status ControllerHQP::
+  check(Vector const * param, Vector const & value) const
+  {
+    if ((param == &velocity_limit_) || (param == &torque_limit_)) {
+      for (int ii(0); ii < value.rows(); ++ii) {
+	if (value[ii] < 0) {
+	  return Status(false, "velocity and torque limits must be non-negative");
+	}
+      }
+    }
+    Status ok;
+    return ok;
+  }
+  
+  
+  Status ControllerHQP::
+  init(Model const & model)
+  {
+    if (model.getConstraint()) {
+      return Status(false, "constrained models are not supported (yet)");
+    }
+    ndof_ = model.getNDOF();
+    
+    if ((0 == joint_lower_.rows()) && (0 == joint_upper_.rows())) {
+      model.getJointLimits(joint_lower_, joint_upper_);
+      for (size_t ii(0); ii < ndof_; ++ii) {
+	if (joint_lower_[ii] >= joint_upper_[ii]) {
+	  // the model does not know the limits of this joint
+	  joint_lower_[ii] = -inf;
+	  joint_upper_[ii] = inf;
+	}
+      }
+    }
+    if ((ndof_ != static_cast<size_t>(joint_lower_.rows()))
+	|| (ndof_ != static_cast<size_t>(joint_upper_.rows()))) {
+      return Status(false, "joint_lower and joint_upper must both have one entry per DOF");
+    }
+    if ((0 != velocity_limit_.rows())
+	&& (ndof_ != static_cast<size_t>(velocity_limit_.rows()))) {
+      return Status(false, "velocity_limit must be empty or have one entry per DOF");
+    }
+    if ((0 != torque_limit_.rows())
+	&& (ndof_ != static_cast<size_t>(torque_limit_.rows()))) {
+      return Status(false, "torque_limit must be empty or have one entry per DOF");
+    }
+    
+    C0_ = Matrix::Zero(4 * ndof_, ndof_);
+    c0_ = Vector::Zero(4 * ndof_);
+    nrows_ = 0;
+    mass_ = Matrix::Zero(ndof_, ndof_);
+    grav_ = Vector::Zero(ndof_);
+    bias_ = Vector::Zero(ndof_);
+    ZZ_ = Matrix::Zero(ndof_, ndof_);
+    ZZnext_ = Matrix::Zero(ndof_, ndof_);
+    AZ_ = Matrix::Zero(ndof_, ndof_);
+    QQ_ = Matrix::Zero(ndof_, ndof_);
+    tmp_ = Vector::Zero(ndof_);
+    gamma_ = Vector::Zero(ndof_);
+    qdd_ = Vector::Zero(ndof_);
+    
+    // the rest depends on the task table
+    qp_.clear();
+    max_task_dim_ = 0;
+    JZ_.resize(0, 0);
+    err_.resize(0);
+    
+    Status ok;
+    return ok;
+  }
+  
+  
+  Status ControllerHQP::
+  allocate(size_t nlevels, size_t max_task_dim)
+  {
+    if (0 == ndof_) {
+      return Status(false, "not initialized");
+    }
+    if (qp_.size() < nlevels) {
+      size_t const old(qp_.size());
+      qp_.resize(nlevels);
+      for (size_t ii(old); ii < nlevels; ++ii) {
+	qp_[ii].init(ndof_, 0, C0_.rows());
+      }
+    }
+    if (max_task_dim_ < max_task_dim) {
+      max_task_dim_ = max_task_dim;
+      JZ_ = Matrix::Zero(max_task_dim_, ndof_);
+      err_ = Vector::Zero(max_task_dim_);
+    }
+    Status ok;
+    return ok;
+  }
+  
+  
+  void ControllerHQP::
+  updateBounds(Model const & model)
+  {
+    Vector const & qq(model.getState().position_);
+    Vector const & qd(model.getState().velocity_);
+    double const h2(2.0 / (horizon_ * horizon_));
+    
+    // The number and order of rows only depends on which limits are
+    // given, which keeps the QP warm starts meaningful.
+    nrows_ = 0;
+    for (size_t ii(0); ii < ndof_; ++ii) {
+      double lo(-inf);
+      double hi(inf);
+      if (joint_lower_[ii] > -inf) {
+	lo = h2 * (joint_lower_[ii] - qq[ii] - qd[ii] * horizon_);
+      }
+      if (joint_upper_[ii] < inf) {
+	hi = h2 * (joint_upper_[ii] - qq[ii] - qd[ii] * horizon_);
+      }
+      if (0 != velocity_limit_.rows()) {
+	double const vlo((- velocity_limit_[ii] - qd[ii]) / horizon_);
+	double const vhi((velocity_limit_[ii] - qd[ii]) / horizon_);
+	if (vlo > lo) {
+	  lo = vlo;
+	}
+	if (vhi < hi) {
+	  hi = vhi;
+	}
+      }
+      if (lo > hi) {
+	// e.g. beyond a position limit at more than the velocity
+	// limit, split the difference rather than give up
+	lo = 0.5 * (lo + hi);
+	hi = lo;
+      }
+      if (lo > -inf) {
+	C0_.row(nrows_).setZero();
+	C0_.coeffRef(nrows_, ii) = 1;
+	c0_.coeffRef(nrows_) = lo;
+	++nrows_;
+      }
+      if (hi < inf) {
+	C0_.row(nrows_).setZero();
+	C0_.coeffRef(nrows_, ii) = -1;
+	c0_.coeffRef(nrows_) = -hi;
+	++nrows_;
+      }
+    }
+    
+    if (0 != torque_limit_.rows()) {
+      for (size_t ii(0); ii < ndof_; ++ii) {
+	for (size_t jj(0); jj < ndof_; ++jj) {
+	  C0_.coeffRef(nrows_, jj) = mass_.coeff(ii, jj);
+	  C0_.coeffRef(nrows_ + 1, jj) = - mass_.coeff(ii, jj);
+	}
+	c0_.coeffRef(nrows_) = - torque_limit_[ii] - bias_[ii];
+	c0_.coeffRef(nrows_ + 1) = - torque_limit_[ii] + bias_[ii];
+	nrows_ += 2;
+      }
+    }
+  }
+  
+  
+  size_t ControllerHQP::
+  updateNullspace(size_t nz, size_t mm, double tolerance)
+  {
+    // Orthonormal basis of the rows of JZ (in the first rank columns
+    // of QQ), by modified Gram-Schmidt with re-orthogonalization.
+    double maxnorm(0);
+    for (size_t rr(0); rr < mm; ++rr) {
+      double nn(0);
+      for (size_t ii(0); ii < nz; ++ii) {
+	nn += JZ_.coeff(rr, ii) * JZ_.coeff(rr, ii);
+      }
+      if (nn > maxnorm) {
+	maxnorm = nn;
+      }
+    }
+    double const threshold(tolerance * sqrt(maxnorm));
+    
+    size_t rank(0);
+    for (size_t rr(0); (rr < mm) && (rank < nz); ++rr) {
+      for (size_t ii(0); ii < nz; ++ii) {
+	QQ_.coeffRef(ii, rank) = JZ_.coeff(rr, ii);
+      }
+      for (size_t pass(0); pass < 2; ++pass) {
+	for (size_t bb(0); bb < rank; ++bb) {
+	  double dot(0);
+	  for (size_t ii(0); ii < nz; ++ii) {
+	    dot += QQ_.coeff(ii, bb) * QQ_.coeff(ii, rank);
+	  }
+	  for (size_t ii(0); ii < nz; ++ii) {
+	    QQ_.coeffRef(ii, rank) -= dot * QQ_.coeff(ii, bb);
+	  }
+	}
+      }
+      double nn(0);
+      for (size_t ii(0); ii < nz; ++ii) {
+	nn += QQ_.coeff(ii, rank) * QQ_.coeff(ii, rank);
+      }
+      nn = sqrt(nn);
+      if (nn > threshold) {
+	for (size_t ii(0); ii < nz; ++ii) {
+	  QQ_.coeffRef(ii, rank) /= nn;
+	}
+	++rank;
+      }
+    }
+    
+    // Complete the basis with whichever unit vector has the largest
+    // component outside of what we have so far. The new columns span
+    // the nullspace of JZ.
+    for (size_t col(rank); col < nz; ++col) {
+      size_t best(0);
+      double bestnorm(-1);
+      for (size_t ee(0); ee < nz; ++ee) {
+	// |(I - Q Q^T) e|^2 = 1 - sum_b Q(e,b)^2
+	double nn(1);
+	for (size_t bb(0); bb < col; ++bb) {
+	  nn -= QQ_.coeff(ee, bb) * QQ_.coeff(ee, bb);
+	}
+	if (nn > bestnorm) {
+	  bestnorm = nn;
+	  best = ee;
+	}
+      }
+      for (size_t ii(0); ii < nz; ++ii) {
+	QQ_.coeffRef(ii, col) = (ii == best) ? 1 : 0;
+      }
+      for (size_t pass(0); pass < 2; ++pass) {
+	for (size_t bb(0); bb < col; ++bb) {
+	  double proj(0);
+	  for (size_t ii(0); ii < nz; ++ii) {
+	    proj += QQ_.coeff(ii, bb) * QQ_.coeff(ii, col);
+	  }
+	  for (size_t ii(0); ii < nz; ++ii) {
+	    QQ_.coeffRef(ii, col) -= proj * QQ_.coeff(ii, bb);
+	  }
+	}
+      }
+      double nn(0);
+      for (size_t ii(0); ii < nz; ++ii) {
+	nn += QQ_.coeff(ii, col) * QQ_.coeff(ii, col);
+      }
+      nn = sqrt(nn);
+      for (size_t ii(0); ii < nz; ++ii) {
+	QQ_.coeffRef(ii, col) /= nn;
+      }
+    }
+    
+    // Z <- Z N
+    size_t const nnext(nz - rank);
+    for (size_t ii(0); ii < ndof_; ++ii) {
+      for (size_t jj(0); jj < nnext; ++jj) {
+	double sum(0);
+	for (size_t kk(0); kk < nz; ++kk) {
+	  sum += ZZ_.coeff(ii, kk) * QQ_.coeff(kk, rank + jj);
+	}
+	ZZnext_.coeffRef(ii, jj) = sum;
+      }
+    }
+    for (size_t ii(0); ii < ndof_; ++ii) {
+      for (size_t jj(0); jj < nnext; ++jj) {
+	ZZ_.coeffRef(ii, jj) = ZZnext_.coeff(ii, jj);
+      }
+    }
+    return nnext;
+  }
+  
+  
+  Status ControllerHQP::
+  computeCommand(Model const & model,
+		 Skill & skill,
+		 Vector & gamma)
+  {
+    if (model.getConstraint()) {
+      return Status(false, "constrained models are not supported (yet)");
+    }
+    
+    Status st(skill.update(model));
+    if ( ! st) {
+      return Status(false, "skill update failed: " + st.errstr);
+    }
+    Skill::task_table_t const * tasks(skill.getTaskTable());
+    if (( ! tasks) || tasks->empty()) {
+      return Status(false, "empty task table");
+    }
+    
+    size_t max_task_dim(0);
+    for (size_t kk(0); kk < tasks->size(); ++kk) {
+      Matrix const & jac((*tasks)[kk]->getJacobian());
+      if (0 == jac.rows()) {
+	continue;
+      }
+      if (ndof_ != static_cast<size_t>(jac.cols())) {
+	return Status(false, "Jacobian of task `" + (*tasks)[kk]->getName()
+		      + "' does not have one column per DOF");
+      }
+      if (static_cast<size_t>(jac.rows()) > max_task_dim) {
+	max_task_dim = jac.rows();
+      }
+    }
+    st = allocate(tasks->size(), max_task_dim);
+    if ( ! st) {
+      return st;
+    }
+    
+    if ( ! model.getMassInertia(mass_)) {
+      return Status(false, "failed to retrieve mass inertia");
+    }
+    if ( ! model.getGravity(grav_)) {
+      return Status(false, "failed to retrieve gravity torques");
+    }
+    
+    // bias = g + sum_k J_k^T f_k
+    for (size_t ii(0); ii < ndof_; ++ii) {
+      bias_.coeffRef(ii) = grav_.coeff(ii);
+    }
+    for (size_t kk(0); kk < tasks->size(); ++kk) {
+      Matrix const & jac((*tasks)[kk]->getJacobian());
+      Vector const & force((*tasks)[kk]->getForce());
+      if ((0 == jac.rows()) || (force.rows() != jac.rows())) {
+	continue;
+      }
+      for (size_t ii(0); ii < ndof_; ++ii) {
+	for (int rr(0); rr < jac.rows(); ++rr) {
+	  bias_.coeffRef(ii) += jac.coeff(rr, ii) * force.coeff(rr);
+	}
+      }
+    }
+    
+    updateBounds(model);
+    
+    for (size_t ii(0); ii < ndof_; ++ii) {
+      for (size_t jj(0); jj < ndof_; ++jj) {
+	ZZ_.coeffRef(ii, jj) = (ii == jj) ? 1 : 0;
+      }
+      qdd_.coeffRef(ii) = 0;
+    }
+    size_t nz(ndof_);
+    nactive_ = 0;
+    niterations_ = 0;
+    nlevels_ = 0;
+    
+    for (size_t kk(0); (kk < tasks->size()) && (nz > 0); ++kk) {
+      Task const * task((*tasks)[kk]);
+      Matrix const & jac(task->getJacobian());
+      Vector const & cmd(task->getCommand());
+      size_t const mm(jac.rows());
+      if (0 == mm) {
+	continue;
+      }
+      if (static_cast<size_t>(cmd.rows()) != mm) {
+	return Status(false, "command of task `" + task->getName()
+		      + "' does not match its Jacobian");
+      }
+      
+      // JZ = J Z, err = cmd - J qdd, AZ = A Z
+      for (size_t rr(0); rr < mm; ++rr) {
+	double jq(0);
+	for (size_t ii(0); ii < ndof_; ++ii) {
+	  jq += jac.coeff(rr, ii) * qdd_.coeff(ii);
+	}
+	err_.coeffRef(rr) = cmd.coeff(rr) - jq;
+	for (size_t jj(0); jj < nz; ++jj) {
+	  double sum(0);
+	  for (size_t ii(0); ii < ndof_; ++ii) {
+	    sum += jac.coeff(rr, ii) * ZZ_.coeff(ii, jj);
+	  }
+	  JZ_.coeffRef(rr, jj) = sum;
+	}
+      }
+      for (size_t ii(0); ii < ndof_; ++ii) {
+	for (size_t jj(0); jj < nz; ++jj) {
+	  double sum(0);
+	  for (size_t ll(0); ll < ndof_; ++ll) {
+	    sum += mass_.coeff(ii, ll) * ZZ_.coeff(ll, jj);
+	  }
+	  AZ_.coeffRef(ii, jj) = sum;
+	}
+      }
+      
+      // min 1/2 |JZ z - err|^2 + 1/2 damping (qdd + Z z)^T A (qdd + Z z)
+      jspace::DenseQP & qp(qp_[kk]);
+      Matrix & hh(qp.getHessian());
+      Vector & ff(qp.getGradient());
+      for (size_t ii(0); ii < nz; ++ii) {
+	for (size_t jj(ii); jj < nz; ++jj) {
+	  double sum(0);
+	  for (size_t rr(0); rr < mm; ++rr) {
+	    sum += JZ_.coeff(rr, ii) * JZ_.coeff(rr, jj);
+	  }
+	  double zaz(0);
+	  for (size_t ll(0); ll < ndof_; ++ll) {
+	    zaz += ZZ_.coeff(ll, ii) * AZ_.coeff(ll, jj);
+	  }
+	  hh.coeffRef(ii, jj) = sum + damping_ * zaz;
+	  hh.coeffRef(jj, ii) = hh.coeff(ii, jj);
+	}
+	double sum(0);
+	for (size_t rr(0); rr < mm; ++rr) {
+	  sum -= JZ_.coeff(rr, ii) * err_.coeff(rr);
+	}
+	double azq(0);
+	for (size_t ll(0); ll < ndof_; ++ll) {
+	  azq += AZ_.coeff(ll, ii) * qdd_.coeff(ll);
+	}
+	ff.coeffRef(ii) = sum + damping_ * azq;
+      }
+      
+      // C0 (qdd + Z z) >= c0
+      Matrix & cin(qp.getInequalityMatrix());
+      Vector & din(qp.getInequalityVector());
+      for (size_t rr(0); rr < nrows_; ++rr) {
+	double cq(0);
+	for (size_t ii(0); ii < ndof_; ++ii) {
+	  cq += C0_.coeff(rr, ii) * qdd_.coeff(ii);
+	}
+	din.coeffRef(rr) = c0_.coeff(rr) - cq;
+	for (size_t jj(0); jj < nz; ++jj) {
+	  double sum(0);
+	  for (size_t ii(0); ii < ndof_; ++ii) {
+	    sum += C0_.coeff(rr, ii) * ZZ_.coeff(ii, jj);
+	  }
+	  cin.coeffRef(rr, jj) = sum;
+	}
+      }
+      
+      st = qp.solve(nz, 0, nrows_);
+      niterations_ += qp.getNIterations();
+      if ( ! st) {
+	return Status(false, "QP of task `" + task->getName() + "' failed: " + st.errstr);
+      }
+      Vector const & zz(qp.getSolution());
+      for (size_t ii(0); ii < ndof_; ++ii) {
+	double sum(0);
+	for (size_t jj(0); jj < nz; ++jj) {
+	  sum += ZZ_.coeff(ii, jj) * zz.coeff(jj);
+	}
+	qdd_.coeffRef(ii) += sum;
+      }
+      nactive_ = qp.getNActive();
+      ++nlevels_;
+      
+      nz = updateNullspace(nz, mm, rank_tolerance);
+    }
+    
+    // gamma = A qdd + g + sum_k J_k^T f_k
+    for (size_t ii(0); ii < ndof_; ++ii) {
+      double sum(bias_.coeff(ii));
+      for (size_t jj(0); jj < ndof_; ++jj) {
+	sum += mass_.coeff(ii, jj) * qdd_.coeff(jj);
+      }
+      gamma_.coeffRef(ii) = sum;
+    }
+    gamma = gamma_;
+    
+    return st;
+  }
+  
+  
+  void ControllerHQP::
+  dbg(std::ostream & os,
+      std::string const & title,
+      std::string const & prefix) const
+  {
+    if ( ! title.empty()) {
+      os << title << "\n";
+    }
+    os << prefix << "levels: " << nlevels_ << "  QP iterations: " << niterations_
+       << "  active bounds (last level): " << nactive_ << "\n"
+       << prefix << "parameters\n";
+    dump(os, "", prefix + "  ");
+  }
+  
+}
@@ -0,0 +1,139 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef UTA_OPSPACE_CONTROLLER_HQP_HPP
+#define UTA_OPSPACE_CONTROLLER_HQP_HPP
+
+#include <opspace/Controller.hpp>
+#include <jspace/DenseQP.hpp>
+#include <vector>
+
+namespace uta_opspace {
+  
+  using namespace opspace;
+  
+  
+  /**
+     Task-priority controller which solves the task hierarchy of a
+     Skill as a sequence of small dense QPs in joint accelerations,
+     one per priority level, with joint position, velocity and torque
+     limits as inequalities that hold at every level.
+     
+     Level k minimizes |J_k qdd - a_k|^2 (a_k being the task command)
+     over the accelerations that keep all higher-priority task
+     accelerations at the values the higher levels achieved, plus a
+     small damping term 1/2 damping qdd^T A qdd which makes each QP
+     strictly convex and picks the dynamically consistent solution
+     for whatever is left redundant at the end. The torque is then
+     gamma = A qdd + g + sum_k J_k^T f_k, where f_k is the optional
+     task force. As long as no inequality is active and every task
+     can be achieved in the nullspace of the ones above it (e.g. the
+     stacked joint tasks of wbc_benchmark), this gives the same
+     torques as ControllerNG. A task that can only be partially
+     achieved is solved in the least-squares sense on accelerations
+     here, whereas ControllerNG weighs it by its task-space inertia,
+     so the two differ in that case.
+     
+     Position and velocity limits are turned into bounds on qdd over
+     the given horizon:
+     
+       (qmin - q - qd h) 2 / h^2 <= qdd <= (qmax - q - qd h) 2 / h^2
+       (-vmax - qd) / h <= qdd <= (vmax - qd) / h
+     
+     and torque limits give the rows -tmax <= A qdd + g + ... <= tmax.
+     An empty limit parameter means no limit of that kind, except
+     joint_lower and joint_upper, which default to the limits of the
+     model (for joints where those are given).
+     
+     Everything is sized in init() from the model and the first task
+     table that comes along, each level has its own jspace::DenseQP
+     whose active set carries over to the next tick. Models with a
+     jspace::Constraint are not supported yet.
+  */
+  class ControllerHQP
+    : public Controller
+  {
+  public:
+    explicit ControllerHQP(std::string const & name);
+    
+    virtual Status init(Model const & model);
+    
+    virtual Status computeCommand(Model const & model,
+				  Skill & skill,
+				  Vector & gamma);
+    
+    virtual Status check(double const * param, double value) const;
+    virtual Status check(Vector const * param, Vector const & value) const;
+    
+    virtual void dbg(std::ostream & os,
+		     std::string const & title,
+		     std::string const & prefix) const;
+    
+    inline Vector const & getCommand() const { return gamma_; }
+    inline Vector const & getAcceleration() const { return qdd_; }
+    
+  protected:
+    // parameters
+    double damping_;
+    double horizon_;
+    Vector joint_lower_;
+    Vector joint_upper_;
+    Vector velocity_limit_;
+    Vector torque_limit_;
+    
+    // read-only, for logging and debugging
+    Vector gamma_;
+    Vector qdd_;
+    int nactive_;		// inequalities active at the last level
+    int niterations_;		// summed over all levels
+    int nlevels_;		// levels that were actually solved
+    
+    size_t ndof_;
+    size_t max_task_dim_;
+    std::vector<jspace::DenseQP> qp_;
+    
+    // Constraint rows in terms of qdd, (C0 qdd >= c0), and the
+    // per-level scratch space. Z spans the accelerations which the
+    // levels solved so far leave free, nz is its current width.
+    Matrix C0_;
+    Vector c0_;
+    size_t nrows_;
+    Matrix mass_;
+    Vector grav_;
+    Vector bias_;
+    Matrix ZZ_;
+    Matrix ZZnext_;
+    Matrix JZ_;
+    Matrix AZ_;
+    Matrix QQ_;
+    Vector err_;
+    Vector tmp_;
+    
+    Status allocate(size_t nlevels, size_t max_task_dim);
+    void updateBounds(Model const & model);
+    size_t updateNullspace(size_t nz, size_t mm, double tolerance);
+  };
+  
+}
+
+#endif // UTA_OPSPACE_CONTROLLER_HQP_HPP
@@ -38,6 +38,176 @@ using boost::shared_ptr;
 
 namespace uta_opspace {
   
+  namespace {
+    
+    typedef enum {
+      HIERARCHY_OK,
+      HIERARCHY_ERROR,		// Status carries the message, no fallback
+      HIERARCHY_FALLBACK	// Status carries the fallback reason
+    } hierarchy_status_t;
+    
+    
+    void task_jstar(Task const * task,
+		    Matrix const & UNcBar,
+		    Matrix const & UNcBar_s,
+		    Matrix & jstar)
+    {
+      jspace::SparseJacobian const * sparse(task->getSparseJacobian());
+      if (sparse) {
+	sparse->multiply(UNcBar, jstar);
+      }
+      else {
+	jstar = task->getJacobian() * UNcBar;
+      }
+    }
+    
+    
+    void task_jstar(Task const * task,
+		    Matrix const & UNcBar,
+		    jspace::MatrixF const & UNcBar_s,
+		    jspace::MatrixF & jstar)
+    {
+      jspace::SparseJacobian const * sparse(task->getSparseJacobian());
+      if (sparse) {
+	// the compact product is cheap enough to do in double
+	Matrix tmp;
+	sparse->multiply(UNcBar, tmp);
+	jstar = tmp.cast<float>();
+      }
+      else {
+	jstar = task->getJacobian().cast<float>() * UNcBar_s;
+      }
+    }
+    
+    
+    /**
+       The task hierarchy part of ControllerNG::computeCommand(), for
+       either double (MatrixT = jspace::Matrix) or single
+       (jspace::MatrixF) precision. Inputs that are the same for all
+       tasks are expected in the target precision already, except for
+       UNcBar which is additionally needed in double for sparse
+       Jacobians. Task Jacobians, commands and forces are converted as
+       they are used.
+       
+       The skill gets to check the singular values of each task only
+       if check_sv is true, so that a second pass over the same tick
+       (the double precision guard) does not call it again.
+    */
+    template<typename MatrixT, typename VectorT>
+    hierarchy_status_t compute_hierarchy(Skill & skill,
+					 Skill::task_table_t const & tasks,
+					 Matrix const & UNcBar,
+					 MatrixT const & UNcBar_s,
+					 MatrixT const & phi,
+					 VectorT const & unc_grav,
+					 size_t nunc,
+					 bool check_sv,
+					 VectorT & gamma,
+					 Vector & actual,
+					 Status & st)
+    {
+      typedef typename MatrixT::Scalar Scalar;
+      
+      size_t const n_minus_1(tasks.size() - 1);
+      MatrixT nstar(MatrixT::Identity(nunc, nunc));
+      int first_active_task_index(0); // because tasks can have empty Jacobian
+      
+      for (size_t ii(0); ii < tasks.size(); ++ii) {
+	
+	Task const * task(tasks[ii]);
+	Matrix const & jac(task->getJacobian());
+	
+	// skip inactive tasks at beginning of table
+	if ((0 == jac.rows()) || (0 == jac.cols())) {
+	  ++first_active_task_index;
+	  if (first_active_task_index >= tasks.size()) {
+	    st = Status(false, "no active tasks (all Jacobians are empty)");
+	    return HIERARCHY_ERROR;
+	  }
+	  continue;
+	}
+	
+	MatrixT jstar;
+	task_jstar(task, UNcBar, UNcBar_s, jstar);
+	if (ii != first_active_task_index) {
+	  jstar = jstar * nstar;
+	}
+	
+	MatrixT jjt(jstar * jstar.transpose());
+	VectorT sv_jstar;
+	
+	if (1 == jjt.rows()) {	// work around limitations of Eigen2 SVD.
+	  sv_jstar = VectorT::Ones(1, 1) * jjt.coeff(0, 0);
+	}
+	else {
+	  //////////////////////////////////////////////////
+	  // If Eigen ends up freeing a non-allocated pointer on the line
+	  // below: that appears to happen on zero-rank matrices when you
+	  // do an SVD (at least that's my best guess while writing this
+	  // comment). Maybe you have a task hierarchy with entries after
+	  // all degrees of freedom have been eaten up, or maybe you have
+	  // a task more than one in the hierarchy. This should not
+	  // trigger a segfault, and/or it should be detected earlier, but
+	  // this effect is a bit obscure for now.
+	  sv_jstar = Eigen::SVD<MatrixT>(jjt).singularValues();
+	}
+	
+	if (check_sv) {
+	  st = skill.checkJStarSV(task, sv_jstar.template cast<double>());
+	  if ( ! st) {
+	    st.errstr = "checkJStarSV failed: " + st.errstr;
+	    return HIERARCHY_FALLBACK;
+	  }
+	}
+	
+	// phi is symmetric, so phijt also gives us jstar * phi
+	MatrixT const phijt(phi * jstar.transpose());
+	MatrixT lstar;
+	jspace::pseudoInverse(jstar * phijt,
+			      Scalar(task->getSigmaThreshold()),
+			      lstar, 0);
+	VectorT pstar;
+	pstar = lstar * (jstar * unc_grav);
+	
+	VectorT force(task->getForce().template cast<Scalar>());
+	if (force.rows() == 0) {
+	  force = VectorT::Zero(jstar.rows());
+	}
+	
+	// could add coriolis-centrifugal just like pstar...
+	if (ii == first_active_task_index) {
+	  // first time around: initialize gamma
+	  gamma = jstar.transpose() * (lstar * task->getCommand().template cast<Scalar>()
+				       + pstar + force);
+	  actual = task->getActual();
+	}
+	else {
+	  VectorT fcomp;
+	  // here, gamma is still at the previous iteration's value
+	  fcomp = lstar * (phijt.transpose() * gamma);
+	  gamma += jstar.transpose() * (lstar * task->getCommand().template cast<Scalar>()
+					+ pstar + force - fcomp);
+	}
+	
+	if (ii != n_minus_1) {
+	  // rank-k update, equivalent to the dense
+	  //   nstar = (I - phi * jstar^T * lstar * jstar) * nstar
+	  // but linear instead of cubic in the number of task dimensions
+	  jspace::updateNullspace(phijt, lstar, jstar, nstar);
+	}
+      }
+      
+      if (tasks.size() <= first_active_task_index) {
+	st = Status(false, "no active tasks");
+	return HIERARCHY_FALLBACK;
+      }
+      
+      return HIERARCHY_OK;
+    }
+    
+  }
+  
+  
   ControllerNG::
   ControllerNG(std::string const & name)
     : Controller(name),
@@ -49,7 +219,15 @@ namespace uta_opspace {
       loglen_(1000),
       logsubsample_(1),
       logprefix_("Ramp_Experiment"),
-      logcount_(0)
+      logcount_(0),
+      single_precision_(0),
+      guard_period_(100),
+      guard_threshold_(0),
+      guard_error_(0),
+      guard_max_error_(0),
+      guard_count_(0),
+      guard_trips_(0),
+      guard_tick_(0)
   {
     declareParameter("loglen", &loglen_, PARAMETER_FLAG_NOLOG);
     declareParameter("logsubsample", &logsubsample_, PARAMETER_FLAG_NOLOG);
@@ -59,6 +237,38 @@ namespace uta_opspace {
     declareParameter("gamma", &gamma_);
     declareParameter("fullJpos", &fullJpos_);
     declareParameter("fullJvel", &fullJvel_);
+    declareParameter("single_precision", &single_precision_);
+    declareParameter("guard_period", &guard_period_);
+    declareParameter("guard_threshold", &guard_threshold_);
+    declareParameter("guard_error", &guard_error_, PARAMETER_FLAG_READONLY);
+    declareParameter("guard_max_error", &guard_max_error_, PARAMETER_FLAG_READONLY);
+    declareParameter("guard_count", &guard_count_, PARAMETER_FLAG_READONLY);
+    declareParameter("guard_trips", &guard_trips_, PARAMETER_FLAG_READONLY);
+  }
+  
+  
+  Status ControllerNG::
+  check(int const * param, int value) const
+  {
+    if ((param == &single_precision_) && (value != 0) && (value != 1)) {
+      return Status(false, "single_precision must be 0 or 1");
+    }
+    if ((param == &guard_period_) && (value < 0)) {
+      return Status(false, "guard_period must be >= 0 (0 disables the guard)");
+    }
+    Status ok;
+    return ok;
+  }
+  
+  
+  Status ControllerNG::
+  check(double const * param, double value) const
+  {
+    if ((param == &guard_threshold_) && (value < 0)) {
+      return Status(false, "guard_threshold must be >= 0 (0 means report only)");
+    }
+    Status ok;
+    return ok;
   }
   
   
@@ -186,154 +396,83 @@ namespace uta_opspace {
       return Status(false, "failed to retrieve gravity torques");
     }
 
+    // The constraint caches its projection per model state, so
+    // anybody else who needs it during this tick gets it for free.
     jspace::Constraint * constraint = model.getConstraint();
-
+    jspace::constraint_projection_s unconstrained;
     if (constraint) {
-      if(!constraint->updateJc(model)) {
-	return Status(false, "failed to update Jc");
-      }
-    }
-
-    Matrix Nc;
-    if (constraint) {
-      if (!constraint->getNc(ainv,Nc)) {
-	return Status(false, "failed to get Nc");
+      st = constraint->updateProjection(model);
+      if ( ! st) {
+	return Status(false, "failed to update constraint projection: " + st.errstr);
       }
     }
     else {
-      Nc = Matrix::Identity(model.getNDOF(),model.getNDOF());
-    }
-
-    Matrix UNc;
-    if (constraint) {
-      Matrix U;
-      if (!constraint->getU(U)) {
-	return Status(false, "failed to get U");
-      }
-      UNc = U*Nc;
+      unconstrained.Nc = Matrix::Identity(model.getNDOF(),model.getNDOF());
+      unconstrained.UNc = unconstrained.Nc;
+      unconstrained.phi = ainv;
+      unconstrained.UNcBar = unconstrained.Nc;
     }
-    else {
-      UNc = Matrix::Identity(model.getNDOF(),model.getNDOF());
-    }  
-
-    Matrix phi(UNc * ainv * UNc.transpose());
+    jspace::constraint_projection_s const &
+      projection(constraint ? constraint->getProjection() : unconstrained);
+    Matrix const & Nc(projection.Nc);
+    Matrix const & UNc(projection.UNc);
     
-
-    Matrix UNcBar;
-    if (constraint) {
-      Matrix phiinv;
-      //XXXX hardcoded sigma threshold
-      jspace::pseudoInverse(phi,
-		    0.0001,
-		    phiinv, 0);
-      UNcBar = ainv * UNc.transpose() * phiinv;
+    // gravity seen through the constraint, same for all tasks
+    Vector const unc_grav(UNc * (ainv * (Nc.transpose() * grav)));
+    
+    size_t const nunc(model.getUnconstrainedNDOF());
+    hierarchy_status_t hst;
+    
+    if ( ! single_precision_) {
+      hst = compute_hierarchy(skill, *tasks, projection.UNcBar, projection.UNcBar,
+			      projection.phi, unc_grav, nunc, true, gamma, actual_, st);
     }
     else {
-      UNcBar = Matrix::Identity(model.getNDOF(),model.getNDOF());
-    }
-
-    size_t const ndof(model.getNDOF());
-    size_t const n_minus_1(tasks->size() - 1);
-    Matrix nstar(Matrix::Identity(model.getUnconstrainedNDOF(), model.getUnconstrainedNDOF()));
-    int first_active_task_index(0); // because tasks can have empty Jacobian
-    
-    for (size_t ii(0); ii < tasks->size(); ++ii) {
-      
-      Task const * task((*tasks)[ii]);
-      Matrix const & jac(task->getJacobian());
-      
-      // skip inactive tasks at beginning of table
-      if ((0 == jac.rows()) || (0 == jac.cols())) {
-	++first_active_task_index;
-	if (first_active_task_index >= tasks->size()) {
-	  return Status(false, "no active tasks (all Jacobians are empty)");
-	}
-	continue;
-      }
-
-      Matrix jstar;
-      if (ii == first_active_task_index) {
-	jstar = jac * UNcBar;
-      }
-      else {
-	jstar = jac * UNcBar * nstar;
-      }
-      
-      Matrix jjt(jstar * jstar.transpose());
-      Vector sv_jstar;
-      
-      if (1 == jjt.rows()) {	// work around limitations of Eigen2 SVD.
-	sv_jstar = Vector::Ones(1, 1) * jjt.coeff(0, 0);
-      }
-      else {
-	//////////////////////////////////////////////////
-	// If Eigen ends up freeing a non-allocated pointer on the line
-	// below: that appears to happen on zero-rank matrices when you
-	// do an SVD (at least that's my best guess while writing this
-	// comment). Maybe you have a task hierarchy with entries after
-	// all degrees of freedom have been eaten up, or maybe you have
-	// a task more than one in the hierarchy. This should not
-	// trigger a segfault, and/or it should be detected earlier, but
-	// this effect is a bit obscure for now.
-	sv_jstar = Eigen::SVD<Matrix>(jjt).singularValues();
-      }
-      
-      st = skill.checkJStarSV(task, sv_jstar);
-      if ( ! st) {
-	fallback_ = true;
-	fallback_reason_ = "checkJStarSV failed: " + st.errstr;
-	return computeFallback(model, true, gamma);
-      }
-      
-      Matrix lstar;
-      jspace::pseudoInverse(jstar * phi * jstar.transpose(),
-		    task->getSigmaThreshold(),
-		    lstar, 0);////&sv_lstar_[ii]);
-      Vector pstar;
-      pstar = lstar * jstar * UNc * ainv * Nc.transpose()* grav;
-
-      Vector force(task->getForce());
-      if (force.rows() == 0) {
-	force = Vector::Zero(jstar.rows());
-      }
-      
-      // could add coriolis-centrifugal just like pstar...
-      if (ii == first_active_task_index) {
-	// first time around: initialize gamma
-	gamma = jstar.transpose() * (lstar * task->getCommand() + pstar + force);
-	actual_ = task->getActual();
-	//gamma = jstar.transpose() * (pstar);
-      }
-      else {
-	Vector fcomp;
-	// here, gamma is still at the previous iteration's value
-	fcomp = lstar * jstar * phi * gamma;
-	gamma += jstar.transpose() * (lstar * task->getCommand() + pstar + force - fcomp);
-      }
-      
-      if (ii != n_minus_1) {
-	// not sure whether Eigen2 correctly handles the case where a
-	// matrix gets updated by left-multiplication...
-	Matrix const
-	  nnext((Matrix::Identity(model.getUnconstrainedNDOF(), model.getUnconstrainedNDOF()) - phi * jstar.transpose() * lstar * jstar) * nstar);
-	nstar = nnext;
-	/*
-	Vector sv_nstar;
-	if (1 == nstar.rows()) {
-	  sv_nstar = Vector::Ones(1, 1) * nstar.coeff(0, 0);
-	}
-	else {
-	  sv_nstar = Eigen::SVD<Matrix>(nstar).singularValues();
+      // Everything that is the same for all tasks gets converted
+      // once. The Model always hands out double, even when TAO was
+      // built with TAO_FLOAT and computed the dynamics in float.
+      jspace::MatrixF const UNcBar_f(projection.UNcBar.cast<float>());
+      jspace::MatrixF const phi_f(projection.phi.cast<float>());
+      jspace::VectorF const unc_grav_f(unc_grav.cast<float>());
+      jspace::VectorF gamma_f;
+      hst = compute_hierarchy(skill, *tasks, projection.UNcBar, UNcBar_f,
+			      phi_f, unc_grav_f, nunc, true, gamma_f, actual_, st);
+      if (HIERARCHY_OK == hst) {
+	gamma = gamma_f.cast<double>();
+	
+	if ((guard_period_ > 0) && (++guard_tick_ >= guard_period_)) {
+	  guard_tick_ = 0;
+	  Vector gamma_d;
+	  Vector actual_d;
+	  Status gst;
+	  // The skill has already seen this tick in the float pass.
+	  if (HIERARCHY_OK == compute_hierarchy(skill, *tasks, projection.UNcBar,
+						projection.UNcBar, projection.phi,
+						unc_grav, nunc, false, gamma_d, actual_d, gst)) {
+	    guard_error_ = (gamma_d - gamma).cwise().abs().maxCoeff();
+	    if (guard_error_ > guard_max_error_) {
+	      guard_max_error_ = guard_error_;
+	    }
+	    ++guard_count_;
+	    if ((guard_threshold_ > 0) && (guard_error_ > guard_threshold_)) {
+	      // The double result is at hand anyway, so send that one
+	      // and stay in double until somebody re-enables float.
+	      ++guard_trips_;
+	      single_precision_ = 0;
+	      gamma = gamma_d;
+	      actual_ = actual_d;
+	    }
+	  }
 	}
-	if (ii == 0) {
-	  jspace::pretty_print(sv_nstar, std::cout, "sv_nstar", "  ");
-	  }*/
       }
     }
     
-    if (tasks->size() <= first_active_task_index) {
+    if (HIERARCHY_ERROR == hst) {
+      return st;
+    }
+    if (HIERARCHY_FALLBACK == hst) {
       fallback_ = true;
-      fallback_reason_ = "no active tasks";
+      fallback_reason_ = st.errstr;
       return computeFallback(model, true, gamma);
     }
     
@@ -357,6 +496,12 @@ namespace uta_opspace {
     os << prefix << "log count: " << logcount_ << "\n"
        << prefix << "parameters\n";
     dump(os, "", prefix + "  ");
+    if (single_precision_ || (guard_count_ > 0)) {
+      os << prefix << "precision: " << (single_precision_ ? "float" : "double") << "\n"
+	 << prefix << "guard: " << guard_count_ << " checks, max |dgamma| "
+	 << guard_max_error_ << ", last " << guard_error_ << ", "
+	 << guard_trips_ << " trips\n";
+    }
     if (fallback_) {
       os << prefix << "# FALLBACK MODE ENABLED ##########################\n"
 	 << prefix << "# reason: " << fallback_reason_ << "\n";
@@ -48,7 +48,9 @@ namespace uta_opspace {
 				  Skill & skill,
 				  Vector & gamma);
     
+    virtual Status check(int const * param, int value) const;
     virtual Status check(std::string const * param, std::string const & value) const;
+    virtual Status check(double const * param, double value) const;
     
     virtual void dbg(std::ostream & os,
 		     std::string const & title,
@@ -93,6 +95,27 @@ namespace uta_opspace {
 
     Vector fullJpos_;
     Vector fullJvel_;
+    
+    // Run the task hierarchy in float instead of double. Every
+    // guard_period_ ticks (0 = never) the same tick is recomputed in
+    // double and the largest torque difference is recorded. If
+    // guard_threshold_ is positive and gets exceeded, the controller
+    // sends the double result and stays in double until
+    // single_precision gets set again.
+    //
+    // The guard runs inside the servo tick: on every guard_period_-th
+    // tick, computeCommand() takes as long as a float tick plus a
+    // full double tick, i.e. more than twice as long as in between.
+    // Choose guard_period_ (or 0) such that the servo deadline still
+    // holds on those ticks.
+    int single_precision_;
+    int guard_period_;
+    double guard_threshold_;
+    double guard_error_;	// last max |gamma_double - gamma_float|
+    double guard_max_error_;
+    int guard_count_;
+    int guard_trips_;
+    int guard_tick_;
   };
 
 }
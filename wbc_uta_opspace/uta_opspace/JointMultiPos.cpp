@@ -14,12 +14,16 @@ namespace uta_opspace {
       jpos_(Vector::Zero(7)),
       threshold_(-1),
       vel_threshold_(-1),
-      cur_row_(0)
+      cur_row_(0),
+      blend_(0),
+      dt_seconds_(-1),
+      trj_time_(0)
     {
       declareSlot("jpos", &jpos_task_);
       declareParameter("jpos", &jpos_);
       declareParameter("threshold", &threshold_);
       declareParameter("vel_threshold", &vel_threshold_);
+      declareParameter("blend", &blend_);
   }
 
  Status JointMultiPos::
@@ -63,6 +67,21 @@ namespace uta_opspace {
    st = jpos_goal_->set(cur_jpos);
    if (!st) { return st; }
 
+   if (blend_) {
+     Parameter const * dt(jpos_task_->lookupParameter("dt_seconds", PARAMETER_TYPE_REAL));
+     Parameter const * maxvel(jpos_task_->lookupParameter("maxvel", PARAMETER_TYPE_VECTOR));
+     Parameter const * maxacc(jpos_task_->lookupParameter("maxacc", PARAMETER_TYPE_VECTOR));
+     if (( ! dt) || ( ! maxvel) || ( ! maxacc)) {
+       return Status(false, "jpos task needs dt_seconds, maxvel, and maxacc for blending");
+     }
+     dt_seconds_ = *dt->getReal();
+     trj_time_ = 0;
+     st = trj_.compute(model.getState().position_, jpos_,
+		       *maxvel->getVector(), *maxacc->getVector());
+     if (!st) { return st; }
+     st = jpos_goal_->set(Vector(jpos_.segment(jpos_.rows() - ndof_, ndof_)));
+   }
+
    return st;
   }
 
@@ -74,10 +93,23 @@ namespace uta_opspace {
     Vector delta;
     Vector v_delta;
 
+    if (blend_ && (trj_time_ < trj_.getDuration())) {
+      trj_time_ += dt_seconds_;
+      Vector pos, vel, acc;
+      trj_.evaluate(trj_time_, pos, vel, acc);
+      st = jpos_task_->stream(pos, vel, acc);
+      if ( ! st) { return st; }
+      int const target(trj_.getTarget(trj_time_));
+      cur_row_ = (target > 0) ? target - 1 : 0;
+    }
+
     for (size_t ii(0); ii < task_table_.size(); ++ii) {
       st = task_table_[ii]->update(model);
       if ( ! st) { return st; }
     }
+    if (blend_) {
+      return st;
+    }
     for(int ii=0; ii<ndof_; ii++) {
       cur_jpos[ii] = jpos_[ndof_*cur_row_+ii];
     }
@@ -28,12 +28,20 @@
 
 #include <opspace/Skill.hpp>
 #include <opspace/task_library.hpp>
+#include <opspace/ViaPointTrajectory.hpp>
 
 namespace uta_opspace {
   
   using namespace opspace;
   
   
+  /**
+     Moves through the jpos joint configurations once. By default, it
+     waits at each of them until the distance and velocity fall below
+     threshold and vel_threshold. With a non-zero blend parameter, it
+     instead follows a ViaPointTrajectory (computed by init()) which
+     passes through them without stopping.
+  */
   class JointMultiPos
     : public Skill
   {
@@ -63,6 +71,11 @@ namespace uta_opspace {
 
     int ndof_;
     
+    int blend_;
+    double dt_seconds_;
+    ViaPointTrajectory trj_;
+    double trj_time_;
+    
   };
   
 }
@@ -99,4 +99,30 @@ namespace uta_opspace {
     return Status(false,"ID not in database!"); 
   }
 
+  //Appends all points of the given letter, scaled and placed at
+  //the given center, to strokes. This is for computing the whole
+  //writing motion ahead of time, instead of going through the
+  //points one by one with curPoint().
+  Status LetterManager::appendStroke(std::string id, Vector center, Vector & strokes) {
+    if ( center.rows() != 3) {
+      return Status(false,"Invalid or missing center vector");
+    }
+    for (int i=0; i<all_letters_.size(); i++) {
+      if (all_letters_[i]->id() == id) {
+	Vector const points(all_letters_[i]->points());
+	Vector appended(strokes.rows() + points.rows());
+	for (int j=0; j<strokes.rows(); j++) {
+	  appended[j] = strokes[j];
+	}
+	for (int j=0; j<points.rows(); j++) {
+	  appended[strokes.rows()+j] = center[j%3] + scale_ * points[j];
+	}
+	strokes = appended;
+	Status ok;
+	return ok;
+      }
+    }
+    return Status(false,"ID not in database!"); 
+  }
+
 }
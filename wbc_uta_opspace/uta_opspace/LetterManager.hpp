@@ -35,6 +35,7 @@ public:
   Status idIs(std::string id, Vector center);
   std::string id();
   bool curPoint(Vector actual, Vector & point);  
+  Status appendStroke(std::string id, Vector center, Vector & strokes);
 };
 
 }
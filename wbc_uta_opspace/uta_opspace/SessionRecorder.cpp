@@ -0,0 +1,560 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include "SessionRecorder.hpp"
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+
+using boost::shared_ptr;
+
+
+namespace {
+  
+  char const session_magic[8] = { 'W', 'B', 'C', 'S', 'E', 'S', 'S', 'N' };
+  uint32_t const session_version(1);
+  
+  enum {
+    RECORD_INIT = 1,
+    RECORD_TICK = 2,
+    RECORD_PARAMETER = 3
+  };
+  
+  
+  inline size_t flag_get(size_t * flag)
+  {
+    return __sync_fetch_and_add(flag, 0);
+  }
+  
+  
+  class session_writer {
+  public:
+    explicit session_writer(std::string & buf): buf_(buf) {}
+    
+    void raw(void const * src, size_t len) {
+      buf_.append(static_cast<char const *>(src), len);
+    }
+    
+    void u32(uint32_t value) { raw(&value, sizeof(value)); }
+    void u64(uint64_t value) { raw(&value, sizeof(value)); }
+    void i64(int64_t value) { raw(&value, sizeof(value)); }
+    void f64(double value) { raw(&value, sizeof(value)); }
+    
+    void str(std::string const & value) {
+      u32(value.size());
+      buf_.append(value);
+    }
+    
+    void coeffs(jspace::Vector const & value, size_t len) {
+      for (size_t ii(0); ii < len; ++ii) {
+	f64((static_cast<int>(ii) < value.size()) ? value[ii] : 0.0);
+      }
+    }
+    
+  private:
+    std::string & buf_;
+  };
+  
+  
+  class session_reader {
+  public:
+    session_reader(char const * begin, char const * end)
+      : pos_(begin), end_(end), ok_(true) {}
+    
+    bool ok() const { return ok_; }
+    bool done() const { return pos_ == end_; }
+    
+    void raw(void * dst, size_t len) {
+      if ( ! ok_ || (static_cast<size_t>(end_ - pos_) < len)) {
+	ok_ = false;
+	memset(dst, 0, len);
+	return;
+      }
+      memcpy(dst, pos_, len);
+      pos_ += len;
+    }
+    
+    uint32_t u32() { uint32_t value; raw(&value, sizeof(value)); return value; }
+    uint64_t u64() { uint64_t value; raw(&value, sizeof(value)); return value; }
+    int64_t i64() { int64_t value; raw(&value, sizeof(value)); return value; }
+    double f64() { double value; raw(&value, sizeof(value)); return value; }
+    
+    std::string str() {
+      uint32_t const len(u32());
+      if ( ! ok_ || (static_cast<size_t>(end_ - pos_) < len)) {
+	ok_ = false;
+	return "";
+      }
+      std::string value(pos_, len);
+      pos_ += len;
+      return value;
+    }
+    
+    /** Sizes come from the file, so check them against what is left
+	before allocating anything. */
+    bool coeffs(jspace::Vector & value, size_t len) {
+      if ( ! ok_ || (static_cast<size_t>(end_ - pos_) < len * sizeof(double))) {
+	ok_ = false;
+	return false;
+      }
+      value.resize(len);
+      for (size_t ii(0); ii < len; ++ii) {
+	value[ii] = f64();
+      }
+      return true;
+    }
+    
+  private:
+    char const * pos_;
+    char const * end_;
+    bool ok_;
+  };
+  
+  
+  bool tick_less(uta_opspace::SessionLog::parameter_s const & lhs,
+		 uta_opspace::SessionLog::parameter_s const & rhs)
+  {
+    return lhs.tick < rhs.tick;
+  }
+  
+}
+
+
+namespace uta_opspace {
+  
+  
+  SessionRecorder::
+  SessionRecorder(size_t capacity)
+    : file_(0),
+      npos_(0),
+      nvel_(0),
+      nforce_(0),
+      ncommand_(0),
+      capacity_(capacity + 1),	// one slot stays empty to tell full from empty
+      slot_size_(0),
+      head_(0),
+      tail_(0),
+      last_tick_(-1),
+      nrecorded_(0),
+      ndropped_(0)
+  {
+    pthread_mutex_init(&mutex_, 0);
+  }
+  
+  
+  SessionRecorder::
+  ~SessionRecorder()
+  {
+    close();
+    pthread_mutex_destroy(&mutex_);
+  }
+  
+  
+  Status SessionRecorder::
+  open(std::string const & filename,
+       jspace::State const & state,
+       size_t ncommand,
+       shared_ptr<ReflectionRegistry> registry)
+  {
+    if (file_) {
+      return Status(false, "already open");
+    }
+    if ( ! registry) {
+      return Status(false, "no registry");
+    }
+    
+    npos_ = state.position_.size();
+    nvel_ = state.velocity_.size();
+    nforce_ = state.force_.size();
+    ncommand_ = ncommand;
+    slot_size_ = npos_ + nvel_ + nforce_ + ncommand_;
+    slot_tick_.assign(capacity_, 0);
+    slot_duration_.assign(capacity_, 0);
+    slot_sec_.assign(capacity_, 0);
+    slot_usec_.assign(capacity_, 0);
+    slot_data_.assign(capacity_ * slot_size_, 0.0);
+    head_ = 0;
+    tail_ = 0;
+    last_tick_ = -1;
+    nrecorded_ = 0;
+    ndropped_ = 0;
+    
+    names_.clear();
+    ReflectionRegistry::enumeration_t enumeration;
+    registry->enumerate(enumeration);
+    for (size_t ii(0); ii < enumeration.size(); ++ii) {
+      name_s & name(names_[enumeration[ii].parameter]);
+      name.type_name = enumeration[ii].type_name;
+      name.instance_name = enumeration[ii].instance_name;
+      name.parameter_name = enumeration[ii].parameter_name;
+    }
+    
+    std::string buf;
+    session_writer ww(buf);
+    ww.raw(session_magic, sizeof(session_magic));
+    ww.u32(session_version);
+    ww.u32(npos_);
+    ww.u32(nvel_);
+    ww.u32(nforce_);
+    ww.u32(ncommand_);
+    
+    ww.u32(RECORD_INIT);
+    ww.u64(state.time_sec_);
+    ww.u64(state.time_usec_);
+    ww.coeffs(state.position_, npos_);
+    ww.coeffs(state.velocity_, nvel_);
+    ww.coeffs(state.force_, nforce_);
+    
+    for (size_t ii(0); ii < enumeration.size(); ++ii) {
+      if ( ! (enumeration[ii].parameter->flags_ & PARAMETER_FLAG_READONLY)) {
+	writeParameter(buf, -1, enumeration[ii].parameter);
+      }
+    }
+    
+    file_ = fopen(filename.c_str(), "wb");
+    if ( ! file_) {
+      return Status(false, "failed to create " + filename + ": " + strerror(errno));
+    }
+    if (buf.size() != fwrite(buf.data(), 1, buf.size(), file_)) {
+      fclose(file_);
+      file_ = 0;
+      return Status(false, "failed to write header to " + filename);
+    }
+    
+    return Status();
+  }
+  
+  
+  void SessionRecorder::
+  recordTick(long long tick,
+	     jspace::State const & state,
+	     Vector const & command,
+	     long long duration_ns)
+  {
+    if ( ! file_) {
+      return;
+    }
+    size_t const tail(tail_);
+    size_t const next((tail + 1) % capacity_);
+    if (next == flag_get(&head_)) {
+      ++ndropped_;
+    }
+    else {
+      slot_tick_[tail] = tick;
+      slot_duration_[tail] = duration_ns;
+      slot_sec_[tail] = state.time_sec_;
+      slot_usec_[tail] = state.time_usec_;
+      double * dst(&slot_data_[tail * slot_size_]);
+      memcpy(dst, state.position_.data(), npos_ * sizeof(double));
+      dst += npos_;
+      memcpy(dst, state.velocity_.data(), nvel_ * sizeof(double));
+      dst += nvel_;
+      memcpy(dst, state.force_.data(), nforce_ * sizeof(double));
+      dst += nforce_;
+      memcpy(dst, command.data(), ncommand_ * sizeof(double));
+      ++nrecorded_;
+      // the builtin is a full barrier, so the slot is complete before
+      // flush() gets to see it
+      __sync_lock_test_and_set(&tail_, next);
+    }
+    __sync_lock_test_and_set(&last_tick_, tick);
+  }
+  
+  
+  void SessionRecorder::
+  recordParameter(Parameter const * param)
+  {
+    if ( ! file_) {
+      return;
+    }
+    long long const tick(__sync_fetch_and_add(&last_tick_, 0) + 1);
+    pthread_mutex_lock(&mutex_);
+    writeParameter(params_, tick, param);
+    pthread_mutex_unlock(&mutex_);
+  }
+  
+  
+  void SessionRecorder::
+  writeParameter(std::string & buf, long long tick, Parameter const * param) const
+  {
+    name_map_t::const_iterator const in(names_.find(param));
+    if (names_.end() == in) {
+      return;
+    }
+    session_writer ww(buf);
+    ww.u32(RECORD_PARAMETER);
+    ww.i64(tick);
+    ww.str(in->second.type_name);
+    ww.str(in->second.instance_name);
+    ww.str(in->second.parameter_name);
+    ww.u32(param->type_);
+    
+    switch (param->type_) {
+    case PARAMETER_TYPE_STRING:
+      ww.str(*param->getString());
+      break;
+    case PARAMETER_TYPE_INTEGER:
+      ww.i64(*param->getInteger());
+      break;
+    case PARAMETER_TYPE_REAL:
+      ww.f64(*param->getReal());
+      break;
+    case PARAMETER_TYPE_VECTOR:
+      {
+	Vector const & vv(*param->getVector());
+	ww.u32(vv.size());
+	ww.coeffs(vv, vv.size());
+      }
+      break;
+    case PARAMETER_TYPE_MATRIX:
+      {
+	Matrix const & mm(*param->getMatrix());
+	ww.u32(mm.rows());
+	ww.u32(mm.cols());
+	for (int jj(0); jj < mm.cols(); ++jj) {
+	  for (int ii(0); ii < mm.rows(); ++ii) {
+	    ww.f64(mm.coeff(ii, jj));
+	  }
+	}
+      }
+      break;
+    default:
+      // void parameters carry no value, the name is all there is
+      break;
+    }
+  }
+  
+  
+  Status SessionRecorder::
+  flush()
+  {
+    pthread_mutex_lock(&mutex_);
+    if ( ! file_) {
+      pthread_mutex_unlock(&mutex_);
+      return Status(false, "not open");
+    }
+    
+    std::string buf;
+    session_writer ww(buf);
+    size_t const tail(flag_get(&tail_));
+    for (size_t head(head_); head != tail; head = (head + 1) % capacity_) {
+      ww.u32(RECORD_TICK);
+      ww.i64(slot_tick_[head]);
+      ww.i64(slot_duration_[head]);
+      ww.u64(slot_sec_[head]);
+      ww.u64(slot_usec_[head]);
+      ww.raw(&slot_data_[head * slot_size_], slot_size_ * sizeof(double));
+    }
+    __sync_lock_test_and_set(&head_, tail);
+    
+    // Parameters are written after the ticks that were buffered
+    // along with them, but SessionLog::load() sorts them by tick
+    // anyway.
+    buf.append(params_);
+    params_.clear();
+    
+    Status st;
+    if (buf.size() != fwrite(buf.data(), 1, buf.size(), file_)) {
+      st.ok = false;
+      st.errstr = "write error";
+    }
+    else if (0 != fflush(file_)) {
+      st.ok = false;
+      st.errstr = std::string("fflush: ") + strerror(errno);
+    }
+    pthread_mutex_unlock(&mutex_);
+    return st;
+  }
+  
+  
+  Status SessionRecorder::
+  close()
+  {
+    if ( ! file_) {
+      return Status();
+    }
+    Status const st(flush());
+    pthread_mutex_lock(&mutex_);
+    fclose(file_);
+    file_ = 0;
+    pthread_mutex_unlock(&mutex_);
+    return st;
+  }
+  
+  
+  Status SessionLog::
+  load(std::string const & filename)
+  {
+    FILE * ff(fopen(filename.c_str(), "rb"));
+    if ( ! ff) {
+      return Status(false, "failed to open " + filename + ": " + strerror(errno));
+    }
+    std::string data;
+    char chunk[65536];
+    size_t nread;
+    while (0 < (nread = fread(chunk, 1, sizeof(chunk), ff))) {
+      data.append(chunk, nread);
+    }
+    bool const read_error(ferror(ff));
+    fclose(ff);
+    if (read_error) {
+      return Status(false, "read error on " + filename);
+    }
+    
+    session_reader rr(data.data(), data.data() + data.size());
+    char magic[sizeof(session_magic)];
+    rr.raw(magic, sizeof(magic));
+    if ( ! rr.ok() || (0 != memcmp(magic, session_magic, sizeof(magic)))) {
+      return Status(false, filename + " is not a session recording");
+    }
+    if (session_version != rr.u32()) {
+      return Status(false, filename + " has an unsupported version");
+    }
+    size_t const npos(rr.u32());
+    size_t const nvel(rr.u32());
+    size_t const nforce(rr.u32());
+    ncommand = rr.u32();
+    if ( ! rr.ok()) {
+      return Status(false, filename + " has a truncated header");
+    }
+    
+    init_state.init(npos, nvel, nforce);
+    ticks.clear();
+    parameters.clear();
+    bool have_init(false);
+    
+    while (rr.ok() && ( ! rr.done())) {
+      uint32_t const kind(rr.u32());
+      
+      if (RECORD_INIT == kind) {
+	init_state.time_sec_ = rr.u64();
+	init_state.time_usec_ = rr.u64();
+	rr.coeffs(init_state.position_, npos);
+	rr.coeffs(init_state.velocity_, nvel);
+	rr.coeffs(init_state.force_, nforce);
+	have_init = true;
+      }
+      
+      else if (RECORD_TICK == kind) {
+	ticks.push_back(tick_s());
+	tick_s & tick(ticks.back());
+	tick.tick = rr.i64();
+	tick.duration_ns = rr.i64();
+	tick.state.init(npos, nvel, nforce);
+	tick.state.time_sec_ = rr.u64();
+	tick.state.time_usec_ = rr.u64();
+	rr.coeffs(tick.state.position_, npos);
+	rr.coeffs(tick.state.velocity_, nvel);
+	rr.coeffs(tick.state.force_, nforce);
+	rr.coeffs(tick.command, ncommand);
+	if ( ! rr.ok()) {
+	  // The servo may have died in the middle of a flush, keep
+	  // what was complete.
+	  ticks.pop_back();
+	  break;
+	}
+      }
+      
+      else if (RECORD_PARAMETER == kind) {
+	parameter_s param;
+	param.tick = rr.i64();
+	param.type_name = rr.str();
+	param.instance_name = rr.str();
+	param.parameter_name = rr.str();
+	param.type = static_cast<parameter_type_t>(rr.u32());
+	param.integer = 0;
+	param.real = 0;
+	switch (param.type) {
+	case PARAMETER_TYPE_STRING:
+	  param.string = rr.str();
+	  break;
+	case PARAMETER_TYPE_INTEGER:
+	  param.integer = rr.i64();
+	  break;
+	case PARAMETER_TYPE_REAL:
+	  param.real = rr.f64();
+	  break;
+	case PARAMETER_TYPE_VECTOR:
+	  rr.coeffs(param.vector, rr.u32());
+	  break;
+	case PARAMETER_TYPE_MATRIX:
+	  {
+	    size_t const nrows(rr.u32());
+	    size_t const ncols(rr.u32());
+	    Vector coeffs;
+	    if (rr.coeffs(coeffs, nrows * ncols)) {
+	      param.matrix = Matrix::Map(coeffs.data(), nrows, ncols);
+	    }
+	  }
+	  break;
+	default:
+	  break;
+	}
+	if ( ! rr.ok()) {
+	  break;
+	}
+	parameters.push_back(param);
+      }
+      
+      else {
+	return Status(false, filename + " contains an invalid record");
+      }
+    }
+    
+    if ( ! have_init) {
+      return Status(false, filename + " lacks the initial state");
+    }
+    std::stable_sort(parameters.begin(), parameters.end(), tick_less);
+    
+    return Status();
+  }
+  
+  
+  Status SessionLog::
+  apply(parameter_s const & param, ReflectionRegistry & registry)
+  {
+    Parameter * pp(registry.lookupParameter(param.type_name, param.instance_name,
+					    param.parameter_name, param.type));
+    if ( ! pp) {
+      return Status(false, param.type_name + "/" + param.instance_name + "/"
+		    + param.parameter_name + " not found");
+    }
+    switch (param.type) {
+    case PARAMETER_TYPE_STRING:
+      return pp->set(param.string);
+    case PARAMETER_TYPE_INTEGER:
+      return pp->set(param.integer);
+    case PARAMETER_TYPE_REAL:
+      return pp->set(param.real);
+    case PARAMETER_TYPE_VECTOR:
+      return pp->set(param.vector);
+    case PARAMETER_TYPE_MATRIX:
+      return pp->set(param.matrix);
+    default:
+      break;
+    }
+    return Status(false, "cannot set " + param.parameter_name);
+  }
+  
+}
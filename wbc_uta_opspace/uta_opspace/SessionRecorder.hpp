@@ -0,0 +1,200 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef UTA_OPSPACE_SESSION_RECORDER_HPP
+#define UTA_OPSPACE_SESSION_RECORDER_HPP
+
+#include <opspace/Parameter.hpp>
+#include <jspace/State.hpp>
+#include <boost/shared_ptr.hpp>
+#include <pthread.h>
+#include <stdio.h>
+#include <map>
+#include <vector>
+
+namespace uta_opspace {
+  
+  using namespace opspace;
+  
+  
+  /**
+     Records the inputs of a servo session so that it can be replayed
+     offline through the same controller code (see SessionLog and the
+     wbc_replay tool). What gets recorded:
+     
+     - the state passed to the servo's init callback,
+     - every servo tick: the state passed to the update callback, the
+       resulting command, and how long the tick took,
+     - every parameter write that reaches the controller or the skills
+       from the outside, e.g. through the ROS parameter callbacks or
+       UDP goals, tagged with the tick that it precedes,
+     - the value of all writable parameters at open(), so that replay
+       starts from the same configuration.
+     
+     Ticks go through a lock-free single-producer ring: recordTick()
+     copies into preallocated slots using only GCC atomic builtins, it
+     never blocks, allocates, or enters the kernel. When the ring is
+     full the tick is dropped and counted, so flush() has to be called
+     often enough (the servos do it from their non-RT main loop).
+     Parameter writes are queued under a mutex that the RT thread
+     never takes.
+     
+     Parameter writes happen on a non-RT thread and are tagged with
+     the tick after the last recorded one. A write that lands while a
+     tick is being computed can therefore be replayed one tick early,
+     which shows up as a command mismatch at that tick.
+     
+     The file format is native-endian binary, see SessionLog::load().
+  */
+  class SessionRecorder
+  {
+  public:
+    /**
+       \param capacity The number of ticks that can be buffered
+       between two calls to flush().
+    */
+    explicit SessionRecorder(size_t capacity);
+    
+    /** Calls close(). */
+    ~SessionRecorder();
+    
+    /**
+       Create the file, write the header, the initial state, and a
+       snapshot of all non-read-only parameters of the registry, and
+       size the ring. Call this from the servo's init callback, before
+       entering hard real time. The registry is also used to find the
+       names of the parameters passed to recordParameter().
+    */
+    Status open(std::string const & filename,
+		jspace::State const & state,
+		size_t ncommand,
+		boost::shared_ptr<ReflectionRegistry> registry);
+    
+    /**
+       Record one tick. This is the only method meant to be called
+       from the RT thread. The state and command dimensions must match
+       the ones given to open().
+    */
+    void recordTick(long long tick,
+		    jspace::State const & state,
+		    Vector const & command,
+		    long long duration_ns);
+    
+    /**
+       Record the current value of a parameter that has just been
+       written. Parameters that are not in the registry are ignored.
+       Not for the RT thread.
+    */
+    void recordParameter(Parameter const * param);
+    
+    /** Write all buffered ticks and parameters to the file. */
+    Status flush();
+    
+    /** Flush and close the file. Safe to call repeatedly. */
+    Status close();
+    
+    inline bool isOpen() const { return 0 != file_; }
+    inline long long getNRecorded() const { return nrecorded_; }
+    inline long long getNDropped() const { return ndropped_; }
+    
+  protected:
+    struct name_s {
+      std::string type_name, instance_name, parameter_name;
+    };
+    typedef std::map<Parameter const *, name_s> name_map_t;
+    
+    void writeParameter(std::string & buf, long long tick, Parameter const * param) const;
+    
+    FILE * file_;
+    size_t npos_, nvel_, nforce_, ncommand_;
+    name_map_t names_;
+    
+    // The ring belongs to recordTick() between tail_ and head_, and
+    // to flush() between head_ and tail_. Only recordTick() advances
+    // tail_, only flush() advances head_.
+    size_t capacity_;
+    size_t slot_size_;
+    std::vector<long long> slot_tick_;
+    std::vector<long long> slot_duration_;
+    std::vector<size_t> slot_sec_;
+    std::vector<size_t> slot_usec_;
+    std::vector<double> slot_data_;
+    size_t head_;
+    size_t tail_;
+    long long last_tick_;
+    
+    // only written by the RT thread
+    long long nrecorded_;
+    long long ndropped_;
+    
+    // protects params_ and the file
+    pthread_mutex_t mutex_;
+    std::string params_;
+  };
+  
+  
+  /**
+     In-memory copy of a file written by SessionRecorder.
+  */
+  class SessionLog
+  {
+  public:
+    struct tick_s {
+      long long tick;
+      long long duration_ns;
+      jspace::State state;
+      Vector command;
+    };
+    
+    struct parameter_s {
+      long long tick;		// apply before this tick, -1 means before init
+      std::string type_name, instance_name, parameter_name;
+      parameter_type_t type;
+      int integer;
+      std::string string;
+      double real;
+      Vector vector;
+      Matrix matrix;
+    };
+    
+    /**
+       Read a recording. The file starts with an 8 byte magic and a
+       header of uint32 version, npos, nvel, nforce, ncommand, and is
+       followed by records that start with a uint32 kind: the initial
+       state, ticks, and parameters. Parameters end up sorted by tick,
+       in the order they were recorded.
+    */
+    Status load(std::string const & filename);
+    
+    /** Write the value of a recorded parameter into the registry. */
+    static Status apply(parameter_s const & param, ReflectionRegistry & registry);
+    
+    jspace::State init_state;
+    std::vector<tick_s> ticks;
+    std::vector<parameter_s> parameters;
+    size_t ncommand;
+  };
+  
+}
+
+#endif // UTA_OPSPACE_SESSION_RECORDER_HPP
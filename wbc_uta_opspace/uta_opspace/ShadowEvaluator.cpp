@@ -0,0 +1,354 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include "ShadowEvaluator.hpp"
+#include <iostream>
+#include <time.h>
+#include <unistd.h>
+
+using boost::shared_ptr;
+
+
+static long long now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+// The mailbox flags are plain ints accessed through the GCC atomic
+// builtins, which are full barriers and never enter the kernel, so
+// the RT thread can use them in hard real-time mode.
+static inline int flag_get(int * flag)
+{
+  return __sync_fetch_and_add(flag, 0);
+}
+
+
+namespace uta_opspace {
+  
+  
+  struct ShadowEvaluator::lane_s {
+    ShadowEvaluator * owner;
+    std::string name;
+    size_t index;
+    shared_ptr<jspace::Model> model;
+    shared_ptr<ControllerNG> controller;
+    shared_ptr<Skill> skill;
+    pthread_t thread;
+    bool running;
+    int quit;
+    
+    // The mailbox belongs to submit() while busy is zero and to the
+    // worker while it is one.
+    int busy;
+    long long mbox_tick;
+    long long mbox_live_ns;
+    jspace::State mbox_state;
+    Vector mbox_live;
+    
+    // only written by the RT thread
+    long long nsubmitted;
+    long long ndropped;
+    
+    // only touched by the worker
+    jspace::State state;
+    Vector live;
+    Vector shadow;
+    
+    // protected by the owner's mutex
+    long long nevaluated;
+    long long nfailed;
+    long long sum_ns;
+    long long max_ns;
+    double max_deviation;
+    std::string error;
+  };
+  
+  
+  ShadowEvaluator::
+  ShadowEvaluator(size_t logcapacity)
+    : poll_us_(200),
+      started_(false),
+      log_(logcapacity),
+      lognext_(0),
+      logsize_(0)
+  {
+    pthread_mutex_init(&mutex_, 0);
+  }
+  
+  
+  ShadowEvaluator::
+  ~ShadowEvaluator()
+  {
+    stop();
+    for (size_t ii(0); ii < lanes_.size(); ++ii) {
+      delete lanes_[ii];
+    }
+    pthread_mutex_destroy(&mutex_);
+  }
+  
+  
+  Status ShadowEvaluator::
+  addLane(std::string const & name,
+	  shared_ptr<jspace::Model> model,
+	  shared_ptr<ControllerNG> controller,
+	  shared_ptr<Skill> skill)
+  {
+    if (started_) {
+      return Status(false, "cannot add lanes after start()");
+    }
+    if (( ! model) || ( ! controller) || ( ! skill)) {
+      return Status(false, "lane `" + name + "' needs a model, a controller, and a skill");
+    }
+    lane_s * lane(new lane_s());
+    lane->owner = this;
+    lane->name = name;
+    lane->index = lanes_.size();
+    lane->model = model;
+    lane->controller = controller;
+    lane->skill = skill;
+    lane->running = false;
+    lane->quit = 0;
+    lane->busy = 0;
+    lane->mbox_tick = 0;
+    lane->mbox_live_ns = 0;
+    lane->nsubmitted = 0;
+    lane->ndropped = 0;
+    lane->nevaluated = 0;
+    lane->nfailed = 0;
+    lane->sum_ns = 0;
+    lane->max_ns = 0;
+    lane->max_deviation = 0;
+    lanes_.push_back(lane);
+    return Status();
+  }
+  
+  
+  Status ShadowEvaluator::
+  start(jspace::State const & state, long poll_us)
+  {
+    if (started_) {
+      return Status(false, "already started");
+    }
+    poll_us_ = poll_us;
+    
+    for (size_t ii(0); ii < lanes_.size(); ++ii) {
+      lane_s & lane(*lanes_[ii]);
+      lane.model->update(state);
+      Status st(lane.controller->init(*lane.model));
+      if ( ! st) {
+	return Status(false, "lane `" + lane.name + "': controller init failed: " + st.errstr);
+      }
+      st = lane.skill->init(*lane.model);
+      if ( ! st) {
+	return Status(false, "lane `" + lane.name + "': skill init failed: " + st.errstr);
+      }
+      // Pre-size everything submit() assigns to, so that the RT
+      // thread copies into existing storage.
+      lane.mbox_state = state;
+      lane.mbox_live = Vector::Zero(state.position_.rows());
+      lane.state = state;
+      lane.live = lane.mbox_live;
+      lane.shadow = lane.mbox_live;
+    }
+    for (size_t ii(0); ii < log_.size(); ++ii) {
+      log_[ii].live = Vector::Zero(state.position_.rows());
+      log_[ii].shadow = log_[ii].live;
+    }
+    lognext_ = 0;
+    logsize_ = 0;
+    
+    started_ = true;
+    for (size_t ii(0); ii < lanes_.size(); ++ii) {
+      lane_s & lane(*lanes_[ii]);
+      __sync_lock_test_and_set(&lane.quit, 0);
+      if (0 != pthread_create(&lane.thread, 0, run, &lane)) {
+	stop();
+	return Status(false, "failed to create worker thread for lane `" + lane.name + "'");
+      }
+      lane.running = true;
+    }
+    
+    return Status();
+  }
+  
+  
+  void ShadowEvaluator::
+  stop()
+  {
+    for (size_t ii(0); ii < lanes_.size(); ++ii) {
+      __sync_lock_test_and_set(&lanes_[ii]->quit, 1);
+    }
+    for (size_t ii(0); ii < lanes_.size(); ++ii) {
+      if (lanes_[ii]->running) {
+	pthread_join(lanes_[ii]->thread, 0);
+	lanes_[ii]->running = false;
+      }
+    }
+    started_ = false;
+  }
+  
+  
+  void ShadowEvaluator::
+  submit(long long tick,
+	 jspace::State const & state,
+	 Vector const & live_command,
+	 long long live_ns)
+  {
+    if ( ! started_) {
+      return;
+    }
+    for (size_t ii(0); ii < lanes_.size(); ++ii) {
+      lane_s & lane(*lanes_[ii]);
+      ++lane.nsubmitted;
+      if (flag_get(&lane.busy)) {
+	++lane.ndropped;
+	continue;
+      }
+      lane.mbox_tick = tick;
+      lane.mbox_live_ns = live_ns;
+      lane.mbox_state = state;
+      lane.mbox_live = live_command;
+      __sync_fetch_and_add(&lane.busy, 1);
+    }
+  }
+  
+  
+  void * ShadowEvaluator::
+  run(void * arg)
+  {
+    lane_s * lane(static_cast<lane_s*>(arg));
+    lane->owner->work(*lane);
+    return 0;
+  }
+  
+  
+  void ShadowEvaluator::
+  work(lane_s & lane)
+  {
+    while ( ! flag_get(&lane.quit)) {
+      if ( ! flag_get(&lane.busy)) {
+	usleep(poll_us_);
+	continue;
+      }
+      
+      // Copy the snapshot out right away, so the mailbox is free for
+      // the next tick while this one is being evaluated.
+      long long const tick(lane.mbox_tick);
+      long long const live_ns(lane.mbox_live_ns);
+      lane.state = lane.mbox_state;
+      lane.live = lane.mbox_live;
+      __sync_fetch_and_sub(&lane.busy, 1);
+      
+      long long const t0(now_ns());
+      lane.model->update(lane.state);
+      Status const st(lane.controller->computeCommand(*lane.model, *lane.skill, lane.shadow));
+      long long const dt(now_ns() - t0);
+      
+      pthread_mutex_lock(&mutex_);
+      ++lane.nevaluated;
+      lane.sum_ns += dt;
+      if (dt > lane.max_ns) {
+	lane.max_ns = dt;
+      }
+      if ( ! st) {
+	++lane.nfailed;
+	lane.error = st.errstr;
+      }
+      else if (lane.shadow.rows() == lane.live.rows()) {
+	double const deviation((lane.shadow - lane.live).cwise().abs().maxCoeff());
+	if (deviation > lane.max_deviation) {
+	  lane.max_deviation = deviation;
+	}
+      }
+      if ( ! log_.empty()) {
+	record_s & rec(log_[lognext_]);
+	rec.tick = tick;
+	rec.lane = lane.index;
+	rec.ok = st.ok;
+	rec.live_ns = live_ns;
+	rec.shadow_ns = dt;
+	rec.live = lane.live;
+	rec.shadow = lane.shadow;
+	lognext_ = (lognext_ + 1) % log_.size();
+	if (logsize_ < log_.size()) {
+	  ++logsize_;
+	}
+      }
+      pthread_mutex_unlock(&mutex_);
+    }
+  }
+  
+  
+  void ShadowEvaluator::
+  writeLog(std::ostream & os) const
+  {
+    pthread_mutex_lock(&mutex_);
+    os << "# tick lane ok live_ns shadow_ns live[0..n-1] shadow[0..n-1]\n";
+    for (size_t ii(0); ii < logsize_; ++ii) {
+      record_s const & rec(log_[(lognext_ + log_.size() - logsize_ + ii) % log_.size()]);
+      os << rec.tick << " " << lanes_[rec.lane]->name << " " << (rec.ok ? 1 : 0)
+	 << " " << rec.live_ns << " " << rec.shadow_ns;
+      for (int jj(0); jj < rec.live.rows(); ++jj) {
+	os << " " << rec.live[jj];
+      }
+      for (int jj(0); jj < rec.shadow.rows(); ++jj) {
+	os << " " << rec.shadow[jj];
+      }
+      os << "\n";
+    }
+    pthread_mutex_unlock(&mutex_);
+  }
+  
+  
+  void ShadowEvaluator::
+  dump(std::ostream & os,
+       std::string const & title,
+       std::string const & prefix) const
+  {
+    if ( ! title.empty()) {
+      os << title << "\n";
+    }
+    pthread_mutex_lock(&mutex_);
+    for (size_t ii(0); ii < lanes_.size(); ++ii) {
+      lane_s const & lane(*lanes_[ii]);
+      os << prefix << "lane " << lane.name << " (skill " << lane.skill->getName() << ")\n"
+	 << prefix << "  submitted:     " << lane.nsubmitted << "\n"
+	 << prefix << "  dropped:       " << lane.ndropped << "\n"
+	 << prefix << "  evaluated:     " << lane.nevaluated << "\n"
+	 << prefix << "  failed:        " << lane.nfailed << "\n";
+      if (0 < lane.nevaluated) {
+	os << prefix << "  mean time:     " << 1e-3 * lane.sum_ns / lane.nevaluated << " us\n"
+	   << prefix << "  max time:      " << 1e-3 * lane.max_ns << " us\n";
+      }
+      os << prefix << "  max deviation: " << lane.max_deviation << "\n";
+      if ( ! lane.error.empty()) {
+	os << prefix << "  last error:    " << lane.error << "\n";
+      }
+    }
+    pthread_mutex_unlock(&mutex_);
+  }
+  
+}
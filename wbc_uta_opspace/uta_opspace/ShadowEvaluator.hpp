@@ -0,0 +1,153 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef UTA_OPSPACE_SHADOW_EVALUATOR_HPP
+#define UTA_OPSPACE_SHADOW_EVALUATOR_HPP
+
+#include "ControllerNG.hpp"
+#include <opspace/Skill.hpp>
+#include <jspace/Model.hpp>
+#include <boost/shared_ptr.hpp>
+#include <pthread.h>
+#include <iosfwd>
+#include <vector>
+
+namespace uta_opspace {
+  
+  
+  /**
+     Runs candidate (ControllerNG, Skill) pairs in shadow mode next to
+     the live controller: each lane receives the same per-tick joint
+     state as the servo and computes a command, which is logged next
+     to the live command but never sent to the robot.
+     
+     Neither ControllerNG nor the skills and the Model are safe to
+     share between threads (the model caches derived quantities and
+     the constraint projection, the controller keeps its fallback
+     flag and log counters), so every lane owns a separate instance
+     of each. What gets shared is the read-only snapshot of the
+     tick: the jspace::State that the live model was updated with,
+     and the resulting live command.
+     
+     Each lane has its own non-RT worker thread. The handoff from the
+     servo tick is a single-slot mailbox: submit() copies the
+     snapshot into every lane whose mailbox is free and skips the
+     others (counting a dropped tick), it never blocks, never makes a
+     system call, and never allocates once start() has sized the
+     buffers. A lane that cannot keep up with the servo rate
+     therefore sees a subsampled stream of ticks, which matters for
+     skills whose trajectories assume a fixed dt.
+     
+     Typical use: addLane() a few times, start() from the servo's
+     init callback, submit() from each servo tick, and stop() and
+     writeLog() when shutting down.
+  */
+  class ShadowEvaluator
+  {
+  public:
+    /** One evaluated tick of one lane. */
+    struct record_s {
+      long long tick;
+      size_t lane;
+      bool ok;
+      long long live_ns;	// as reported to submit()
+      long long shadow_ns;	// model update plus computeCommand()
+      Vector live;
+      Vector shadow;
+    };
+    
+    /**
+       \param logcapacity The most recent logcapacity records (across
+       all lanes) are kept for writeLog().
+    */
+    explicit ShadowEvaluator(size_t logcapacity);
+    
+    /** Calls stop(). */
+    ~ShadowEvaluator();
+    
+    /**
+       Add a lane before calling start(). The model has to describe
+       the same robot as the live one (with the same constraint), but
+       it must be a separate instance. The same goes for the
+       controller and the skill, which typically comes from a
+       separate Factory so that its tasks are not shared with the
+       live skill either.
+    */
+    Status addLane(std::string const & name,
+		   boost::shared_ptr<jspace::Model> model,
+		   boost::shared_ptr<ControllerNG> controller,
+		   boost::shared_ptr<Skill> skill);
+    
+    /**
+       Update each lane's model with the given state, initialize its
+       controller and skill, size all buffers, and launch the worker
+       threads. Workers poll their mailbox every poll_us microseconds
+       while they are idle.
+    */
+    Status start(jspace::State const & state, long poll_us = 200);
+    
+    /** Stop and join the worker threads. Safe to call repeatedly. */
+    void stop();
+    
+    /**
+       Hand a tick to every idle lane. This is the only method meant
+       to be called from the RT thread. The state and command
+       dimensions must match the ones given to start().
+    */
+    void submit(long long tick,
+		jspace::State const & state,
+		Vector const & live_command,
+		long long live_ns);
+    
+    inline size_t getNLanes() const { return lanes_.size(); }
+    
+    /** Write the retained records, oldest first, one per line. */
+    void writeLog(std::ostream & os) const;
+    
+    /** Per-lane summary: tick counts, timing, and command deviation. */
+    void dump(std::ostream & os,
+	      std::string const & title,
+	      std::string const & prefix) const;
+    
+  protected:
+    struct lane_s;
+    
+    static void * run(void * arg);
+    void work(lane_s & lane);
+    
+    std::vector<lane_s *> lanes_;
+    long poll_us_;
+    bool started_;
+    
+    // The log and the per-lane statistics are shared between the
+    // workers and whoever calls writeLog() or dump(), never the RT
+    // thread.
+    mutable pthread_mutex_t mutex_;
+    std::vector<record_s> log_;
+    size_t lognext_;
+    size_t logsize_;
+  };
+  
+}
+
+#endif // UTA_OPSPACE_SHADOW_EVALUATOR_HPP
@@ -29,7 +29,10 @@ namespace uta_opspace {
       threshold_(-1),
       cur_row_(0),
       scale_(-1),
-      file_name_("")
+      file_name_(""),
+      blend_(0),
+      dt_seconds_(-1),
+      trj_time_(0)
     {
     declareSlot("eepos", &eepos_task_);
     declareSlot("eeori", &eeori_task_);
@@ -43,6 +46,7 @@ namespace uta_opspace {
     declareParameter("threshold", &threshold_);
     declareParameter("scale", &scale_);
     declareParameter("file_name", &file_name_);
+    declareParameter("blend", &blend_);
   }
 
  Status WriteSkill::
@@ -169,14 +173,72 @@ namespace uta_opspace {
        return st;
      }     
 
+     if (blend_) {
+       st = initBlend();
+     }
+
      return st;
   }
 
+
+ Status WriteSkill::
+  initBlend()
+  {
+    Parameter const * dt(eepos_task_->lookupParameter("dt_seconds", PARAMETER_TYPE_REAL));
+    Parameter const * maxvel(eepos_task_->lookupParameter("maxvel", PARAMETER_TYPE_VECTOR));
+    Parameter const * maxacc(eepos_task_->lookupParameter("maxacc", PARAMETER_TYPE_VECTOR));
+    if (( ! dt) || ( ! maxvel) || ( ! maxacc)) {
+      return Status(false, "eepos task needs dt_seconds, maxvel, and maxacc for blending");
+    }
+    dt_seconds_ = *dt->getReal();
+
+    Vector strokes;
+    letter_end_.clear();
+    for (size_t ii(0); ii < letters_.length(); ++ii) {
+      Status st(letter_manager_->appendStroke(letters_.substr(ii, 1),
+					      Vector(letter_centers_.segment(3 * ii, 3)),
+					      strokes));
+      if ( ! st) {
+	return st;
+      }
+      letter_end_.push_back(strokes.rows() / 3);
+    }
+
+    Status st(trj_.compute(eepos_task_->getActual(), strokes,
+			   *maxvel->getVector(), *maxacc->getVector()));
+    if ( ! st) {
+      return st;
+    }
+    trj_time_ = 0;
+    return eepos_goal_->set(Vector(strokes.segment(strokes.rows() - 3, 3)));
+  }
+
  Status WriteSkill::
   update(Model const & model)
   {
     Status st;    
     
+    if (blend_ && (trj_time_ < trj_.getDuration())) {
+      trj_time_ += dt_seconds_;
+      Vector pos, vel, acc;
+      trj_.evaluate(trj_time_, pos, vel, acc);
+      st = eepos_task_->stream(pos, vel, acc);
+      if ( ! st) {
+	return st;
+      }
+      // keep the letter manager at the current letter, for dbg()
+      size_t const target(trj_.getTarget(trj_time_));
+      while ((cur_row_ + 1 < static_cast<int>(letter_end_.size()))
+	     && (target > letter_end_[cur_row_])) {
+	++cur_row_;
+	st = letter_manager_->idIs(letters_.substr(cur_row_, 1),
+				   Vector(letter_centers_.segment(3 * cur_row_, 3)));
+	if ( ! st) {
+	  return st;
+	}
+      }
+    }
+
     for (size_t ii(0); ii < task_table_.size(); ++ii) {
       st = task_table_[ii]->update(model);
       if ( ! st) {
@@ -184,6 +246,10 @@ namespace uta_opspace {
       }
     }
 
+    if (blend_) {
+      return st;
+    }
+
     Vector curPoint(Vector::Zero(3));
     Vector curCenter(Vector::Zero(3));
     for(int ii=0; ii<curCenter.size(); ii++) {
@@ -4,6 +4,7 @@
 
 #include <opspace/Skill.hpp>
 #include <opspace/task_library.hpp>
+#include <opspace/ViaPointTrajectory.hpp>
 #include "LetterManager.hpp"
 
 namespace uta_opspace {
@@ -11,6 +12,12 @@ namespace uta_opspace {
   using namespace opspace;
   
   
+  /**
+     Writes the given letters, one after the other. With a non-zero
+     blend parameter, the points of all letters get joined into one
+     ViaPointTrajectory at init() time, so the pen does not stop at
+     each point.
+  */
   class WriteSkill
     : public Skill
   {
@@ -52,6 +59,14 @@ namespace uta_opspace {
     double scale_;
     int cur_row_;
 
+    int blend_;
+    double dt_seconds_;
+    ViaPointTrajectory trj_;
+    double trj_time_;
+    std::vector<size_t> letter_end_; // index of the last trajectory point of each letter
+
+    Status initBlend();
+
   };
   
 }
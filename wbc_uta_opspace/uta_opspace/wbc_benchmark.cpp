@@ -0,0 +1,1073 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+/**
+   \file wbc_benchmark.cpp
+
+   Microbenchmarks for the model, the controller, and the other bits
+   that run in the servo loop. Results get written as JSON (see
+   uta_opspace::BenchmarkLog) and can be compared against an earlier
+   run in order to spot slowdowns between commits, e.g.
+
+   \verbatim
+   wbc_benchmark -o before.json
+   ...hack hack hack...
+   wbc_benchmark -o after.json -b before.json
+   \endverbatim
+*/
+
+// The CMake setup "should" set WBC_BENCHMARK_STACK_DIR to the root of
+// the stack, which is where we find the default robot and skill
+// files. Otherwise, specify them using the -m and -y options.
+
+#ifndef WBC_BENCHMARK_STACK_DIR
+#define WBC_BENCHMARK_STACK_DIR "."
+#endif // WBC_BENCHMARK_STACK_DIR
+
+#include "BenchmarkLog.hpp"
+#include "ControllerNG.hpp"
+#include "ControllerHQP.hpp"
+#include "HelloGoodbyeSkill.hpp"
+#include "TaskOriPostureSkill.hpp"
+#include "CartMultiPos.hpp"
+#include "JointMultiPos.hpp"
+#include "BaseMultiPos.hpp"
+#include <opspace/Factory.hpp>
+#include <opspace/TypeIOTGCursor.hpp>
+#include <opspace/ViaPointTrajectory.hpp>
+#include <opspace/skill_library.hpp>
+#include <opspace/task_library.hpp>
+#include <jspace/Model.hpp>
+#include <jspace/DynamicsDerivatives.hpp>
+#include <jspace/pseudo_inverse.hpp>
+#include <jspace/test/sai_util.hpp>
+#include <wbc_tinyxml/wbc_tinyxml.h>
+#include <wbc_tinyxml/wbc_tinyxmlinsitu.h>
+#include <tao/dynamics/taoNode.h>
+#include <tao/dynamics/taoJoint.h>
+#include <tao/dynamics/taoVar.h>
+#include <tao/dynamics/taoDynamics.h>
+#include <tao/utility/TaoDeMassProp.h>
+#include <tao/matrix/TaoDeMath.h>
+#include <boost/shared_ptr.hpp>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <err.h>
+#include <stdlib.h>
+#include <math.h>
+
+using namespace uta_opspace;
+using namespace opspace;
+using jspace::State;
+using boost::shared_ptr;
+using namespace std;
+
+
+namespace {
+
+
+  struct robot_spec_s {
+    string name;
+    string filename;
+    string constraint;
+  };
+
+
+  class ModelStageCase
+    : public BenchmarkCase
+  {
+  public:
+    typedef enum {
+      UPDATE,
+      SET_STATE,
+      KINEMATICS,
+      GRAVITY,
+      CORIOLIS_CENTRIFUGAL,
+      MASS_INERTIA,
+      INVERSE_MASS_INERTIA
+    } stage_t;
+
+    ModelStageCase(Model & model, State const & state, stage_t stage)
+      : model_(model), state_(state), stage_(stage) {}
+
+    virtual void run() {
+      switch (stage_) {
+      case UPDATE:               model_.update(state_); break;
+      case SET_STATE:            model_.setState(state_); break;
+      case KINEMATICS:           model_.updateKinematics(); break;
+      case GRAVITY:              model_.computeGravity(); break;
+      case CORIOLIS_CENTRIFUGAL: model_.computeCoriolisCentrifugal(); break;
+      case MASS_INERTIA:         model_.computeMassInertia(); break;
+      case INVERSE_MASS_INERTIA: model_.computeInverseMassInertia(); break;
+      }
+    }
+
+  protected:
+    Model & model_;
+    State const & state_;
+    stage_t const stage_;
+  };
+
+
+  class JacobianCase
+    : public BenchmarkCase
+  {
+  public:
+    JacobianCase(Model const & model, taoDNode const * node)
+      : model_(model), node_(node) {}
+
+    virtual void run() { model_.computeJacobian(node_, jacobian_); }
+
+  protected:
+    Model const & model_;
+    taoDNode const * node_;
+    Matrix jacobian_;
+  };
+
+
+  /**
+     The products that the controller needs for each task: J times an
+     ndof-by-ndof matrix (as in jstar = J * UNcBar) and J * M * J^T (as
+     in the inverse of lambda star). Either using the dense Jacobian,
+     or the column-sparse one which skips the columns of joints that
+     are not ancestors of the node.
+  */
+  class JacobianProductCase
+    : public BenchmarkCase
+  {
+  public:
+    JacobianProductCase(Model const & model, taoDNode const * node, bool sparse)
+      : model_(model), node_(node), sparse_(sparse)
+    {
+      size_t const ndof(model.getNDOF());
+      Matrix const rr(Matrix::Random(ndof, ndof));
+      mm_ = rr * rr.transpose();
+    }
+
+    virtual void run() {
+      if (sparse_) {
+	model_.computeJacobian(node_, sparse_jacobian_);
+	sparse_jacobian_.multiply(mm_, jm_);
+	sparse_jacobian_.quadratic(mm_, jmjt_);
+      }
+      else {
+	model_.computeJacobian(node_, jacobian_);
+	jm_ = jacobian_ * mm_;
+	jmjt_ = jacobian_ * mm_ * jacobian_.transpose();
+      }
+    }
+
+  protected:
+    Model const & model_;
+    taoDNode const * node_;
+    bool const sparse_;
+    Matrix mm_;
+    Matrix jacobian_;
+    jspace::SparseJacobian sparse_jacobian_;
+    Matrix jm_;
+    Matrix jmjt_;
+  };
+
+
+  /**
+     Derivatives of gravity (with respect to q) or of the inverse
+     dynamics (with respect to q and qd), either analytically or by
+     central differences over perturbed Model::update() calls: 2n of
+     them for gravity and 4n for the inverse dynamics, n being the
+     number of DOF in the state.
+  */
+  class DerivativesCase
+    : public BenchmarkCase
+  {
+  public:
+    DerivativesCase(Model & model, jspace::DynamicsDerivatives & derivatives,
+		    State const & state, bool inverse_dynamics, bool analytical)
+      : model_(model),
+	derivatives_(derivatives),
+	state_(state),
+	inverse_dynamics_(inverse_dynamics),
+	analytical_(analytical),
+	qdd_(Vector::Zero(model.getNDOF())) {}
+
+    virtual void run() {
+      if (analytical_) {
+	derivatives_.update(model_);
+	if (inverse_dynamics_) {
+	  derivatives_.computeInverseDynamicsDerivatives(qdd_, tau_, dq_, dqd_);
+	}
+	else {
+	  derivatives_.computeGravityDerivative(dq_);
+	}
+	return;
+      }
+      size_t const nstate(state_.position_.size());
+      dq_.resize(model_.getNDOF(), nstate);
+      dqd_.resize(model_.getNDOF(), nstate);
+      State perturbed(state_);
+      Vector plus, minus;
+      for (size_t jj(0); jj < nstate; ++jj) {
+	for (size_t iv(0); iv < (inverse_dynamics_ ? 2 : 1); ++iv) {
+	  Vector & var(0 == iv ? perturbed.position_ : perturbed.velocity_);
+	  var[jj] += 1e-6;
+	  perturb(perturbed, plus);
+	  var[jj] -= 2e-6;
+	  perturb(perturbed, minus);
+	  var[jj] += 1e-6;
+	  (0 == iv ? dq_ : dqd_).col(jj) = (plus - minus) / 2e-6;
+	}
+      }
+      model_.update(state_);
+    }
+
+  protected:
+    void perturb(State const & state, Vector & result) {
+      model_.update(state);
+      if (inverse_dynamics_) {
+	model_.getBiasForces(result);
+      }
+      else {
+	model_.getGravity(result);
+      }
+    }
+
+    Model & model_;
+    jspace::DynamicsDerivatives & derivatives_;
+    State const & state_;
+    bool const inverse_dynamics_;
+    bool const analytical_;
+    Vector qdd_;
+    Vector tau_;
+    Matrix dq_;
+    Matrix dqd_;
+  };
+
+
+  class PseudoInverseCase
+    : public BenchmarkCase
+  {
+  public:
+    explicit PseudoInverseCase(size_t dim) {
+      // symmetric positive semi-definite, like the matrices that the
+      // controllers invert (one direction is left near-singular)
+      Matrix const rr(Matrix::Random(dim, dim));
+      matrix_ = rr * rr.transpose();
+      if (dim > 1) {
+	Vector const vv(Vector::Random(dim));
+	matrix_ += 1e-6 * vv * vv.transpose();
+      }
+    }
+
+    virtual void run() { jspace::pseudoInverse(matrix_, 1e-4, inverse_, 0); }
+
+  protected:
+    Matrix matrix_;
+    Matrix inverse_;
+  };
+
+
+  class ControllerCase
+    : public BenchmarkCase
+  {
+  public:
+    ControllerCase(Model const & model, Controller & controller, Skill & skill)
+      : model_(model), controller_(controller), skill_(skill) {}
+
+    virtual void run() { controller_.computeCommand(model_, skill_, gamma_); }
+
+  protected:
+    Model const & model_;
+    Controller & controller_;
+    Skill & skill_;
+    Vector gamma_;
+  };
+
+
+  /**
+     Moves back and forth between two goals, which makes the
+     phase-synchronized cursor plan once per stroke.
+  */
+  class CursorCase
+    : public BenchmarkCase
+  {
+  public:
+    CursorCase(size_t ndof, bool phase_sync)
+      : cursor_(ndof, 1e-3),
+	maxvel_(Vector::Ones(ndof)),
+	maxacc_(4.0 * Vector::Ones(ndof)),
+	goal_(Vector::Ones(ndof))
+    {
+      for (size_t ii(0); ii < ndof; ++ii) {
+	goal_[ii] += 0.1 * ii;
+      }
+      cursor_.setPhaseSync(phase_sync);
+    }
+
+    virtual void run() {
+      if (TypeIOTG::OTG_FINAL_STATE_REACHED == cursor_.next(maxvel_, maxacc_, goal_)) {
+	goal_ = -goal_;
+      }
+    }
+
+  protected:
+    TypeIOTGCursor cursor_;
+    Vector maxvel_;
+    Vector maxacc_;
+    Vector goal_;
+  };
+
+
+  /**
+     Streams a ViaPointTrajectory around a polygon with npoints
+     corners, which is what the multi-position skills do at each
+     tick when blending.
+  */
+  class ViaPointCase
+    : public BenchmarkCase
+  {
+  public:
+    explicit ViaPointCase(size_t npoints)
+      : time_(0)
+    {
+      Vector start(Vector::Zero(3));
+      Vector points(3 * npoints);
+      start[0] = 0.3;
+      for (size_t ii(0); ii < npoints; ++ii) {
+	points[3 * ii] = 0.3 * cos(2 * M_PI * (ii + 1) / npoints);
+	points[3 * ii + 1] = 0.3 * sin(2 * M_PI * (ii + 1) / npoints);
+	points[3 * ii + 2] = 0.0;
+      }
+      trj_.compute(start, points, Vector::Ones(1), Vector::Ones(1));
+    }
+
+    virtual void run() {
+      time_ += 1e-3;
+      if (time_ > trj_.getDuration()) {
+	time_ = 0;
+      }
+      trj_.evaluate(time_, pos_, vel_, acc_);
+    }
+
+  protected:
+    ViaPointTrajectory trj_;
+    double time_;
+    Vector pos_, vel_, acc_;
+  };
+
+
+  /**
+     The TAO tree sweeps on their own, without the jspace::Model
+     bookkeeping around them, so that they can be timed on chains
+     which are much deeper than any of our robots.
+  */
+  class TaoSweepCase
+    : public BenchmarkCase
+  {
+  public:
+    typedef enum {
+      UPDATE_TRANSFORMATION,
+      INV_DYNAMICS,
+      FWD_DYNAMICS
+    } sweep_t;
+
+    TaoSweepCase(taoNodeRoot * root, sweep_t sweep)
+      : root_(root), sweep_(sweep)
+    {
+      gravity_.set(0.0, 0.0, -9.81);
+    }
+
+    virtual void run() {
+      switch (sweep_) {
+      case UPDATE_TRANSFORMATION: taoDynamics::updateTransformation(root_); break;
+      case INV_DYNAMICS:          taoDynamics::invDynamics(root_, &gravity_); break;
+      case FWD_DYNAMICS:          taoDynamics::fwdDynamics(root_, &gravity_); break;
+      }
+    }
+
+  protected:
+    taoNodeRoot * root_;
+    sweep_t const sweep_;
+    deVector3 gravity_;
+  };
+
+
+  /**
+     The TAO math primitives that the sweeps spend their time in, one
+     at a time. Which implementation gets timed depends on how TAO was
+     built, so compare a default build against one configured with
+     -DTAO_SIMD=NONE (using the -b option) to see what the SIMD
+     kernels buy.
+  */
+  class TaoMathCase
+    : public BenchmarkCase
+  {
+  public:
+    typedef enum {
+      MATRIX3_MULTIPLY,
+      MATRIX3_MULTIPLY_TRANSPOSED,
+      VECTOR3_MULTIPLY,
+      VECTOR3_CROSS,
+      MATRIX6_MULTIPLY,
+      MATRIX6_TRANSPOSED_MULTIPLY,
+      MATRIX6_MULTIPLY_TRANSPOSED,
+      MATRIX6_OUTER_PRODUCT,
+      MATRIX6_SIMILARITY_XFORM,
+      VECTOR6_XFORM,
+      QUATERNION_MULTIPLY,
+      FRAME_MULTIPLY,
+      FRAME_XFORM
+    } primitive_t;
+
+    explicit TaoMathCase(primitive_t primitive)
+      : primitive_(primitive)
+    {
+      for (int ii(0); ii < 6; ++ii) {
+	for (int jj(0); jj < 6; ++jj) {
+	  m6a_.elementAt(ii, jj) = deFloat(rand()) / RAND_MAX - 0.5;
+	  m6b_.elementAt(ii, jj) = deFloat(rand()) / RAND_MAX - 0.5;
+	}
+	v6_.elementAt(ii) = deFloat(rand()) / RAND_MAX - 0.5;
+      }
+      m3a_ = m6a_[0][0];
+      m3b_ = m6b_[1][1];
+      v3_ = v6_[0];
+      deQuaternion qa, qb;
+      qa.set(v6_[1], 0.3);
+      qb.set(v6_[0], -1.2);
+      fa_.set(qa, v6_[0]);
+      fb_.set(qb, v6_[1]);
+      xform_.set(fa_);
+    }
+
+    virtual void run() {
+      switch (primitive_) {
+      case MATRIX3_MULTIPLY:            m3_.multiply(m3a_, m3b_); break;
+      case MATRIX3_MULTIPLY_TRANSPOSED: m3_.multiplyTransposed(m3a_, m3b_); break;
+      case VECTOR3_MULTIPLY:            v3out_.multiply(m3a_, v3_); break;
+      case VECTOR3_CROSS:               v3out_.crossMultiply(v3_, v6_[1]); break;
+      case MATRIX6_MULTIPLY:            m6_.multiply(m6a_, m6b_); break;
+      case MATRIX6_TRANSPOSED_MULTIPLY: m6_.transposedMultiply(m6a_, m6b_); break;
+      case MATRIX6_MULTIPLY_TRANSPOSED: m6_.multiplyTransposed(m6a_, m6b_); break;
+      case MATRIX6_OUTER_PRODUCT:       m6_.multiplyTransposed(v6_, v6_); break;
+      case MATRIX6_SIMILARITY_XFORM:    m6_.similarityXform(xform_, m6a_); break;
+      case VECTOR6_XFORM:               v6out_.xform(xform_, v6_); break;
+      case QUATERNION_MULTIPLY:         f_.rotation().multiply(fa_.rotation(), fb_.rotation()); break;
+      case FRAME_MULTIPLY:              f_.multiply(fa_, fb_); break;
+      case FRAME_XFORM:                 v3out_.multiply(fa_, v3_); break;
+      }
+    }
+
+  protected:
+    primitive_t const primitive_;
+    deMatrix3 m3a_, m3b_, m3_;
+    deVector3 v3_, v3out_;
+    deMatrix6 m6a_, m6b_, m6_;
+    deVector6 v6_, v6out_;
+    deFrame fa_, fb_, f_;
+    deTransform xform_;
+  };
+
+
+  class XmlParseCase
+    : public BenchmarkCase
+  {
+  public:
+    typedef enum {
+      DOM,			// TiXmlDocument, one allocation per node and string
+      IN_SITU,			// TiXmlInSituDocument, mapped and parsed in place
+      MODEL			// the whole SAI parser, up to a jspace::Model
+    } parser_t;
+
+    XmlParseCase(string const & filename, parser_t parser)
+      : filename_(filename), parser_(parser) {}
+
+    virtual void run() {
+      switch (parser_) {
+      case DOM:
+	{
+	  wbc_tinyxml::TiXmlDocument doc;
+	  doc.LoadFile(filename_.c_str());
+	}
+	break;
+      case IN_SITU:
+	{
+	  wbc_tinyxml::TiXmlInSituDocument doc;
+	  doc.LoadFile(filename_.c_str());
+	}
+	break;
+      case MODEL:
+	delete jspace::test::parse_sai_xml_file(filename_, false);
+	break;
+      }
+    }
+
+  protected:
+    string const filename_;
+    parser_t const parser_;
+  };
+
+
+  class FactoryCase
+    : public BenchmarkCase
+  {
+  public:
+    explicit FactoryCase(string const & filename)
+      : filename_(filename) {}
+
+    virtual void run() {
+      Factory factory;
+      status_ = factory.parseFile(filename_);
+    }
+
+    Status status_;
+
+  protected:
+    string const filename_;
+  };
+
+
+}
+
+
+static string basename_noext(string const & path)
+{
+  size_t const slash(path.find_last_of('/'));
+  string name(string::npos == slash ? path : path.substr(slash + 1));
+  size_t const dot(name.find_last_of('.'));
+  if (string::npos != dot) {
+    name.resize(dot);
+  }
+  return name;
+}
+
+
+// A serial chain of nlinks identical links with revolute joints
+// around alternating axes, in a random configuration.
+static taoNodeRoot * create_snake(size_t nlinks)
+{
+  deFrame frame;
+  frame.identity();
+  taoNodeRoot * root(new taoNodeRoot(frame));
+  taoDNode * parent(root);
+  for (size_t ii(0); ii < nlinks; ++ii) {
+    frame.translation().set(0.0, 0.0, 0.1);
+    taoNode * node(new taoNode(parent, &frame));
+    deFrame com;
+    com.identity();
+    com.translation().set(0.0, 0.0, 0.05);
+    deMassProp mp;
+    mp.inertia(0.001, 0.001, 0.0005, &com);
+    mp.mass(0.5, &com);
+    mp.get(node->mass(), node->center(), node->inertia());
+    node->setID(ii);
+    taoJoint * joint(new taoJointRevolute(0 == ii % 2 ? TAO_AXIS_X : TAO_AXIS_Y));
+    joint->setDVar(new taoVarDOF1);
+    joint->reset();
+    deFloat const qq(0.3 * (2.0 * rand() / RAND_MAX - 1.0));
+    joint->setQ(&qq);
+    deFloat const dq(0.1 * (2.0 * rand() / RAND_MAX - 1.0));
+    joint->setDQ(&dq);
+    joint->setDamping(0.0);
+    joint->setInertia(0.0);
+    node->addJoint(joint);
+    node->addABNode();
+    parent = node;
+  }
+  taoDynamics::initialize(root);
+  return root;
+}
+
+
+// Stacks ntasks SelectedJointPostureTask instances which share the
+// unconstrained DOF among themselves in round-robin fashion. That
+// exercises all the nullspace projections of the controller while
+// only depending on the number of joints, not on any link names.
+static shared_ptr<GenericSkill> create_stacked_skill(Model const & model, size_t ntasks)
+{
+  size_t const ndof(model.getNDOF());
+  Vector constrained;
+  if ( ! model.getConstrained(constrained)) {
+    constrained = Vector::Zero(ndof);
+  }
+  vector<Vector> selection(ntasks, Vector::Zero(ndof));
+  vector<size_t> ndim(ntasks, 0);
+  size_t itask(0);
+  for (size_t ii(0); ii < ndof; ++ii) {
+    if (constrained[ii] < 0.5) {
+      selection[itask][ii] = 1.0;
+      ++ndim[itask];
+      itask = (itask + 1) % ntasks;
+    }
+  }
+
+  shared_ptr<GenericSkill> skill(new GenericSkill("stack"));
+  for (itask = 0; itask < ntasks; ++itask) {
+    if (0 == ndim[itask]) {
+      return shared_ptr<GenericSkill>();
+    }
+    ostringstream name;
+    name << "task" << itask;
+    shared_ptr<Task> task(new SelectedJointPostureTask(name.str()));
+    Vector const goalpos(0.1 * Vector::Ones(ndim[itask]));
+    Vector const kp(100.0 * Vector::Ones(ndim[itask]));
+    Vector const kd(20.0 * Vector::Ones(ndim[itask]));
+    if ( ! task->lookupParameter("selection", PARAMETER_TYPE_VECTOR)->set(selection[itask])
+	 || ! task->lookupParameter("goalpos", PARAMETER_TYPE_VECTOR)->set(goalpos)
+	 || ! task->lookupParameter("kp", PARAMETER_TYPE_VECTOR)->set(kp)
+	 || ! task->lookupParameter("kd", PARAMETER_TYPE_VECTOR)->set(kd)) {
+      return shared_ptr<GenericSkill>();
+    }
+    skill->appendTask(task);
+  }
+  return skill;
+}
+
+
+static void usage(int ecode, string const & msg)
+{
+  errx(ecode,
+       "%s\n"
+       "  options:\n"
+       "  -h                   help (this message)\n"
+       "  -v                   print a human-readable summary to stderr\n"
+       "  -o  <filename>       write JSON results to file (default `-' is stdout)\n"
+       "  -b  <filename>       compare against baseline JSON results\n"
+       "  -t  <fraction>       slowdown tolerated before flagging a regression (default 0.1)\n"
+       "  -n  <count>          number of samples per benchmark (default 200)\n"
+       "  -c                   enable the Coriolis-centrifugal model\n"
+       "  -m  <file>[:<constr>] robot (SAI XML) with optional constraint name, can be repeated\n"
+       "  -y  <filename>       skill specification (YAML) for Factory::parseFile(), can be repeated",
+       msg.c_str());
+}
+
+
+int main(int argc, char ** argv)
+{
+  Factory::addSkillType<uta_opspace::HelloGoodbyeSkill>("uta_opspace::HelloGoodbyeSkill");
+  Factory::addSkillType<uta_opspace::TaskOriPostureSkill>("uta_opspace::TaskPostureSkill");
+  Factory::addSkillType<uta_opspace::JointMultiPos>("uta_opspace::JointMultiPos");
+  Factory::addSkillType<uta_opspace::CartMultiPos>("uta_opspace::CartMultiPos");
+  Factory::addSkillType<uta_opspace::BaseMultiPos>("uta_opspace::BaseMultiPos");
+
+  //////////////////////////////////////////////////
+  // parse options
+
+  bool verbose(false);
+  string outfname("-");
+  string basefname("");
+  double tolerance(0.1);
+  size_t nsamples(200);
+  bool enable_coriolis_centrifugal(false);
+  vector<robot_spec_s> robots;
+  vector<string> skillfiles;
+
+  for (int ii(1); ii < argc; ++ii) {
+    string const opt(argv[ii]);
+    if ("-h" == opt) {
+      usage(EXIT_SUCCESS, "wbc_benchmark [-hvc] [-o out] [-b baseline] [-t tol] [-n count] [-m robot] [-y skills]");
+    }
+    else if ("-v" == opt) {
+      verbose = true;
+    }
+    else if ("-c" == opt) {
+      enable_coriolis_centrifugal = true;
+    }
+    else if (("-o" == opt) || ("-b" == opt) || ("-t" == opt)
+	     || ("-n" == opt) || ("-m" == opt) || ("-y" == opt)) {
+      ++ii;
+      if (ii >= argc) {
+	usage(EXIT_FAILURE, opt + " requires parameter");
+      }
+      string const arg(argv[ii]);
+      if ("-o" == opt) {
+	outfname = arg;
+      }
+      else if ("-b" == opt) {
+	basefname = arg;
+      }
+      else if ("-t" == opt) {
+	istringstream is(arg);
+	if ( ! (is >> tolerance) || (tolerance < 0)) {
+	  usage(EXIT_FAILURE, "invalid tolerance `" + arg + "'");
+	}
+      }
+      else if ("-n" == opt) {
+	istringstream is(arg);
+	if ( ! (is >> nsamples) || (0 == nsamples)) {
+	  usage(EXIT_FAILURE, "invalid sample count `" + arg + "'");
+	}
+      }
+      else if ("-m" == opt) {
+	robot_spec_s spec;
+	size_t const colon(arg.find(':'));
+	spec.filename = arg.substr(0, colon);
+	if (string::npos != colon) {
+	  spec.constraint = arg.substr(colon + 1);
+	}
+	spec.name = basename_noext(spec.filename);
+	robots.push_back(spec);
+      }
+      else {
+	skillfiles.push_back(arg);
+      }
+    }
+    else {
+      usage(EXIT_FAILURE, "invalid option `" + opt + "'");
+    }
+  }
+
+  if (robots.empty()) {
+    static char const * defaults[][2] = {
+      { "/wbc_core/stanford_wbc/tutorials/tutrob.xml", "" },
+      { "/wbc_m3_ctrl/base_config/trikey.xml", "Dreamer_Base" },
+      { "/wbc_m3_ctrl/upperbody_config/upperbody.xml", "Dreamer_Torso" },
+      { "/wbc_m3_ctrl/full_config/dreamer.xml", "Dreamer_Full" },
+      { 0, 0 }
+    };
+    for (size_t ii(0); 0 != defaults[ii][0]; ++ii) {
+      robot_spec_s spec;
+      spec.filename = string(WBC_BENCHMARK_STACK_DIR) + defaults[ii][0];
+      spec.constraint = defaults[ii][1];
+      spec.name = basename_noext(spec.filename);
+      robots.push_back(spec);
+    }
+  }
+  if (skillfiles.empty()) {
+    skillfiles.push_back(string(WBC_BENCHMARK_STACK_DIR) + "/wbc_m3_ctrl/full_config/opspace_task.yaml");
+    skillfiles.push_back(string(WBC_BENCHMARK_STACK_DIR) + "/wbc_m3_ctrl/full_config/follow.yaml");
+    skillfiles.push_back(string(WBC_BENCHMARK_STACK_DIR) + "/wbc_m3_ctrl/upperbody_config/reach.yaml");
+  }
+
+  BenchmarkLog log("wbc_benchmark");
+  srand(42);
+
+  //////////////////////////////////////////////////
+  // model and controller, for each robot
+
+  for (size_t ir(0); ir < robots.size(); ++ir) {
+    robot_spec_s const & spec(robots[ir]);
+    shared_ptr<Model> model;
+    try {
+      model.reset(jspace::test::parse_sai_xml_file(spec.filename, enable_coriolis_centrifugal));
+    }
+    catch (runtime_error const & ee) {
+      warnx("skipping robot %s: %s", spec.filename.c_str(), ee.what());
+      continue;
+    }
+    if (( ! spec.constraint.empty()) && ( ! model->getConstraint())
+	&& ( ! model->setConstraint(spec.constraint))) {
+      warnx("skipping robot %s: invalid constraint `%s'", spec.filename.c_str(), spec.constraint.c_str());
+      continue;
+    }
+
+    // State holds the actuated DOF, the model fills in the rest.
+    size_t const ndof(model->getNDOF());
+    size_t const nact(model->getUnconstrainedNDOF());
+    State state(nact, nact, nact);
+    state.position_ = 0.3 * Vector::Random(nact);
+    state.velocity_ = 0.1 * Vector::Random(nact);
+    state.orientation_mtx_ = Matrix::Identity(3, 3);
+    model->update(state);
+
+    string const prefix(spec.name + "/");
+    {
+      XmlParseCase bc(spec.filename, XmlParseCase::DOM);
+      log.run(prefix + "xml.parse.dom", bc, nsamples);
+    }
+    {
+      XmlParseCase bc(spec.filename, XmlParseCase::IN_SITU);
+      log.run(prefix + "xml.parse.insitu", bc, nsamples);
+    }
+    {
+      XmlParseCase bc(spec.filename, XmlParseCase::MODEL);
+      log.run(prefix + "xml.parse.model", bc, (nsamples + 9) / 10, 1);
+    }
+    {
+      ModelStageCase bc(*model, state, ModelStageCase::UPDATE);
+      log.run(prefix + "model.update", bc, nsamples);
+    }
+    {
+      ModelStageCase bc(*model, state, ModelStageCase::SET_STATE);
+      log.run(prefix + "model.setState", bc, nsamples);
+    }
+    {
+      ModelStageCase bc(*model, state, ModelStageCase::KINEMATICS);
+      log.run(prefix + "model.updateKinematics", bc, nsamples);
+    }
+    {
+      ModelStageCase bc(*model, state, ModelStageCase::GRAVITY);
+      log.run(prefix + "model.computeGravity", bc, nsamples);
+    }
+    if (enable_coriolis_centrifugal) {
+      ModelStageCase bc(*model, state, ModelStageCase::CORIOLIS_CENTRIFUGAL);
+      log.run(prefix + "model.computeCoriolisCentrifugal", bc, nsamples);
+    }
+    {
+      ModelStageCase bc(*model, state, ModelStageCase::MASS_INERTIA);
+      log.run(prefix + "model.computeMassInertia", bc, nsamples);
+    }
+    {
+      ModelStageCase bc(*model, state, ModelStageCase::INVERSE_MASS_INERTIA);
+      log.run(prefix + "model.computeInverseMassInertia", bc, nsamples);
+    }
+    {
+      // the last node is the tip of the longest chain in all our models
+      JacobianCase bc(*model, model->getNode(ndof - 1));
+      log.run(prefix + "model.computeJacobian", bc, nsamples);
+    }
+    {
+      JacobianProductCase bc(*model, model->getNode(ndof - 1), false);
+      log.run(prefix + "jacobian.products.dense", bc, nsamples);
+    }
+    {
+      JacobianProductCase bc(*model, model->getNode(ndof - 1), true);
+      log.run(prefix + "jacobian.products.sparse", bc, nsamples);
+    }
+
+    {
+      jspace::DynamicsDerivatives derivatives;
+      jspace::Status const st(derivatives.init(*model));
+      if ( ! st) {
+	warnx("%s: skipping derivatives: %s", spec.name.c_str(), st.errstr.c_str());
+      }
+      else {
+	for (size_t ii(0); ii < 2; ++ii) {
+	  bool const inverse_dynamics(1 == ii);
+	  if (inverse_dynamics && ! enable_coriolis_centrifugal) {
+	    break;
+	  }
+	  string const id(prefix + (inverse_dynamics ? "derivatives.invDynamics" : "derivatives.gravity"));
+	  {
+	    DerivativesCase bc(*model, derivatives, state, inverse_dynamics, true);
+	    log.run(id + "/analytical", bc, nsamples);
+	  }
+	  {
+	    DerivativesCase bc(*model, derivatives, state, inverse_dynamics, false);
+	    log.run(id + "/perturbation", bc, (nsamples + 9) / 10, 1);
+	  }
+	}
+      }
+    }
+
+    for (size_t ntasks(1); ntasks <= 6; ++ntasks) {
+      shared_ptr<GenericSkill> skill(create_stacked_skill(*model, ntasks));
+      if ( ! skill) {
+	if (verbose) {
+	  warnx("%s: not enough DOF for %zu stacked tasks", spec.name.c_str(), ntasks);
+	}
+	break;
+      }
+      ControllerNG controller("benchmark");
+      Vector gamma;
+      Status st(skill->init(*model));
+      if (st) {
+	st = controller.init(*model);
+      }
+      if (st) {
+	st = controller.computeCommand(*model, *skill, gamma);
+      }
+      if ( ! st) {
+	warnx("%s: skipping controller with %zu tasks: %s",
+	      spec.name.c_str(), ntasks, st.errstr.c_str());
+	continue;
+      }
+      ostringstream id;
+      id << prefix << "controllerNG.computeCommand/" << ntasks;
+      ControllerCase bc(*model, controller, *skill);
+      log.run(id.str(), bc, nsamples);
+      
+      // The QP hierarchy on the same skill, with the joint limits of
+      // the model and torque limits which are generous enough to stay
+      // inactive but still get their rows set up and checked.
+      ControllerHQP hqp("benchmark_hqp");
+      Vector const torque_limit(1e4 * Vector::Ones(model->getNDOF()));
+      st = hqp.lookupParameter("torque_limit", PARAMETER_TYPE_VECTOR)->set(torque_limit);
+      if (st) {
+	st = hqp.init(*model);
+      }
+      if (st) {
+	st = hqp.computeCommand(*model, *skill, gamma);
+      }
+      if (st) {
+	ostringstream hid;
+	hid << prefix << "controllerHQP.computeCommand/" << ntasks;
+	ControllerCase hc(*model, hqp, *skill);
+	log.run(hid.str(), hc, nsamples);
+      }
+      else if (verbose) {
+	warnx("%s: skipping QP controller with %zu tasks: %s",
+	      spec.name.c_str(), ntasks, st.errstr.c_str());
+      }
+      
+      // Same hierarchy in single precision, guard off so that only
+      // the float path gets timed. Afterwards, one guarded tick says
+      // how far float is from double for this robot and task count.
+      if ( ! controller.lookupParameter("single_precision", PARAMETER_TYPE_INTEGER)->set(1)
+	   || ! controller.lookupParameter("guard_period", PARAMETER_TYPE_INTEGER)->set(0)) {
+	warnx("%s: failed to switch controller to single precision", spec.name.c_str());
+	continue;
+      }
+      log.run(id.str() + "/float", bc, nsamples);
+      if (verbose) {
+	controller.lookupParameter("guard_period", PARAMETER_TYPE_INTEGER)->set(1);
+	controller.computeCommand(*model, *skill, gamma);
+	double const * err(controller.lookupParameter("guard_max_error", PARAMETER_TYPE_REAL)->getReal());
+	warnx("%s: %zu tasks, float vs double max |dgamma| = %g",
+	      spec.name.c_str(), ntasks, err ? *err : -1.0);
+      }
+    }
+  }
+
+  //////////////////////////////////////////////////
+  // robot-independent pieces
+
+  {
+    static size_t const dim[] = { 1, 2, 3, 6, 9, 12, 19, 0 };
+    for (size_t ii(0); 0 != dim[ii]; ++ii) {
+      ostringstream id;
+      id << "pseudoInverse/" << dim[ii];
+      PseudoInverseCase bc(dim[ii]);
+      log.run(id.str(), bc, nsamples);
+    }
+  }
+
+  {
+    static size_t const ndof[] = { 1, 3, 7, 12, 0 };
+    for (size_t ii(0); 0 != ndof[ii]; ++ii) {
+      {
+	ostringstream id;
+	id << "TypeIOTGCursor.next/" << ndof[ii];
+	CursorCase bc(ndof[ii], false);
+	log.run(id.str(), bc, nsamples);
+      }
+      {
+	ostringstream id;
+	id << "TypeIOTGCursor.next.phase_sync/" << ndof[ii];
+	CursorCase bc(ndof[ii], true);
+	log.run(id.str(), bc, nsamples);
+      }
+    }
+  }
+
+  {
+    static size_t const npoints[] = { 4, 16, 64, 0 };
+    for (size_t ii(0); 0 != npoints[ii]; ++ii) {
+      ostringstream id;
+      id << "ViaPointTrajectory.evaluate/" << npoints[ii];
+      ViaPointCase bc(npoints[ii]);
+      log.run(id.str(), bc, nsamples);
+    }
+  }
+
+  {
+    static size_t const nlinks[] = { 7, 30, 100, 0 };
+    for (size_t ii(0); 0 != nlinks[ii]; ++ii) {
+      shared_ptr<taoNodeRoot> snake(create_snake(nlinks[ii]));
+      ostringstream prefix;
+      prefix << "tao.snake/" << nlinks[ii] << "/";
+      {
+	TaoSweepCase bc(snake.get(), TaoSweepCase::UPDATE_TRANSFORMATION);
+	log.run(prefix.str() + "updateTransformation", bc, nsamples);
+      }
+      {
+	TaoSweepCase bc(snake.get(), TaoSweepCase::INV_DYNAMICS);
+	log.run(prefix.str() + "invDynamics", bc, nsamples);
+      }
+      {
+	TaoSweepCase bc(snake.get(), TaoSweepCase::FWD_DYNAMICS);
+	log.run(prefix.str() + "fwdDynamics", bc, nsamples);
+      }
+    }
+  }
+
+  {
+    static struct {
+      char const * id;
+      TaoMathCase::primitive_t primitive;
+    } const primitive[] = {
+      { "deMatrix3.multiply", TaoMathCase::MATRIX3_MULTIPLY },
+      { "deMatrix3.multiplyTransposed", TaoMathCase::MATRIX3_MULTIPLY_TRANSPOSED },
+      { "deVector3.multiply", TaoMathCase::VECTOR3_MULTIPLY },
+      { "deVector3.crossMultiply", TaoMathCase::VECTOR3_CROSS },
+      { "deMatrix6.multiply", TaoMathCase::MATRIX6_MULTIPLY },
+      { "deMatrix6.transposedMultiply", TaoMathCase::MATRIX6_TRANSPOSED_MULTIPLY },
+      { "deMatrix6.multiplyTransposed", TaoMathCase::MATRIX6_MULTIPLY_TRANSPOSED },
+      { "deMatrix6.multiplyTransposed.vector", TaoMathCase::MATRIX6_OUTER_PRODUCT },
+      { "deMatrix6.similarityXform", TaoMathCase::MATRIX6_SIMILARITY_XFORM },
+      { "deVector6.xform", TaoMathCase::VECTOR6_XFORM },
+      { "deQuaternion.multiply", TaoMathCase::QUATERNION_MULTIPLY },
+      { "deFrame.multiply", TaoMathCase::FRAME_MULTIPLY },
+      { "deVector3.multiply.frame", TaoMathCase::FRAME_XFORM },
+      { 0, TaoMathCase::MATRIX3_MULTIPLY }
+    };
+    for (size_t ii(0); 0 != primitive[ii].id; ++ii) {
+      TaoMathCase bc(primitive[ii].primitive);
+      log.run(string("tao.math/") + primitive[ii].id, bc, nsamples);
+    }
+  }
+
+  for (size_t ii(0); ii < skillfiles.size(); ++ii) {
+    FactoryCase bc(skillfiles[ii]);
+    bc.run();
+    if ( ! bc.status_) {
+      warnx("skipping skill file %s: %s", skillfiles[ii].c_str(), bc.status_.errstr.c_str());
+      continue;
+    }
+    // parsing takes a while, no need for hundreds of samples
+    log.run("Factory.parseFile/" + basename_noext(skillfiles[ii]), bc, (nsamples + 9) / 10, 1);
+  }
+
+  //////////////////////////////////////////////////
+  // output
+
+  if ("-" == outfname) {
+    log.writeJSON(cout);
+  }
+  else {
+    ofstream os(outfname.c_str());
+    if ( ! os) {
+      errx(EXIT_FAILURE, "failed to open `%s' for writing", outfname.c_str());
+    }
+    log.writeJSON(os);
+  }
+  if (verbose) {
+    log.writeSummary(cerr);
+  }
+
+  if ( ! basefname.empty()) {
+    ifstream is(basefname.c_str());
+    if ( ! is) {
+      errx(EXIT_FAILURE, "failed to open baseline `%s'", basefname.c_str());
+    }
+    map<string, double> baseline;
+    if ( ! BenchmarkLog::readBaseline(is, baseline)) {
+      errx(EXIT_FAILURE, "no results in baseline `%s'", basefname.c_str());
+    }
+    size_t const nregressions(log.compare(baseline, tolerance, cerr));
+    if (0 != nregressions) {
+      errx(EXIT_FAILURE, "%zu regressions (tolerance %g)", nregressions, tolerance);
+    }
+  }
+
+  return 0;
+}
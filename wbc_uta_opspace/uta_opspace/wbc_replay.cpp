@@ -0,0 +1,366 @@
+/*
+ * Shared copyright notice and LGPLv3 license statement.
+ *
+ * Copyright (C) 2011 University of Texas at Austin. All rights reserved.
+ *
+ * Authors: Roland Philippsen and Josh Petersen (UT Austin)
+ *          http://www.me.utexas.edu/~hcrl/
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+/**
+   \file wbc_replay.cpp
+
+   Offline replay of servo sessions recorded with the -R option of
+   the servo (see uta_opspace::SessionRecorder). The recorded states
+   and parameter writes are fed to a fresh ControllerNG and
+   SkillSwitch, as fast as possible, and each command gets compared
+   bit for bit with the recorded one, e.g.
+
+   \verbatim
+   servo -r robot.xml -s skills.yaml -R session.bin
+   ...hack hack hack...
+   wbc_replay -r robot.xml -s skills.yaml -i session.bin -o timing.txt
+   \endverbatim
+   
+   The timing file has one line per tick: the tick number, the
+   recorded and the replayed duration in nanoseconds, whether the
+   command matched exactly, and the largest absolute deviation.
+*/
+
+#include "SessionRecorder.hpp"
+#include "ControllerNG.hpp"
+#include "HelloGoodbyeSkill.hpp"
+#include "TaskOriPostureSkill.hpp"
+#include "CartMultiPos.hpp"
+#include "JointMultiPos.hpp"
+#include "BaseMultiPos.hpp"
+#include <opspace/Factory.hpp>
+#include <opspace/SkillSwitch.hpp>
+#include <jspace/Model.hpp>
+#include <jspace/test/sai_util.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <iostream>
+#include <fstream>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+using namespace uta_opspace;
+using boost::shared_ptr;
+using boost::scoped_ptr;
+using namespace std;
+
+
+static long long now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+static void usage(int ecode, string const & msg)
+{
+  errx(ecode,
+       "%s\n"
+       "  options:\n"
+       "  -h                   help (this message)\n"
+       "  -v                   report parameter writes and mismatches as they happen\n"
+       "  -i  <filename>       session recording (required)\n"
+       "  -r  <filename>       robot specification, SAI XML (required)\n"
+       "  -C  <constraint>     constraint to set on the model (e.g. Dreamer_Full)\n"
+       "  -c                   enable the Coriolis-centrifugal model\n"
+       "  -s  <filename>       skill specification, YAML (required)\n"
+       "  -n  <name>           instance name of the controller and the skill switch\n"
+       "                       (default wbc_m3_ctrl::servo)\n"
+       "  -1                   only initialize and run the first skill, without a\n"
+       "                       skill switch (for sessions recorded by teleop)\n"
+       "  -o  <filename>       write per-tick timing and comparison (`-' is stdout)",
+       msg.c_str());
+}
+
+
+int main(int argc, char ** argv)
+{
+  Factory::addSkillType<uta_opspace::HelloGoodbyeSkill>("uta_opspace::HelloGoodbyeSkill");
+  Factory::addSkillType<uta_opspace::TaskOriPostureSkill>("uta_opspace::TaskPostureSkill");
+  Factory::addSkillType<uta_opspace::JointMultiPos>("uta_opspace::JointMultiPos");
+  Factory::addSkillType<uta_opspace::CartMultiPos>("uta_opspace::CartMultiPos");
+  Factory::addSkillType<uta_opspace::BaseMultiPos>("uta_opspace::BaseMultiPos");
+  
+  //////////////////////////////////////////////////
+  // parse options
+  
+  bool verbose(false);
+  string session_file("");
+  string robot_spec("");
+  string constraint("");
+  bool enable_coriolis_centrifugal(false);
+  string skill_spec("");
+  string name("wbc_m3_ctrl::servo");
+  bool first_skill_only(false);
+  string outfname("");
+  
+  for (int ii(1); ii < argc; ++ii) {
+    string const opt(argv[ii]);
+    if ("-h" == opt) {
+      usage(EXIT_SUCCESS, "wbc_replay [-hvc1] [-C constraint] [-n name] [-o out] -i session -r robot -s skills");
+    }
+    else if ("-v" == opt) {
+      verbose = true;
+    }
+    else if ("-c" == opt) {
+      enable_coriolis_centrifugal = true;
+    }
+    else if ("-1" == opt) {
+      first_skill_only = true;
+    }
+    else if (("-i" == opt) || ("-r" == opt) || ("-C" == opt)
+	     || ("-s" == opt) || ("-n" == opt) || ("-o" == opt)) {
+      ++ii;
+      if (ii >= argc) {
+	usage(EXIT_FAILURE, opt + " requires parameter");
+      }
+      string const arg(argv[ii]);
+      if ("-i" == opt) {
+	session_file = arg;
+      }
+      else if ("-r" == opt) {
+	robot_spec = arg;
+      }
+      else if ("-C" == opt) {
+	constraint = arg;
+      }
+      else if ("-s" == opt) {
+	skill_spec = arg;
+      }
+      else if ("-n" == opt) {
+	name = arg;
+      }
+      else {
+	outfname = arg;
+      }
+    }
+    else {
+      usage(EXIT_FAILURE, "invalid option `" + opt + "'");
+    }
+  }
+  if (session_file.empty()) {
+    usage(EXIT_FAILURE, "no session recording (see option -i)");
+  }
+  if (robot_spec.empty()) {
+    usage(EXIT_FAILURE, "no robot specification (see option -r)");
+  }
+  if (skill_spec.empty()) {
+    usage(EXIT_FAILURE, "no skill specification (see option -s)");
+  }
+  
+  //////////////////////////////////////////////////
+  // load everything and set up the controller like the servo does
+  
+  SessionLog session;
+  Status st(session.load(session_file));
+  if ( ! st) {
+    errx(EXIT_FAILURE, "%s", st.errstr.c_str());
+  }
+  
+  scoped_ptr<jspace::Model> model;
+  try {
+    model.reset(jspace::test::parse_sai_xml_file(robot_spec, enable_coriolis_centrifugal));
+  }
+  catch (runtime_error const & ee) {
+    errx(EXIT_FAILURE, "failed to parse robot specification %s: %s", robot_spec.c_str(), ee.what());
+  }
+  if (( ! constraint.empty()) && ( ! model->getConstraint())
+      && ( ! model->setConstraint(constraint))) {
+    errx(EXIT_FAILURE, "invalid constraint `%s'", constraint.c_str());
+  }
+  
+  shared_ptr<Factory> factory(new Factory());
+  st = factory->parseFile(skill_spec);
+  if ( ! st) {
+    errx(EXIT_FAILURE, "failed to parse skills from %s: %s", skill_spec.c_str(), st.errstr.c_str());
+  }
+  if (factory->getSkillTable().empty()) {
+    errx(EXIT_FAILURE, "no skills in %s", skill_spec.c_str());
+  }
+  
+  shared_ptr<ControllerNG> controller(new ControllerNG(name));
+  shared_ptr<SkillSwitch> skill_switch(new SkillSwitch(name));
+  shared_ptr<ReflectionRegistry> registry(factory->createRegistry());
+  registry->add(controller);
+  registry->add(skill_switch);
+  
+  size_t nparam(0);
+  size_t nparamfail(0);
+  vector<SessionLog::parameter_s> const & params(session.parameters);
+  for (/**/; (nparam < params.size()) && (0 > params[nparam].tick); ++nparam) {
+    st = SessionLog::apply(params[nparam], *registry);
+    if ( ! st) {
+      // The snapshot contains everything writable, some of which
+      // (e.g. goals before the skill is initialized) may legitimately
+      // get rejected at this point.
+      ++nparamfail;
+      if (verbose) {
+	warnx("initial parameter: %s", st.errstr.c_str());
+      }
+    }
+  }
+  
+  model->update(session.init_state);
+  st = controller->init(*model);
+  if ( ! st) {
+    errx(EXIT_FAILURE, "controller->init() failed: %s", st.errstr.c_str());
+  }
+  Skill * skill(0);
+  if (first_skill_only) {
+    skill = factory->getSkillTable()[0].get();
+    st = skill->init(*model);
+  }
+  else {
+    st = skill_switch->init(*model, factory->getSkillTable());
+  }
+  if ( ! st) {
+    errx(EXIT_FAILURE, "skill init failed: %s", st.errstr.c_str());
+  }
+  
+  ostream * os(0);
+  ofstream ofs;
+  if ("-" == outfname) {
+    os = &cout;
+  }
+  else if ( ! outfname.empty()) {
+    ofs.open(outfname.c_str());
+    if ( ! ofs) {
+      errx(EXIT_FAILURE, "failed to open %s for writing", outfname.c_str());
+    }
+    os = &ofs;
+  }
+  if (os) {
+    *os << "# tick recorded_ns replay_ns match max_deviation\n";
+  }
+  
+  //////////////////////////////////////////////////
+  // the replay loop
+  
+  Vector command;
+  long long nmismatch(0);
+  long long first_mismatch(-1);
+  long long ngaps(0);
+  long long sum_recorded_ns(0);
+  long long max_recorded_ns(0);
+  long long sum_replay_ns(0);
+  long long max_replay_ns(0);
+  double max_deviation(0);
+  
+  for (size_t it(0); it < session.ticks.size(); ++it) {
+    SessionLog::tick_s const & tick(session.ticks[it]);
+    if ((0 < it) && (tick.tick != session.ticks[it - 1].tick + 1)) {
+      // Dropped ticks mean the replayed skills see a different
+      // history, so expect mismatches from here on.
+      ++ngaps;
+      if (verbose) {
+	warnx("gap before tick %lld", tick.tick);
+      }
+    }
+    
+    for (/**/; (nparam < params.size()) && (params[nparam].tick <= tick.tick); ++nparam) {
+      st = SessionLog::apply(params[nparam], *registry);
+      if ( ! st) {
+	++nparamfail;
+      }
+      if (verbose) {
+	warnx("tick %lld: %s/%s/%s%s%s", tick.tick,
+	      params[nparam].type_name.c_str(), params[nparam].instance_name.c_str(),
+	      params[nparam].parameter_name.c_str(),
+	      st ? "" : " FAILED: ", st.errstr.c_str());
+      }
+    }
+    
+    long long const t0(now_ns());
+    model->update(tick.state);
+    if ( ! first_skill_only) {
+      skill_switch->update(*model);
+      skill = skill_switch->getActive();
+    }
+    st = controller->computeCommand(*model, *skill, command);
+    long long const dt(now_ns() - t0);
+    
+    bool match(st.ok && (command.size() == tick.command.size()));
+    double deviation(0);
+    if (match) {
+      match = (0 == memcmp(command.data(), tick.command.data(), command.size() * sizeof(double)));
+      if ( ! match) {
+	deviation = (command - tick.command).cwise().abs().maxCoeff();
+      }
+    }
+    if ( ! match) {
+      ++nmismatch;
+      if (0 > first_mismatch) {
+	first_mismatch = tick.tick;
+      }
+      if (deviation > max_deviation) {
+	max_deviation = deviation;
+      }
+      if (verbose) {
+	if ( ! st) {
+	  warnx("tick %lld: computeCommand() failed: %s", tick.tick, st.errstr.c_str());
+	}
+	else {
+	  warnx("tick %lld: command differs by %g", tick.tick, deviation);
+	}
+      }
+    }
+    
+    sum_recorded_ns += tick.duration_ns;
+    if (tick.duration_ns > max_recorded_ns) {
+      max_recorded_ns = tick.duration_ns;
+    }
+    sum_replay_ns += dt;
+    if (dt > max_replay_ns) {
+      max_replay_ns = dt;
+    }
+    if (os) {
+      *os << tick.tick << " " << tick.duration_ns << " " << dt << " "
+	  << (match ? 1 : 0) << " " << deviation << "\n";
+    }
+  }
+  
+  //////////////////////////////////////////////////
+  // summary
+  
+  size_t const nticks(session.ticks.size());
+  cerr << "replayed " << session_file << "\n"
+       << "  ticks:             " << nticks << "\n"
+       << "  gaps:              " << ngaps << "\n"
+       << "  parameter writes:  " << params.size() << " (" << nparamfail << " rejected)\n"
+       << "  mismatches:        " << nmismatch << "\n";
+  if (0 < nmismatch) {
+    cerr << "  first mismatch:    tick " << first_mismatch << "\n"
+	 << "  max deviation:     " << max_deviation << "\n";
+  }
+  if (0 < nticks) {
+    cerr << "  recorded mean/max: " << 1e-3 * sum_recorded_ns / nticks
+	 << " / " << 1e-3 * max_recorded_ns << " us\n"
+	 << "  replay mean/max:   " << 1e-3 * sum_replay_ns / nticks
+	 << " / " << 1e-3 * max_replay_ns << " us\n";
+  }
+  
+  return (0 == nmismatch) ? EXIT_SUCCESS : EXIT_FAILURE;
+}